@@ -238,11 +238,12 @@ def exportEnergyPlusAsFMU(showDiagnostics, litter, iddFileName, wthFileName, idf
   #
   # Populate zip file.
   #   Note fcn addToZipFile() closes the zip file if it encounters an error.
+  #   Note the export-prep application is not needed in the resources, since
+  # the shared library links the preprocessor.
   addToZipFile(workZipFile, OUT_modelDescFileName, None, None)
   addToZipFile(workZipFile, idfFileName, 'resources', modelIdName+'.idf')
   addToZipFile(workZipFile, OUT_variablesFileName, 'resources', None)
   addToZipFile(workZipFile, iddFileName, 'resources', None)
-  addToZipFile(workZipFile, exportPrepExeName, 'resources', None)
   if( wthFileName is not None ):
     addToZipFile(workZipFile, wthFileName, 'resources', None)
   addToZipFile(workZipFile, OUT_fmuSharedLibName, os.path.join('binaries',fmuBinDirName), None)
@@ -5,6 +5,7 @@
 #
 #   Compile the source code file(s) named as command-line arguments.
 # ** Use gcc/c++.
+# ** Position-independent code, so the objects can go in a shared library.
 # ** Native address size.
 
 
@@ -26,4 +27,4 @@ fi
 
 #--- Compile.
 #
-g++ -c  "$@"
+g++ -c -fPIC  "$@"
@@ -5,7 +5,7 @@
 #
 #   Link the object file(s) named as command-line arguments.
 # ** Make a shared library.
-# ** Use gcc/c.
+# ** Use gcc/c.  Link with g++, for the C++ runtime of the preprocessor library.
 # ** Native address size.
 
 
@@ -32,4 +32,4 @@ shift 1
 
 #--- Link.
 #
-gcc -shared -lm  -o "${outputName}"  "$@"
+g++ -shared -lm  -o "${outputName}"  "$@"  -lpthread
@@ -32,4 +32,4 @@ shift 1
 
 #--- Link.
 #
-g++ -lm  -o "${outputName}"  "$@"
+g++ -lm  -o "${outputName}"  "$@"  -lpthread
@@ -211,6 +211,7 @@ def makeExportPrepApp(showDiagnostics, litter, forceRebuild):
     'fmu-export-idf-data',
     'fmu-export-write-model-desc',
     'fmu-export-write-vars-cfg',
+    'fmu-export-prep-lib',
     'fmu-export-prep-main'
     ]:
     srcFileNameList.append(os.path.join(srcDirName, theRootName +'.cpp'))
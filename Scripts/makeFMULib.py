@@ -30,15 +30,18 @@ if( PLATFORM_NAME.startswith('win') ):
     PLATFORM_SHORT_NAME = 'win'
     BATCH_EXTENSION = '.bat'
     SHARED_LIB_EXTENSION = '.dll'
+    STATIC_LIB_EXTENSION = '.lib'
 elif( PLATFORM_NAME.startswith('linux')
     or PLATFORM_NAME.startswith('cygwin') ):
     PLATFORM_SHORT_NAME = 'linux'
     BATCH_EXTENSION = '.sh'
     SHARED_LIB_EXTENSION = '.so'
+    STATIC_LIB_EXTENSION = '.a'
 elif( PLATFORM_NAME.startswith('darwin') ):
     PLATFORM_SHORT_NAME = 'darwin'
     BATCH_EXTENSION = '.sh'
     SHARED_LIB_EXTENSION = '.dylib'
+    STATIC_LIB_EXTENSION = '.a'
 else:
     raise Exception('Unknown platform {' +PLATFORM_NAME +'}')
 
@@ -47,11 +50,14 @@ else:
 #
 #   This script uses separate, system-dependent, batch files to compile and
 # link source code.  For more information, see fcns printCompileCBatchInfo(),
-# printLinkCLibBatchInfo(), and printLinkCExeBatchInfo().
+# printLinkCLibBatchInfo(), printLinkCExeBatchInfo(), printCompileCppBatchInfo(),
+# and printLinkCppLibBatchInfo().
 #
 COMPILE_C_BATCH_FILE_NAME = 'compile-c' + BATCH_EXTENSION
 LINK_C_LIB_BATCH_FILE_NAME = 'link-c-lib' + BATCH_EXTENSION
 LINK_C_EXE_BATCH_FILE_NAME = 'link-c-exe' + BATCH_EXTENSION
+COMPILE_CPP_BATCH_FILE_NAME = 'compile-cpp' + BATCH_EXTENSION
+LINK_CPP_LIB_BATCH_FILE_NAME = 'link-cpp-lib' + BATCH_EXTENSION
 
 
 #--- Running this script.
@@ -87,6 +93,12 @@ def printCmdLineUsage():
   print
   printLinkCExeBatchInfo()
   #
+  print
+  printCompileCppBatchInfo()
+  #
+  print
+  printLinkCppLibBatchInfo()
+  #
   # End fcn printCmdLineUsage().
 
 
@@ -127,6 +139,31 @@ def printLinkCExeBatchInfo():
   # End fcn printLinkCExeBatchInfo().
 
 
+def printCompileCppBatchInfo():
+  #
+  print 'Require a batch file {' +COMPILE_CPP_BATCH_FILE_NAME +'}'
+  print '-- The batch file should compile C++ source code files'
+  print '-- The batch file should produce position-independent code, which can go in a shared library'
+  print '-- The batch file should accept one argument, the name (including path) of the source code file to compile'
+  print '-- The batch file should leave the resulting object file in the working directory'
+  print '-- Place the batch file in the system-specific batch directory'
+  #
+  # End fcn printCompileCppBatchInfo().
+
+
+def printLinkCppLibBatchInfo():
+  #
+  print 'Require a batch file {' +LINK_CPP_LIB_BATCH_FILE_NAME +'}'
+  print '-- The batch file should archive object files compiled via ' +COMPILE_CPP_BATCH_FILE_NAME
+  print '-- The batch file should produce a static library'
+  print '-- The batch file should accept at least two arguments, in this order:'
+  print '  ** the name of the output static library'
+  print '  ** the name(s) of the object files to archive'
+  print '-- Place the batch file in the system-specific batch directory'
+  #
+  # End fcn printLinkCppLibBatchInfo().
+
+
 #--- Fcn to print diagnostics.
 #
 def printDiagnostic(messageStr):
@@ -221,10 +258,12 @@ def sanitizeIdentifier(identifier):
 #   Replace a dummy string in {origFileName} with the required one, and save as
 # {modFileName}.
 #   Assume the dummy string occurs exactly once in {origFileName}.
+#   Follow it with a {#define} for each name in {otherDefineNameList}.
 #
 g_rexPoundDefineModelIdString = re.compile(r'^#define MODEL_IDENTIFIER(.*)$')
 #
-def poundDefineModelId(showDiagnostics, origFileName, modelIdName, modFileName):
+def poundDefineModelId(showDiagnostics, origFileName, modelIdName, modFileName,
+  otherDefineNameList):
   #
   if( showDiagnostics ):
     printDiagnostic('Setting {#define MODEL_IDENTIFIER} to {' +modelIdName +'} in copy of {' +origFileName +'}')
@@ -253,6 +292,8 @@ def poundDefineModelId(showDiagnostics, origFileName, modelIdName, modFileName):
     else:
       gotCt += 1
       modFile.write('#define MODEL_IDENTIFIER ' +modelIdName +'\r\n')  # Note normally would use '\n' to get system-specific line ending, but want to force line ending on all systems.
+      for otherDefineName in otherDefineNameList:
+        modFile.write('#define ' +otherDefineName +'\r\n')
   #
   # Close up.
   modFile.close()
@@ -306,10 +347,19 @@ def makeFmuSharedLib(showDiagnostics, litter,
   linkCExeBatchFileName = os.path.join(batchDirAbsName, LINK_C_EXE_BATCH_FILE_NAME)
   findFileOrQuit('linker batch', linkCExeBatchFileName)
   #
+  compileCppBatchFileName = os.path.join(batchDirAbsName, COMPILE_CPP_BATCH_FILE_NAME)
+  findFileOrQuit('compiler batch', compileCppBatchFileName)
+  #
+  linkCppLibBatchFileName = os.path.join(batchDirAbsName, LINK_CPP_LIB_BATCH_FILE_NAME)
+  findFileOrQuit('linker batch', linkCppLibBatchFileName)
+  #
   # Insert model identifier into source code files.
+  #   Also #define FMU_EXPORT_PREP_LIB, so that the FMU calls the preprocessor
+  # library linked into it, rather than run the preprocessor executable.
   origMainName = os.path.join(scriptDirName, '../SourceCode/EnergyPlus/main.c')
   modMainName  = os.path.join(scriptDirName, '../SourceCode/EnergyPlus', 'temp-'+modelIdSanitizedName+'.c')
-  poundDefineModelId(showDiagnostics, origMainName, modelIdSanitizedName, modMainName)
+  poundDefineModelId(showDiagnostics, origMainName, modelIdSanitizedName, modMainName,
+    ['FMU_EXPORT_PREP_LIB'])
   #
   # Assemble names of source files.
   srcFileNameList = list()
@@ -331,6 +381,34 @@ def makeFmuSharedLib(showDiagnostics, litter,
     ]:
     srcFileNameList.append(os.path.join(srcDirName, theRootName +'.c'))
   #
+  # Assemble names of source files for the preprocessor library.
+  #   These are the sources of the preprocessor executable that write the run
+  # files, without its command-line interface.
+  prepSrcFileNameList = list()
+  #
+  srcDirName = os.path.join(scriptDirName, '../SourceCode/fmu-export-prep')
+  for theRootName in ['fmu-export-idf-data',
+    'fmu-export-prep-lib'
+    ]:
+    prepSrcFileNameList.append(os.path.join(srcDirName, theRootName +'.cpp'))
+  #
+  srcDirName = os.path.join(scriptDirName, '../SourceCode/read-ep-file')
+  for theRootName in ['ep-idd-map',
+    'fileReader',
+    'fileReaderData',
+    'fileReaderDictionary'
+    ]:
+    prepSrcFileNameList.append(os.path.join(srcDirName, theRootName +'.cpp'))
+  #
+  srcDirName = os.path.join(scriptDirName, '../SourceCode/utility')
+  for theRootName in ['digest-md5',
+    'file-help',
+    'string-help',
+    'time-help',
+    'utilReport'
+    ]:
+    prepSrcFileNameList.append(os.path.join(srcDirName, theRootName +'.cpp'))
+  #
   # Load modules expect to find in same directory as this script file.
   if( scriptDirName not in sys.path ):
     sys.path.append(scriptDirName)
@@ -341,9 +419,17 @@ def makeFmuSharedLib(showDiagnostics, litter,
   except:
     quitWithError('Unable to import {utilManageCompileLink.py}', False)
   #
+  # Build the preprocessor library.
+  prepLibName = 'fmu-export-prep-lib' + STATIC_LIB_EXTENSION
+  if( showDiagnostics ):
+    printDiagnostic('Building preprocessor library {' +prepLibName +'}')
+  utilManageCompileLink.manageCompileLink(showDiagnostics, litter, True,
+    compileCppBatchFileName, linkCppLibBatchFileName, prepSrcFileNameList, prepLibName)
+  #
   # Build {fmuSharedLibName}.
   utilManageCompileLink.manageCompileLink(showDiagnostics, litter, True,
-    compileCBatchFileName, linkCLibBatchFileName, srcFileNameList, fmuSharedLibName)
+    compileCBatchFileName, linkCLibBatchFileName, srcFileNameList, fmuSharedLibName,
+    [prepLibName])
   #
   # Delete {modMainName}.
   #   Note always do this, regardless of {litter}, since the file is in the
@@ -388,6 +474,7 @@ def makeFmuSharedLib(showDiagnostics, litter,
     if( showDiagnostics ):
       printDiagnostic('Cleaning up intermediate files')
     # deleteFile(modMainName)  # Done above.
+    deleteFile(prepLibName)
     deleteFile(getAddressSizeExeName)
   #
   return( (fmuSharedLibName, fmuBinDirName) )
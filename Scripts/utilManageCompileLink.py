@@ -220,8 +220,12 @@ def runCompiler(showDiagnostics, compileBatchFileName, srcFileName):
 #   Note this fcn doesn't escape characters, such as spaces, in directory and
 # file names.  The caller must take care of these issues.
 #
+#   Optional {linkFileNameList} names files, such as static libraries, to link
+# after the object files.
+#
 def manageCompileLink(showDiagnostics, litter, forceRebuild,
-  compileBatchFileName, linkBatchFileName, srcFileNameList, outputFileName):
+  compileBatchFileName, linkBatchFileName, srcFileNameList, outputFileName,
+  linkFileNameList=None):
   #
   if( showDiagnostics ):
     printDiagnostic('Begin compile-link build of {' +outputFileName +'}')
@@ -247,6 +251,10 @@ def manageCompileLink(showDiagnostics, litter, forceRebuild,
   srcFileAbsNameList = list()
   for srcFileName in srcFileNameList:
     srcFileAbsNameList.append(findFileOrQuit('source',srcFileName))
+  linkFileAbsNameList = list()
+  if( linkFileNameList is not None ):
+    for linkFileName in linkFileNameList:
+      linkFileAbsNameList.append(findFileOrQuit('link',linkFileName))
   outputFileName = os.path.abspath(outputFileName)
   #
   # Name the build directory.
@@ -281,7 +289,7 @@ def manageCompileLink(showDiagnostics, litter, forceRebuild,
   if( showDiagnostics ):
     printDiagnostic('Linking object files using {' +linkBatchFileName +'}')
     printDiagnostic('Linking to create {' +outputFileBaseName +'}')
-  subprocess.call([linkBatchFileName, outputFileBaseName] +objFileNameList)
+  subprocess.call([linkBatchFileName, outputFileBaseName] +objFileNameList +linkFileAbsNameList)
   if( not os.path.isfile(outputFileBaseName) ):
     quitWithError('Failed to link object files into {' +outputFileBaseName +'}')
   #
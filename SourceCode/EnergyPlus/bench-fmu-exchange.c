@@ -0,0 +1,335 @@
+// Methods for Functional Mock-up Unit Export of EnergyPlus.
+///////////////////////////////////////////////////////
+/// \file   bench-fmu-exchange.c
+///
+/// \brief  Benchmark of the data exchange of the FMU library.
+///
+/// This program runs \c fmiInstantiateSlave, \c fmiInitializeSlave,
+/// \c fmiGetReal, \c fmiSetReal, \c fmiDoStep and
+/// \c fmiFreeSlaveInstance of \c main.c against the stand-in for
+/// EnergyPlus in \c mock-energyplus.c, and reports the time spent in
+/// each stage. The time per step, minus the latency of the stand-in,
+/// is the overhead of the FMU layer.
+///
+/// The stand-in must be compiled to an executable named \c energyplus
+/// in the directory of this program, for instance
+///
+///   gcc -o energyplus mock-energyplus.c utilSocket.c
+///   gcc -o bench-fmu-exchange bench-fmu-exchange.c main.c stack.c util.c
+///       utilSocket.c xml_parser_cosim.c <Expat sources> -lm -lpthread
+///
+/// Usage: bench-fmu-exchange [inputs] [outputs] [steps] [latency in us] [instances]
+///
+/// In every step, the program sets the inputs, does the step and gets
+/// the outputs of one instance after the other. If \c BENCH_BATCH is
+/// set, it sets the inputs of all instances, does the step of all
+/// instances with \c fmiDoStepBatch, and then gets their outputs.
+///
+/// The program writes a synthetic FMU to the directory
+/// \c bench-fmu-exchange in the current working directory, and
+/// runs the FMU in this directory. The transport can be selected
+/// with \c EPFMU_TRANSPORT, and the version of the messages that
+/// the stand-in sends with \c EPFMU_MOCK_VERSION.
+///
+///////////////////////////////////////////////////////
+#define MODEL_IDENTIFIER SmOffPSZ
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include "defines.h"
+
+#define BENCH_DIR "bench-fmu-exchange"
+#define BENCH_GUID "0123456789abcdef0123456789abcdef"
+#define BENCH_NAME "bench"
+/// Number of time steps per hour, which is written to \c tstep.txt
+#define BENCH_STEPS_PER_HOUR 6
+#define BENCH_PATHLEN 10000
+
+#ifdef __APPLE__
+#define BENCH_PREP "idf-to-fmu-export-prep-darwin"
+#else
+#define BENCH_PREP "idf-to-fmu-export-prep-linux"
+#endif
+
+static int verbose = 0;
+
+/////////////////////////////////////////////////////////////////
+/// Logger that only prints warnings and errors, or all messages
+/// if \c BENCH_VERBOSE is set.
+static void benchLogger(fmiComponent c, fmiString instanceName, fmiStatus status,
+	fmiString category, fmiString message, ...){
+	va_list argp;
+	if ( status == fmiOK && !verbose )
+		return;
+	printf("%s (%s): ", instanceName ? instanceName : "?", category ? category : "?");
+	va_start(argp, message);
+	vprintf(message, argp);
+	va_end(argp);
+}
+
+/////////////////////////////////////////////////////////////////
+/// Returns the wall clock time in seconds.
+static double wallTime(void){
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec + 1e-6 * tv.tv_usec;
+}
+
+/////////////////////////////////////////////////////////////////
+/// Writes a text file.
+///
+///\param fileName The name of the file.
+///\param text The content of the file.
+///\return 0 if no error occurred.
+static int writeText(const char *fileName, const char *text){
+	FILE *fp = fopen(fileName, "w");
+	if ( fp == NULL ){
+		fprintf(stderr, "Error: Cannot write %s.\n", fileName);
+		return 1;
+	}
+	fputs(text, fp);
+	fclose(fp);
+	return 0;
+}
+
+/////////////////////////////////////////////////////////////////
+/// Writes the model description and the resources of a synthetic FMU.
+///
+///\param nIn The number of inputs.
+///\param nOut The number of outputs.
+///\return 0 if no error occurred.
+static int writeFMU(const int nIn, const int nOut){
+	FILE *fp;
+	int i;
+	mkdir("fmu", 0755);
+	mkdir("fmu/resources", 0755);
+
+	fp = fopen("fmu/modelDescription.xml", "w");
+	if ( fp == NULL ){
+		fprintf(stderr, "Error: Cannot write the model description.\n");
+		return 1;
+	}
+	fprintf(fp, "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n");
+	fprintf(fp, "<fmiModelDescription  fmiVersion=\"1.0\"\n"
+		"  modelName=\"%s.idf\"\n"
+		"  modelIdentifier=\"%s\"\n"
+		"  guid=\"%s\"\n"
+		"  numberOfContinuousStates=\"0\"\n"
+		"  numberOfEventIndicators=\"0\">\n"
+		"  <ModelVariables>\n", BENCH_NAME, BENCH_NAME, BENCH_GUID);
+	for ( i = 0; i < nIn; i++ )
+		fprintf(fp, "    <ScalarVariable  name=\"u%d\"  valueReference=\"%d\"\n"
+			"      variability=\"continuous\"  causality=\"input\">\n"
+			"      <Real  start=\"0\"/>\n"
+			"    </ScalarVariable>\n", i, i + 1);
+	for ( i = 0; i < nOut; i++ )
+		fprintf(fp, "    <ScalarVariable  name=\"y%d\"  valueReference=\"%d\"\n"
+			"      variability=\"continuous\"  causality=\"output\">\n"
+			"      <Real/>\n"
+			"    </ScalarVariable>\n", i, i + 100001);
+	fprintf(fp, "  </ModelVariables>\n"
+		"  <Implementation>\n"
+		"    <CoSimulation_Tool>\n"
+		"      <Capabilities  canHandleVariableCommunicationStepSize=\"false\"/>\n"
+		"      <Model  entryPoint=\"fmu://resources/%s.idf\"  manualStart=\"false\"  type=\"text/plain\"/>\n"
+		"    </CoSimulation_Tool>\n"
+		"  </Implementation>\n"
+		"</fmiModelDescription>\n", BENCH_NAME);
+	fclose(fp);
+
+	fp = fopen("fmu/resources/variables.cfg", "w");
+	if ( fp == NULL ){
+		fprintf(stderr, "Error: Cannot write variables.cfg.\n");
+		return 1;
+	}
+	fprintf(fp, "<?xml version=\"1.0\" encoding=\"ISO-8859-1\"?>\n"
+		"<BCVTB-variables>\n");
+	for ( i = 0; i < nIn; i++ )
+		fprintf(fp, "  <variable  source=\"Ptolemy\">\n"
+			"    <EnergyPlus  schedule=\"u%d\"/>\n"
+			"  </variable>\n", i);
+	for ( i = 0; i < nOut; i++ )
+		fprintf(fp, "  <variable  source=\"EnergyPlus\">\n"
+			"    <EnergyPlus  name=\"y%d\"  type=\"Output\"/>\n"
+			"  </variable>\n", i);
+	fprintf(fp, "</BCVTB-variables>\n");
+	fclose(fp);
+
+	// The preprocessor copies the input file, which is its last
+	// argument, and the weather file, and writes the number of time
+	// steps per hour.
+	if ( writeText("fmu/resources/" BENCH_NAME ".idf", "Version, 8.4;\n")
+		|| writeText("fmu/resources/" BENCH_NAME ".idd", "!IDD_Version 8.4.0\n")
+		|| writeText("fmu/resources/" BENCH_NAME ".epw", "LOCATION,Benchmark\n")
+		|| writeText("fmu/resources/" BENCH_PREP,
+		"#!/bin/sh\n"
+		"for arg in \"$@\"; do\n"
+		"  [ \"$prev\" = -w ] && cp \"$arg\" runweafile.epw\n"
+		"  prev=\"$arg\"; idf=\"$arg\"\n"
+		"done\n"
+		"cp \"$idf\" runinfile.idf && echo 6 > tstep.txt\n") )
+		return 1;
+	return 0;
+}
+
+/////////////////////////////////////////////////////////////////
+/// Main routine of the benchmark.
+int main(int argc, char *argv[]){
+	const int nIn     = (argc > 1) ? atoi(argv[1]) : 10;
+	const int nOut    = (argc > 2) ? atoi(argv[2]) : 10;
+	const int nSteps  = (argc > 3) ? atoi(argv[3]) : 1000;
+	const char *latency = (argc > 4) ? argv[4] : "0";
+	const int nIns    = (argc > 5) ? atoi(argv[5]) : 1;
+	const double stepSize = 3600.0 / BENCH_STEPS_PER_HOUR;
+	char exeDir[BENCH_PATHLEN];
+	char fmuDir[BENCH_PATHLEN];
+	char *path;
+	char *sep;
+	fmiCallbackFunctions functions;
+	fmiComponent *c;
+	fmiStatus *status;
+	char instanceName[MAX_VARNAME_LEN];
+	int batch;
+	fmiValueReference *vrIn;
+	fmiValueReference *vrOut;
+	fmiReal *valIn;
+	fmiReal *valOut;
+	fmiReal expected;
+	double tIns, tIni, tSte, tFre;
+	int nErr = 0;
+	int i, j, k;
+
+	if ( nIn < 0 || nOut < 0 || nIn + nOut == 0 || nSteps < 1 || nIns < 1 ){
+		fprintf(stderr, "Usage: %s [inputs] [outputs] [steps] [latency in us] [instances]\n", argv[0]);
+		return 1;
+	}
+	verbose = ( getenv("BENCH_VERBOSE") != NULL );
+	batch = ( getenv("BENCH_BATCH") != NULL );
+
+	// put the directory of this program, which contains the
+	// stand-in for EnergyPlus, in front of the search path
+	if ( realpath(argv[0], exeDir) == NULL ){
+		fprintf(stderr, "Error: Cannot resolve %s.\n", argv[0]);
+		return 1;
+	}
+	sep = strrchr(exeDir, '/');
+	if ( sep != NULL )
+		*sep = '\0';
+	path = (char*)malloc(strlen(exeDir) + strlen(getenv("PATH") ? getenv("PATH") : "") + 2);
+	sprintf(path, "%s:%s", exeDir, getenv("PATH") ? getenv("PATH") : "");
+	setenv("PATH", path, 1);
+	free(path);
+	setenv("EPFMU_MOCK_LATENCY_US", latency, 1);
+
+	// write the FMU
+	mkdir(BENCH_DIR, 0755);
+	if ( chdir(BENCH_DIR) != 0 || writeFMU(nIn, nOut) != 0
+		|| realpath("fmu", fmuDir) == NULL ){
+		fprintf(stderr, "Error: Cannot write the FMU to %s.\n", BENCH_DIR);
+		return 1;
+	}
+
+	vrIn   = (fmiValueReference*)calloc(nIn + 1, sizeof(fmiValueReference));
+	vrOut  = (fmiValueReference*)calloc(nOut + 1, sizeof(fmiValueReference));
+	valIn  = (fmiReal*)calloc(nIn + 1, sizeof(fmiReal));
+	valOut = (fmiReal*)calloc(nOut + 1, sizeof(fmiReal));
+	for ( i = 0; i < nIn; i++ )
+		vrIn[i] = i + 1;
+	for ( i = 0; i < nOut; i++ )
+		vrOut[i] = i + 100001;
+
+	functions.logger = benchLogger;
+	functions.allocateMemory = calloc;
+	functions.freeMemory = free;
+	functions.stepFinished = NULL;
+
+	c = (fmiComponent*)calloc(nIns, sizeof(fmiComponent));
+	status = (fmiStatus*)calloc(nIns, sizeof(fmiStatus));
+	tIns = wallTime();
+	for ( j = 0; j < nIns; j++ ){
+		if ( nIns > 1 )
+			sprintf(instanceName, "%s%d", BENCH_NAME, j);
+		else
+			strcpy(instanceName, BENCH_NAME);
+		c[j] = fmiInstantiateSlave(instanceName, BENCH_GUID, fmuDir, "", 0, fmiFalse,
+			fmiFalse, functions, fmiTrue);
+		if ( c[j] == NULL ){
+			fprintf(stderr, "Error: fmiInstantiateSlave failed.\n");
+			return 1;
+		}
+	}
+	tIns = wallTime() - tIns;
+
+	tIni = wallTime();
+	for ( j = 0; j < nIns; j++ ){
+		if ( fmiInitializeSlave(c[j], 0, fmiTrue, nSteps * stepSize) != fmiOK ){
+			fprintf(stderr, "Error: fmiInitializeSlave failed. Is the stand-in"
+				" for EnergyPlus in %s/energyplus?\n", exeDir);
+			return 1;
+		}
+	}
+	tIni = wallTime() - tIni;
+
+	// In step k, the stand-in returns the inputs of step k-1 plus k.
+	// The outputs are got after each step, hence the outputs of step 0
+	// are read by the first call of fmiDoStep.
+	tSte = wallTime();
+	for ( k = 0; k < nSteps; k++ ){
+		for ( i = 0; i < nIn; i++ )
+			valIn[i] = k + 0.125 * i;
+		for ( j = 0; j < nIns; j++ ){
+			fmiSetReal(c[j], vrIn, nIn, valIn);
+			if ( !batch ){
+				status[j] = fmiDoStep(c[j], k * stepSize, stepSize, fmiTrue);
+				fmiGetReal(c[j], vrOut, nOut, valOut);
+			}
+		}
+		if ( batch )
+			fmiDoStepBatch(c, nIns, k * stepSize, stepSize, fmiTrue, status);
+		for ( j = 0; j < nIns; j++ ){
+			if ( status[j] != fmiOK ){
+				fprintf(stderr, "Error: fmiDoStep failed in step %d.\n", k);
+				return 1;
+			}
+			if ( batch )
+				fmiGetReal(c[j], vrOut, nOut, valOut);
+			for ( i = 0; i < nOut; i++ ){
+				expected = (k + 1) + ( (nIn > 0) ? k + 0.125 * (i % nIn) : 0.0 );
+				if ( valOut[i] != expected )
+					nErr++;
+			}
+		}
+	}
+	tSte = wallTime() - tSte;
+
+	tFre = wallTime();
+	for ( j = 0; j < nIns; j++ )
+		fmiFreeSlaveInstance(c[j]);
+	tFre = wallTime() - tFre;
+
+	printf("inputs %d, outputs %d, steps %d, transport %s, latency %s us, instances %d%s\n",
+		nIn, nOut, nSteps, getenv("EPFMU_TRANSPORT") ? getenv("EPFMU_TRANSPORT") : "tcp", latency,
+		nIns, batch ? ", batch" : "");
+	printf("  fmiInstantiateSlave  %10.3f ms\n", 1e3 * tIns);
+	printf("  fmiInitializeSlave   %10.3f ms\n", 1e3 * tIni);
+	printf("  fmiDoStep            %10.3f us per step\n", 1e6 * tSte / nSteps);
+	// the stand-ins of a batch compute the step at the same time
+	printf("  FMU overhead         %10.3f us per step\n",
+		1e6 * tSte / nSteps - (batch ? 1 : nIns) * atof(latency));
+	printf("  fmiFreeSlaveInstance %10.3f ms\n", 1e3 * tFre);
+	if ( nErr > 0 )
+		printf("Error: %d values were not exchanged correctly.\n", nErr);
+
+	free(vrIn);
+	free(vrOut);
+	free(valIn);
+	free(valOut);
+	free(c);
+	free(status);
+	return ( nErr > 0 ) ? 1 : 0;
+}
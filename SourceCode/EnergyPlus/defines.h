@@ -29,6 +29,44 @@
  */
 #define MAINVERSION 2
 
+/** \val The version of the socket interface that exchanges the values
+ *  as raw little-endian IEEE-754 doubles. It is used only if the server
+ *  sends its first message in this format, otherwise the FMU falls back
+ *  to the ASCII format of MAINVERSION.
+ */
+#define BINARYVERSION 3
+
+/** \val Length of the header of a binary message. It contains the version,
+ *  the flag, the number of doubles, integers and booleans, a reserved
+ *  word and the current simulation time.
+ */
+#define BINARY_HEADER_LENGTH 32
+
+/** \val Name of the environment variable that selects the transport
+ *  between the FMU and EnergyPlus. It can be set to "tcp", "unix" or "shm".
+ *  If it is not set, or the transport is not available, TCP is used.
+ */
+#define TRANSPORT_ENV  "EPFMU_TRANSPORT"
+#define TRANSPORT_TCP  0
+#define TRANSPORT_UNIX 1
+#define TRANSPORT_SHM  2
+
+/** \val Roles of the two sides of a shared memory channel. */
+#define SHM_ROLE_FMU 0
+#define SHM_ROLE_EP  1
+
+/** \val Time in milliseconds that the FMU waits for EnergyPlus to map the
+ *  shared memory file. If EnergyPlus exits or does not connect in time,
+ *  the FMU runs it again with a TCP socket.
+ */
+#define SHM_CONNECT_TIMEOUT_MS 600000
+
+/** \val Time in milliseconds that fmiDoStepBatch waits for the outputs of
+ *  the FMU instances. An instance whose EnergyPlus does not send them in
+ *  time gets the status fmiError.
+ */
+#define DOSTEPBATCH_TIMEOUT_MS 600000
+
 
 /////////////////////////////////////////////////////////////////////
 /*  Header specific to the FMU export project (added by T. Nouidui) 
@@ -40,8 +78,25 @@
 #define FTIMESTEP    "tstep.txt"
 #define VARCFG       "variables.cfg"
 #define SOCKCFG      "socket.cfg"
+#define SOCKUNIX     "socket.unx"
+#define SHMFILE      "socket.shm"
+
+/** \val Name of the environment variable that names the directory in which
+ *  the outputs of the preprocessor are cached. If it is not set, the
+ *  resources folder of the FMU is used. If it is empty, nothing is cached.
+ */
+#define PREPCACHE_ENV "FMU_EXPORT_PREP_CACHE_DIR"
+
+/** \val Name of the environment variable that names the directory in which
+ *  the parsed model description is cached in a binary file. If it is not set
+ *  or empty, no file is used, and the model description is only shared by the
+ *  instances of the same process.
+ */
+#define MDCACHE_ENV "EPFMU_MD_CACHE_DIR"
 #define EPBAT        "EP.bat"
 #define MAX_VARNAME_LEN 100
+#define VR_INPUT_BASE  1
+#define VR_OUTPUT_BASE 100001
 #ifdef _MSC_VER
 #include <windows.h>
 #define PATH_SEP "\\"
@@ -55,6 +110,32 @@
 #include "fmiFunctions.h"
 #include "xml_parser_cosim.h"
 
+/** \val Extension of FMI 1.0 that does the time stepping of several
+ *  instances of the FMU at once, see fmiDoStepBatch in main.c. Like the
+ *  functions of fmiFunctions.h, its name is prefixed by the model identifier.
+ */
+#define fmiDoStepBatch fmiFullName(_fmiDoStepBatch)
+DllExport fmiStatus fmiDoStepBatch(fmiComponent c[], size_t nc, fmiReal currentCommunicationPoint,
+	fmiReal communicationStepSize, fmiBoolean newStep, fmiStatus status[]);
+
+/** \val Shared memory channel, which is defined in utilSocket.c. */
+struct ShmChannel;
+
+/** \val Buffers of a socket connection and version number of the server.
+ *  They are kept per FMU instance and reused for every exchange.
+ *  If shm is not NULL, the values are exchanged through shared memory.
+ */
+typedef struct SocketBuffers {
+	char *readBuffer;
+	int readLength;
+	char *writeBuffer;
+	int writeLength;
+	int serverVersion;
+	struct ShmChannel *shm;
+	int shmLength;
+	int shmRole;
+} SocketBuffers;
+
 typedef struct ModelInstance {
 	int index;
 	fmiCallbackFunctions functions;
@@ -75,6 +156,7 @@ typedef struct ModelInstance {
 	int numOutVar;
 	int sockfd;
 	int newsockfd;
+	SocketBuffers sockBuf;
 	fmiReal timeout; 
 	fmiBoolean visible;
 	fmiBoolean interactive;
@@ -102,6 +184,12 @@ typedef struct ModelInstance {
 
 	fmiReal *inVec;
 	fmiReal *outVec;
+	// Map value references to slots of inVec and outVec.
+	// Entries are -1 for references which are not set or got by the master.
+	int *inVrSlot;
+	int *outVrSlot;
+	fmiValueReference inVrSlotLen;
+	fmiValueReference outVrSlotLen;
 	fmiReal tStartFMU;
 	fmiReal tStopFMU;
 	fmiReal nexComm;
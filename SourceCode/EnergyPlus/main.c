@@ -24,12 +24,22 @@
 #define MAX_MSG_SIZE 1000
 #define MAXBUFFSIZE 1000
 
+// for posix_spawn_file_actions_addchdir_np() on Linux.
+#ifdef __linux__
+#define _GNU_SOURCE
+#endif
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include "util.h"
 #include "utilSocket.h" 
 #include "defines.h"
+// Define FMU_EXPORT_PREP_LIB to link the preprocessor into the FMU,
+// rather than run its executable from the resources folder.
+// makeFMULib.py defines it, and links the preprocessor library.
+#ifdef FMU_EXPORT_PREP_LIB
+#include "../fmu-export-prep/fmu-export-prep-lib.h"
+#endif
 //#include "reader.h" 
 #include <errno.h>
 #include <sys/stat.h>
@@ -51,51 +61,88 @@
 #include <spawn.h>
 #include <sys/types.h> /* pid_t */
 #include <sys/ioctl.h>
+#include <sys/wait.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <time.h>
+#ifdef __APPLE__
+#include <crt_externs.h>
+#define environ (*_NSGetEnviron())
+#else
+extern char **environ;
+#endif
+#ifdef __linux__
+#include <sys/epoll.h>
+#endif
+// posix_spawn can change the directory of the child since glibc 2.29.
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 29))
+#define HAVE_SPAWN_CHDIR 1
+#endif
 #define INVALID_SOCKET -1
 #define SOCKET_ERROR   -1
 #endif
 
-int zI=0;
-int insNum=0;
-int firstCallIns=1;
-
+// The list of FMU instances is shared by all instances of the process
+// and is guarded by a lock.
 int arrsize=0;
 ModelInstance **fmuInstances;
 int fmuLocCoun=0;
 #define DELTA 10
+#ifdef _MSC_VER
+static SRWLOCK fmuInstancesLock = SRWLOCK_INIT;
+#define LOCK_FMU_INSTANCES() AcquireSRWLockExclusive(&fmuInstancesLock)
+#define UNLOCK_FMU_INSTANCES() ReleaseSRWLockExclusive(&fmuInstancesLock)
+#else
+static pthread_mutex_t fmuInstancesLock = PTHREAD_MUTEX_INITIALIZER;
+#define LOCK_FMU_INSTANCES() pthread_mutex_lock(&fmuInstancesLock)
+#define UNLOCK_FMU_INSTANCES() pthread_mutex_unlock(&fmuInstancesLock)
+#endif
+
+////////////////////////////////////////////////////////////////////////////////////
+/// Gets the path of a file in the output folder of an FMU instance.
+///
+/// Instances use paths in their output folder, rather than change the working
+/// directory of the process, so that several instances can run concurrently.
+///
+///\param _c The FMU instance.
+///\param fileName The name of the file.
+///\return The path, to be freed by the caller.
+////////////////////////////////////////////////////////////////////////////////////
+char *getOutputPath(ModelInstance *_c, const char *fileName)
+{
+	char *path;
+	path = (char *)_c->functions.allocateMemory(strlen(_c->fmuOutput) + strlen(fileName) + 1, sizeof(char));
+	sprintf(path, "%s%s", _c->fmuOutput, fileName);
+	return path;
+}
 
 ///////////////////////////////////////////////////////////////////////////////
 /// This function deletes temporary created files. 
+///
+///\param _c The FMU instance.
 ///////////////////////////////////////////////////////////////////////////////
-void findFileDelete()
+void findFileDelete(ModelInstance *_c)
 {
+	const char *fileNames[] = {VARCFG, SOCKCFG, EPBAT, FTIMESTEP, SOCKUNIX, SHMFILE};
 	struct stat stat_p;
-	int res;
+	char *path;
+	size_t i;
 
-	if (stat(VARCFG, &stat_p) >= 0)
-	{
-		remove(VARCFG);
-	}
-	if (stat(SOCKCFG, &stat_p) >= 0)
+	for (i = 0; i < sizeof(fileNames)/sizeof(fileNames[0]); i++)
 	{
-		remove(SOCKCFG);
-	}
-	if (stat(EPBAT, &stat_p) >= 0)
-	{
-		remove(EPBAT);
-	}
-	if (stat(FTIMESTEP, &stat_p) >= 0)
-	{
-		remove(FTIMESTEP);
+		path = getOutputPath(_c, fileNames[i]);
+		if (stat(path, &stat_p) >= 0)
+		{
+			remove(path);
+		}
+		_c->functions.freeMemory(path);
 	}
-	if (stat(FRUNWEAFILE, &stat_p) >= 0){
+	path = getOutputPath(_c, FRUNWEAFILE);
+	if (stat(path, &stat_p) >= 0){
 		// cleanup .epw files
-#ifdef _MSC_VER
-		res = system("del *.epw");
-#else
-		res = system("rm -f *.epw");
-#endif
+		removeFilesWithExt(_c->fmuOutput, ".epw");
 	}
+	_c->functions.freeMemory(path);
 }
 
 ////////////////////////////////////////////////////////////////////////////////////
@@ -120,14 +167,20 @@ void replace_char (char *s, const char find, const char replace) {
 ////////////////////////////////////////////////////////////////////////////////////
 void addfmuInstances(ModelInstance* s){
 	ModelInstance **temp;
+	LOCK_FMU_INSTANCES();
 	if(fmuLocCoun==arrsize){
 		temp=(ModelInstance**)malloc(sizeof(ModelInstance*) * (DELTA + arrsize));
+		if (temp==NULL){
+			UNLOCK_FMU_INSTANCES();
+			return;
+		}
 		arrsize +=DELTA;
-		memcpy(temp, fmuInstances, fmuLocCoun);
+		memcpy(temp, fmuInstances, sizeof(ModelInstance*) * fmuLocCoun);
 		free(fmuInstances);
 		fmuInstances=temp;
 	}
 	fmuInstances[fmuLocCoun++]=s;
+	UNLOCK_FMU_INSTANCES();
 }
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -238,31 +291,194 @@ int getResFile(ModelInstance *_c, fmiString pattern)
 /// write socket description file
 ///
 ///\param _c The FMU instance.
-///\param porNum The port number.
-///\param hostName The host name.
+///\param transport The transport, which is TRANSPORT_TCP, TRANSPORT_UNIX or TRANSPORT_SHM.
+///\param porNum The port number of a TCP socket.
+///\param hostName The host name of a TCP socket.
 ///\return 0 if no error occurred.
 ////////////////////////////////////////////////////////////////////////////////////
-int write_socket_cfg(ModelInstance *_c, int portNum, const char* hostName)
+int write_socket_cfg(ModelInstance *_c, int transport, int portNum, const char* hostName)
 {
 	FILE *fp;
-	fp=fopen("socket.cfg", "w");
+	char *path;
+	path=getOutputPath(_c, SOCKCFG);
+	fp=fopen(path, "w");
+	_c->functions.freeMemory(path);
 	if (fp==NULL) {
 		_c->functions.logger(NULL, _c->instanceName, fmiError, "error",  "Can't open socket.cfg file.\n");
 		return 1;  // STL error code: File not open.
 	}
 
 	/////////////////////////////////////////////////////////////////////////////
-	// write socket configuration file
+	// write socket configuration file. The version attribute is the highest
+	// version of the socket interface which the FMU understands.
 	fprintf(fp, "<\?xml version=\"1.0\" encoding=\"ISO-8859-1\"\?>\n");
 	fprintf(fp, "<BCVTB-client>\n");
 	fprintf(fp, "  <ipc>\n");
-	fprintf(fp, "    <socket port=\"%d\" hostname=\"%s\"/>\n", portNum, hostName);
+	if (transport==TRANSPORT_SHM)
+		fprintf(fp, "    <shm path=\"%s\" version=\"%d\"/>\n", SHMFILE, BINARYVERSION);
+	else if (transport==TRANSPORT_UNIX)
+		fprintf(fp, "    <socket path=\"%s\" version=\"%d\"/>\n", SOCKUNIX, BINARYVERSION);
+	else
+		fprintf(fp, "    <socket port=\"%d\" hostname=\"%s\" version=\"%d\"/>\n", portNum, hostName, BINARYVERSION);
 	fprintf(fp, "  </ipc>\n");
 	fprintf(fp, "</BCVTB-client>\n");
 	fclose(fp);
 	return 0;
 }
 
+////////////////////////////////////////////////////////////////////////////////////
+/// create the TCP socket server and write the socket description file
+///
+///\param _c The FMU instance.
+///\return 0 if no error occurred.
+////////////////////////////////////////////////////////////////////////////////////
+int create_tcp_server(ModelInstance *_c)
+{
+	int retVal;
+#ifdef _MSC_VER
+	int sockLength;
+#else
+	socklen_t sockLength;
+#endif
+	struct sockaddr_in   server_addr;
+	int                  port_num;
+	char                 ThisHost[10000];
+	struct  hostent *hp;
+
+	_c->sockfd=socket(AF_INET, SOCK_STREAM, 0);
+	// check for errors to ensure that the socket is a valid socket.
+	if (_c->sockfd==INVALID_SOCKET)
+	{
+		_c->functions.logger(NULL, _c->instanceName, fmiError, 
+			"error", "fmiInitializeSlave: Opening socket failed"
+			" sockfd=%d.\n", _c->sockfd);
+		return 1;
+	}
+	_c->functions.logger(NULL, _c->instanceName, fmiOK, "ok",  "fmiInitializeSlave: The sockfd is %d.\n", _c->sockfd);
+	// initialize socket structure server address information
+	memset(&server_addr, 0, sizeof(server_addr));
+	server_addr.sin_family=AF_INET;                 // Address family to use
+	server_addr.sin_port=htons(0);                  // Port number to use
+	server_addr.sin_addr.s_addr=htonl(INADDR_ANY);  // Listen on any IP address
+
+	// bind the socket
+	if (bind(_c->sockfd, (struct sockaddr *)&server_addr, sizeof(server_addr))==SOCKET_ERROR)
+	{
+		_c->functions.logger(NULL, _c->instanceName, fmiError, 
+			"error", "fmiInitializeSlave: bind() failed.\n");
+		closeipcFMU (&(_c->sockfd));
+		return 1;
+	}
+
+	// get socket information information
+	sockLength=sizeof(server_addr);
+	if ( getsockname (_c->sockfd, (struct sockaddr *)&server_addr, &sockLength)) {
+		_c->functions.logger(NULL,  _c->instanceName, fmiError,
+			"error", "fmiInitializeSlave: Get socket name failed.\n");
+		return 1;
+	}
+
+	// get the port number
+	port_num=ntohs(server_addr.sin_port);
+	_c->functions.logger(NULL, _c->instanceName, fmiOK, "ok",  "fmiInitializeSlave: The port number is %d.\n", port_num);
+
+	// get the hostname information
+	gethostname(ThisHost, MAXHOSTNAME);
+	if  ((hp=gethostbyname(ThisHost))==NULL ) {
+		_c->functions.logger(NULL,  _c->instanceName, fmiError, 
+			"error", "fmiInitializeSlave: Get host by name failed.\n");
+		return 1;
+	}
+
+	// write socket cfg file
+	retVal=write_socket_cfg (_c, TRANSPORT_TCP, port_num, ThisHost);
+	_c->functions.logger(NULL, _c->instanceName, fmiOK, "ok",  "fmiInitializeSlave: This hostname is %s.\n", ThisHost);
+	if  (retVal !=0) {
+		_c->functions.logger(NULL,  _c->instanceName, fmiError, 
+			"error", "fmiInitializeSlave: Write socket cfg failed.\n");
+		return 1;
+	}
+	// listen to the port
+	if (listen(_c->sockfd, 1)==SOCKET_ERROR)
+	{
+		_c->functions.logger(NULL,  _c->instanceName, fmiError, "error", "fmiInitializeSlave: listen() failed.\n");
+		closeipcFMU (&(_c->sockfd));
+		return 1;
+	}
+	_c->functions.logger(NULL, _c->instanceName, fmiOK, "ok",  "fmiInitializeSlave: TCPServer Server waiting for clients on port: %d.\n", port_num);
+	return 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////////
+/// create the Unix domain socket server and write the socket description file
+///
+///\param _c The FMU instance.
+///\return 0 if no error occurred.
+////////////////////////////////////////////////////////////////////////////////////
+int create_unix_server(ModelInstance *_c)
+{
+	int retVal;
+	char *path;
+	// the path may be too long for a socket address, in which case the
+	// caller falls back to TCP.
+	path=getOutputPath(_c, SOCKUNIX);
+	_c->sockfd=establishunixserversocketFMU(path);
+	_c->functions.freeMemory(path);
+	if (_c->sockfd==INVALID_SOCKET)
+	{
+		_c->functions.logger(NULL, _c->instanceName, fmiWarning, "warning",
+			"fmiInitializeSlave: Could not create Unix domain socket %s.\n", SOCKUNIX);
+		return 1;
+	}
+	// write socket cfg file
+	retVal=write_socket_cfg (_c, TRANSPORT_UNIX, 0, NULL);
+	if  (retVal !=0) {
+		_c->functions.logger(NULL,  _c->instanceName, fmiError, 
+			"error", "fmiInitializeSlave: Write socket cfg failed.\n");
+		closeipcFMU (&(_c->sockfd));
+		_c->sockfd=INVALID_SOCKET;
+		return 1;
+	}
+	_c->functions.logger(NULL, _c->instanceName, fmiOK, "ok",  
+		"fmiInitializeSlave: Unix domain socket server waiting for clients on %s.\n", SOCKUNIX);
+	return 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////////
+/// create the shared memory channel and write the socket description file
+///
+///\param _c The FMU instance.
+///\return 0 if no error occurred.
+////////////////////////////////////////////////////////////////////////////////////
+int create_shm_server(ModelInstance *_c)
+{
+	int retVal;
+	// a message holds either the inputs or the outputs of the FMU
+	int nDblCap = (_c->numInVar > _c->numOutVar) ? _c->numInVar : _c->numOutVar;
+	char *path;
+	path=getOutputPath(_c, SHMFILE);
+	retVal=establishshmserverFMU(&(_c->sockBuf), path, nDblCap);
+	_c->functions.freeMemory(path);
+	if (retVal!=0)
+	{
+		_c->functions.logger(NULL, _c->instanceName, fmiWarning, "warning",
+			"fmiInitializeSlave: Could not create shared memory file %s.\n", SHMFILE);
+		return 1;
+	}
+	_c->sockfd=INVALID_SOCKET;
+	// write socket cfg file
+	retVal=write_socket_cfg (_c, TRANSPORT_SHM, 0, NULL);
+	if  (retVal !=0) {
+		_c->functions.logger(NULL,  _c->instanceName, fmiError, 
+			"error", "fmiInitializeSlave: Write socket cfg failed.\n");
+		closeshmFMU(&(_c->sockBuf));
+		return 1;
+	}
+	_c->functions.logger(NULL, _c->instanceName, fmiOK, "ok",  
+		"fmiInitializeSlave: Shared memory channel waiting for clients on %s.\n", SHMFILE);
+	return 0;
+}
+
 ////////////////////////////////////////////////////////////////////////////////////
 /// copy variables.cfg file into the results folder
 ///
@@ -273,100 +489,492 @@ int copy_var_cfg(ModelInstance *_c)
 {
 	char *tmp_str;
 	int retVal;
-	tmp_str=(char*)(_c->functions.allocateMemory(strlen(_c->tmpResCon) + strlen (_c->fmuOutput) + 30, sizeof(char)));
+	tmp_str=(char*)(_c->functions.allocateMemory(strlen (_c->fmuOutput) + strlen (VARCFG) + 1, sizeof(char)));
 
-#ifdef _MSC_VER
-	//"\"" are quotes needed for path with spaces in the names
-	sprintf(tmp_str, "xcopy %s%s %s%s%s /Y /I", "\"", _c->tmpResCon, "\"", _c->fmuOutput, "\"");
-#elif __linux__
-	sprintf(tmp_str, "cp -f %s%s %s%s%s", "\"", _c->tmpResCon,  "\"", _c->fmuOutput, "\"");
-#elif __APPLE__
-	sprintf(tmp_str, "cp -f %s%s %s%s%s", "\"", _c->tmpResCon,  "\"", _c->fmuOutput, "\"");
-#else
-	printf ("Cannot execute %s. The FMU export is only supported on Windows, Linux and Mac OS.\n", tmp_str);
-#endif
+	sprintf(tmp_str, "%s%s", _c->fmuOutput, VARCFG);
 	_c->functions.logger(NULL, _c->instanceName, fmiOK, "ok",  
-		"Command executes to copy content of resources folder: %s\n", tmp_str);
-	retVal=system (tmp_str);
+		"Copying %s of resources folder to %s\n", _c->tmpResCon, tmp_str);
+	retVal=copyFile (_c->tmpResCon, tmp_str);
 	_c->functions.freeMemory(tmp_str);
 	return retVal;
 }
 
+#ifndef _MSC_VER
 ////////////////////////////////////////////////////////////////////////////////////
-/// create results folder 
+/// Adds bytes to a 64-bit FNV-1a hash.
+///
+///\param hash The hash.
+///\param bytes The bytes.
+///\param len The number of bytes.
+////////////////////////////////////////////////////////////////////////////////////
+void hashPrepBytes(unsigned long long *hash, const unsigned char *bytes, size_t len)
+{
+	size_t i;
+	for (i=0; i<len; i++){
+		*hash ^= bytes[i];
+		*hash *= 1099511628211ULL;
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////////
+/// Adds the contents of a file, then its length, to a 64-bit FNV-1a hash.
+///
+///\param hash The hash.
+///\param fileName The name of the file.
+///\return 0 if no error occurred.
+////////////////////////////////////////////////////////////////////////////////////
+int hashPrepFile(unsigned long long *hash, const char *fileName)
+{
+	unsigned char buf[65536];
+	unsigned long long fileLen = 0;
+	ssize_t len;
+	int fd;
+
+	fd = open(fileName, O_RDONLY);
+	if (fd < 0)
+		return 1;
+	while ((len = read(fd, buf, sizeof(buf))) > 0){
+		hashPrepBytes(hash, buf, (size_t)len);
+		fileLen += (unsigned long long)len;
+	}
+	close(fd);
+	hashPrepBytes(hash, (const unsigned char *)&fileLen, sizeof(fileLen));
+	return (len < 0) ? 1 : 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////////
+/// Gets the path, without extension, of the cached outputs of the preprocessor
+/// for the inputs of an FMU instance.
+///
+/// The path holds a hash of the preprocessor, the idd, idf and weather files,
+/// and the start and stop time, so that instances with the same inputs share
+/// the same outputs.  If the preprocessor is linked into the FMU, the version
+/// of its outputs stands in for its executable.
+///
+///\param _c The FMU instance.
+///\param prepExe The path of the preprocessor executable.
+///\param tStartFMUstr The start time, as passed to the preprocessor.
+///\param tStopFMUstr The stop time, as passed to the preprocessor.
+///\return The path, to be freed by the caller, or NULL if the outputs
+///        are not cached.
+////////////////////////////////////////////////////////////////////////////////////
+char *getPrepCacheBase(ModelInstance *_c, const char *prepExe, const char *tStartFMUstr,
+	const char *tStopFMUstr)
+{
+	const char *cacheDir;
+	char *cacheBase;
+	size_t dirLen;
+	unsigned long long hash = 14695981039346656037ULL;
+	const unsigned char haveWea = (_c->wea_file != NULL);
+
+	cacheDir = getenv(PREPCACHE_ENV);
+	if (cacheDir == NULL)
+		cacheDir = _c->fmuResourceLocation;
+	if (cacheDir[0] == '\0')
+		return NULL;
+#ifdef FMU_EXPORT_PREP_LIB
+	hashPrepBytes(&hash, (const unsigned char *)fmuExportPrep_getRunFilesVersion(),
+		strlen(fmuExportPrep_getRunFilesVersion()) + 1);
+#else
+	if (hashPrepFile(&hash, prepExe) != 0)
+		return NULL;
+#endif
+	if (hashPrepFile(&hash, _c->idd_file) != 0 || hashPrepFile(&hash, _c->in_file) != 0)
+		return NULL;
+	hashPrepBytes(&hash, &haveWea, 1);
+	if (haveWea && hashPrepFile(&hash, _c->wea_file) != 0)
+		return NULL;
+	hashPrepBytes(&hash, (const unsigned char *)tStartFMUstr, strlen(tStartFMUstr) + 1);
+	hashPrepBytes(&hash, (const unsigned char *)tStopFMUstr, strlen(tStopFMUstr) + 1);
+
+	dirLen = strlen(cacheDir);
+	cacheBase = (char *)_c->functions.allocateMemory(dirLen + 30, sizeof(char));
+	sprintf(cacheBase, "%s%sprep-%016llx", cacheDir,
+		(cacheDir[dirLen-1] == '/') ? "" : "/", hash);
+	return cacheBase;
+}
+
+////////////////////////////////////////////////////////////////////////////////////
+/// Links the cached outputs of the preprocessor into the output folder.
+///
+/// The time step file is linked first, since it is the last file added to
+/// the cache. The weather file is copied, as in isLeapYear, so that the
+/// output folder never shares an inode with it. On failure, removes the
+/// files linked so far, so that the preprocessor never writes into a cached file.
 ///
 ///\param _c The FMU instance.
+///\param cacheBase The path of the cached outputs, without extension.
 ///\return 0 if no error occurred.
 ////////////////////////////////////////////////////////////////////////////////////
-int create_res(ModelInstance *_c)
+int linkCachedPrepOutputs(ModelInstance *_c, const char *cacheBase)
 {
-	char *tmp_str;
+	char *cacheFile;
+	char *tStepFile;
+	char *inFile;
+	char *weaFile;
 	int retVal;
-	// The 30 are for the additional characters in tmp_str
-	tmp_str=(char*)(_c->functions.allocateMemory(strlen(_c->fmuOutput) + 30, sizeof(char)));
 
-	sprintf(tmp_str, "mkdir %s%s%s", "\"", _c->fmuOutput, "\"");
-	retVal=system (tmp_str);
-	_c->functions.freeMemory (tmp_str);
+	cacheFile = (char *)_c->functions.allocateMemory(strlen(cacheBase) + 10, sizeof(char));
+	tStepFile = getOutputPath(_c, FTIMESTEP);
+	inFile = getOutputPath(_c, _c->in_file_name);
+	weaFile = getOutputPath(_c, FRUNWEAFILE);
+	remove(tStepFile);
+	remove(inFile);
+	remove(weaFile);
+	sprintf(cacheFile, "%s.tstep", cacheBase);
+	retVal = link(cacheFile, tStepFile);
+	if (retVal == 0){
+		sprintf(cacheFile, "%s.idf", cacheBase);
+		retVal = link(cacheFile, inFile);
+	}
+	if (retVal == 0 && _c->wea_file != NULL){
+		sprintf(cacheFile, "%s.epw", cacheBase);
+		retVal = copyFile(cacheFile, weaFile);
+	}
+	if (retVal != 0){
+		remove(tStepFile);
+		remove(inFile);
+		remove(weaFile);
+	}
+	_c->functions.freeMemory(cacheFile);
+	_c->functions.freeMemory(tStepFile);
+	_c->functions.freeMemory(inFile);
+	_c->functions.freeMemory(weaFile);
 	return retVal;
 }
 
+////////////////////////////////////////////////////////////////////////////////////
+/// Adds one output of the preprocessor to the cache.
+///
+/// Links or copies the file under a temporary name, then renames it, so that
+/// other instances never see a partial file.
+///
+///\param _c The FMU instance.
+///\param fileName The output of the preprocessor, in the output folder.
+///\param cacheBase The path of the cached outputs, without extension.
+///\param ext The extension of the cached file.
+///\param copy 1 to copy the file rather than link it.
+///\return 0 if no error occurred.
+////////////////////////////////////////////////////////////////////////////////////
+int addPrepOutputToCache(ModelInstance *_c, const char *fileName, const char *cacheBase,
+	const char *ext, int copy)
+{
+	char *cacheFile;
+	char *tmpFile;
+	char *outFile;
+	int retVal;
+
+	cacheFile = (char *)_c->functions.allocateMemory(strlen(cacheBase) + strlen(ext) + 1, sizeof(char));
+	tmpFile = (char *)_c->functions.allocateMemory(strlen(cacheBase) + strlen(ext) + 60, sizeof(char));
+	sprintf(cacheFile, "%s%s", cacheBase, ext);
+	// name the temporary file for this process and instance.
+	sprintf(tmpFile, "%s%s.%ld.%p", cacheBase, ext, (long)getpid(), (void *)_c);
+	outFile = getOutputPath(_c, fileName);
+	remove(tmpFile);
+	retVal = copy ? copyFile(outFile, tmpFile) : link(outFile, tmpFile);
+	_c->functions.freeMemory(outFile);
+	if (retVal == 0){
+		retVal = rename(tmpFile, cacheFile);
+		if (retVal != 0)
+			remove(tmpFile);
+	}
+	_c->functions.freeMemory(cacheFile);
+	_c->functions.freeMemory(tmpFile);
+	return retVal;
+}
 
 ////////////////////////////////////////////////////////////////////////////////////
-/// delete old results folder
+/// Adds the outputs of the preprocessor to the cache.
 ///
 ///\param _c The FMU instance.
+///\param cacheBase The path of the cached outputs, without extension.
 ///\return 0 if no error occurred.
 ////////////////////////////////////////////////////////////////////////////////////
-int removeFMUDir (ModelInstance* _c)
+int addPrepOutputsToCache(ModelInstance *_c, const char *cacheBase)
 {
 	int retVal;
-	char *tmp_str;
-	// The 30 are for the additional characters in tmp_str
-	tmp_str=(char*)(_c->functions.allocateMemory(strlen(_c->fmuOutput) + 30, sizeof(char)));
-	_c->functions.logger(NULL, _c->instanceName, fmiOK, "ok", 
-		"This is the output folder %s\n", _c->fmuOutput);
 
+	retVal = addPrepOutputToCache(_c, _c->in_file_name, cacheBase, ".idf", 0);
+	if (retVal == 0 && _c->wea_file != NULL)
+		retVal = addPrepOutputToCache(_c, FRUNWEAFILE, cacheBase, ".epw", 1);
+	if (retVal == 0)
+		retVal = addPrepOutputToCache(_c, FTIMESTEP, cacheBase, ".tstep", 0);
+	return retVal;
+}
+#endif
+
+////////////////////////////////////////////////////////////////////////////////////
+/// Starts a program in the output folder of an FMU instance, without changing
+/// the working directory of the process.
+///
+///\param _c The FMU instance.
+///\param pid Set to the process of the program.
+///\param argv The program, which is searched on the path if it has no folder,
+///            and its arguments, ending with NULL.
+///\return 0 if no error occurred.
+////////////////////////////////////////////////////////////////////////////////////
 #ifdef _MSC_VER
-	sprintf(tmp_str, "rmdir /S /Q %s%s%s", "\"", _c->fmuOutput, "\"");
+int spawn_in_output(ModelInstance *_c, HANDLE *pid, const char *const argv[])
+{
+	STARTUPINFOA startInfo;
+	PROCESS_INFORMATION procInfo;
+	char *cmdLine;
+	size_t len;
+	int i;
+
+	// quote the arguments which hold spaces.
+	len = 1;
+	for (i = 0; argv[i] != NULL; i++)
+		len += strlen(argv[i]) + 3;
+	cmdLine = (char *)_c->functions.allocateMemory(len, sizeof(char));
+	for (i = 0; argv[i] != NULL; i++){
+		if (i > 0)
+			strcat(cmdLine, " ");
+		if (strchr(argv[i], ' ') != NULL)
+			sprintf(cmdLine + strlen(cmdLine), "\"%s\"", argv[i]);
+		else
+			strcat(cmdLine, argv[i]);
+	}
+	ZeroMemory(&startInfo, sizeof(startInfo));
+	startInfo.cb = sizeof(startInfo);
+	if (!CreateProcessA(NULL, cmdLine, NULL, NULL, FALSE, 0, NULL, _c->fmuOutput,
+		&startInfo, &procInfo)){
+		_c->functions.freeMemory(cmdLine);
+		return 1;
+	}
+	_c->functions.freeMemory(cmdLine);
+	CloseHandle(procInfo.hThread);
+	*pid = procInfo.hProcess;
+	return 0;
+}
 #else
-	sprintf(tmp_str, "rm -rf %s%s%s", "\"", _c->fmuOutput, "\"");
+int spawn_in_output(ModelInstance *_c, pid_t *pid, const char *const argv[])
+{
+	posix_spawn_file_actions_t actions;
+	int retVal;
+#ifndef HAVE_SPAWN_CHDIR
+	const char **shArgv;
+	int i, argc;
 #endif
-	_c->functions.logger(NULL, _c->instanceName, fmiOK, "ok",  
-		"This is the command to be executed to delete existing directory %s\n", tmp_str);
-	retVal=system (tmp_str);
-	_c->functions.freeMemory (tmp_str);
+
+	retVal = posix_spawn_file_actions_init(&actions);
+	if (retVal != 0)
+		return retVal;
+#ifdef HAVE_SPAWN_CHDIR
+	retVal = posix_spawn_file_actions_addchdir_np(&actions, _c->fmuOutput);
+	if (retVal == 0)
+		retVal = posix_spawnp(pid, argv[0], &actions, NULL, (char *const *)argv, environ);
+#else
+	// change the directory in a shell, which then replaces itself with
+	// the program, so that pid is the process of the program.
+	for (argc = 0; argv[argc] != NULL; argc++)
+		;
+	shArgv = (const char **)_c->functions.allocateMemory(argc + 5, sizeof(char *));
+	shArgv[0] = "/bin/sh";
+	shArgv[1] = "-c";
+	shArgv[2] = "cd \"$0\" && exec \"$@\"";
+	shArgv[3] = _c->fmuOutput;
+	for (i = 0; i <= argc; i++)
+		shArgv[4 + i] = argv[i];
+	retVal = posix_spawn(pid, shArgv[0], &actions, NULL, (char *const *)shArgv, environ);
+	_c->functions.freeMemory((void *)shArgv);
+#endif
+	posix_spawn_file_actions_destroy(&actions);
 	return retVal;
 }
+#endif
 
 ////////////////////////////////////////////////////////////////////////////////////
-/// start simulation
+/// Runs a program in the output folder of an FMU instance, and waits for it
+/// to finish.
+///
+///\param _c The FMU instance.
+///\param argv The program and its arguments, ending with NULL.
+///\return 0 if the program ran and exited with status 0.
+////////////////////////////////////////////////////////////////////////////////////
+int run_in_output(ModelInstance *_c, const char *const argv[])
+{
+#ifdef _MSC_VER
+	HANDLE pid;
+	DWORD exitCode;
+
+	if (spawn_in_output(_c, &pid, argv) != 0)
+		return 1;
+	WaitForSingleObject(pid, INFINITE);
+	if (!GetExitCodeProcess(pid, &exitCode))
+		exitCode = 1;
+	CloseHandle(pid);
+	return (exitCode == 0) ? 0 : 1;
+#else
+	pid_t pid;
+	int status;
+
+	if (spawn_in_output(_c, &pid, argv) != 0)
+		return 1;
+	while (waitpid(pid, &status, 0) < 0){
+		if (errno != EINTR)
+			return 1;
+	}
+	return (WIFEXITED(status) && WEXITSTATUS(status) == 0) ? 0 : 1;
+#endif
+}
+
+////////////////////////////////////////////////////////////////////////////////////
+/// Runs the preprocessor, which writes the input file, the weather file
+/// and the time step file of the run into the output folder.
+///
+/// If the preprocessor is linked into the FMU, calls it directly, and gets
+/// the time step without reading the time step file.  Otherwise runs the
+/// preprocessor executable.
 ///
 ///\param _c The FMU instance.
+///\param cmdstr The path of the preprocessor executable.
+///\param tStartFMUstr The start time.
+///\param tStopFMUstr The stop time.
+///\param timeStep Set to the number of time steps per hour, or to 0 if
+///                 the time step must be read from the time step file.
 ///\return 0 if no error occurred.
 ////////////////////////////////////////////////////////////////////////////////////
-int start_sim(ModelInstance* _c)
+int run_prep(ModelInstance *_c, const char *cmdstr, const char *tStartFMUstr,
+	const char *tStopFMUstr, int *timeStep)
 {
+	int retVal;
+	char *tStepFile;
+	char *weaFile;
+	char *runInFile;
+	char *inFile;
+#ifndef FMU_EXPORT_PREP_LIB
+	const char *argv[10];
+	int argc;
+#ifndef _MSC_VER
 	struct stat stat_p;
+#endif
+#endif
 
-#ifdef _MSC_VER
-	FILE *fpBat;
-#else
-#ifdef __APPLE__
-#include <crt_externs.h>
-#define environ (*_NSGetEnviron())
+	tStepFile = getOutputPath(_c, FTIMESTEP);
+	weaFile = getOutputPath(_c, FRUNWEAFILE);
+	runInFile = getOutputPath(_c, FRUNINFILE);
+	inFile = getOutputPath(_c, _c->in_file_name);
+
+	// remove outputs of an earlier run, which may be linked to the cache.
+	remove(tStepFile);
+	remove(weaFile);
+	remove(runInFile);
+	*timeStep = 0;
+
+#ifdef FMU_EXPORT_PREP_LIB
+	retVal = fmuExportPrep_writeRunFiles(_c->fmuOutput, _c->idd_file, _c->in_file, _c->wea_file,
+		tStartFMUstr, tStopFMUstr, timeStep);
 #else
-	extern char **environ;
+	//Make file executable if UNIX
+#ifndef _MSC_VER
+	retVal = stat(cmdstr, &stat_p);
+	if (retVal == 0)
+		retVal = chmod(cmdstr, stat_p.st_mode | S_IXUSR | S_IXGRP | S_IXOTH);
+	if (retVal != 0){
+		_c->functions.logger(NULL, _c->instanceName, fmiError, "error", "fmiInitializeSlave: Could not"
+			" make preprocessor executable. Initialization of %s failed.\n",
+			_c->instanceName);
+		retVal = 1;
+		goto done;
+	}
+#endif
+	argc = 0;
+	argv[argc++] = cmdstr;
+	if (_c->wea_file != NULL){
+		argv[argc++] = "-w";
+		argv[argc++] = _c->wea_file;
+	}
+	argv[argc++] = "-b";
+	argv[argc++] = tStartFMUstr;
+	argv[argc++] = "-e";
+	argv[argc++] = tStopFMUstr;
+	argv[argc++] = _c->idd_file;
+	argv[argc++] = _c->in_file;
+	argv[argc] = NULL;
+	retVal = run_in_output(_c, argv);
 #endif
+	if (retVal != 0){
+		_c->functions.logger(NULL, _c->instanceName, fmiError, "error", "fmiInitializeSlave: Could not"
+			" create the input and weather file. Initialization of %s failed.\n",
+			_c->instanceName);
+		retVal = 1;
+		goto done;
+	}
+
+	// rename found idf to have the correct name.
+	retVal = rename(runInFile, inFile);
+	if (retVal != 0){
+		_c->functions.logger(NULL, _c->instanceName, fmiError, "error", "fmiInitializeSlave: Could not"
+			" rename the temporary input file. Initialization of %s failed.\n",
+			_c->instanceName);
+		retVal = 1;
+	}
+done:
+	_c->functions.freeMemory(tStepFile);
+	_c->functions.freeMemory(weaFile);
+	_c->functions.freeMemory(runInFile);
+	_c->functions.freeMemory(inFile);
+	return retVal;
+}
+
+////////////////////////////////////////////////////////////////////////////////////
+/// create results folder 
+///
+///\param _c The FMU instance.
+///\return 0 if no error occurred.
+////////////////////////////////////////////////////////////////////////////////////
+int create_res(ModelInstance *_c)
+{
+	return makeDirs (_c->fmuOutput);
+}
+
+
+////////////////////////////////////////////////////////////////////////////////////
+/// delete old results folder
+///
+///\param _c The FMU instance.
+///\return 0 if no error occurred.
+////////////////////////////////////////////////////////////////////////////////////
+int removeFMUDir (ModelInstance* _c)
+{
+	_c->functions.logger(NULL, _c->instanceName, fmiOK, "ok", 
+		"This is the output folder %s\n", _c->fmuOutput);
+	return removeDirTree (_c->fmuOutput);
+}
+
+////////////////////////////////////////////////////////////////////////////////////
+/// start simulation
+///
+///\param _c The FMU instance.
+///\return 0 if no error occurred.
+////////////////////////////////////////////////////////////////////////////////////
+int start_sim(ModelInstance* _c)
+{
+	struct stat stat_p;
+	char *weaFile;
+	int hasWeaFile;
 	int retVal;
+#ifdef _MSC_VER
+	FILE *fpBat;
+	char *batFile;
+	const char *const argv[]={"cmd.exe", "/c", EPBAT, NULL};
 #endif
 	_c->functions.logger(NULL, _c->instanceName, fmiOK, "ok", 
 		"This version uses the **energyplus** command line interface to "
 		" call the EnergyPlus executable. **RunEPlus.bat** and **runenergyplus** ," 
 		" which were used in earlier versions, were deprecated as of August 2015.");
+	weaFile = getOutputPath(_c, FRUNWEAFILE);
+	hasWeaFile = (stat(weaFile, &stat_p)>=0);
+	_c->functions.freeMemory(weaFile);
 #ifdef _MSC_VER
-	fpBat=fopen("EP.bat", "w");
-	if (stat(FRUNWEAFILE, &stat_p)>=0){
+	batFile = getOutputPath(_c, EPBAT);
+	fpBat=fopen(batFile, "w");
+	_c->functions.freeMemory(batFile);
+	if (fpBat == NULL) {
+		return 1;
+	}
+	if (hasWeaFile){
 		// write the command string
 		fprintf(fpBat, "energyplus %s %s %s %s %s %s %s %s %s %s", 
 			"-w", FRUNWEAFILE, "-p", _c->mID, "-s", "C", "-x", "-m",
@@ -379,34 +987,56 @@ int start_sim(ModelInstance* _c)
 			"-p", _c->mID, "-s", "C", "-x", "-m", "-r", _c->in_file_name);
 	}
 	fclose (fpBat);
-	_c->pid=(HANDLE)_spawnl(P_NOWAIT, "EP.bat", "EP.bat", NULL); 
-	if (_c->pid > 0 ) {
-		return 0;
-	}
-	else {
-		return 1;
-	}
+	retVal=spawn_in_output(_c, &_c->pid, argv);
+	return retVal;
 #else
-	if (stat (FRUNWEAFILE, &stat_p)>=0){
+	if (hasWeaFile){
 		//char *const argv[]={"runenergyplus", _c->mID, FRUNWEAFILE, NULL};
-		char *const argv[]={"energyplus", "-w", FRUNWEAFILE, "-p", _c->mID, 
+		const char *const argv[]={"energyplus", "-w", FRUNWEAFILE, "-p", _c->mID, 
 			"-s", "C", "-x", "-m", "-r", _c->in_file_name, NULL};
 		// execute the command string
-		retVal=posix_spawnp( &_c->pid, argv[0], NULL, NULL, argv, environ);
+		retVal=spawn_in_output(_c, &_c->pid, argv);
 		return retVal;
 	}
 	else
 	{
 		//char *const argv[]={"runenergyplus", _c->mID, NULL};
-		char *const argv[]={"energyplus", "-p", _c->mID, "-s", "C", "-x", 
+		const char *const argv[]={"energyplus", "-p", _c->mID, "-s", "C", "-x", 
 			"-m", "-r", _c->in_file_name, NULL};
 		// execute the command string
-		retVal=posix_spawnp( &_c->pid, argv[0], NULL, NULL, argv, environ);
+		retVal=spawn_in_output(_c, &_c->pid, argv);
 		return retVal;
 	}
 #endif
 }
 
+#ifndef _MSC_VER
+////////////////////////////////////////////////////////////////////////////////////
+/// stop EnergyPlus, which did not connect to the shared memory channel, and
+/// start it again with a TCP socket
+///
+///\param _c The FMU instance.
+///\return 0 if no error occurred.
+////////////////////////////////////////////////////////////////////////////////////
+int restart_sim_tcp(ModelInstance* _c)
+{
+	int status;
+	char *path;
+	_c->functions.logger(NULL, _c->instanceName, fmiWarning, "warning", 
+		"fmiInitializeSlave: EnergyPlus did not connect to the shared memory channel. "
+		"Falling back to TCP socket.\n");
+	kill(_c->pid, SIGKILL);
+	waitpid(_c->pid, &status, 0);
+	closeshmFMU(&(_c->sockBuf));
+	path=getOutputPath(_c, SHMFILE);
+	remove(path);
+	_c->functions.freeMemory(path);
+	if (create_tcp_server(_c)!=0)
+		return 1;
+	return start_sim(_c);
+}
+#endif
+
 // The methods below should be used only when testing the main program below.
 /////////////////////////////////////////////////////////////////////////////////
 ///// FMI status
@@ -503,6 +1133,9 @@ void freeInstanceResources(ModelInstance* _c) {
 	// free model GUID
 	if (_c->mGUID!=NULL) _c->functions.freeMemory(_c->mGUID);
 	_c->mGUID = NULL;
+	// release model description, which is shared with other instances
+	if (_c->md!=NULL) releaseModelDescription(_c->md);
+	_c->md = NULL;
 	// free xml file
 	if (_c->xml_file!=NULL) _c->functions.freeMemory(_c->xml_file);
 	_c->xml_file = NULL;
@@ -533,11 +1166,94 @@ void freeInstanceResources(ModelInstance* _c) {
 	// deallocate memory for outVec
 	if (_c->outVec != NULL)  _c->functions.freeMemory(_c->outVec);
 	_c->outVec = NULL;
+	// deallocate memory for the value reference tables
+	if (_c->inVrSlot != NULL)  _c->functions.freeMemory(_c->inVrSlot);
+	_c->inVrSlot = NULL;
+	if (_c->outVrSlot != NULL)  _c->functions.freeMemory(_c->outVrSlot);
+	_c->outVrSlot = NULL;
+	// deallocate the socket buffers
+	freesocketbuffersFMU(&(_c->sockBuf));
 	 // free fmu instance
 	if (_c!=NULL) _c->functions.freeMemory(_c);
 	_c=NULL;
 }
 
+////////////////////////////////////////////////////////////////
+///  This method is used to build the tables which map the value
+///  references of the input and output variables to their slots
+///  in inVec and outVec. The tables are indexed by vr-VR_INPUT_BASE
+///  and vr-VR_OUTPUT_BASE, so that fmiSetReal and fmiGetReal do
+///  not need to scan the model variables.
+///
+///\param _c The FMU instance.
+///\return 0 if no error occurred.
+////////////////////////////////////////////////////////////////
+int buildVrSlotTables(ModelInstance* _c) {
+	ScalarVariable** vars;
+	fmiValueReference vrTemp;
+	fmiValueReference inMax=0;
+	fmiValueReference outMax=0;
+	int numIn=0;
+	int numOut=0;
+	int k;
+	Enu cau;
+
+	vars=_c->md->modelVariables;
+	if (!vars) return 0;
+
+	// get the range of the value references and the size of inVec and outVec
+	for (k=0; vars[k]; k++) {
+		cau=getCausality(vars[k]);
+		if (cau==enu_input) numIn++;
+		else if (cau==enu_output) numOut++;
+		else continue;
+		if (getAlias(vars[k])!=enu_noAlias) continue;
+		vrTemp=getValueReference(vars[k]);
+		if (cau==enu_input && vrTemp>=VR_INPUT_BASE && vrTemp-VR_INPUT_BASE+1>inMax){
+			inMax=vrTemp-VR_INPUT_BASE+1;
+		}
+		if (cau==enu_output && vrTemp>=VR_OUTPUT_BASE && vrTemp-VR_OUTPUT_BASE+1>outMax){
+			outMax=vrTemp-VR_OUTPUT_BASE+1;
+		}
+	}
+	_c->inVrSlotLen=inMax;
+	_c->outVrSlotLen=outMax;
+	if (inMax>0){
+		_c->inVrSlot=(int*)_c->functions.allocateMemory(inMax, sizeof(int));
+		if (_c->inVrSlot==NULL) return 1;
+		memset(_c->inVrSlot, -1, inMax*sizeof(int));
+	}
+	if (outMax>0){
+		_c->outVrSlot=(int*)_c->functions.allocateMemory(outMax, sizeof(int));
+		if (_c->outVrSlot==NULL) return 1;
+		memset(_c->outVrSlot, -1, outMax*sizeof(int));
+	}
+
+	// fill the tables
+	for (k=0; vars[k]; k++) {
+		if (getAlias(vars[k])!=enu_noAlias) continue;
+		cau=getCausality(vars[k]);
+		vrTemp=getValueReference(vars[k]);
+		if (cau==enu_input && vrTemp>=VR_INPUT_BASE){
+			if ((int)(vrTemp-VR_INPUT_BASE)<numIn){
+				_c->inVrSlot[vrTemp-VR_INPUT_BASE]=vrTemp-VR_INPUT_BASE;
+				continue;
+			}
+		}
+		else if (cau==enu_output && vrTemp>=VR_OUTPUT_BASE){
+			if ((int)(vrTemp-VR_OUTPUT_BASE)<numOut){
+				_c->outVrSlot[vrTemp-VR_OUTPUT_BASE]=vrTemp-VR_OUTPUT_BASE;
+				continue;
+			}
+		}
+		else continue;
+		_c->functions.logger(NULL, _c->instanceName, fmiWarning, "warning",
+			"buildVrSlotTables: Value reference %u of variable %s is out of range and will be ignored.\n",
+			vrTemp, getName(vars[k]));
+	}
+	return 0;
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 /// This function writes the path to the fmu resource location. 
 ///
@@ -684,6 +1400,7 @@ DllExport fmiComponent fmiInstantiateSlave(fmiString instanceName,
 	fmiString mFmiVers;
 	struct stat st;
 	fmiBoolean errDir;
+	const char* mdCacheDir;
 	ModelInstance* _c;
 
 	// Perform checks.
@@ -782,10 +1499,9 @@ DllExport fmiComponent fmiInstantiateSlave(fmiString instanceName,
 	replace_char (_c->fmuUnzipLocation, '//', '\\');
 #endif
 
-	// create content of resources folder in created output directory
-	// "\"" is to make sure that we have quotation at the end of the path for variables.cfg.
-	_c->tmpResCon=(char *)_c->functions.allocateMemory(strlen (_c->fmuResourceLocation) + strlen (VARCFG) + strlen ("\"") + 1, sizeof(char));
-	sprintf(_c->tmpResCon, "%s%s%s", _c->fmuResourceLocation, "\"", VARCFG);
+	// path of variables.cfg in the resources folder, to copy into the output directory
+	_c->tmpResCon=(char *)_c->functions.allocateMemory(strlen (_c->fmuResourceLocation) + strlen (VARCFG) + 1, sizeof(char));
+	sprintf(_c->tmpResCon, "%s%s", _c->fmuResourceLocation, VARCFG);
 
 	// create the output directory
 	retVal=create_res(_c);
@@ -795,7 +1511,7 @@ DllExport fmiComponent fmiInstantiateSlave(fmiString instanceName,
 	}
 
 	// add the end slash to the fmuOutput
-	sprintf(_c->fmuOutput, "%s%s", _c->fmuOutput, PATH_SEP);
+	strcat(_c->fmuOutput, PATH_SEP);
 
 	// copy the vriables cfg into the output directory
 	retVal=copy_var_cfg(_c);
@@ -807,28 +1523,18 @@ DllExport fmiComponent fmiInstantiateSlave(fmiString instanceName,
 		return NULL;
 	}
 
-	// change the directory to make sure that FMUs are not overwritten
-#ifdef _MSC_VER
-	retVal=_chdir(_c->fmuOutput);
-#else
-	retVal=chdir(_c->fmuOutput);
-#endif
-	if (retVal!=0){
-		_c->functions.logger(NULL, _c->instanceName, fmiError, "error", "fmiInstantiateSlave: Could not switch"
-			" to the output folder %s. Instantiation of %s failed.\n", _c->fmuOutput, _c->instanceName);
-		// Free resources allocated to instance.
-		freeInstanceResources (_c);
-		return NULL;
-	}
-
 	// create path to xml file
 	_c->xml_file=(char *)_c->functions.allocateMemory(strlen (_c->fmuUnzipLocation) + strlen (XML_FILE) + 1, sizeof(char));
 	sprintf(_c->xml_file, "%s%s", _c->fmuUnzipLocation, XML_FILE);
 	_c->functions.logger(NULL, _c->instanceName, fmiOK, "ok", 
 		"fmiInstantiateSlave: Path to model description file is %s.\n", _c->xml_file);
 
-	// get model description of the FMU
-	_c->md=parse(_c->xml_file);
+	// get model description of the FMU. Instances of the FMU in this process
+	// share it. Later processes load it from a binary cache file only if
+	// the folder of that file is set.
+	mdCacheDir=getenv(MDCACHE_ENV);
+	_c->md=getModelDescription(_c->xml_file, fmuGUID,
+		(mdCacheDir==NULL || mdCacheDir[0]=='\0') ? NULL : mdCacheDir);
 	if (!_c->md) {
 		_c->functions.logger(NULL, _c->instanceName, fmiError, "error", "fmiInstantiateSlave: Failed to parse the model description"
 			" found in directory %s. Instantiation of %s failed\n", _c->xml_file, _c->instanceName);
@@ -837,6 +1543,15 @@ DllExport fmiComponent fmiInstantiateSlave(fmiString instanceName,
 		return NULL;
 	}
 
+	// map the value references to the input and output vectors
+	if (buildVrSlotTables(_c)!=0) {
+		_c->functions.logger(NULL, _c->instanceName, fmiError, "error", "fmiInstantiateSlave: Could not allocate"
+			" the value reference tables. Instantiation of %s failed\n", _c->instanceName);
+		// Free resources allocated to instance.
+		freeInstanceResources (_c);
+		return NULL;
+	}
+
 	// gets the modelID of the FMU
 	mID=getModelIdentifier(_c->md);
 
@@ -873,20 +1588,6 @@ DllExport fmiComponent fmiInstantiateSlave(fmiString instanceName,
 	}
 	_c->functions.logger(NULL, _c->instanceName, fmiOK, "ok", 
 		"fmiInstantiateSlave: Slave %s is instantiated.\n", _c->instanceName);
-	// reset the current working directory. This is particularly important for Dymola
-	// otherwise Dymola will write results at wrong place
-#ifdef _MSC_VER
-	retVal=_chdir(_c->cwd);
-#else
-	retVal=chdir(_c->cwd);
-#endif
-	if (retVal!=0){
-		_c->functions.logger(NULL, _c->instanceName, fmiError, "error", "fmiInstantiateSlave: Could not switch to"
-			" the working directory folder %s. Instantiation of %s failed.\n", _c->cwd, _c->instanceName);
-		// Free resources allocated to instance.
-		freeInstanceResources (_c);
-		return NULL;
-	}
 	// This is required to prevent Dymola to call fmiSetReal before the initialization
 	_c->firstCallIni=1;
 	_c->functions.logger(NULL, _c->instanceName, fmiOK, "ok", 
@@ -906,36 +1607,27 @@ DllExport fmiComponent fmiInstantiateSlave(fmiString instanceName,
 DllExport fmiStatus fmiInitializeSlave(fmiComponent c, fmiReal tStart, fmiBoolean StopTimeDefined, fmiReal tStop)
 {
 	int retVal;
+	int transport;
 	ModelInstance* _c=(ModelInstance *)c;
 	FILE *fp;
 	char tStartFMUstr[100];
 	char tStopFMUstr[100];
 	char command[100];
 	char *tmpstr;
+	char *tStepFile;
 	char *cmdstr;
-	char *cmdstrEXE;
+	int cacheHit;
 
-#ifdef _MSC_VER
-	int sockLength;
-
-#else
+#ifndef _MSC_VER
+	char *cacheBase;
 	struct stat stat_p;
-	socklen_t sockLength;
 #endif
-	struct sockaddr_in   server_addr;
-	int                  port_num;
-	char                 ThisHost[10000];
-	struct  hostent *hp;
 
 #ifdef _MSC_VER
 	WORD wVersionRequested=MAKEWORD(2,2);
 	WSADATA wsaData;
 #endif
 
-#ifndef _MSC_VER
-	mode_t process_mask=umask(0);
-#endif 
-
 	// save start of the simulation time step
 	_c->tStartFMU=tStart;
 	// save end of smulation time step
@@ -962,17 +1654,6 @@ DllExport fmiStatus fmiInitializeSlave(fmiComponent c, fmiReal tStart, fmiBoolea
 	_c->numInVar =-1;
 	_c->numOutVar=-1;
 
-	// change the directory to make sure that FMUs are not overwritten
-#ifdef _MSC_VER
-	retVal=_chdir(_c->fmuOutput);
-#else
-	retVal=chdir(_c->fmuOutput);
-#endif
-	if (retVal!=0){
-		_c->functions.logger(NULL, _c->instanceName, fmiError, "error", 
-			"fmiInitializeSlave: The path to the output folder %s is not valid.\n", _c->fmuOutput);
-		return fmiError;
-	}
 	///////////////////////////////////////////////////////////////////////////////////
 	// create the socket server
 
@@ -996,68 +1677,6 @@ DllExport fmiStatus fmiInitializeSlave(fmiComponent c, fmiReal tStart, fmiBoolea
 	}
 #endif  /************* End of Windows specific code *******/
 
-	_c->sockfd=socket(AF_INET, SOCK_STREAM, 0);
-	// check for errors to ensure that the socket is a valid socket.
-	if (_c->sockfd==INVALID_SOCKET)
-	{
-		_c->functions.logger(NULL, _c->instanceName, fmiError, 
-			"error", "fmiInitializeSlave: Opening socket failed"
-			" sockfd=%d.\n", _c->sockfd);
-		return fmiError;
-	}
-	_c->functions.logger(NULL, _c->instanceName, fmiOK, "ok",  "fmiInitializeSlave: The sockfd is %d.\n", _c->sockfd);
-	// initialize socket structure server address information
-	memset(&server_addr, 0, sizeof(server_addr));
-	server_addr.sin_family=AF_INET;                 // Address family to use
-	server_addr.sin_port=htons(0);                  // Port number to use
-	server_addr.sin_addr.s_addr=htonl(INADDR_ANY);  // Listen on any IP address
-
-	// bind the socket
-	if (bind(_c->sockfd, (struct sockaddr *)&server_addr, sizeof(server_addr))==SOCKET_ERROR)
-	{
-		_c->functions.logger(NULL, _c->instanceName, fmiError, 
-			"error", "fmiInitializeSlave: bind() failed.\n");
-		closeipcFMU (&(_c->sockfd));
-		return fmiError;
-	}
-
-	// get socket information information
-	sockLength=sizeof(server_addr);
-	if ( getsockname (_c->sockfd, (struct sockaddr *)&server_addr, &sockLength)) {
-		_c->functions.logger(NULL,  _c->instanceName, fmiError,
-			"error", "fmiInitializeSlave: Get socket name failed.\n");
-		return fmiError;
-	}
-
-	// get the port number
-	port_num=ntohs(server_addr.sin_port);
-	_c->functions.logger(NULL, _c->instanceName, fmiOK, "ok",  "fmiInitializeSlave: The port number is %d.\n", port_num);
-
-	// get the hostname information
-	gethostname(ThisHost, MAXHOSTNAME);
-	if  ((hp=gethostbyname(ThisHost))==NULL ) {
-		_c->functions.logger(NULL,  _c->instanceName, fmiError, 
-			"error", "fmiInitializeSlave: Get host by name failed.\n");
-		return fmiError;
-	}
-
-	// write socket cfg file
-	retVal=write_socket_cfg (_c, port_num, ThisHost);
-	_c->functions.logger(NULL, _c->instanceName, fmiOK, "ok",  "fmiInitializeSlave: This hostname is %s.\n", ThisHost);
-	if  (retVal !=0) {
-		_c->functions.logger(NULL,  _c->instanceName, fmiError, 
-			"error", "fmiInitializeSlave: Write socket cfg failed.\n");
-		return fmiError;
-	}
-	// listen to the port
-	if (listen(_c->sockfd, 1)==SOCKET_ERROR)
-	{
-		_c->functions.logger(NULL,  _c->instanceName, fmiError, "error", "fmiInitializeSlave: listen() failed.\n");
-		closeipcFMU (&(_c->sockfd));
-		return fmiError;
-	}
-	_c->functions.logger(NULL, _c->instanceName, fmiOK, "ok",  "fmiInitializeSlave: TCPServer Server waiting for clients on port: %d.\n", port_num);
-
 	// get the number of input variables of the FMU
 	if (_c->numInVar==-1)
 	{
@@ -1082,6 +1701,35 @@ DllExport fmiStatus fmiInitializeSlave(fmiComponent c, fmiReal tStart, fmiBoolea
 			_c->instanceName);
 		return fmiError;
 	}
+
+	// use shared memory or a Unix domain socket if it is requested, and 
+	// fall back to TCP if it is not requested or not available.
+	retVal=1;
+	transport=getsockettransportFMU();
+	if (transport==TRANSPORT_SHM)
+	{
+		retVal=create_shm_server(_c);
+		if (retVal!=0){
+			_c->functions.logger(NULL, _c->instanceName, fmiWarning, "warning", 
+				"fmiInitializeSlave: Falling back to TCP socket.\n");
+		}
+	}
+	else if (transport==TRANSPORT_UNIX)
+	{
+		retVal=create_unix_server(_c);
+		if (retVal!=0){
+			_c->functions.logger(NULL, _c->instanceName, fmiWarning, "warning", 
+				"fmiInitializeSlave: Falling back to TCP socket.\n");
+		}
+	}
+	if (retVal!=0)
+	{
+		retVal=create_tcp_server(_c);
+		if (retVal!=0){
+			return fmiError;
+		}
+	}
+
 	// create the input and weather file for the run
 	// Need to see how we will parste the start and stop time so 
 	// they become strings and can be used by str when calling the system command.
@@ -1123,95 +1771,84 @@ DllExport fmiStatus fmiInitializeSlave(fmiComponent c, fmiReal tStart, fmiBoolea
 	strcpy(command, "idf-to-fmu-export-prep-darwin");
 #endif
 
-	if (_c->wea_file != NULL){
-		cmdstr = (char *)_c->functions.allocateMemory(strlen(_c->fmuResourceLocation) + strlen(command) + 10, sizeof(char));
-		sprintf(cmdstr, "%s%s", _c->fmuResourceLocation, command);
-		//Make file executable if UNIX
+	cmdstr = (char *)_c->functions.allocateMemory(strlen(_c->fmuResourceLocation) + strlen(command) + 10, sizeof(char));
+	sprintf(cmdstr, "%s%s", _c->fmuResourceLocation, command);
+
+	// set the name of the input file of the run.
+	tmpstr = (char *)_c->functions.allocateMemory(strlen(_c->mID) + strlen(".idf") + 1, sizeof(char));
+	sprintf(tmpstr, "%s%s", _c->mID, ".idf");
+	strcpy(_c->in_file_name, tmpstr);
+	// free tmpstr
+	_c->functions.freeMemory(tmpstr);
+
+	// link the outputs of an earlier run of the preprocessor on the same inputs,
+	// if there is one, else run the preprocessor and cache its outputs.
+	retVal = 0;
+	cacheHit = 0;
+	_c->timeStepIDF = 0;
 #ifndef _MSC_VER
-		cmdstrEXE = (char *)_c->functions.allocateMemory(strlen(cmdstr) + 10, sizeof(char));
-		sprintf(cmdstrEXE, "%s %s", "chmod +x", cmdstr);
-		retVal = system(cmdstrEXE);
-		if (retVal != 0){
-			_c->functions.logger(NULL, _c->instanceName, fmiError, "error", "fmiInitializeSlave: Could not"
-				" make preprocessor executable. Initialization of %s failed.\n",
-				_c->instanceName);
-			return fmiError;
-		}
-		_c->functions.freeMemory(cmdstrEXE);
+	cacheBase = getPrepCacheBase(_c, cmdstr, tStartFMUstr, tStopFMUstr);
+	if (cacheBase != NULL && linkCachedPrepOutputs(_c, cacheBase) == 0){
+		cacheHit = 1;
+		_c->functions.logger(NULL, _c->instanceName, fmiOK, "ok",
+			"fmiInitializeSlave: Reusing the input and weather file cached in %s.\n", cacheBase);
+	}
 #endif
-		tmpstr = (char *)_c->functions.allocateMemory(strlen(cmdstr) + strlen(_c->wea_file) +
-			strlen(_c->idd_file) + strlen(_c->in_file) + strlen(tStartFMUstr) + strlen(tStopFMUstr) + 50, sizeof(char));
-		sprintf(tmpstr, "%s -w %s -b %s -e %s %s %s", cmdstr, _c->wea_file, tStartFMUstr, tStopFMUstr, _c->idd_file, _c->in_file);
-		retVal = system(tmpstr);
+	if (!cacheHit){
+		retVal = run_prep(_c, cmdstr, tStartFMUstr, tStopFMUstr, &(_c->timeStepIDF));
 	}
-	else{
-		cmdstr = (char *)_c->functions.allocateMemory(strlen(_c->fmuResourceLocation) + strlen(command) + 10, sizeof(char));
-		sprintf(cmdstr, "%s%s", _c->fmuResourceLocation, command);
 #ifndef _MSC_VER
-		cmdstrEXE = (char *)_c->functions.allocateMemory(strlen(cmdstr) + 10, sizeof(char));
-		sprintf(cmdstrEXE, "%s %s", "chmod +x", cmdstr);
-		retVal = system(cmdstrEXE);
-		if (retVal != 0){
-			_c->functions.logger(NULL, _c->instanceName, fmiError, "error", "fmiInitializeSlave: Could not"
-				" make preprocessor executable. Initialization of %s failed.\n",
-				_c->instanceName);
-			return fmiError;
+	if (!cacheHit && retVal == 0 && cacheBase != NULL){
+		if (addPrepOutputsToCache(_c, cacheBase) != 0){
+			_c->functions.logger(NULL, _c->instanceName, fmiOK, "ok",
+				"fmiInitializeSlave: Could not cache the input and weather file in %s.\n", cacheBase);
 		}
-		_c->functions.freeMemory(cmdstrEXE);
-#endif
-		tmpstr = (char *)_c->functions.allocateMemory(strlen(cmdstr) + 
-			strlen(_c->idd_file) + strlen(_c->in_file) + strlen(tStartFMUstr) + strlen(tStopFMUstr) + 50, sizeof(char));
-		sprintf(tmpstr, "%s -b %s -e %s %s %s", cmdstr, tStartFMUstr, tStopFMUstr, _c->idd_file, _c->in_file);
-		retVal = system(tmpstr);
 	}
+	if (cacheBase != NULL)
+		_c->functions.freeMemory(cacheBase);
+#endif
 	_c->functions.freeMemory(cmdstr);
-	_c->functions.freeMemory(tmpstr);
-	if (retVal != 0){
-		_c->functions.logger(NULL, _c->instanceName, fmiError, "error", "fmiInitializeSlave: Could not"
-			" create the input and weather file. Initialization of %s failed.\n",
-			_c->instanceName);
-		return fmiError;
-	}
-
-	// rename found idf to have the correct name.
-	tmpstr = (char *)_c->functions.allocateMemory(strlen(_c->mID) + strlen(".idf") + 1, sizeof(char));
-	sprintf(tmpstr, "%s%s", _c->mID, ".idf");
-	strcpy(_c->in_file_name, tmpstr);
-	// free tmpstr
-	_c->functions.freeMemory(tmpstr);
-	retVal = rename(FRUNINFILE, _c->in_file_name);
 	if (retVal != 0){
-		_c->functions.logger(NULL, _c->instanceName, fmiError, "error", "fmiInitializeSlave: Could not"
-			" rename the temporary input file. Initialization of %s failed.\n",
-			_c->instanceName);
 		return fmiError;
 	}
 
-	if((fp=fopen(FTIMESTEP, "r")) !=NULL) {
-		retVal=fscanf(fp, "%d", &(_c->timeStepIDF));
-		fclose (fp);
-		// check if the timeStepIDF is null to avoid division by zero
-		if (_c->timeStepIDF==0){
+	// read the time step file, unless the preprocessor returned the time step.
+	if (_c->timeStepIDF==0){
+		tStepFile=getOutputPath(_c, FTIMESTEP);
+		fp=fopen(tStepFile, "r");
+		_c->functions.freeMemory(tStepFile);
+		if(fp==NULL) {
 			_c->functions.logger(NULL, _c->instanceName, fmiError, "error", 
-				"fmiInitializeSlave: The time step in IDF cannot be null.\n");
-			_c->functions.logger(NULL, _c->instanceName, fmiError, "error",   "fmiInitializeSlave: Time step in IDF is null.\n");
+				"fmiInitializeSlave: A valid time step could not be determined.\n");
+			_c->functions.logger(NULL, _c->instanceName, fmiError, "error",   "fmiInitializeSlave: Can't read time step file.\n");
 			return fmiError;
-		}	
+		}
+		retVal=fscanf(fp, "%d", &(_c->timeStepIDF));
+		fclose (fp);
 	}
-	else
-	{
+	// check if the timeStepIDF is null to avoid division by zero
+	if (_c->timeStepIDF==0){
 		_c->functions.logger(NULL, _c->instanceName, fmiError, "error", 
-			"fmiInitializeSlave: A valid time step could not be determined.\n");
-		_c->functions.logger(NULL, _c->instanceName, fmiError, "error",   "fmiInitializeSlave: Can't read time step file.\n");
+			"fmiInitializeSlave: The time step in IDF cannot be null.\n");
+		_c->functions.logger(NULL, _c->instanceName, fmiError, "error",   "fmiInitializeSlave: Time step in IDF is null.\n");
 		return fmiError;
 	}
 
-#ifndef _MSC_VER
-	umask(process_mask);
-#endif
 	// start the simulation
 	retVal=start_sim(_c);
-	_c->newsockfd=accept(_c->sockfd, NULL, NULL);
+#ifndef _MSC_VER
+	// EnergyPlus may exit, or ignore the shared memory channel if it does
+	// not support it. In both cases, run it again with a TCP socket.
+	if (_c->sockBuf.shm!=NULL && retVal==0)
+	{
+		if (acceptshmclientFMU(&(_c->sockBuf), _c->pid, SHM_CONNECT_TIMEOUT_MS)!=0)
+			retVal=restart_sim_tcp(_c);
+	}
+#endif
+	if (_c->sockBuf.shm!=NULL)
+		_c->newsockfd=INVALID_SOCKET;
+	else if (retVal==0)
+		_c->newsockfd=accept(_c->sockfd, NULL, NULL);
 	_c->functions.logger(NULL, _c->instanceName, fmiOK, "ok",  "fmiInitializeSlave: The connection has been accepted.\n");
 	// check whether the simulation could start successfully
 	if  (retVal !=0) {
@@ -1228,30 +1865,21 @@ DllExport fmiStatus fmiInitializeSlave(fmiComponent c, fmiReal tStart, fmiBoolea
 		_c->firstCallIni=0;
 	}
 	_c->functions.logger(NULL, _c->instanceName, fmiOK, "ok",  "fmiInitializeSlave: Slave %s is initialized.\n", _c->instanceName);
-	// reset the current working directory. This is particularly important for Dymola
-	// otherwise Dymola will write results at wrong place
-#ifdef _MSC_VER
-	retVal=_chdir(_c->cwd);
-#else
-	retVal=chdir(_c->cwd);
-#endif
 	return fmiOK;
 } 
 
 ////////////////////////////////////////////////////////////////
-///  This method is used to do the time stepping the FMU
+///  This method is used to check whether the FMU instance can do
+///  a time step, and stores the communication point and step size
 ///
-///\param c The FMU instance.
+///\param _c The FMU instance.
 ///\param currentCommunicationPoint The communication point.
 ///\param communicationStepSize The communication step size.
 ///\param newStep The flag to accept or reflect communication step.
-///\return fmiOK if no error occurred.
+///\return fmiOK if the inputs and outputs of the step can be exchanged.
 ////////////////////////////////////////////////////////////////
-DllExport fmiStatus fmiDoStep(fmiComponent c, fmiReal currentCommunicationPoint, fmiReal communicationStepSize, fmiBoolean newStep)
+fmiStatus checkDoStep(ModelInstance* _c, fmiReal currentCommunicationPoint, fmiReal communicationStepSize, fmiBoolean newStep)
 {
-	ModelInstance* _c=(ModelInstance *)c;
-	int retVal;
-
 	// get current communication point
 	_c->curComm=currentCommunicationPoint;
 	// get current communication step size
@@ -1346,36 +1974,54 @@ DllExport fmiStatus fmiDoStep(fmiComponent c, fmiReal currentCommunicationPoint,
 				_c->tStopFMU);
 			return fmiError;
 	}
+	return fmiOK;
+}
 
-	// check whether all input and outputs are available and then do the time stepping
-	if (_c->firstCallDoStep
-		||
-		(_c->firstCallDoStep==0) 
-		&& _c->curComm <=(_c->tStopFMU - 
-		_c->communicationStepSize)) {
-			if (_c->flaWri !=1){
-				_c->flaGetRea=1;
-				if (_c->flaGetRealCall==0)
-				{
-					retVal=readfromsocketFMU(&(_c->newsockfd), &(_c->flaRea),
-						&(_c->numOutVar), &zI, &zI, &(_c->simTimRec), 
-						_c->outVec, NULL, NULL);
-				}
-				retVal=writetosocketFMU(&(_c->newsockfd), &(_c->flaWri),
-					&_c->numInVar, &zI, &zI, &(_c->simTimSen),
-					_c->inVec, NULL, NULL);
+////////////////////////////////////////////////////////////////
+///  This method is used to read the outputs of the FMU instance
+///
+///\param _c The FMU instance.
+///\return 0 if no error occurred.
+////////////////////////////////////////////////////////////////
+int readOutputs(ModelInstance* _c)
+{
+	// the counts are the lengths of the arrays on entry, so that
+	// EnergyPlus cannot send more values than outVec holds.
+	int nDblRea=_c->numOutVar;
+	int nIntRea=0;
+	int nBooRea=0;
+	return readfromsocketFMU(&(_c->newsockfd), &(_c->sockBuf), &(_c->flaRea),
+		&nDblRea, &nIntRea, &nBooRea, &(_c->simTimRec), 
+		_c->outVec, NULL, NULL);
+}
 
-				if (_c->flaGetRealCall==1)
-				{
-					_c->flaGetRealCall=0;
-				}
-			}
-			_c->readReady=0;
-			_c->writeReady=0;
-			_c->setCounter=0;
-			_c->getCounter=0;
-	}
+////////////////////////////////////////////////////////////////
+///  This method is used to write the inputs of the FMU instance
+///
+///\param _c The FMU instance.
+///\return A negative value if an error occurred.
+////////////////////////////////////////////////////////////////
+int writeInputs(ModelInstance* _c)
+{
+	int nIntWri=0;
+	int nBooWri=0;
+	return writetosocketFMU(&(_c->newsockfd), &(_c->sockBuf), &(_c->flaWri),
+		&_c->numInVar, &nIntWri, &nBooWri, &(_c->simTimSen),
+		_c->inVec, NULL, NULL);
+}
 
+////////////////////////////////////////////////////////////////
+///  This method is used to advance the FMU instance to the next
+///  communication point once the step is done
+///
+///\param _c The FMU instance.
+////////////////////////////////////////////////////////////////
+void finishDoStep(ModelInstance* _c)
+{
+	_c->readReady=0;
+	_c->writeReady=0;
+	_c->setCounter=0;
+	_c->getCounter=0;
 	// calculate next communication point
 	_c->nexComm=_c->curComm 
 		+ _c->communicationStepSize;
@@ -1384,9 +2030,269 @@ DllExport fmiStatus fmiDoStep(fmiComponent c, fmiReal currentCommunicationPoint,
 	{
 		_c->firstCallDoStep=0;
 	}		
+}
+
+////////////////////////////////////////////////////////////////
+///  This method is used to do the time stepping the FMU
+///
+///\param c The FMU instance.
+///\param currentCommunicationPoint The communication point.
+///\param communicationStepSize The communication step size.
+///\param newStep The flag to accept or reflect communication step.
+///\return fmiOK if no error occurred.
+////////////////////////////////////////////////////////////////
+DllExport fmiStatus fmiDoStep(fmiComponent c, fmiReal currentCommunicationPoint, fmiReal communicationStepSize, fmiBoolean newStep)
+{
+	ModelInstance* _c=(ModelInstance *)c;
+	fmiStatus status;
+
+	status=checkDoStep(_c, currentCommunicationPoint, communicationStepSize, newStep);
+	if (status!=fmiOK)
+		return status;
+
+	// exchange the inputs and outputs of the time step
+	if (_c->flaWri !=1){
+		_c->flaGetRea=1;
+		if (_c->flaGetRealCall==0)
+		{
+			readOutputs(_c);
+		}
+		writeInputs(_c);
+
+		if (_c->flaGetRealCall==1)
+		{
+			_c->flaGetRealCall=0;
+		}
+	}
+	finishDoStep(_c);
 	return fmiOK;
 }  
 
+////////////////////////////////////////////////////////////////
+///  This method is used to get a monotonic time in milliseconds
+///
+///\return The time in milliseconds.
+////////////////////////////////////////////////////////////////
+long long getTimeMS()
+{
+#ifdef _MSC_VER
+	return (long long)GetTickCount64();
+#else
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (long long)ts.tv_sec*1000 + ts.tv_nsec/1000000;
+#endif
+}
+
+////////////////////////////////////////////////////////////////
+///  This method is used to check whether the current step of the
+///  FMU instance ends at the stop time of the simulation
+///
+///\param _c The FMU instance.
+///\return 1 if the step is the last step.
+////////////////////////////////////////////////////////////////
+int isLastStep(ModelInstance* _c)
+{
+	return _c->tStopFMU - (_c->curComm + _c->communicationStepSize) < 1e-10;
+}
+
+////////////////////////////////////////////////////////////////
+///  This method is used to read one message of outputs from each
+///  of several FMU instances, in the order in which the messages
+///  arrive. On Linux, the sockets are watched with epoll. Shared
+///  memory channels, and all instances on other platforms, are
+///  read in order afterwards. Their EnergyPlus processes compute
+///  the step at the same time as the others, hence reading them
+///  in order does not add their step times.
+///
+///\param _c The FMU instances.
+///\param n The number of FMU instances.
+///\param retVal The return value of readOutputs for each instance,
+///              or -2 if its outputs did not arrive within timeout.
+///\param done Flags that are set for each instance that is read.
+///            Instances whose flag is already set are not read.
+///\param timeout The maximum time to wait in milliseconds.
+////////////////////////////////////////////////////////////////
+void readOutputsBatch(ModelInstance** _c, size_t n, int retVal[], char done[], int timeout)
+{
+	size_t i;
+	long long deadline=getTimeMS()+timeout;
+	int remaining;
+#ifdef __linux__
+	struct epoll_event ev;
+	struct epoll_event events[64];
+	size_t nPending=0;
+	int epfd;
+	int k, m;
+
+	epfd=epoll_create1(EPOLL_CLOEXEC);
+	for (i=0; i<n && epfd>=0; i++){
+		if (done[i] || _c[i]->sockBuf.shm!=NULL)
+			continue;
+		ev.events=EPOLLIN;
+		ev.data.u64=i;
+		if (epoll_ctl(epfd, EPOLL_CTL_ADD, _c[i]->newsockfd, &ev)==0)
+			nPending++;
+	}
+	while (nPending>0){
+		remaining=(int)(deadline-getTimeMS());
+		if (remaining<=0)
+			break;
+		m=epoll_wait(epfd, events, sizeof(events)/sizeof(events[0]), remaining);
+		if (m<0){
+			if (errno==EINTR)
+				continue;
+			break;
+		}
+		for (k=0; k<m; k++){
+			i=(size_t)events[k].data.u64;
+			// the message was sent at once, hence the rest of it follows soon
+			retVal[i]=readOutputs(_c[i]);
+			done[i]=1;
+			epoll_ctl(epfd, EPOLL_CTL_DEL, _c[i]->newsockfd, NULL);
+			nPending--;
+		}
+	}
+	if (epfd>=0)
+		close(epfd);
+#endif
+	// read the other instances once their outputs arrived. This
+	// also returns at once for an EnergyPlus that exited.
+	for (i=0; i<n; i++){
+		if (done[i])
+			continue;
+		remaining=(int)(deadline-getTimeMS());
+		if (waitforsocketFMU(&(_c[i]->newsockfd), &(_c[i]->sockBuf),
+			(remaining>0) ? remaining : 0)>0)
+			retVal[i]=readOutputs(_c[i]);
+		else
+			retVal[i]=-2;
+		done[i]=1;
+	}
+}
+
+////////////////////////////////////////////////////////////////
+///  This method is used to do the time stepping of several FMU
+///  instances at once. It extends FMI 1.0 for masters that step
+///  many instances of this FMU in lockstep.
+///
+///  The inputs of all instances are written first, so that their
+///  EnergyPlus processes compute the step at the same time. The
+///  outputs are then read as they arrive, and fmiGetReal returns
+///  them without waiting. For one instance, this is the same as
+///  calling fmiDoStep and then fmiGetReal. As with fmiDoStep, the
+///  outputs of the last step are left to fmiGetReal.
+///
+///  An instance whose EnergyPlus exits, ends the simulation, or does
+///  not send its outputs within DOSTEPBATCH_TIMEOUT_MS gets the
+///  status fmiError. The other instances are not affected.
+///
+///\param c The FMU instances, which must be instances of this FMU.
+///\param nc The number of FMU instances.
+///\param currentCommunicationPoint The communication point.
+///\param communicationStepSize The communication step size.
+///\param newStep The flag to accept or reflect communication step.
+///\param status The status of each instance, as fmiDoStep returns it.
+///\return The most severe status of all instances.
+////////////////////////////////////////////////////////////////
+DllExport fmiStatus fmiDoStepBatch(fmiComponent c[], size_t nc, fmiReal currentCommunicationPoint, fmiReal communicationStepSize, fmiBoolean newStep, fmiStatus status[])
+{
+	ModelInstance** _c;
+	size_t* idx;
+	int* retVal;
+	char* done;
+	size_t i, n;
+	fmiStatus worst=fmiOK;
+
+	if (nc==0)
+		return fmiOK;
+	_c=(ModelInstance**)malloc(nc*sizeof(ModelInstance*));
+	idx=(size_t*)malloc(nc*sizeof(size_t));
+	retVal=(int*)malloc(nc*sizeof(int));
+	done=(char*)malloc(nc);
+	if (!_c || !idx || !retVal || !done){
+		free(_c);
+		free(idx);
+		free(retVal);
+		free(done);
+		for (i=0; i<nc; i++)
+			status[i]=fmiError;
+		printf("fmiDoStepBatch: Could not allocate memory for %d FMU instances.\n", (int)nc);
+		return fmiError;
+	}
+
+	// check the instances, and keep those that exchange values in this step
+	n=0;
+	for (i=0; i<nc; i++){
+		ModelInstance* _ci=(ModelInstance *)c[i];
+		status[i]=checkDoStep(_ci, currentCommunicationPoint, communicationStepSize, newStep);
+		if (status[i]!=fmiOK)
+			continue;
+		if (_ci->flaWri==1){
+			finishDoStep(_ci);
+			continue;
+		}
+		_c[n]=_ci;
+		idx[n]=i;
+		retVal[n]=0;
+		// read the outputs of the previous step, unless fmiGetReal read them
+		done[n]=(char)(_ci->flaGetRealCall!=0);
+		n++;
+	}
+	readOutputsBatch(_c, n, retVal, done, DOSTEPBATCH_TIMEOUT_MS);
+
+	// write the inputs of all instances before reading any outputs,
+	// unless EnergyPlus ended the simulation
+	for (i=0; i<n; i++){
+		if (retVal[i]==0 && _c[i]->flaRea==0 && writeInputs(_c[i])<0)
+			retVal[i]=-1;
+		done[i]=(char)(retVal[i]!=0 || _c[i]->flaRea!=0 || isLastStep(_c[i]));
+	}
+	readOutputsBatch(_c, n, retVal, done, DOSTEPBATCH_TIMEOUT_MS);
+
+	for (i=0; i<n; i++){
+		if (isLastStep(_c[i])){
+			// as fmiDoStep, leave the outputs to fmiGetReal
+			_c[i]->flaGetRea=1;
+			_c[i]->flaGetRealCall=0;
+		}
+		else{
+			// the outputs are read, hence fmiGetReal must not read them again
+			_c[i]->flaGetRea=0;
+			_c[i]->flaGetRealCall=1;
+			_c[i]->firstCallGetReal=0;
+		}
+		finishDoStep(_c[i]);
+		if (retVal[i]==-2){
+			_c[i]->functions.logger(NULL, _c[i]->instanceName, fmiError, "error", 
+				"fmiDoStepBatch: EnergyPlus did not send the outputs of time %f within %d ms.\n",
+				_c[i]->curComm, DOSTEPBATCH_TIMEOUT_MS);
+			status[idx[i]]=fmiError;
+		}
+		else if (retVal[i]!=0){
+			_c[i]->functions.logger(NULL, _c[i]->instanceName, fmiError, "error", 
+				"fmiDoStepBatch: Could not exchange the values of time %f with EnergyPlus.\n",
+				_c[i]->curComm);
+			status[idx[i]]=fmiError;
+		}
+		else if (_c[i]->flaRea!=0){
+			_c[i]->functions.logger(NULL, _c[i]->instanceName, fmiError, "error", 
+				"fmiDoStepBatch: EnergyPlus ended the simulation with flag %d at time %f.\n",
+				_c[i]->flaRea, _c[i]->curComm);
+			status[idx[i]]=fmiError;
+		}
+	}
+	for (i=0; i<nc; i++){
+		if (status[i]>worst)
+			worst=status[i];
+	}
+	free(_c);
+	free(idx);
+	free(retVal);
+	free(done);
+	return worst;
+}
+
 ////////////////////////////////////////////////////////////////
 ///  This method is used to cancel a step in the FMU
 ///
@@ -1442,12 +2348,6 @@ DllExport void fmiFreeSlaveInstance(fmiComponent c)
 
 #ifndef _MSC_VER
 		int status;
-#endif
-		// change the directory to make sure that FMUs are not overwritten
-#ifdef _MSC_VER
-		retVal=_chdir(_c->fmuOutput);
-#else
-		retVal=chdir(_c->fmuOutput);
 #endif
 		_c->functions.logger(NULL, _c->instanceName, fmiOK, 
 		"ok", "fmiFreeSlaveInstance: The function fmiFreeSlaveInstance of instance %s is executed.\n", 
@@ -1455,15 +2355,15 @@ DllExport void fmiFreeSlaveInstance(fmiComponent c)
 		// send end of simulation flag
 		_c->flaWri=1;
 		_c->flaRea=1;
-		retVal=exchangedoubleswithsocketFMUex (&(_c->newsockfd), &(_c->flaWri), 
-			&(_c->flaRea), &(_c->numOutVar), &(_c->numInVar), 
-			&(_c->simTimRec), _c->outVec, &(_c->simTimSen), 
-			_c->inVec);
+		retVal=exchangedoubleswithsocketFMUex (&(_c->newsockfd), &(_c->sockBuf), &(_c->flaWri), 
+			&(_c->flaRea), &(_c->numInVar), &(_c->numOutVar), 
+			&(_c->simTimSen), _c->inVec, &(_c->simTimRec), 
+			_c->outVec);
 		// close socket
 		closeipcFMU(&(_c->sockfd));
 		closeipcFMU(&(_c->newsockfd));
 		// clean-up temporary files
-		findFileDelete();
+		findFileDelete(_c);
 #ifdef _MSC_VER
 		// wait for object to terminate
 		WaitForSingleObject (_c->pid, INFINITE);
@@ -1475,13 +2375,6 @@ DllExport void fmiFreeSlaveInstance(fmiComponent c)
 #ifdef _MSC_VER
 		// clean-up winsock
 		WSACleanup();
-#endif
-		// reset the current working directory. This is particularly important for Dymola
-		// otherwise Dymola will write results at wrong place
-#ifdef _MSC_VER
-		retVal=_chdir(_c->cwd);
-#else
-		retVal=chdir(_c->cwd);
 #endif
 		// FIXME: Freeing the FMU instance seems to cause
 		// segmentation fault in Dymola 2016, thus
@@ -1526,25 +2419,19 @@ DllExport fmiStatus fmiSetReal(fmiComponent c, const fmiValueReference vr[], siz
 	// to prevent the fmiSetReal to be called before the FMU is initialized
 	if (_c->firstCallIni==0)
 	{
-		// fmiValueReference to check for input variable
-		fmiValueReference vrTemp;
-		ScalarVariable** vars;
-		int i, k;
+		fmiValueReference idx;
+		int i, slot;
 
-		vars=_c->md->modelVariables;
 		if (!_c->writeReady){
 			for(i=0; i<nvr; i++)
 			{
-				for (k=0; vars[k]; k++) {
-					ScalarVariable* svTemp=vars [k];
-					if (getAlias(svTemp)!=enu_noAlias) continue;
-					if (getCausality(svTemp) !=enu_input) continue; 
-					vrTemp=getValueReference(svTemp);
-					if (vrTemp==vr[i]){
-						_c->inVec[vr[i]-1]=value[i]; 
-						_c->setCounter++;
-					}
-				}
+				// look up the slot of the input variable
+				idx=vr[i]-VR_INPUT_BASE;
+				if (vr[i]<VR_INPUT_BASE || idx>=_c->inVrSlotLen) continue;
+				slot=_c->inVrSlot[idx];
+				if (slot<0) continue;
+				_c->inVec[slot]=value[i];
+				_c->setCounter++;
 			}
 			if (_c->setCounter==_c->numInVar)
 			{
@@ -1637,19 +2524,15 @@ DllExport fmiStatus fmiGetReal(fmiComponent c, const fmiValueReference vr[], siz
 	int retVal;
 	// to prevent the fmiGetReal to be called before the FMU is initialized
 	if (_c->firstCallIni==0){
-		fmiValueReference vrTemp;
-		ScalarVariable** vars;
-		int i, k;
+		fmiValueReference idx;
+		int i, slot;
 
-		vars=_c->md->modelVariables;
 		_c->flaGetRealCall=1;
 
 		if (_c->firstCallGetReal||((_c->firstCallGetReal==0) 
 			&& (_c->flaGetRea)))  {
 				// read the values from the server
-				retVal=readfromsocketFMU(&(_c->newsockfd), &(_c->flaRea),
-					&(_c->numOutVar), &zI, &zI, &(_c->simTimRec), 
-					_c->outVec, NULL, NULL);
+				retVal=readOutputs(_c);
 				// reset flaGetRea
 				_c->flaGetRea=0;
 		}
@@ -1657,16 +2540,13 @@ DllExport fmiStatus fmiGetReal(fmiComponent c, const fmiValueReference vr[], siz
 		{
 			for(i=0; i<nvr; i++)
 			{
-				for (k=0; vars[k]; k++) {
-					ScalarVariable* svTemp=vars [k];
-					if (getAlias(svTemp)!=enu_noAlias) continue;
-					if (getCausality(svTemp) !=enu_output) continue; 
-					vrTemp=getValueReference(svTemp);
-					if (vrTemp==vr[i]){
-						value[i]=_c->outVec[vr[i]-100001];
-						_c->getCounter++;
-					}
-				}
+				// look up the slot of the output variable
+				idx=vr[i]-VR_OUTPUT_BASE;
+				if (vr[i]<VR_OUTPUT_BASE || idx>=_c->outVrSlotLen) continue;
+				slot=_c->outVrSlot[idx];
+				if (slot<0) continue;
+				value[i]=_c->outVec[slot];
+				_c->getCounter++;
 			}
 			if (_c->getCounter==_c->numOutVar)
 			{
@@ -0,0 +1,341 @@
+// Methods for Functional Mock-up Unit Export of EnergyPlus.
+///////////////////////////////////////////////////////
+/// \file   mock-energyplus.c
+///
+/// \brief  Stand-in for the EnergyPlus executable
+///         that exchanges data with the FMU.
+///
+/// This program replaces \c energyplus when the FMU library
+/// is benchmarked or tested without EnergyPlus. It must be
+/// named \c energyplus and be found on the \c PATH, since
+/// \c start_sim spawns the program with this name.
+///
+/// The program ignores its command line arguments. It reads
+/// \c socket.cfg and \c variables.cfg from the current directory,
+/// connects to the FMU through the socket or the shared memory
+/// file described in \c socket.cfg, and then exchanges data until
+/// the FMU sends a nonzero flag.
+/// In every time step, the program sends the outputs and reads the
+/// inputs of the FMU. Output \c i is set to input \c i modulo the
+/// number of inputs of the previous time step, plus the time step
+/// number, so that a caller can check the values it receives.
+///
+/// The program is configured with these environment variables:
+///  - \c EPFMU_MOCK_LATENCY_US: time in microseconds that the program
+///       sleeps in every time step to model the computing time of
+///       EnergyPlus. The default is 0.
+///  - \c EPFMU_MOCK_VERSION: version of the socket messages that the
+///       program sends, which is \c MAINVERSION for text messages or
+///       \c BINARYVERSION for binary messages. The default is
+///       \c MAINVERSION, which is what EnergyPlus sends.
+///  - \c EPFMU_MOCK_EXIT_STEP: time step in which the program exits
+///       before it sends the outputs, to model a crash of EnergyPlus.
+///       The default is -1, for which the program does not exit early.
+///
+///////////////////////////////////////////////////////
+#include "utilSocket.h"
+
+#include <time.h>
+#include <unistd.h>
+#include <netdb.h>
+
+/// Prefix of all messages of this program
+#define MOCK_NAME "mock-energyplus"
+#define MOCK_LATENCY_ENV "EPFMU_MOCK_LATENCY_US"
+#define MOCK_VERSION_ENV "EPFMU_MOCK_VERSION"
+#define MOCK_EXIT_STEP_ENV "EPFMU_MOCK_EXIT_STEP"
+#define MOCK_MAX_LINE 10000
+
+
+/////////////////////////////////////////////////////////////////
+/// Returns the integer value of an environment variable.
+///
+///\param name The name of the environment variable.
+///\param defVal The value if the variable is not set.
+///\return The value of the environment variable.
+static int getenvintMOCK(const char *name, const int defVal){
+	const char *val = getenv(name);
+	if ( val == NULL || strlen(val) == 0 )
+		return defVal;
+	return atoi(val);
+}
+
+/////////////////////////////////////////////////////////////////
+/// Copies the value of an attribute of an XML element.
+///
+///\param line The line that contains the element.
+///\param name The name of the attribute.
+///\param val The value of the attribute.
+///\param valLen The length of \c val.
+///\return 0 if the attribute was found.
+static int getattributeMOCK(const char *line, const char *name, char *val, const int valLen){
+	char pattern[100];
+	const char *sta;
+	const char *end;
+	sprintf(pattern, " %s=\"", name);
+	sta = strstr(line, pattern);
+	if ( sta == NULL )
+		return -1;
+	sta += strlen(pattern);
+	end = strchr(sta, '"');
+	if ( end == NULL || end - sta >= valLen )
+		return -1;
+	memcpy(val, sta, end - sta);
+	val[end - sta] = '\0';
+	return 0;
+}
+
+/////////////////////////////////////////////////////////////////
+/// Reads the socket configuration file written by the FMU.
+///
+///\param fileName The name of the configuration file.
+///\param transport The transport, which is \c TRANSPORT_TCP, \c TRANSPORT_UNIX
+///                 or \c TRANSPORT_SHM.
+///\param hostName The host name of a TCP socket.
+///\param portNum The port number of a TCP socket.
+///\param path The path of the Unix domain socket or the shared memory file.
+///\param version The highest version of the messages that the FMU understands.
+///\return 0 if no error occurred.
+static int readsocketcfgMOCK(const char *fileName, int *transport,
+	char *hostName, int *portNum, char *path, int *version){
+	FILE *fp;
+	char line[MOCK_MAX_LINE];
+	char val[100];
+	int found = 0;
+	fp = fopen(fileName, "r");
+	if ( fp == NULL ){
+		fprintf(stderr, "%s: Cannot open %s.\n", MOCK_NAME, fileName);
+		return -1;
+	}
+	*version = MAINVERSION;
+	while ( !found && fgets(line, MOCK_MAX_LINE, fp) != NULL ){
+		if ( strstr(line, "<shm ") != NULL ){
+			*transport = TRANSPORT_SHM;
+			found = ( getattributeMOCK(line, "path", path, MOCK_MAX_LINE) == 0 );
+		}
+		else if ( strstr(line, "<socket ") != NULL ){
+			if ( getattributeMOCK(line, "path", path, MOCK_MAX_LINE) == 0 ){
+				*transport = TRANSPORT_UNIX;
+				found = 1;
+			}
+			else{
+				*transport = TRANSPORT_TCP;
+				found = ( getattributeMOCK(line, "hostname", hostName, MOCK_MAX_LINE) == 0 )
+					&& ( getattributeMOCK(line, "port", val, sizeof(val)) == 0 );
+				if ( found )
+					*portNum = atoi(val);
+			}
+		}
+		if ( found && getattributeMOCK(line, "version", val, sizeof(val)) == 0 )
+			*version = atoi(val);
+	}
+	fclose(fp);
+	if ( !found ){
+		fprintf(stderr, "%s: No socket or shared memory element in %s.\n", MOCK_NAME, fileName);
+		return -1;
+	}
+	return 0;
+}
+
+/////////////////////////////////////////////////////////////////
+/// Counts the variables in the variables configuration file.
+///
+///\param fileName The name of the configuration file.
+///\param nIn The number of inputs of the FMU, which EnergyPlus reads.
+///\param nOut The number of outputs of the FMU, which EnergyPlus writes.
+///\return 0 if no error occurred.
+static int countvariablesMOCK(const char *fileName, int *nIn, int *nOut){
+	FILE *fp;
+	char line[MOCK_MAX_LINE];
+	char val[100];
+	fp = fopen(fileName, "r");
+	if ( fp == NULL ){
+		fprintf(stderr, "%s: Cannot open %s.\n", MOCK_NAME, fileName);
+		return -1;
+	}
+	*nIn = 0;
+	*nOut = 0;
+	while ( fgets(line, MOCK_MAX_LINE, fp) != NULL ){
+		if ( strstr(line, "<variable ") == NULL
+			|| getattributeMOCK(line, "source", val, sizeof(val)) != 0 )
+			continue;
+		if ( strcmp(val, "Ptolemy") == 0 )
+			(*nIn)++;
+		else if ( strcmp(val, "EnergyPlus") == 0 )
+			(*nOut)++;
+	}
+	fclose(fp);
+	return 0;
+}
+
+/////////////////////////////////////////////////////////////////
+/// Connects to the TCP socket of the FMU.
+///
+///\param hostName The host name.
+///\param portNum The port number.
+///\return The socket file descriptor, or a negative value if an error occurred.
+static int connecttcpMOCK(const char *hostName, const int portNum){
+	struct sockaddr_in server_addr;
+	struct hostent *hp;
+	int sockfd;
+	hp = gethostbyname(hostName);
+	if ( hp == NULL ){
+		fprintf(stderr, "%s: Cannot resolve host %s.\n", MOCK_NAME, hostName);
+		return -1;
+	}
+	sockfd = socket(AF_INET, SOCK_STREAM, 0);
+	if ( sockfd < 0 ){
+		perror(MOCK_NAME ": Cannot create socket");
+		return -1;
+	}
+	memset(&server_addr, 0, sizeof(server_addr));
+	server_addr.sin_family = AF_INET;
+	server_addr.sin_port = htons(portNum);
+	memcpy(&server_addr.sin_addr, hp->h_addr_list[0], hp->h_length);
+	if ( connect(sockfd, (struct sockaddr *)&server_addr, sizeof(server_addr)) != 0 ){
+		perror(MOCK_NAME ": Cannot connect to socket");
+		close(sockfd);
+		return -1;
+	}
+	return sockfd;
+}
+
+/////////////////////////////////////////////////////////////////
+/// Connects to the Unix domain socket of the FMU.
+///
+///\param path The path of the socket.
+///\return The socket file descriptor, or a negative value if an error occurred.
+static int connectunixMOCK(const char *path){
+	struct sockaddr_un server_addr;
+	int sockfd;
+	if ( strlen(path) >= sizeof(server_addr.sun_path) ){
+		fprintf(stderr, "%s: Socket path %s is too long.\n", MOCK_NAME, path);
+		return -1;
+	}
+	sockfd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if ( sockfd < 0 ){
+		perror(MOCK_NAME ": Cannot create socket");
+		return -1;
+	}
+	memset(&server_addr, 0, sizeof(server_addr));
+	server_addr.sun_family = AF_UNIX;
+	strcpy(server_addr.sun_path, path);
+	if ( connect(sockfd, (struct sockaddr *)&server_addr, sizeof(server_addr)) != 0 ){
+		perror(MOCK_NAME ": Cannot connect to socket");
+		close(sockfd);
+		return -1;
+	}
+	return sockfd;
+}
+
+/////////////////////////////////////////////////////////////////
+/// Sleeps to model the computing time of EnergyPlus.
+///
+///\param latency The time in microseconds.
+static void sleepMOCK(const int latency){
+	struct timespec ts;
+	if ( latency <= 0 )
+		return;
+	ts.tv_sec = latency / 1000000;
+	ts.tv_nsec = (latency % 1000000) * 1000L;
+	while ( nanosleep(&ts, &ts) != 0 && errno == EINTR )
+		;
+}
+
+/////////////////////////////////////////////////////////////////
+/// Main routine of the stand-in for EnergyPlus.
+///
+///\return 0 if the FMU terminated the simulation,
+///        1 if an error occurred, or 2 if it exited in step \c EPFMU_MOCK_EXIT_STEP.
+int main(int argc, char *argv[]){
+	SocketBuffers sockBuf;
+	char hostName[MOCK_MAX_LINE];
+	char path[MOCK_MAX_LINE];
+	int transport = TRANSPORT_TCP;
+	int portNum = 0;
+	int version;
+	int sockfd = -1;
+	int nIn, nOut;
+	int flaWri = 0;
+	int flaRea = 0;
+	int nDblRea, nIntRea, nBooRea;
+	int zero = 0;
+	int step, i;
+	int retVal = 0;
+	double curSimTim = 0;
+	double *inVal;
+	double *outVal;
+	const int latency = getenvintMOCK(MOCK_LATENCY_ENV, 0);
+	const int exitStep = getenvintMOCK(MOCK_EXIT_STEP_ENV, -1);
+
+	memset(&sockBuf, 0, sizeof(sockBuf));
+	if ( readsocketcfgMOCK(SOCKCFG, &transport, hostName, &portNum, path, &version) != 0 )
+		return 1;
+	if ( countvariablesMOCK(VARCFG, &nIn, &nOut) != 0 )
+		return 1;
+	inVal  = (double*)calloc(nIn > 0 ? nIn : 1, sizeof(double));
+	outVal = (double*)calloc(nOut > 0 ? nOut : 1, sizeof(double));
+	if ( inVal == NULL || outVal == NULL ){
+		perror(MOCK_NAME ": Cannot allocate values");
+		return 1;
+	}
+
+	// connect to the FMU
+	if ( transport == TRANSPORT_SHM )
+		retVal = connectshmclientFMU(&sockBuf, path);
+	else{
+		if ( transport == TRANSPORT_UNIX )
+			sockfd = connectunixMOCK(path);
+		else
+			sockfd = connecttcpMOCK(hostName, portNum);
+		retVal = ( sockfd < 0 ) ? -1 : 0;
+		// send binary messages only if the FMU understands them
+		if ( getenvintMOCK(MOCK_VERSION_ENV, MAINVERSION) >= BINARYVERSION
+			&& version >= BINARYVERSION )
+			sockBuf.serverVersion = BINARYVERSION;
+	}
+	if ( retVal != 0 ){
+		fprintf(stderr, "%s: Cannot connect to the FMU.\n", MOCK_NAME);
+		return 1;
+	}
+
+	// exchange data until the FMU terminates the simulation
+	for ( step = 0; ; step++ ){
+		if ( step == exitStep ){
+			fprintf(stderr, "%s: Exiting in step %d.\n", MOCK_NAME, step);
+			exit(2);
+		}
+		for ( i = 0; i < nOut; i++ )
+			outVal[i] = ( nIn > 0 ? inVal[i % nIn] : 0.0 ) + step;
+		retVal = writetosocketFMU(&sockfd, &sockBuf, &flaWri,
+			&nOut, &zero, &zero, &curSimTim, outVal, NULL, NULL);
+		if ( retVal < 0 ){
+			fprintf(stderr, "%s: Cannot write to the FMU in step %d.\n", MOCK_NAME, step);
+			break;
+		}
+		nDblRea = nIn;
+		nIntRea = nBooRea = 0;
+		retVal = readfromsocketFMU(&sockfd, &sockBuf, &flaRea,
+			&nDblRea, &nIntRea, &nBooRea, &curSimTim, inVal, NULL, NULL);
+		if ( retVal < 0 ){
+			fprintf(stderr, "%s: Cannot read from the FMU in step %d.\n", MOCK_NAME, step);
+			break;
+		}
+		if ( flaRea != 0 )
+			break;
+		if ( nDblRea != nIn ){
+			fprintf(stderr, "%s: Received %d values, but %s lists %d inputs.\n",
+				MOCK_NAME, nDblRea, VARCFG, nIn);
+			retVal = -1;
+			break;
+		}
+		sleepMOCK(latency);
+	}
+
+	freesocketbuffersFMU(&sockBuf);
+	if ( sockfd >= 0 )
+		closeipcFMU(&sockfd);
+	free(inVal);
+	free(outVal);
+	return ( retVal < 0 ) ? 1 : 0;
+}
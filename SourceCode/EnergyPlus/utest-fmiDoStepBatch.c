@@ -0,0 +1,298 @@
+//--- Unit test for fmiDoStepBatch of main.c.
+//
+/// \brief  Unit test for the time stepping of several FMU instances at once.
+///
+/// Two instances of a synthetic FMU run against the stand-in for
+/// EnergyPlus in mock-energyplus.c, and are stepped with fmiDoStepBatch.
+/// The stand-in of the second instance exits in the middle of the
+/// simulation. The test checks that the first instance gets its outputs
+/// in every step, including the last one, and that the second instance
+/// gets fmiError in the step in which its stand-in exited, without
+/// waiting for the timeout. This is done for each transport.
+///
+/// The stand-in must be compiled to an executable named energyplus
+/// in the directory of this program, for instance
+///
+///   gcc -o energyplus mock-energyplus.c utilSocket.c
+///   gcc -o utest-fmiDoStepBatch utest-fmiDoStepBatch.c main.c stack.c util.c
+///       utilSocket.c xml_parser_cosim.c <Expat sources> -lm -lpthread
+///
+/// The test writes the FMU to the directory utest-fmiDoStepBatch in the
+/// current working directory, and runs the FMU in this directory.
+///
+/// Usage: utest-fmiDoStepBatch
+
+
+//--- Includes.
+#define MODEL_IDENTIFIER SmOffPSZ
+
+#include <assert.h>
+#include <signal.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+
+#include "defines.h"
+
+
+//--- File-scope constants.
+//
+#define TEST_DIR "utest-fmiDoStepBatch"
+#define TEST_GUID "0123456789abcdef0123456789abcdef"
+#define TEST_NAME "batch"
+#define TEST_PATHLEN 10000
+#ifdef __APPLE__
+#define TEST_PREP "idf-to-fmu-export-prep-darwin"
+#else
+#define TEST_PREP "idf-to-fmu-export-prep-linux"
+#endif
+static const int nIn = 2;
+static const int nOut = 3;
+static const int nSteps = 6;
+// Step of the stand-in of the second instance in which it exits.
+static const int exitStep = 3;
+// Number of time steps per hour, which is written to tstep.txt.
+static const int stepsPerHour = 6;
+
+
+//--- Logger that prints warnings and errors.
+//
+static void testLogger(fmiComponent c, fmiString instanceName, fmiStatus status,
+	fmiString category, fmiString message, ...){
+	va_list argp;
+	if( status == fmiOK ){
+		return;
+		}
+	printf("  %s (%s): ", instanceName ? instanceName : "?", category ? category : "?");
+	va_start(argp, message);
+	vprintf(message, argp);
+	va_end(argp);
+	}
+
+
+//--- Wall clock time in seconds.
+//
+static double wallTime(void){
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec + 1e-6 * tv.tv_usec;
+	}
+
+
+//--- Write a text file.
+//
+static void writeText(const char *fileName, const char *text){
+	FILE *fp = fopen(fileName, "w");
+	assert( fp != NULL );
+	fputs(text, fp);
+	fclose(fp);
+	}
+
+
+//--- Write the model description and the resources of a synthetic FMU.
+//
+//   The preprocessor is a script that copies the input file, which is
+//   its last argument, and the weather file, and writes the number of
+//   time steps per hour.
+static void writeFMU(void){
+	FILE *fp;
+	int i;
+	//
+	mkdir("fmu", 0755);
+	mkdir("fmu/resources", 0755);
+	fp = fopen("fmu/modelDescription.xml", "w");
+	assert( fp != NULL );
+	fprintf(fp, "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+		"<fmiModelDescription  fmiVersion=\"1.0\"\n"
+		"  modelName=\"%s.idf\"\n"
+		"  modelIdentifier=\"%s\"\n"
+		"  guid=\"%s\"\n"
+		"  numberOfContinuousStates=\"0\"\n"
+		"  numberOfEventIndicators=\"0\">\n"
+		"  <ModelVariables>\n", TEST_NAME, TEST_NAME, TEST_GUID);
+	for( i=0; i<nIn; ++i ){
+		fprintf(fp, "    <ScalarVariable  name=\"u%d\"  valueReference=\"%d\"\n"
+			"      variability=\"continuous\"  causality=\"input\">\n"
+			"      <Real  start=\"0\"/>\n"
+			"    </ScalarVariable>\n", i, VR_INPUT_BASE + i);
+		}
+	for( i=0; i<nOut; ++i ){
+		fprintf(fp, "    <ScalarVariable  name=\"y%d\"  valueReference=\"%d\"\n"
+			"      variability=\"continuous\"  causality=\"output\">\n"
+			"      <Real/>\n"
+			"    </ScalarVariable>\n", i, VR_OUTPUT_BASE + i);
+		}
+	fprintf(fp, "  </ModelVariables>\n"
+		"  <Implementation>\n"
+		"    <CoSimulation_Tool>\n"
+		"      <Capabilities  canHandleVariableCommunicationStepSize=\"false\"/>\n"
+		"      <Model  entryPoint=\"fmu://resources/%s.idf\"  manualStart=\"false\"  type=\"text/plain\"/>\n"
+		"    </CoSimulation_Tool>\n"
+		"  </Implementation>\n"
+		"</fmiModelDescription>\n", TEST_NAME);
+	fclose(fp);
+	//
+	fp = fopen("fmu/resources/" VARCFG, "w");
+	assert( fp != NULL );
+	fprintf(fp, "<?xml version=\"1.0\" encoding=\"ISO-8859-1\"?>\n"
+		"<BCVTB-variables>\n");
+	for( i=0; i<nIn; ++i ){
+		fprintf(fp, "  <variable  source=\"Ptolemy\">\n"
+			"    <EnergyPlus  schedule=\"u%d\"/>\n"
+			"  </variable>\n", i);
+		}
+	for( i=0; i<nOut; ++i ){
+		fprintf(fp, "  <variable  source=\"EnergyPlus\">\n"
+			"    <EnergyPlus  name=\"y%d\"  type=\"Output\"/>\n"
+			"  </variable>\n", i);
+		}
+	fprintf(fp, "</BCVTB-variables>\n");
+	fclose(fp);
+	//
+	writeText("fmu/resources/" TEST_NAME ".idf", "Version, 8.4;\n");
+	writeText("fmu/resources/" TEST_NAME ".idd", "!IDD_Version 8.4.0\n");
+	writeText("fmu/resources/" TEST_NAME ".epw", "LOCATION,Test\n");
+	fp = fopen("fmu/resources/" TEST_PREP, "w");
+	assert( fp != NULL );
+	fprintf(fp, "#!/bin/sh\n"
+		"for arg in \"$@\"; do\n"
+		"  [ \"$prev\" = -w ] && cp \"$arg\" runweafile.epw\n"
+		"  prev=\"$arg\"; idf=\"$arg\"\n"
+		"done\n"
+		"cp \"$idf\" runinfile.idf && echo %d > tstep.txt\n", stepsPerHour);
+	fclose(fp);
+	}
+
+
+//--- Input of the given step.
+//
+static double inputValue(const int step, const int idx){
+	return step + 0.125 * idx;
+	}
+
+
+//--- Output of the given step, as the stand-in computes it.
+//
+//   In step k, the stand-in returns the inputs of step k-1 plus k.
+//   The outputs are got after each step, hence the outputs of step 0
+//   are read by the first call of fmiDoStepBatch.
+static double outputValue(const int step, const int idx){
+	return (step + 1) + inputValue(step, idx % nIn);
+	}
+
+
+//--- Step two instances, the second of which loses its stand-in.
+//
+static void testBatch(const char *fmuDir, const char *transport){
+	const double stepSize = 3600.0 / stepsPerHour;
+	fmiCallbackFunctions functions;
+	fmiComponent c[2];
+	fmiStatus status[2];
+	fmiValueReference vrIn[2];
+	fmiValueReference vrOut[3];
+	fmiReal valIn[2];
+	fmiReal valOut[3];
+	char exitStr[20];
+	double start;
+	size_t nc;
+	int step, idx, j;
+	//
+	setenv(TRANSPORT_ENV, transport, 1);
+	functions.logger = testLogger;
+	functions.allocateMemory = calloc;
+	functions.freeMemory = free;
+	functions.stepFinished = NULL;
+	for( idx=0; idx<nIn; ++idx ){
+		vrIn[idx] = VR_INPUT_BASE + idx;
+		}
+	for( idx=0; idx<nOut; ++idx ){
+		vrOut[idx] = VR_OUTPUT_BASE + idx;
+		}
+	//
+	c[0] = fmiInstantiateSlave(TEST_NAME "0", TEST_GUID, fmuDir, "", 0, fmiFalse,
+		fmiFalse, functions, fmiTrue);
+	c[1] = fmiInstantiateSlave(TEST_NAME "1", TEST_GUID, fmuDir, "", 0, fmiFalse,
+		fmiFalse, functions, fmiTrue);
+	assert( c[0] != NULL && c[1] != NULL );
+	assert( fmiInitializeSlave(c[0], 0, fmiTrue, nSteps * stepSize) == fmiOK );
+	// The stand-in reads the environment when it is started.
+	sprintf(exitStr, "%d", exitStep);
+	setenv("EPFMU_MOCK_EXIT_STEP", exitStr, 1);
+	assert( fmiInitializeSlave(c[1], 0, fmiTrue, nSteps * stepSize) == fmiOK );
+	unsetenv("EPFMU_MOCK_EXIT_STEP");
+	//
+	nc = 2;
+	for( step=0; step<nSteps; ++step ){
+		for( idx=0; idx<nIn; ++idx ){
+			valIn[idx] = inputValue(step, idx);
+			}
+		for( j=0; j<(int) nc; ++j ){
+			assert( fmiSetReal(c[j], vrIn, nIn, valIn) == fmiOK );
+			}
+		start = wallTime();
+		fmiDoStepBatch(c, nc, step * stepSize, stepSize, fmiTrue, status);
+		// The lost stand-in is noticed at once, not after the timeout.
+		assert( wallTime() - start < 10.0 );
+		assert( status[0] == fmiOK );
+		// The stand-in of the second instance exits before it sends
+		// the outputs of its step exitStep, which are read in the step before.
+		if( nc == 2 ){
+			assert( status[1] == ((step == exitStep - 1) ? fmiError : fmiOK) );
+			if( status[1] == fmiError ){
+				nc = 1;
+				}
+			}
+		// The outputs of the last step are read by fmiGetReal.
+		for( j=0; j<(int) nc; ++j ){
+			assert( fmiGetReal(c[j], vrOut, nOut, valOut) == fmiOK );
+			for( idx=0; idx<nOut; ++idx ){
+				assert( valOut[idx] == outputValue(step, idx) );
+				}
+			}
+		}
+	assert( nc == 1 );
+	fmiFreeSlaveInstance(c[0]);
+	fmiFreeSlaveInstance(c[1]);
+	}
+
+
+//--- Main driver.
+//
+int main(int argc, const char* argv[]) {
+	char exeDir[TEST_PATHLEN];
+	char fmuDir[TEST_PATHLEN];
+	char *path;
+	char *sep;
+	//
+	// Put the directory of this program, which contains the
+	// stand-in for EnergyPlus, in front of the search path.
+	assert( realpath(argv[0], exeDir) != NULL );
+	sep = strrchr(exeDir, '/');
+	if( sep != NULL ){
+		*sep = '\0';
+		}
+	path = (char*) malloc(strlen(exeDir) + strlen(getenv("PATH") ? getenv("PATH") : "") + 2);
+	sprintf(path, "%s:%s", exeDir, getenv("PATH") ? getenv("PATH") : "");
+	setenv("PATH", path, 1);
+	free(path);
+	// The FMU writes the end of the simulation to the lost stand-in.
+	signal(SIGPIPE, SIG_IGN);
+	//
+	mkdir(TEST_DIR, 0755);
+	assert( chdir(TEST_DIR) == 0 );
+	writeFMU();
+	assert( realpath("fmu", fmuDir) != NULL );
+	//
+	testBatch(fmuDir, "tcp");
+	printf("tcp:  ok\n");
+	testBatch(fmuDir, "unix");
+	printf("unix: ok\n");
+	testBatch(fmuDir, "shm");
+	printf("shm:  ok\n");
+	//
+	return( 0 );
+	}
@@ -0,0 +1,411 @@
+//--- Unit test for utilSocket.c.
+//
+/// \brief  Unit test for the data exchange of utilSocket.c.
+///
+/// A child process stands in for EnergyPlus. It sends the outputs of
+/// the FMU and receives the inputs, as EnergyPlus does in every time
+/// step. The test checks that the values arrive unchanged, and reports
+/// the time of a round trip through a socket and through shared memory.
+///
+/// Before that, the test checks the byte layout of the binary messages,
+/// a binary exchange whose messages arrive in parts, and the fallback to
+/// the text messages for a server that does not send binary messages.
+///
+/// Usage: utest-utilSocket [number of doubles] [number of steps]
+
+
+//--- Includes.
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+
+#include "utilSocket.h"
+
+
+//--- File-scope constants.
+//
+static const char shmPath[] = "utest-utilSocket.shm";
+
+
+//--- Value sent by the given side in the given step.
+//
+//   The values have a short decimal representation, so that they
+//   are not rounded by the text format of the socket messages.
+static double testValue(const int fromEP, const int step, const int idx){
+	return (fromEP ? 1.0 : -1.0) * (step + 1) + idx * 0.125;
+	}
+
+
+//--- Wall clock time in seconds.
+//
+static double wallTime(void){
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec + 1e-6 * tv.tv_usec;
+	}
+
+
+//--- Check the layout of a binary message.
+//
+//   The header holds little-endian 32-bit integers and a little-endian
+//   double, and the doubles follow it.
+static void testBinaryLayout(void){
+	char buffer[BINARY_HEADER_LENGTH + 3*8];
+	const unsigned char *p = (const unsigned char*) buffer;
+	double dblVal[3] = {-2.5, 0.125, 3.0};
+	double dblRea[3];
+	double curSimTim;
+	int version, flag, nDbl, nInt, nBoo;
+	//
+	assert( getbinarybufferlengthFMU(3, 0, 0) == (int) sizeof(buffer) );
+	assert( assembleBinaryBufferFMU(0, 3, 0, 0, 1.0, dblVal, NULL, NULL,
+		buffer, sizeof(buffer)) == (int) sizeof(buffer) );
+	assert( p[0] == BINARYVERSION && p[1] == 0 && p[2] == 0 && p[3] == 0 );
+	assert( p[4] == 0 && p[8] == 3 && p[12] == 0 && p[16] == 0 );
+	// 1.0 is 0x3FF0000000000000, and -2.5 is 0xC004000000000000.
+	assert( p[24] == 0 && p[29] == 0 && p[30] == 0xF0 && p[31] == 0x3F );
+	assert( p[32] == 0 && p[38] == 0x04 && p[39] == 0xC0 );
+	//
+	assert( disassembleBinaryHeaderFMU(buffer, &version, &flag, &nDbl, &nInt, &nBoo,
+		&curSimTim) == 0 );
+	assert( version == BINARYVERSION && flag == 0 && nDbl == 3 && nInt == 0 && nBoo == 0 );
+	assert( curSimTim == 1.0 );
+	disassembleBinaryBufferFMU(buffer + BINARY_HEADER_LENGTH, nDbl, nInt, nBoo,
+		dblRea, NULL, NULL);
+	assert( memcmp(dblRea, dblVal, sizeof(dblVal)) == 0 );
+	//
+	// A buffer that is too small is rejected.
+	assert( assembleBinaryBufferFMU(0, 3, 0, 0, 1.0, dblVal, NULL, NULL,
+		buffer, sizeof(buffer) - 1) == -1 );
+	// So are numbers of values whose message does not fit an int.
+	assert( getbinarybufferlengthFMU(-1, 0, 0) == -1 );
+	assert( getbinarybufferlengthFMU(INT_MAX / 8, 0, 0) == -1 );
+	assert( getbinarybufferlengthFMU(0, INT_MAX / 4, INT_MAX / 4) == -1 );
+	// A text message is not a binary message.
+	memset(buffer, ' ', BINARY_HEADER_LENGTH);
+	buffer[0] = '0' + MAINVERSION;
+	assert( disassembleBinaryHeaderFMU(buffer, &version, &flag, &nDbl, &nInt, &nBoo,
+		&curSimTim) != 0 );
+	}
+
+
+//--- Write a message to a socket in two parts.
+//
+//   The pause between the parts lets the reader see a partial message.
+static void writeInParts(const int sockfd, const char *buffer, const int nBytes,
+	const int nFirst){
+	assert( write(sockfd, buffer, nFirst) == nFirst );
+	usleep(20000);
+	assert( write(sockfd, buffer + nFirst, nBytes - nFirst) == nBytes - nFirst );
+	}
+
+
+//--- Check a binary exchange, and the fallback to text messages.
+//
+//   A child process stands in for EnergyPlus. If binary is set, it sends
+//   two binary messages, the first split inside the header and the second
+//   split inside a double. Otherwise, it sends a text message. Either way,
+//   the FMU side must answer in the format of the server.
+static void testVersionExchange(const int binary){
+	const int nDbl = 3;
+	SocketBuffers sockBuf;
+	char buffer[BINARY_HEADER_LENGTH + 3*8];
+	double dblVal[3];
+	double curSimTim;
+	int flag, nDblRea, nIntRea, nBooRea;
+	const int zero = 0;
+	int sockfd[2];
+	int status;
+	int step, idx, nBytes;
+	pid_t pid;
+	//
+	memset(&sockBuf, 0, sizeof(sockBuf));
+	assert( socketpair(AF_UNIX, SOCK_STREAM, 0, sockfd) == 0 );
+	pid = fork();
+	assert( pid >= 0 );
+	if( pid == 0 ){
+		close(sockfd[0]);
+		for( step=0; step<2; ++step ){
+			for( idx=0; idx<nDbl; ++idx ){
+				dblVal[idx] = testValue(1, step, idx);
+				}
+			curSimTim = 60.0 * step;
+			if( binary ){
+				nBytes = assembleBinaryBufferFMU(0, nDbl, 0, 0, curSimTim, dblVal,
+					NULL, NULL, buffer, sizeof(buffer));
+				assert( nBytes == (int) sizeof(buffer) );
+				writeInParts(sockfd[1], buffer, nBytes,
+					(step == 0) ? 5 : BINARY_HEADER_LENGTH + 12);
+				}
+			else{
+				flag = 0;
+				assert( writetosocketFMU(&sockfd[1], &sockBuf, &flag, &nDbl, &zero, &zero,
+					&curSimTim, dblVal, NULL, NULL) > 0 );
+				}
+			}
+		// Read the reply of the FMU, which tells its format.
+		nDblRea = nDbl;
+		nIntRea = nBooRea = 0;
+		assert( readfromsocketFMU(&sockfd[1], &sockBuf, &flag, &nDblRea, &nIntRea, &nBooRea,
+			&curSimTim, dblVal, NULL, NULL) == 0 );
+		assert( sockBuf.serverVersion == (binary ? BINARYVERSION : MAINVERSION) );
+		assert( flag == 0 && nDblRea == nDbl && curSimTim == 60.0 );
+		for( idx=0; idx<nDbl; ++idx ){
+			assert( dblVal[idx] == testValue(0, 1, idx) );
+			}
+		freesocketbuffersFMU(&sockBuf);
+		_exit(0);
+		}
+	close(sockfd[1]);
+	for( step=0; step<(binary ? 2 : 1); ++step ){
+		nDblRea = nDbl;
+		nIntRea = nBooRea = 0;
+		assert( readfromsocketFMU(&sockfd[0], &sockBuf, &flag, &nDblRea, &nIntRea, &nBooRea,
+			&curSimTim, dblVal, NULL, NULL) == 0 );
+		assert( sockBuf.serverVersion == (binary ? BINARYVERSION : MAINVERSION) );
+		assert( flag == 0 && nDblRea == nDbl && curSimTim == 60.0 * step );
+		for( idx=0; idx<nDbl; ++idx ){
+			assert( dblVal[idx] == testValue(1, step, idx) );
+			}
+		}
+	if( ! binary ){
+		// The second text message follows the first.
+		nDblRea = nDbl;
+		nIntRea = nBooRea = 0;
+		assert( readfromsocketFMU(&sockfd[0], &sockBuf, &flag, &nDblRea, &nIntRea, &nBooRea,
+			&curSimTim, dblVal, NULL, NULL) == 0 );
+		assert( flag == 0 && nDblRea == nDbl && curSimTim == 60.0 );
+		}
+	for( idx=0; idx<nDbl; ++idx ){
+		dblVal[idx] = testValue(0, 1, idx);
+		}
+	assert( writetosocketFMU(&sockfd[0], &sockBuf, &flag, &nDbl, &zero, &zero,
+		&curSimTim, dblVal, NULL, NULL) > 0 );
+	assert( waitpid(pid, &status, 0) == pid && WIFEXITED(status) && WEXITSTATUS(status) == 0 );
+	freesocketbuffersFMU(&sockBuf);
+	close(sockfd[0]);
+	}
+
+
+//--- Check that a read is bounded by the length of the array, and that
+//   the FMU does not wait for a shared memory peer that is gone.
+//
+static void testReadBounds(void){
+	SocketBuffers sockBuf, peerBuf;
+	char buffer[BINARY_HEADER_LENGTH + 3*8];
+	double dblVal[3] = {1.0, 2.0, 3.0};
+	double curSimTim = 60.0;
+	int flag = 0;
+	int nDblRea, nIntRea, nBooRea;
+	const int nDbl = 3;
+	const int zero = 0;
+	int sockfd[2];
+	int status;
+	pid_t pid;
+	//
+	//-- A text message with more doubles than the array holds.
+	memset(&sockBuf, 0, sizeof(sockBuf));
+	assert( socketpair(AF_UNIX, SOCK_STREAM, 0, sockfd) == 0 );
+	assert( writetosocketFMU(&sockfd[1], &sockBuf, &flag, &nDbl, &zero, &zero,
+		&curSimTim, dblVal, NULL, NULL) > 0 );
+	nDblRea = nDbl - 1;
+	nIntRea = nBooRea = 0;
+	assert( readfromsocketFMU(&sockfd[0], &sockBuf, &flag, &nDblRea, &nIntRea, &nBooRea,
+		&curSimTim, dblVal, NULL, NULL) != 0 );
+	freesocketbuffersFMU(&sockBuf);
+	close(sockfd[0]);
+	close(sockfd[1]);
+	//
+	//-- The same for a binary message.
+	memset(&sockBuf, 0, sizeof(sockBuf));
+	assert( socketpair(AF_UNIX, SOCK_STREAM, 0, sockfd) == 0 );
+	assert( assembleBinaryBufferFMU(0, nDbl, 0, 0, curSimTim, dblVal, NULL, NULL,
+		buffer, sizeof(buffer)) == (int) sizeof(buffer) );
+	assert( write(sockfd[1], buffer, sizeof(buffer)) == (int) sizeof(buffer) );
+	nDblRea = nDbl - 1;
+	nIntRea = nBooRea = 0;
+	assert( readfromsocketFMU(&sockfd[0], &sockBuf, &flag, &nDblRea, &nIntRea, &nBooRea,
+		&curSimTim, dblVal, NULL, NULL) != 0 );
+	freesocketbuffersFMU(&sockBuf);
+	close(sockfd[0]);
+	close(sockfd[1]);
+	sockfd[0] = sockfd[1] = -1;
+	//
+	memset(&sockBuf, 0, sizeof(sockBuf));
+	if( establishshmserverFMU(&sockBuf, shmPath, nDbl) != 0 ){
+		return;
+		}
+	//-- EnergyPlus exits before it connects. It must be left to be reaped.
+	pid = fork();
+	assert( pid >= 0 );
+	if( pid == 0 ){
+		_exit(1);
+		}
+	assert( acceptshmclientFMU(&sockBuf, pid, 60000) == -1 );
+	assert( waitpid(pid, &status, 0) == pid );
+	//
+	//-- EnergyPlus does not connect in time.
+	assert( acceptshmclientFMU(&sockBuf, 0, 200) == -1 );
+	//
+	//-- A shared memory message with more doubles than the array holds.
+	memset(&peerBuf, 0, sizeof(peerBuf));
+	assert( connectshmclientFMU(&peerBuf, shmPath) == 0 );
+	assert( acceptshmclientFMU(&sockBuf, 0, 200) == 0 );
+	assert( writetosocketFMU(&sockfd[1], &peerBuf, &flag, &nDbl, &zero, &zero,
+		&curSimTim, dblVal, NULL, NULL) > 0 );
+	nDblRea = nDbl - 1;
+	nIntRea = nBooRea = 0;
+	assert( readfromsocketFMU(&sockfd[0], &sockBuf, &flag, &nDblRea, &nIntRea, &nBooRea,
+		&curSimTim, dblVal, NULL, NULL) != 0 );
+	freesocketbuffersFMU(&peerBuf);
+	freesocketbuffersFMU(&sockBuf);
+	remove(shmPath);
+	}
+
+
+//--- Run the EnergyPlus side of the exchange.
+//
+//   Send outputs and read inputs until the FMU replies with the
+//   termination flag. If sockfd is negative, connect to the shared
+//   memory file.
+static void runEnergyPlus(int sockfd, const int nDbl){
+	SocketBuffers sockBuf;
+	double *dblVal = (double*) malloc(nDbl * sizeof(double));
+	double curSimTim;
+	int flag, nDblRea, nIntRea, nBooRea;
+	const int zero = 0;
+	int step, idx;
+	//
+	memset(&sockBuf, 0, sizeof(sockBuf));
+	if( sockfd < 0 ){
+		assert( connectshmclientFMU(&sockBuf, shmPath) == 0 );
+		}
+	for( step=0; ; ++step ){
+		for( idx=0; idx<nDbl; ++idx ){
+			dblVal[idx] = testValue(1, step, idx);
+			}
+		curSimTim = 60.0 * step;
+		flag = 0;
+		assert( writetosocketFMU(&sockfd, &sockBuf, &flag, &nDbl, &zero, &zero,
+			&curSimTim, dblVal, NULL, NULL) > 0 );
+		nDblRea = nDbl;
+		nIntRea = nBooRea = 0;
+		assert( readfromsocketFMU(&sockfd, &sockBuf, &flag, &nDblRea, &nIntRea, &nBooRea,
+			&curSimTim, dblVal, NULL, NULL) == 0 );
+		if( flag != 0 ){
+			assert( flag == 1 );
+			break;
+			}
+		assert( nDblRea == nDbl );
+		for( idx=0; idx<nDbl; ++idx ){
+			assert( dblVal[idx] == testValue(0, step, idx) );
+			}
+		}
+	freesocketbuffersFMU(&sockBuf);
+	free(dblVal);
+	_exit(0);
+	}
+
+
+//--- Run the FMU side of the exchange, and return the time per step.
+//
+static double runFMU(int sockfd, SocketBuffers *sockBuf, const int nDbl, const int nSteps){
+	double *dblVal = (double*) malloc(nDbl * sizeof(double));
+	double curSimTim;
+	double start;
+	int flag, nDblRea, nIntRea, nBooRea;
+	const int zero = 0;
+	int step, idx;
+	//
+	start = wallTime();
+	for( step=0; step<nSteps; ++step ){
+		nDblRea = nDbl;
+		nIntRea = nBooRea = 0;
+		assert( readfromsocketFMU(&sockfd, sockBuf, &flag, &nDblRea, &nIntRea, &nBooRea,
+			&curSimTim, dblVal, NULL, NULL) == 0 );
+		assert( flag == 0 );
+		assert( nDblRea == nDbl );
+		assert( curSimTim == 60.0 * step );
+		for( idx=0; idx<nDbl; ++idx ){
+			assert( dblVal[idx] == testValue(1, step, idx) );
+			dblVal[idx] = testValue(0, step, idx);
+			}
+		assert( writetosocketFMU(&sockfd, sockBuf, &flag, &nDbl, &zero, &zero,
+			&curSimTim, dblVal, NULL, NULL) > 0 );
+		}
+	start = wallTime() - start;
+	// Reply to the next outputs with the termination flag.
+	nDblRea = nDbl;
+	nIntRea = nBooRea = 0;
+	assert( readfromsocketFMU(&sockfd, sockBuf, &flag, &nDblRea, &nIntRea, &nBooRea,
+		&curSimTim, dblVal, NULL, NULL) == 0 );
+	flag = 1;
+	assert( writetosocketFMU(&sockfd, sockBuf, &flag, &zero, &zero, &zero,
+		&curSimTim, dblVal, NULL, NULL) > 0 );
+	free(dblVal);
+	return start / nSteps;
+	}
+
+
+//--- Main driver.
+//
+int main(int argc, const char* argv[]) {
+	const int nDbl = (argc > 1) ? atoi(argv[1]) : 20;
+	const int nSteps = (argc > 2) ? atoi(argv[2]) : 10000;
+	SocketBuffers sockBuf;
+	int sockfd[2];
+	int status;
+	pid_t pid;
+	double secPerStep;
+	//
+	assert( nDbl > 0 && nSteps > 0 );
+	//
+	//-- Binary messages, and the fallback to text messages.
+	testBinaryLayout();
+	testVersionExchange(1);
+	testVersionExchange(0);
+	printf("binary format: ok\n");
+	testReadBounds();
+	printf("read bounds:   ok\n");
+	//
+	//-- Exchange through a socket.
+	memset(&sockBuf, 0, sizeof(sockBuf));
+	assert( socketpair(AF_UNIX, SOCK_STREAM, 0, sockfd) == 0 );
+	pid = fork();
+	assert( pid >= 0 );
+	if( pid == 0 ){
+		close(sockfd[0]);
+		runEnergyPlus(sockfd[1], nDbl);
+		}
+	close(sockfd[1]);
+	secPerStep = runFMU(sockfd[0], &sockBuf, nDbl, nSteps);
+	assert( waitpid(pid, &status, 0) == pid && WIFEXITED(status) && WEXITSTATUS(status) == 0 );
+	freesocketbuffersFMU(&sockBuf);
+	close(sockfd[0]);
+	printf("socket:        %8.2f us per step with %d doubles\n", 1e6 * secPerStep, nDbl);
+	//
+	//-- Exchange through shared memory.
+	memset(&sockBuf, 0, sizeof(sockBuf));
+	if( establishshmserverFMU(&sockBuf, shmPath, nDbl) != 0 ){
+		printf("shared memory: not available on this platform\n");
+		return( 0 );
+		}
+	pid = fork();
+	assert( pid >= 0 );
+	if( pid == 0 ){
+		memset(&sockBuf, 0, sizeof(sockBuf));
+		runEnergyPlus(-1, nDbl);
+		}
+	assert( acceptshmclientFMU(&sockBuf, pid, 60000) == 0 );
+	secPerStep = runFMU(-1, &sockBuf, nDbl, nSteps);
+	assert( waitpid(pid, &status, 0) == pid && WIFEXITED(status) && WEXITSTATUS(status) == 0 );
+	freesocketbuffersFMU(&sockBuf);
+	remove(shmPath);
+	printf("shared memory: %8.2f us per step with %d doubles\n", 1e6 * secPerStep, nDbl);
+	//
+	return( 0 );
+	}
@@ -0,0 +1,401 @@
+//--- Unit test for xml_parser_cosim.c.
+//
+/// \brief  Unit test for the parser of the model description.
+///
+/// The test writes a model description with the given number of inputs
+/// and outputs, and checks the AST returned by parse(). It then parses
+/// the file in several threads at once, as FMU instances do when they
+/// are instantiated concurrently, and reports the time per parse, the
+/// time to read the attributes of all variables, and the time to look
+/// up all variables by name and by value reference. Last, it checks the
+/// cache of getModelDescription(), and reports the time to get a cached
+/// model description, and to load it from the binary file in a new process.
+///
+/// Usage: utest-xml_parser_cosim [number of variables] [number of threads]
+
+
+//--- Includes.
+#include <assert.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "xml_parser_cosim.h"
+
+
+//--- File-scope constants.
+//
+static const char xmlPath[] = "utest-xml_parser_cosim.xml";
+static const char badXmlPath[] = "utest-xml_parser_cosim-bad.xml";
+static const char cacheDir[] = "utest-xml_parser_cosim-cache";
+static const int nParsesPerThread = 20;
+static const int nAttributeScans = 1000;
+
+
+//--- Wall clock time in seconds.
+//
+static double wallTime(void){
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec + 1e-6 * tv.tv_usec;
+	}
+
+
+//--- Write a model description with {nVar} inputs and {nVar} outputs.
+//
+//   The outputs depend on the first input, and use a declared type,
+//   so that the file holds elements with content and references.
+static void writeModelDescription(const int nVar){
+	FILE *fp = fopen(xmlPath, "w");
+	int i;
+	//
+	assert( fp != NULL );
+	fprintf(fp, "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+		"<fmiModelDescription  fmiVersion=\"1.0\"  modelName=\"utest.idf\"\n"
+		"  modelIdentifier=\"utest\"  guid=\"{0123}\"\n"
+		"  numberOfContinuousStates=\"0\"  numberOfEventIndicators=\"0\">\n"
+		"  <TypeDefinitions>\n"
+		"    <Type  name=\"Temperature\"  description=\"Air temperature\">\n"
+		"      <RealType  unit=\"K\"  nominal=\"300\"/>\n"
+		"    </Type>\n"
+		"  </TypeDefinitions>\n"
+		"  <ModelVariables>\n");
+	for( i=0; i<nVar; ++i ){
+		fprintf(fp, "    <ScalarVariable  name=\"u%d\"  valueReference=\"%d\"\n"
+			"      variability=\"continuous\"  causality=\"input\">\n"
+			"      <Real  start=\"0\"/>\n"
+			"    </ScalarVariable>\n", i, i + 1);
+		}
+	for( i=0; i<nVar; ++i ){
+		fprintf(fp, "    <ScalarVariable  name=\"y%d\"  valueReference=\"%d\"\n"
+			"      variability=\"continuous\"  causality=\"output\">\n"
+			"      <Real  declaredType=\"Temperature\"/>\n"
+			"      <DirectDependency>\n"
+			"        <Name>u0</Name>\n"
+			"      </DirectDependency>\n"
+			"    </ScalarVariable>\n", i, i + 100001);
+		}
+	fprintf(fp, "  </ModelVariables>\n"
+		"  <Implementation>\n"
+		"    <CoSimulation_Tool>\n"
+		"      <Capabilities  canHandleVariableCommunicationStepSize=\"false\"/>\n"
+		"      <Model  entryPoint=\"fmu://resources/utest.idf\"  manualStart=\"false\"  type=\"text/plain\"/>\n"
+		"    </CoSimulation_Tool>\n"
+		"  </Implementation>\n"
+		"</fmiModelDescription>\n");
+	fclose(fp);
+	}
+
+
+//--- Write a model description with one variable, which has the given
+//   attributes.
+//
+static void writeOneVariable(const char *attributes){
+	FILE *fp = fopen(badXmlPath, "w");
+	//
+	assert( fp != NULL );
+	fprintf(fp, "<fmiModelDescription  fmiVersion=\"1.0\"  modelIdentifier=\"utest\"  guid=\"{0123}\">\n"
+		"  <ModelVariables>\n"
+		"    <ScalarVariable  %s>\n"
+		"      <Real/>\n"
+		"    </ScalarVariable>\n"
+		"  </ModelVariables>\n"
+		"</fmiModelDescription>\n", attributes);
+	fclose(fp);
+	}
+
+
+//--- Check the AST of the model description written above.
+//
+static void checkModelDescription(ModelDescription *md, const int nVar){
+	ScalarVariable *sv;
+	char name[32];
+	int i;
+	//
+	assert( md != NULL );
+	assert( strcmp(getModelIdentifier(md), "utest") == 0 );
+	assert( strcmp(getString(md, att_guid), "{0123}") == 0 );
+	assert( getNumInputVariablesInFMU(md) == nVar );
+	assert( getNumOutputVariablesInFMU(md) == nVar );
+	for( i=0; i<2*nVar; ++i ){
+		sv = md->modelVariables[i];
+		assert( sv != NULL );
+		assert( getCausality(sv) == (i < nVar ? enu_input : enu_output) );
+		assert( getValueReference(sv) == (fmiValueReference)(i < nVar ? i + 1 : i - nVar + 100001) );
+		}
+	assert( md->modelVariables[2*nVar] == NULL );
+	//
+	sprintf(name, "y%d", nVar - 1);
+	sv = getVariableByName(md, name);
+	assert( sv != NULL && getValueReference(sv) == (fmiValueReference)(nVar + 100000) );
+	assert( getVariable(md, nVar + 100000, elm_Real) == sv );
+	assert( getVariable(md, nVar + 100000, elm_Integer) == NULL );
+	assert( strcmp(getDescription(md, sv), "Air temperature") == 0 );
+	assert( getNominal(md, nVar + 100000) == 300.0 );
+	assert( strcmp(getString(sv->directDependencies[0], att_input), "u0") == 0 );
+	assert( sv->directDependencies[1] == NULL );
+	assert( getVariableByName(md, "missing") == NULL );
+	assert( md->cosimulation != NULL && md->cosimulation->model != NULL );
+	}
+
+
+//--- Parse the model description repeatedly.
+//
+typedef struct {
+	int nVar;
+	double secPerParse;
+	} ThreadArgs;
+
+static void* parseRepeatedly(void *arg){
+	ThreadArgs *args = (ThreadArgs*) arg;
+	ModelDescription *md;
+	double start;
+	int i;
+	//
+	start = wallTime();
+	for( i=0; i<nParsesPerThread; ++i ){
+		md = parse(xmlPath);
+		checkModelDescription(md, args->nVar);
+		freeElement(md);
+		}
+	args->secPerParse = (wallTime() - start) / nParsesPerThread;
+	return( NULL );
+	}
+
+
+//--- Path of the only binary file in the cache directory, or NULL.
+//
+static char* getBinPath(char *binPath){
+	DIR *dir = opendir(cacheDir);
+	struct dirent *ent;
+	int nFiles = 0;
+	//
+	assert( dir != NULL );
+	while( (ent = readdir(dir)) != NULL ){
+		if( ent->d_name[0] == '.' ) continue;
+		sprintf(binPath, "%s/%s", cacheDir, ent->d_name);
+		++nFiles;
+		}
+	closedir(dir);
+	assert( nFiles <= 1 );
+	return( nFiles ? binPath : NULL );
+	}
+
+
+//--- Get the model description in a new process, which has an empty
+//   process cache, and report the time it took.
+//
+static void getInNewProcess(const int nVar, const char *what){
+	pid_t pid;
+	int status;
+	//
+	fflush(stdout);
+	pid = fork();
+	assert( pid >= 0 );
+	if( pid == 0 ){
+		double start = wallTime();
+		ModelDescription *md = getModelDescription(xmlPath, "{0123}", cacheDir);
+		printf("%-12s %8.3f ms per load of %d variables\n",
+			what, 1e3 * (wallTime() - start), 2 * nVar);
+		checkModelDescription(md, nVar);
+		releaseModelDescription(md);
+		exit(0);
+		}
+	assert( waitpid(pid, &status, 0) == pid );
+	assert( WIFEXITED(status) && WEXITSTATUS(status) == 0 );
+	}
+
+
+//--- Main driver.
+//
+int main(int argc, const char* argv[]) {
+	const int nVar = (argc > 1) ? atoi(argv[1]) : 1000;
+	const int nThreads = (argc > 2) ? atoi(argv[2]) : 4;
+	pthread_t *threads;
+	ThreadArgs *args;
+	double secPerParse;
+	int i;
+	//
+	assert( nVar > 0 && nThreads > 0 );
+	writeModelDescription(nVar);
+	//
+	//-- Parse in one thread.
+	args = (ThreadArgs*) calloc(nThreads, sizeof(ThreadArgs));
+	args[0].nVar = nVar;
+	parseRepeatedly(&args[0]);
+	printf("1 thread:    %8.3f ms per parse of %d variables\n",
+		1e3 * args[0].secPerParse, 2 * nVar);
+	//
+	//-- Parse in several threads at once.
+	threads = (pthread_t*) malloc(nThreads * sizeof(pthread_t));
+	for( i=0; i<nThreads; ++i ){
+		args[i].nVar = nVar;
+		assert( pthread_create(&threads[i], NULL, parseRepeatedly, &args[i]) == 0 );
+		}
+	secPerParse = 0;
+	for( i=0; i<nThreads; ++i ){
+		assert( pthread_join(threads[i], NULL) == 0 );
+		secPerParse += args[i].secPerParse;
+		}
+	printf("%d threads:   %8.3f ms per parse of %d variables\n",
+		nThreads, 1e3 * secPerParse / nThreads, 2 * nVar);
+	//
+	//-- Read the attributes of all variables, as the FMU does to map
+	// the value references to its inputs and outputs.
+	{
+		ModelDescription *md = parse(xmlPath);
+		ScalarVariable **vars = md->modelVariables;
+		double start = wallTime();
+		long sum = 0;
+		int j;
+		for( i=0; i<nAttributeScans; ++i ){
+			for( j=0; vars[j]; ++j ){
+				sum += getCausality(vars[j]) + getVariability(vars[j]) + getAlias(vars[j])
+					+ getValueReference(vars[j]);
+				}
+			}
+		printf("attributes:  %8.3f us per scan of %d variables (%ld)\n",
+			1e6 * (wallTime() - start) / nAttributeScans, 2 * nVar, sum);
+		freeElement(md);
+	}
+	//
+	//-- Look up every variable by name and by value reference, as a
+	// master does when it connects the variables of many FMUs.
+	{
+		ModelDescription *md = parse(xmlPath);
+		ScalarVariable **vars = md->modelVariables;
+		double start = wallTime();
+		int j;
+		for( j=0; vars[j]; ++j ){
+			assert( getVariableByName(md, getName(vars[j])) == vars[j] );
+			assert( getVariable(md, getValueReference(vars[j]), elm_Real) == vars[j] );
+			}
+		printf("lookups:     %8.3f us per lookup of %d variables\n",
+			1e6 * (wallTime() - start) / (2 * j), j);
+		freeElement(md);
+	}
+	//
+	//-- Return the first of the variables that share a value reference,
+	// and treat Integer and Enumeration as the same base type.
+	{
+		ModelDescription *md;
+		FILE *fp = fopen(badXmlPath, "w");
+		assert( fp != NULL );
+		fprintf(fp, "<fmiModelDescription  fmiVersion=\"1.0\"  modelIdentifier=\"utest\"  guid=\"{0123}\">\n"
+			"  <ModelVariables>\n"
+			"    <ScalarVariable  name=\"a\"  valueReference=\"1\"><Real/></ScalarVariable>\n"
+			"    <ScalarVariable  name=\"b\"  valueReference=\"1\"  alias=\"alias\"><Real/></ScalarVariable>\n"
+			"    <ScalarVariable  name=\"c\"  valueReference=\"1\"><Enumeration/></ScalarVariable>\n"
+			"    <ScalarVariable  name=\"d\"  valueReference=\"1\"><Integer/></ScalarVariable>\n"
+			"  </ModelVariables>\n"
+			"</fmiModelDescription>\n");
+		fclose(fp);
+		md = parse(badXmlPath);
+		assert( md != NULL );
+		assert( getVariable(md, 1, elm_Real) == getVariableByName(md, "a") );
+		assert( getVariable(md, 1, elm_Integer) == getVariableByName(md, "c") );
+		assert( getVariable(md, 1, elm_Enumeration) == getVariableByName(md, "c") );
+		assert( getVariable(md, 1, elm_Boolean) == NULL );
+		assert( getVariable(md, fmiUndefinedValueReference, elm_Real) == NULL );
+		assert( getVariableByName(md, "b") == md->modelVariables[1] );
+		assert( getDeclaredType(md, "Temperature") == NULL );
+		freeElement(md);
+	}
+	//
+	//-- Decode default attributes, and reject illegal ones.
+	{
+		ModelDescription *md;
+		writeOneVariable("name=\"a\"  valueReference=\"7\"");
+		md = parse(badXmlPath);
+		assert( md != NULL );
+		assert( getValueReference(md->modelVariables[0]) == 7 );
+		assert( getCausality(md->modelVariables[0]) == enu_internal );
+		assert( getVariability(md->modelVariables[0]) == enu_continuous );
+		assert( getAlias(md->modelVariables[0]) == enu_noAlias );
+		assert( getNumInputVariablesInFMU(md) == 0 && getNumOutputVariablesInFMU(md) == 0 );
+		freeElement(md);
+		writeOneVariable("name=\"a\"");
+		assert( parse(badXmlPath) == NULL );
+		writeOneVariable("name=\"a\"  valueReference=\"x\"");
+		assert( parse(badXmlPath) == NULL );
+		writeOneVariable("name=\"a\"  valueReference=\"7\"  causality=\"parameter\"");
+		assert( parse(badXmlPath) == NULL );
+		writeOneVariable("name=\"a\"  valueReference=\"7\"  alias=\"bogus\"");
+		assert( parse(badXmlPath) == NULL );
+		remove(badXmlPath);
+	}
+	//
+	//-- Load the model description from the binary file in later
+	// processes, and share it among the instances of a process.
+	{
+		ModelDescription *md, *md2;
+		char binPath[1024];
+		struct stat st;
+		double start;
+		FILE *fp;
+		mkdir(cacheDir, 0755);
+		getInNewProcess(nVar, "parse:");
+		assert( getBinPath(binPath) != NULL );
+		getInNewProcess(nVar, "binary file:");
+		// a corrupt binary file is ignored
+		fp = fopen(binPath, "r+b");
+		assert( fp != NULL );
+		fseek(fp, -8, SEEK_END);
+		fputs("garbage", fp);
+		fclose(fp);
+		getInNewProcess(nVar, "corrupt file:");
+		getInNewProcess(nVar, "binary file:");
+		// the instances of a process share one model description
+		md = getModelDescription(xmlPath, "{0123}", cacheDir);
+		checkModelDescription(md, nVar);
+		start = wallTime();
+		md2 = getModelDescription(xmlPath, "{0123}", cacheDir);
+		printf("cached:      %8.3f us per instantiation\n", 1e6 * (wallTime() - start));
+		assert( md2 == md );
+		releaseModelDescription(md2);
+		// a wrong GUID gets the model description, but not the shared one
+		md2 = getModelDescription(xmlPath, "{4567}", cacheDir);
+		assert( md2 != NULL && md2 != md );
+		assert( strcmp(getString(md2, att_guid), "{0123}") == 0 );
+		releaseModelDescription(md2);
+		// a changed file is parsed again, while the old model description
+		// stays valid until it is released
+		assert( stat(binPath, &st) == 0 );
+		writeModelDescription(nVar + 1);
+		md2 = getModelDescription(xmlPath, "{0123}", cacheDir);
+		checkModelDescription(md2, nVar + 1);
+		checkModelDescription(md, nVar);
+		releaseModelDescription(md);
+		assert( getModelDescription(xmlPath, "{0123}", cacheDir) == md2 );
+		releaseModelDescription(md2);
+		releaseModelDescription(md2);
+		assert( getBinPath(binPath) != NULL );
+		{
+			struct stat st2;
+			assert( stat(binPath, &st2) == 0 && st2.st_size != st.st_size );
+		}
+		// without a cache directory, no binary file is written
+		remove(binPath);
+		md = getModelDescription("./utest-xml_parser_cosim.xml", NULL, NULL);
+		checkModelDescription(md, nVar + 1);
+		assert( md != md2 );
+		releaseModelDescription(md);
+		assert( getBinPath(binPath) == NULL );
+		rmdir(cacheDir);
+	}
+	//
+	//-- Reject a file that does not exist.
+	assert( parse("utest-xml_parser_cosim-missing.xml") == NULL );
+	assert( getModelDescription("utest-xml_parser_cosim-missing.xml", NULL, cacheDir) == NULL );
+	//
+	free(threads);
+	free(args);
+	remove(xmlPath);
+	return( 0 );
+	}
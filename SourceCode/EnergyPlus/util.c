@@ -21,11 +21,36 @@
 /// All rights reserved.
 ///////////////////////////////////////////////////////
 
+// for copy_file_range() on Linux.
+#ifdef __linux__
+#define _GNU_SOURCE
+#endif
+#include <errno.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/stat.h>
 #include "util.h"
+#ifdef _MSC_VER
+#include <direct.h>
+#include "dirent_win.h"
+#define MKDIR(path) _mkdir(path)
+#define RMDIR(path) _rmdir(path)
+#define LSTAT(path, st) stat(path, st)
+#else
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#define MKDIR(path) mkdir(path, 0777)
+#define RMDIR(path) rmdir(path)
+#define LSTAT(path, st) lstat(path, st)
+#endif
+#ifdef __linux__
+#include <sys/sendfile.h>
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 27))
+#define HAVE_COPY_FILE_RANGE 1
+#endif
+#endif
 
 int debug;  // Control for debug information
 
@@ -49,7 +74,6 @@ void doubleToCommaString(char* buffer, double r){
 ///\return 0 if no error occurred
 /////////////////////////////////////////////////////////////////////////
 int deleteTmpDir(char* tmpPat){
-	char* cmd;
   struct stat st;
 
   // Ceck if the folder present
@@ -58,20 +82,7 @@ int deleteTmpDir(char* tmpPat){
     return -1;
   }    
 
-	cmd = (char *)calloc(sizeof(char), strlen(tmpPat) +18);
-	if (cmd == NULL){
-	    printfError("Fail to allocate memory for cmd.\n", tmpPat);
-	    return -1;
-	  }
-  
-  if (WINDOWS)
-  	sprintf(cmd, "rd %s /S/Q", tmpPat); // Command in windows
-  else
-  	sprintf(cmd, "rm -r %s", tmpPat); // Command in Linux
-
-
-	printf("Generated cmd: \"%s\".\n", cmd);
-	if ( system(cmd) != 0 ){	
+	if ( removeDirTree(tmpPat) != 0 ){	
 	  printError("Fail to delete the temporary files");
 	  return -1;
 	}
@@ -79,6 +90,187 @@ int deleteTmpDir(char* tmpPat){
 	return 0;
 }
 
+//////////////////////////////////////////////////////////////////////////
+/// Create a folder, and any missing parent folders.
+///
+///\param path The path of the folder.
+///\return 0 if the folder exists on return.
+/////////////////////////////////////////////////////////////////////////
+int makeDirs(const char *path)
+{
+	char *tmp;
+	size_t i, len;
+	struct stat st;
+
+	len = strlen(path);
+	tmp = (char *)malloc(len + 1);
+	if (tmp == NULL)
+		return -1;
+	strcpy(tmp, path);
+	// create each prefix that ends before a separator, skipping the root,
+	// the drive and repeated separators.
+	for (i = 1; i < len; i++){
+		if ((tmp[i] == '/' || tmp[i] == '\\')
+			&& tmp[i-1] != '/' && tmp[i-1] != '\\' && tmp[i-1] != ':'){
+			tmp[i] = '\0';
+			MKDIR(tmp);
+			tmp[i] = path[i];
+		}
+	}
+	free(tmp);
+	if (MKDIR(path) != 0 && errno != EEXIST)
+		return -1;
+	return (stat(path, &st) == 0 && S_ISDIR(st.st_mode)) ? 0 : -1;
+}
+
+//////////////////////////////////////////////////////////////////////////
+/// Delete a file, or a folder and all it contains.
+///
+/// Does not follow symbolic links.
+///
+///\param path The path of the file or folder.
+///\return 0 if the path does not exist on return.
+/////////////////////////////////////////////////////////////////////////
+int removeDirTree(const char *path)
+{
+	DIR *dirp;
+	struct dirent *dp;
+	struct stat st;
+	char *child;
+	size_t len;
+	int retVal = 0;
+
+	if (LSTAT(path, &st) != 0)
+		return (errno == ENOENT) ? 0 : -1;
+	if (!S_ISDIR(st.st_mode))
+		return remove(path);
+	dirp = opendir(path);
+	if (dirp == NULL)
+		return -1;
+	len = strlen(path);
+	while ((dp = readdir(dirp)) != NULL){
+		if (strcmp(dp->d_name, ".") == 0 || strcmp(dp->d_name, "..") == 0)
+			continue;
+		child = (char *)malloc(len + strlen(dp->d_name) + 2);
+		if (child == NULL){
+			retVal = -1;
+			break;
+		}
+		sprintf(child, "%s/%s", path, dp->d_name);
+		if (removeDirTree(child) != 0)
+			retVal = -1;
+		free(child);
+	}
+	closedir(dirp);
+	if (RMDIR(path) != 0)
+		retVal = -1;
+	return retVal;
+}
+
+//////////////////////////////////////////////////////////////////////////
+/// Delete the files in a folder whose names end with an extension.
+///
+///\param path The path of the folder.
+///\param ext The extension, for example ".epw".
+///\return 0 if no error occurred.
+/////////////////////////////////////////////////////////////////////////
+int removeFilesWithExt(const char *path, const char *ext)
+{
+	DIR *dirp;
+	struct dirent *dp;
+	struct stat st;
+	char *child;
+	size_t len, extLen, nameLen;
+	int retVal = 0;
+
+	dirp = opendir(path);
+	if (dirp == NULL)
+		return -1;
+	len = strlen(path);
+	extLen = strlen(ext);
+	while ((dp = readdir(dirp)) != NULL){
+		nameLen = strlen(dp->d_name);
+		if (nameLen < extLen || strcmp(dp->d_name + nameLen - extLen, ext) != 0)
+			continue;
+		child = (char *)malloc(len + nameLen + 2);
+		if (child == NULL){
+			retVal = -1;
+			break;
+		}
+		sprintf(child, "%s/%s", path, dp->d_name);
+		if (LSTAT(child, &st) == 0 && !S_ISDIR(st.st_mode) && remove(child) != 0)
+			retVal = -1;
+		free(child);
+	}
+	closedir(dirp);
+	return retVal;
+}
+
+//////////////////////////////////////////////////////////////////////////
+/// Copy a file, replacing the destination if it exists.
+///
+/// On Linux, copies in the kernel with copy_file_range(), or else with
+/// sendfile(), and falls back to read() and write() for the rest.
+///
+///\param src The path of the file to copy.
+///\param dst The path of the copy.
+///\return 0 if no error occurred.
+/////////////////////////////////////////////////////////////////////////
+int copyFile(const char *src, const char *dst)
+{
+#ifdef _MSC_VER
+	return CopyFile(src, dst, FALSE) ? 0 : -1;
+#else
+	char buf[65536];
+	struct stat st;
+	ssize_t len, wrote;
+	off_t copied = 0;
+	int in, out, retVal = 0;
+
+	in = open(src, O_RDONLY);
+	if (in < 0)
+		return -1;
+	if (fstat(in, &st) != 0){
+		close(in);
+		return -1;
+	}
+	out = open(dst, O_WRONLY | O_CREAT | O_TRUNC, st.st_mode & 0777);
+	if (out < 0){
+		close(in);
+		return -1;
+	}
+#ifdef HAVE_COPY_FILE_RANGE
+	while (copied < st.st_size
+		&& (len = copy_file_range(in, NULL, out, NULL, (size_t)(st.st_size - copied), 0)) > 0)
+		copied += len;
+#endif
+#ifdef __linux__
+	while (copied < st.st_size
+		&& (len = sendfile(out, in, NULL, (size_t)(st.st_size - copied))) > 0)
+		copied += len;
+#endif
+	// copy what is left, including anything the file grew by.
+	while (retVal == 0 && (len = read(in, buf, sizeof(buf))) != 0){
+		if (len < 0){
+			if (errno != EINTR)
+				retVal = -1;
+			continue;
+		}
+		for (wrote = 0; retVal == 0 && wrote < len; ){
+			ssize_t part = write(out, buf + wrote, (size_t)(len - wrote));
+			if (part > 0)
+				wrote += part;
+			else if (part < 0 && errno != EINTR)
+				retVal = -1;
+		}
+	}
+	close(in);
+	if (close(out) != 0)
+		retVal = -1;
+	return retVal;
+#endif
+}
+
 //////////////////////////////////////////////////////////////////////////////
 /// Get temporary path
 ///
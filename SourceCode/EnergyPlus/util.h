@@ -34,6 +34,14 @@ void doubleToCommaString(char* buffer, double r);
 
 int deleteTmpDir(char* tmpPat);
 
+int makeDirs(const char *path);
+
+int removeDirTree(const char *path);
+
+int removeFilesWithExt(const char *path, const char *ext);
+
+int copyFile(const char *src, const char *dst);
+
 char *getTmpPath(const char *nam, int length);
 
 void printDebug(const char* msg);
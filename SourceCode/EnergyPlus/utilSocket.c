@@ -22,17 +22,23 @@
 
 #ifdef _MSC_VER // Microsoft compiler
 #else
+#include <poll.h>
 #include <unistd.h>
 #endif
+#ifdef __linux__
+#include <fcntl.h>
+#include <signal.h>
+#include <stddef.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <linux/futex.h>
+#endif
 
 
 static FILE *f1 = NULL; 
-static int REQUIRED_READ_LENGTH  = 0;
-static int REQUIRED_WRITE_LENGTH = 0;
-
-/// This will be overwritten to contain the
-/// version number of the server
-int SERVER_VERSION = 0;
 
 // FIX: Increase HEADER_LENGTH for large number of Input/Output variables.
 // This was necessary to address issues reported by several users  when 
@@ -54,12 +60,32 @@ int SERVER_VERSION = 0;
 ///              be set to the new size of \c buffer if memory was reallocated.
 ///\return 0 if no error occurred.
 int save_appendFMU(char* *buffer, const char *toAdd, int *bufLen){
+	int nBufCha = strlen(*buffer);
+	return save_appendlengthFMU(buffer, &nBufCha, toAdd, strlen(toAdd), bufLen);
+}
+
+////////////////////////////////////////////////////////////////
+/// Appends a character array of known length to another character
+/// array of known length.
+///
+/// This function does the same as \c save_appendFMU, but it does not
+/// need to call \c strlen on \c buffer. Hence, assembling a buffer
+/// with \c n values is of order \c n rather than \c n^2.
+///
+///\param buffer The buffer to which the character array will be added.
+///\param nBufCha The number of characters in \c buffer. This parameter will
+///              be increased by \c nNewCha.
+///\param toAdd The character array that will be appended to \c buffer
+///\param nNewCha The number of characters in \c toAdd.
+///\param bufLen The length of the character array \c buffer. This parameter will
+///              be set to the new size of \c buffer if memory was reallocated.
+///\return 0 if no error occurred.
+int save_appendlengthFMU(char* *buffer, int *nBufCha,
+	const char *toAdd, const int nNewCha, int *bufLen){
 	const int size = 1024;
-	const int nNewCha = strlen(toAdd);
-	const int nBufCha = strlen(*buffer);
 	// reallocate memory if needed
-	if ( *bufLen < nNewCha + nBufCha + 1){
-		*bufLen = *bufLen + size * (((nNewCha + nBufCha) / size)+1);
+	if ( *bufLen < nNewCha + *nBufCha + 1){
+		*bufLen = *bufLen + size * (((nNewCha + *nBufCha) / size)+1);
 		*buffer = realloc(*buffer, *bufLen);
 		if (*buffer == NULL) {
 			perror("Realloc failed in save_appendFMU.");
@@ -69,11 +95,56 @@ int save_appendFMU(char* *buffer, const char *toAdd, int *bufLen){
 			return EXIT_FAILURE;
 		}
 	}
-	// append toAdd to buffer
-	strcpy(*buffer + strlen(*buffer), toAdd);
+	// append toAdd to buffer, including the terminating character
+	memcpy(*buffer + *nBufCha, toAdd, nNewCha + 1);
+	*nBufCha += nNewCha;
 	return 0;
 }
 
+////////////////////////////////////////////////////////////////
+/// Makes sure that a buffer has at least a given length.
+///
+/// The buffer is only reallocated if it is too short. Hence, once
+/// the buffers of an FMU instance have their final size, exchanging
+/// data does not allocate memory.
+///
+///\param buffer The buffer.
+///\param bufLen The length of \c buffer. This parameter will
+///              be set to the new size of \c buffer if memory was reallocated.
+///\param minLen The required length.
+///\return 0 if no error occurred.
+int reservebufferFMU(char* *buffer, int *bufLen, const int minLen){
+	char *temp;
+	if ( *buffer != NULL && *bufLen >= minLen )
+		return 0;
+	temp = realloc(*buffer, minLen);
+	if (temp == NULL) {
+		perror("Realloc failed in reservebufferFMU.");
+#ifdef NDEBUG
+		fprintf(f1, "Realloc failed in reservebufferFMU.\n");
+#endif
+		return EXIT_FAILURE;
+	}
+	*buffer = temp;
+	*bufLen = minLen;
+	return 0;
+}
+
+////////////////////////////////////////////////////////////////
+/// Frees the buffers of a socket connection.
+///
+///\param sockBuf The buffers of the socket connection.
+void freesocketbuffersFMU(SocketBuffers *sockBuf){
+	closeshmFMU(sockBuf);
+	if (sockBuf->readBuffer != NULL) free(sockBuf->readBuffer);
+	sockBuf->readBuffer = NULL;
+	sockBuf->readLength = 0;
+	if (sockBuf->writeBuffer != NULL) free(sockBuf->writeBuffer);
+	sockBuf->writeBuffer = NULL;
+	sockBuf->writeLength = 0;
+	sockBuf->serverVersion = 0;
+}
+
 ////////////////////////////////////////////////////////////////
 /// Assembles the buffer that will be exchanged through the IPC.
 ///
@@ -95,52 +166,55 @@ int assembleBufferFMU(int flag,
 {
 	int i;
 	int retVal;
+	int nBufCha = 0; // number of characters in buffer
+	int nTemCha;     // number of characters in temCha
 	char temCha[1024]; // temporary character array
-	memset((char*) *buffer, '\0', *bufLen);
+	if ( *bufLen > 0 )
+		(*buffer)[0] = '\0';
 	// Set up how many values will be in buffer
 	// This is an internally used version number to make update
 	// of the format possible later without braking old versions
-	sprintf(temCha, "%d ", MAINVERSION);
-	retVal = save_appendFMU(buffer, temCha, bufLen);
+	nTemCha = sprintf(temCha, "%d ", MAINVERSION);
+	retVal = save_appendlengthFMU(buffer, &nBufCha, temCha, nTemCha, bufLen);
 	if ( retVal != 0 ) return retVal;
-	sprintf(temCha, "%d ", flag);
-	retVal = save_appendFMU(buffer, temCha, bufLen);
+	nTemCha = sprintf(temCha, "%d ", flag);
+	retVal = save_appendlengthFMU(buffer, &nBufCha, temCha, nTemCha, bufLen);
 	if ( retVal != 0 ) return retVal;
 	if ( flag == 0 ){
 		// Only process data if the flag is zero.
-		sprintf(temCha, "%d ", nDbl);
-		retVal = save_appendFMU(buffer, temCha, bufLen);
+		nTemCha = sprintf(temCha, "%d ", nDbl);
+		retVal = save_appendlengthFMU(buffer, &nBufCha, temCha, nTemCha, bufLen);
 		if ( retVal != 0 ) return retVal;
-		sprintf(temCha, "%d ", nInt);
-		retVal = save_appendFMU(buffer, temCha, bufLen);
+		nTemCha = sprintf(temCha, "%d ", nInt);
+		retVal = save_appendlengthFMU(buffer, &nBufCha, temCha, nTemCha, bufLen);
 		if ( retVal != 0 ) return retVal;
-		sprintf(temCha, "%d ", nBoo);
-		retVal = save_appendFMU(buffer, temCha, bufLen);
+		nTemCha = sprintf(temCha, "%d ", nBoo);
+		retVal = save_appendlengthFMU(buffer, &nBufCha, temCha, nTemCha, bufLen);
 		if ( retVal != 0 ) return retVal;
-		sprintf(temCha,"%20.15e ", curSimTim);
-		retVal = save_appendFMU(buffer, temCha, bufLen);
+		nTemCha = sprintf(temCha, "%20.15e ", curSimTim);
+		retVal = save_appendlengthFMU(buffer, &nBufCha, temCha, nTemCha, bufLen);
 		if ( retVal != 0 ) return retVal;
 		// add values to buffer
 		for(i = 0; i < nDbl; i++){
-			sprintf(temCha,"%20.15e ", dblVal[i]);
-			retVal = save_appendFMU(buffer, temCha, bufLen);
+			nTemCha = sprintf(temCha, "%20.15e ", dblVal[i]);
+			retVal = save_appendlengthFMU(buffer, &nBufCha, temCha, nTemCha, bufLen);
 			if ( retVal != 0 ) return retVal;
 		}
 		for(i = 0; i < nInt; i++){
-			sprintf(temCha,"%d ", intVal[i]);
-			retVal = save_appendFMU(buffer, temCha, bufLen);
+			nTemCha = sprintf(temCha, "%d ", intVal[i]);
+			retVal = save_appendlengthFMU(buffer, &nBufCha, temCha, nTemCha, bufLen);
 			if ( retVal != 0 ) return retVal;
 		}
 		for(i = 0; i < nBoo; i++){
-			sprintf(temCha,"%d ", booVal[i]);
-			retVal = save_appendFMU(buffer, temCha, bufLen);
+			nTemCha = sprintf(temCha, "%d ", booVal[i]);
+			retVal = save_appendlengthFMU(buffer, &nBufCha, temCha, nTemCha, bufLen);
 			if ( retVal != 0 ) return retVal;
 		}
 	}
 	// For the Java server to read the line, the line
 	// needs to be terminated with '\n'
-	sprintf(temCha,"\n");
-	retVal = save_appendFMU(buffer, temCha, bufLen);
+	nTemCha = sprintf(temCha, "\n");
+	retVal = save_appendlengthFMU(buffer, &nBufCha, temCha, nTemCha, bufLen);
 	if ( retVal != 0 ) return retVal;
 	// No error, return 0
 	return 0;
@@ -217,6 +291,7 @@ int getDoubleCheckErrorFMU(const char *nptr, char **endptr,
 /// a long enough buffer for the read operation.
 ///
 ///\param buffer The buffer that contains the values to be parsed.
+///\param version The version number of the server.
 ///\param flag The communication flag.
 ///\param nDbl The number of double values received.
 ///\param nInt The number of integer values received.
@@ -224,6 +299,7 @@ int getDoubleCheckErrorFMU(const char *nptr, char **endptr,
 ///\return 0 if no error occurred.
 int disassembleHeaderBufferFMU(const char* buffer,
 	char **endptr, const int base,
+	int *version,
 	int *fla,
 	int *nDbl, int *nInt, int *nBoo)
 {
@@ -235,7 +311,7 @@ int disassembleHeaderBufferFMU(const char* buffer,
 	*nInt = 0;
 	*nBoo = 0;
 	// version number
-	retVal = getIntCheckErrorFMU(buffer, endptr, base, &SERVER_VERSION);
+	retVal = getIntCheckErrorFMU(buffer, endptr, base, version);
 	if ( retVal )
 		return retVal;
 	//////////////////////////////////////////////////////
@@ -243,6 +319,9 @@ int disassembleHeaderBufferFMU(const char* buffer,
 	retVal = getIntCheckErrorFMU(*endptr, endptr, base, fla);
 	if ( retVal )
 		return retVal;
+	// a message with a nonzero flag has no further values
+	if ( *fla != 0 )
+		return 0;
 	// number of doubles, integers and booleans
 	retVal = getIntCheckErrorFMU(*endptr, endptr, base, nDbl);
 	if ( retVal ) 
@@ -259,9 +338,9 @@ int disassembleHeaderBufferFMU(const char* buffer,
 ///
 ///\param buffer The buffer that contains the values to be parsed.
 ///\param flag The communication flag.
-///\param nDbl The number of double values received.
-///\param nInt The number of integer values received.
-///\param nBoo The number of boolean values received.
+///\param nDbl The number of double values received. On entry, the length of \c dblVal.
+///\param nInt The number of integer values received. On entry, the length of \c intVal.
+///\param nBoo The number of boolean values received. On entry, the length of \c booVal.
 ///\param dblVal The array that stores the double values.
 ///\param intVal The array that stores the integer values.
 ///\param booVal The array that stores the boolean values.
@@ -274,18 +353,29 @@ int disassembleBufferFMU(const char* buffer,
 {
 	int i;
 	int retVal;    // return value
+	int version;
 	const int base = 10;
 	char *endptr = 0;
+	const int nDblCap = *nDbl;
+	const int nIntCap = *nInt;
+	const int nBooCap = *nBoo;
 	retVal = disassembleHeaderBufferFMU(buffer, &endptr, base,
-		fla, nDbl, nInt, nBoo);
+		&version, fla, nDbl, nInt, nBoo);
 	if ( retVal ) {
 #ifdef NDEBUG
 		fprintf(f1, "Error while disassembling the header of the buffer.\n");
 #endif
 		return retVal;
 	}
+	if ( *nDbl > nDblCap || *nInt > nIntCap || *nBoo > nBooCap ){
+		fprintf(stderr, "Error: Received %d doubles, %d integers and %d booleans,\n", *nDbl, *nInt, *nBoo);
+		fprintf(stderr, "       but can store at most %d, %d and %d.\n", nDblCap, nIntCap, nBooCap);
+		return -1;
+	}
 
 	*curSimTim = 0;
+	if ( *fla != 0 )
+		return 0;
 	// current simulation time
 	retVal = getDoubleCheckErrorFMU(endptr, &endptr, curSimTim);
 	if ( retVal ) {
@@ -330,11 +420,245 @@ int disassembleBufferFMU(const char* buffer,
 	return retVal;
 }
 
+/////////////////////////////////////////////////////////////////
+/// Writes a 32 bit integer in little-endian byte order.
+///
+///\param buffer The buffer into which the value will be written.
+///\param val The value to be written.
+static void putint32FMU(unsigned char *buffer, const int val){
+	const unsigned int u = (unsigned int) val;
+	buffer[0] = (unsigned char)( u        & 0xFF);
+	buffer[1] = (unsigned char)((u >> 8)  & 0xFF);
+	buffer[2] = (unsigned char)((u >> 16) & 0xFF);
+	buffer[3] = (unsigned char)((u >> 24) & 0xFF);
+}
+
+/////////////////////////////////////////////////////////////////
+/// Reads a 32 bit integer in little-endian byte order.
+///
+///\param buffer The buffer that contains the value.
+///\return The value.
+static int getint32FMU(const unsigned char *buffer){
+	return (int)( (unsigned int) buffer[0]
+		| ((unsigned int) buffer[1] << 8)
+		| ((unsigned int) buffer[2] << 16)
+		| ((unsigned int) buffer[3] << 24));
+}
+
+/////////////////////////////////////////////////////////////////
+/// Writes an IEEE-754 double in little-endian byte order.
+///
+///\param buffer The buffer into which the value will be written.
+///\param val The value to be written.
+static void putdoubleFMU(unsigned char *buffer, const double val){
+	unsigned long long u;
+	int i;
+	memcpy(&u, &val, sizeof(double));
+	for(i = 0; i < 8; i++)
+		buffer[i] = (unsigned char)((u >> (8*i)) & 0xFF);
+}
+
+/////////////////////////////////////////////////////////////////
+/// Reads an IEEE-754 double in little-endian byte order.
+///
+///\param buffer The buffer that contains the value.
+///\return The value.
+static double getdoubleFMU(const unsigned char *buffer){
+	unsigned long long u = 0;
+	double val;
+	int i;
+	for(i = 7; i >= 0; i--)
+		u = (u << 8) | buffer[i];
+	memcpy(&val, &u, sizeof(double));
+	return val;
+}
+
+/////////////////////////////////////////////////////////////////
+/// Returns the number of bytes of a binary message.
+///
+///\param nDbl Number of double values to read or write.
+///\param nInt Number of integer values to read or write.
+///\param nBoo Number of boolean values to read or write.
+///\return The number of bytes of the message, or -1 if a number is negative
+///        or the message would be longer than \c INT_MAX bytes.
+int getbinarybufferlengthFMU(const int nDbl, const int nInt, const int nBoo){
+	// the numbers may be read from a message, so check them before multiplying.
+	const int maxLen = INT_MAX - BINARY_HEADER_LENGTH;
+	if ( nDbl < 0 || nInt < 0 || nBoo < 0
+		|| nInt > maxLen / 4 || nBoo > maxLen / 4 - nInt
+		|| nDbl > (maxLen - 4 * (nInt + nBoo)) / 8 )
+		return -1;
+	return BINARY_HEADER_LENGTH + 8 * nDbl + 4 * (nInt + nBoo);
+}
+
+/////////////////////////////////////////////////////////////////
+/// Assembles a binary message that will be exchanged through the IPC.
+///
+/// The header contains the version number, the flag, the number of
+/// doubles, integers and booleans, a reserved word, and the current
+/// simulation time. It is followed by the doubles, the integers and
+/// the booleans. All values are in little-endian byte order.
+///
+///\param flag The communication flag.
+///\param nDbl The number of double values.
+///\param nInt The number of integer values.
+///\param nBoo The number of boolean values.
+///\param curSimTim The current simulation time in seconds.
+///\param dblVal The array that stores the double values.
+///\param intVal The array that stores the integer values.
+///\param booVal The array that stores the boolean values.
+///\param buffer The buffer into which the values will be written.
+///\param bufLen The buffer length.
+///\return The number of bytes of the message, or -1 if the buffer is too small.
+int assembleBinaryBufferFMU(int flag,
+	int nDbl, int nInt, int nBoo,
+	double curSimTim,
+	double dblVal[], int intVal[], int booVal[],
+	char *buffer, int bufLen)
+{
+	int i;
+	int nBytes;
+	unsigned char *p = (unsigned char*) buffer;
+	// Values are only sent if the flag is zero.
+	if ( flag != 0 ){
+		nDbl = 0;
+		nInt = 0;
+		nBoo = 0;
+	}
+	nBytes = getbinarybufferlengthFMU(nDbl, nInt, nBoo);
+	if ( nBytes < 0 || bufLen < nBytes ){
+		fprintf(stderr, "Error: Buffer too small in assembleBinaryBufferFMU.\n");
+		return -1;
+	}
+	putint32FMU(p,      BINARYVERSION);
+	putint32FMU(p + 4,  flag);
+	putint32FMU(p + 8,  nDbl);
+	putint32FMU(p + 12, nInt);
+	putint32FMU(p + 16, nBoo);
+	putint32FMU(p + 20, 0);
+	putdoubleFMU(p + 24, curSimTim);
+	p += BINARY_HEADER_LENGTH;
+	for(i = 0; i < nDbl; i++, p += 8)
+		putdoubleFMU(p, dblVal[i]);
+	for(i = 0; i < nInt; i++, p += 4)
+		putint32FMU(p, intVal[i]);
+	for(i = 0; i < nBoo; i++, p += 4)
+		putint32FMU(p, booVal[i]);
+	return (int)(p - (unsigned char*) buffer);
+}
+
+/////////////////////////////////////////////////////////////////
+/// Disassembles the header of a binary message.
+///
+///\param buffer The buffer that contains at least \c BINARY_HEADER_LENGTH bytes.
+///\param version The version number of the server.
+///\param fla The communication flag.
+///\param nDbl The number of double values received.
+///\param nInt The number of integer values received.
+///\param nBoo The number of boolean values received.
+///\param curSimTim The current simulation time in seconds.
+///\return 0 if no error occurred.
+int disassembleBinaryHeaderFMU(const char* buffer,
+	int *version,
+	int *fla,
+	int *nDbl, int *nInt, int *nBoo,
+	double *curSimTim)
+{
+	const unsigned char *p = (const unsigned char*) buffer;
+	*version = getint32FMU(p);
+	if ( *version != BINARYVERSION ){
+		fprintf(stderr, "Error: Received binary message with version %d, expected %d.\n",
+			*version, BINARYVERSION);
+		return EXIT_FAILURE;
+	}
+	*fla  = getint32FMU(p + 4);
+	*nDbl = getint32FMU(p + 8);
+	*nInt = getint32FMU(p + 12);
+	*nBoo = getint32FMU(p + 16);
+	*curSimTim = getdoubleFMU(p + 24);
+	if ( *nDbl < 0 || *nInt < 0 || *nBoo < 0 ){
+		fprintf(stderr, "Error: Received binary message with negative number of values.\n");
+		return EXIT_FAILURE;
+	}
+	return 0;
+}
+
+/////////////////////////////////////////////////////////////////
+/// Disassembles the values of a binary message.
+///
+///\param buffer The buffer that contains the values that follow the header.
+///\param nDbl The number of double values received.
+///\param nInt The number of integer values received.
+///\param nBoo The number of boolean values received.
+///\param dblVal The array that stores the double values.
+///\param intVal The array that stores the integer values.
+///\param booVal The array that stores the boolean values.
+void disassembleBinaryBufferFMU(const char* buffer,
+	const int nDbl, const int nInt, const int nBoo,
+	double dblVal[], int intVal[], int booVal[])
+{
+	int i;
+	const unsigned char *p = (const unsigned char*) buffer;
+	for(i = 0; i < nDbl; i++, p += 8)
+		dblVal[i] = getdoubleFMU(p);
+	for(i = 0; i < nInt; i++, p += 4)
+		intVal[i] = getint32FMU(p);
+	for(i = 0; i < nBoo; i++, p += 4)
+		booVal[i] = getint32FMU(p);
+}
+
+/////////////////////////////////////////////////////////////////
+/// Reads a given number of bytes from the socket.
+///
+///\param sockfd The socket file descripter.
+///\param buffer The buffer into which the bytes will be written.
+///\param nBytes The number of bytes to read.
+///\return The number of bytes read, or a value smaller than 1 if an error occurred.
+int readbytesfromsocketFMU(const int *sockfd, char *buffer, const int nBytes){
+	int retVal;
+	int nRea = 0;
+	while ( nRea < nBytes ){
+#ifdef _MSC_VER
+		retVal = recv(*sockfd, &buffer[nRea], nBytes - nRea, 0);
+#else
+		retVal = read(*sockfd, &buffer[nRea], nBytes - nRea);
+#endif
+		if ( retVal <= 0 )
+			return ( retVal == 0 ) ? -1 : retVal;
+		nRea += retVal;
+	}
+	return nRea;
+}
+
+/////////////////////////////////////////////////////////////////
+/// Writes a given number of bytes to the socket.
+///
+///\param sockfd The socket file descripter.
+///\param buffer The buffer that contains the bytes.
+///\param nBytes The number of bytes to write.
+///\return The number of bytes written, or a negative value if an error occurred.
+int writebytestosocketFMU(const int *sockfd, const char *buffer, const int nBytes){
+	int retVal;
+	int nWri = 0;
+	while ( nWri < nBytes ){
+#ifdef _MSC_VER
+		retVal = send(*sockfd, &buffer[nWri], nBytes - nWri, 0);
+#else
+		retVal = write(*sockfd, &buffer[nWri], nBytes - nWri);
+#endif
+		if ( retVal < 0 )
+			return retVal;
+		nWri += retVal;
+	}
+	return nWri;
+}
+
 /////////////////////////////////////////////////////////////////
 /// Writes data to the socket.
 ///
 /// Clients can call this method to write data to the socket.
 ///\param sockfd Socket file descripter
+///\param sockBuf The buffers of the socket connection.
 ///\param flaWri Communication flag to write to the socket stream.
 ///\param nDblWri Number of double values to write.
 ///\param nIntWri Number of integer values to write.
@@ -346,23 +670,24 @@ int disassembleBufferFMU(const char* buffer,
 ///\sa int establishclientsocket(uint16_t *portNo)
 ///\return The exit value of \c send, or a negative value if an error occured.
 int writetosocketFMU(const int *sockfd,
+	SocketBuffers *sockBuf,
 	const int *flaWri,
 	const int *nDblWri, const int *nIntWri, const int *nBooWri,
 	double *curSimTim,
 	double dblValWri[], int intValWri[], int booValWri[])
 {
 	int retVal;
-	// buffer used to exchange data
-	char *buffer;
-	int bufLen = REQUIRED_WRITE_LENGTH;
-	// FMU Export - needs to modify bufLen as written below so that writetosocket can be used
-	// as a standalone function in the FMI functions.
-	if ( REQUIRED_WRITE_LENGTH < 1 ){
-		REQUIRED_WRITE_LENGTH = getrequiredbufferlengthFMU(*nDblWri, *nIntWri, *nBooWri);
-		if ( REQUIRED_WRITE_LENGTH <= 0 ){
-			return -1;
-		}
-		bufLen = REQUIRED_WRITE_LENGTH;
+	int nBytes = 0;
+	// FMU Export - the required length is computed in every call so that writetosocket
+	// can be used as a standalone function in the FMI functions.
+	const int reqLen = getrequiredbufferlengthFMU(*nDblWri, *nIntWri, *nBooWri);
+	if ( reqLen <= 0 ){
+		return -1;
+	}
+	// A shared memory channel does not need a buffer or a socket.
+	if ( sockBuf->shm != NULL ){
+		return writeshmFMU(sockBuf, *flaWri, *nDblWri, *nIntWri, *nBooWri,
+			*curSimTim, dblValWri);
 	}
 #ifdef NDEBUG
 	if (f1 == NULL) // open file
@@ -388,13 +713,13 @@ int writetosocketFMU(const int *sockfd,
 	}
 
 	/////////////////////////////////////////////////////
-	// allocate storage for buffer
+	// make sure that the buffer is large enough. It is only
+	// allocated in the first call, and reused afterwards.
 #ifdef NDEBUG
 	fprintf(f1, "Assembling buffer.\n", *sockfd);
 #endif
 
-	buffer = malloc(bufLen);
-	if (buffer == NULL) {
+	if (reservebufferFMU(&(sockBuf->writeBuffer), &(sockBuf->writeLength), reqLen) != 0) {
 		perror("malloc failed in writetosocketFMU.");
 #ifdef NDEBUG
 		fprintf(f1, "malloc failed in writetosocketFMU.\n");
@@ -402,11 +727,23 @@ int writetosocketFMU(const int *sockfd,
 		return -1;
 	}
 	//////////////////////////////////////////////////////
-	// copy arguments to buffer
-	retVal = assembleBufferFMU(*flaWri, *nDblWri, *nIntWri, *nBooWri,
-		*curSimTim,
-		dblValWri, intValWri, booValWri,
-		&buffer, &bufLen);
+	// copy arguments to buffer. Use the binary format only if
+	// the server sent its messages in this format.
+	if ( sockBuf->serverVersion == BINARYVERSION ){
+		nBytes = assembleBinaryBufferFMU(*flaWri, *nDblWri, *nIntWri, *nBooWri,
+			*curSimTim,
+			dblValWri, intValWri, booValWri,
+			sockBuf->writeBuffer, sockBuf->writeLength);
+		retVal = ( nBytes < 0 ) ? nBytes : 0;
+	}
+	else{
+		retVal = assembleBufferFMU(*flaWri, *nDblWri, *nIntWri, *nBooWri,
+			*curSimTim,
+			dblValWri, intValWri, booValWri,
+			&(sockBuf->writeBuffer), &(sockBuf->writeLength));
+		if ( retVal == 0 )
+			nBytes = strlen(sockBuf->writeBuffer);
+	}
 
 	if (retVal != 0 ){
 		fprintf(stderr, "Error: Failed to allocate memory for buffer before writing to socket.\n");
@@ -418,21 +755,17 @@ int writetosocketFMU(const int *sockfd,
 		fprintf(f1, "       Message: %s\n",  strerror(errno));
 		fflush(f1);
 #endif
-		free(buffer);
 		return -1; // return a negative value in case of an error
 	}
 	//////////////////////////////////////////////////////
 	// write to socket
 #ifdef NDEBUG
 	fprintf(f1, "Write to socket with fd = %d\n", *sockfd);
-	fprintf(f1, "Buffer        = %s\n", buffer);
+	if ( sockBuf->serverVersion != BINARYVERSION )
+		fprintf(f1, "Buffer        = %s\n", sockBuf->writeBuffer);
 #endif
 
-#ifdef _MSC_VER
-	retVal = send(*sockfd,buffer,strlen(buffer), 0);
-#else
-	retVal = write(*sockfd,buffer,strlen(buffer));
-#endif
+	retVal = writebytestosocketFMU(sockfd, sockBuf->writeBuffer, nBytes);
 
 #ifdef NDEBUG
 	if (retVal >= 0)
@@ -450,18 +783,18 @@ int writetosocketFMU(const int *sockfd,
 		fflush(f1);
 #endif
 	}
-	free(buffer);
 	return retVal;
 
 }
 /////////////////////////////////////////////////////////////////
 /// Returns the required socket buffer length by reading from
 /// the socket how many data it contains.
-/// This method also set the global variable \c SERVER_VERSION
+/// This method also sets the version number of the server.
 ///
 ///\param sockfd Socket file descriptor
+///\param version The version number of the server.
 ///\return nCha The nunber of characters needed to store the buffer
-int getRequiredReadBufferLengthFMU(const int *sockfd){
+int getRequiredReadBufferLengthFMU(const int *sockfd, int *version){
 	int retVal;
 	char buffer[HEADER_LENGTH];
 	const int base = 10;
@@ -483,8 +816,17 @@ int getRequiredReadBufferLengthFMU(const int *sockfd){
 		perror("Failed to peek at socket.");
 		return retVal;
 	}
+	// A server that supports the binary format sends the version
+	// as a binary integer, hence the first byte is not a digit.
+	// The header may not have arrived in full, and a peek does not
+	// wait for it on all sockets. Hence only reserve the header, which
+	// readbinaryfromsocketFMU reads and checks.
+	if ( buffer[0] == BINARYVERSION ){
+		*version = BINARYVERSION;
+		return BINARY_HEADER_LENGTH;
+	}
 	retVal =  disassembleHeaderBufferFMU(buffer, &endptr, base,
-		&fla, &nDbl, &nInt, &nBoo);
+		version, &fla, &nDbl, &nInt, &nBoo);
 	if ( retVal < 0 ){
 		perror("Failed to disassemble header buffer.");
 		return retVal;
@@ -521,22 +863,29 @@ int getrequiredbufferlengthFMU(const int nDbl, const int nInt, const int nBoo){
 /// Clients can call this method to exchange data through the socket.
 ///
 ///\param sockfd Socket file descripter
+///\param sockBuf The buffers of the socket connection.
 ///\param flaRea Communication flag read from the socket stream.
-///\param nDblRea Number of double values to read.
-///\param nIntRea Number of integer values to read.
-///\param nBooRea Number of boolean values to read.
+///\param nDblRea Number of double values read. On entry, the length of \c dblValRea.
+///\param nIntRea Number of integer values read. On entry, the length of \c intValRea.
+///\param nBooRea Number of boolean values read. On entry, the length of \c booValRea.
 ///\param curSimTim Current simulation time in seconds read from socket.
 ///\param dblValRea Double values read from socket.
 ///\param intValRea Integer values read from socket.
 ///\param boolValRea Boolean values read from socket.
 ///\sa int establishclientsocket(uint16_t *portNo)
-int readfromsocketFMU(const int *sockfd, int *flaRea,
+int readfromsocketFMU(const int *sockfd, SocketBuffers *sockBuf,
+	int *flaRea,
 	int *nDblRea, int *nIntRea, int *nBooRea,
 	double *curSimTim,
 	double dblValRea[], int intValRea[], int booValRea[])
 {
 	int retVal;
-	char *inpBuf;
+	int reqLen;
+	// A shared memory channel does not need a buffer or a socket.
+	if ( sockBuf->shm != NULL ){
+		return readshmFMU(sockBuf, flaRea, nDblRea, nIntRea, nBooRea,
+			curSimTim, dblValRea);
+	}
 	/////////////////////////////////////////////////////
 	// make sure that the socketFD is valid
 	if (*sockfd < 0 ){
@@ -552,27 +901,34 @@ int readfromsocketFMU(const int *sockfd, int *flaRea,
 
 	// In the first call, set the socket buffer length
 	// This is done here since we know how many data we need to read.
-	if ( REQUIRED_READ_LENGTH < 1 ){
+	if ( sockBuf->readLength < 1 ){
 		// Peak into the socket message to see how many data we need to read
 		// This is required to assign enough storage for the buffer.
-		// This call also sets the version number SERVER_VERSION
-		// that is sent by the server.
-		REQUIRED_READ_LENGTH = getRequiredReadBufferLengthFMU(sockfd);
-		if ( REQUIRED_READ_LENGTH <= 0 )
+		// This call also sets the version number that is sent by the server.
+		reqLen = getRequiredReadBufferLengthFMU(sockfd, &(sockBuf->serverVersion));
+		if ( reqLen <= 0 )
 			return -1;
-	}
-	// Increase the buffer that is used to store the data
-	inpBuf = (char*) malloc(REQUIRED_READ_LENGTH * sizeof(char));
-	if (inpBuf == NULL) {
-		perror("malloc failed in readfromsocketFMU.");
+		// Allocate the buffer that is used to store the data.
+		// It is reused in the following calls.
+		if (reservebufferFMU(&(sockBuf->readBuffer), &(sockBuf->readLength), reqLen) != 0) {
+			perror("malloc failed in readfromsocketFMU.");
 #ifdef NDEBUG
-		fprintf(f1, "malloc failed in readfromsocketFMU.\n");
+			fprintf(f1, "malloc failed in readfromsocketFMU.\n");
 #endif
-		free(inpBuf);
-		return -1;
+			return -1;
+		}
+	}
+	if ( sockBuf->serverVersion == BINARYVERSION ){
+		return readbinaryfromsocketFMU(sockfd,
+			&(sockBuf->readBuffer), &(sockBuf->readLength),
+			flaRea,
+			nDblRea, nIntRea, nBooRea,
+			curSimTim,
+			dblValRea, intValRea, booValRea);
 	}
-	memset(inpBuf, '\0', REQUIRED_READ_LENGTH);
-	retVal = readbufferfromsocketFMU(sockfd, inpBuf, &REQUIRED_READ_LENGTH);
+	retVal = readbufferfromsocketFMU(sockfd,
+		&(sockBuf->readBuffer), &(sockBuf->readLength),
+		sockBuf->serverVersion);
 	if (retVal < 0){
 #ifdef NDEBUG
 #ifdef _MSC_VER
@@ -582,12 +938,11 @@ int readfromsocketFMU(const int *sockfd, int *flaRea,
 #endif
 		fflush(f1);
 #endif
-		free(inpBuf);
 		return retVal;
 	}
 	//////////////////////////////////////////////////////
 	// disassemble buffer and store values in function argument
-	retVal = disassembleBufferFMU(inpBuf,
+	retVal = disassembleBufferFMU(sockBuf->readBuffer,
 		flaRea,
 		nDblRea, nIntRea, nBooRea,
 		curSimTim,
@@ -595,21 +950,128 @@ int readfromsocketFMU(const int *sockfd, int *flaRea,
 #ifdef NDEBUG
 	fprintf(f1, "Disassembled buffer.\n");
 #endif
-    free(inpBuf);
     return retVal;
 }
 
+/////////////////////////////////////////////////////////////////
+/// Waits until a message can be read without blocking.
+///
+/// A connection that the other side closed can be read without
+/// blocking as well, since the read then returns an error at once.
+///
+///\param sockfd The socket file descriptor.
+///\param sockBuf The buffers of the connection.
+///\param timeout The maximum time to wait in milliseconds.
+///\return 1 if a message can be read, 0 if none arrived within \c timeout,
+///        or -1 if an error occurred.
+int waitforsocketFMU(const int *sockfd, SocketBuffers *sockBuf, const int timeout){
+#ifdef _MSC_VER
+	fd_set fds;
+	struct timeval tv;
+#else
+	struct pollfd pfd;
+#endif
+	int retVal;
+	if ( sockBuf->shm != NULL )
+		return waitshmFMU(sockBuf, timeout);
+	if ( *sockfd < 0 )
+		return -1;
+#ifdef _MSC_VER
+	FD_ZERO(&fds);
+	FD_SET(*sockfd, &fds);
+	tv.tv_sec = timeout / 1000;
+	tv.tv_usec = (timeout % 1000) * 1000;
+	retVal = select(*sockfd + 1, &fds, NULL, NULL, &tv);
+#else
+	pfd.fd = *sockfd;
+	pfd.events = POLLIN;
+	pfd.revents = 0;
+	do {
+		retVal = poll(&pfd, 1, timeout);
+	} while ( retVal < 0 && errno == EINTR );
+#endif
+	if ( retVal < 0 )
+		return -1;
+	return ( retVal > 0 ) ? 1 : 0;
+}
+
+/////////////////////////////////////////////////////////////////
+/// Reads a binary message from the socket.
+///
+/// This method is called by \c readfromsocketFMU if the server
+/// uses the binary format.
+///
+///\param sockfd Socket file descripter
+///\param buffer The buffer used to read the message. It will be
+///              reallocated if it is too short.
+///\param bufLen The buffer length prior and after the call.
+///\param flaRea Communication flag read from the socket stream.
+///\param nDblRea Number of double values read. On entry, the length of \c dblValRea.
+///\param nIntRea Number of integer values read. On entry, the length of \c intValRea.
+///\param nBooRea Number of boolean values read. On entry, the length of \c booValRea.
+///\param curSimTim Current simulation time in seconds read from socket.
+///\param dblValRea Double values read from socket.
+///\param intValRea Integer values read from socket.
+///\param boolValRea Boolean values read from socket.
+///\return 0 if no error occurred.
+int readbinaryfromsocketFMU(const int *sockfd, char **buffer, int *bufLen,
+	int *flaRea,
+	int *nDblRea, int *nIntRea, int *nBooRea,
+	double *curSimTim,
+	double dblValRea[], int intValRea[], int booValRea[])
+{
+	int retVal;
+	int nBytes;
+	int version;
+	const int nDblCap = *nDblRea;
+	const int nIntCap = *nIntRea;
+	const int nBooCap = *nBooRea;
+	if (reservebufferFMU(buffer, bufLen, BINARY_HEADER_LENGTH) != 0)
+		return -1;
+	retVal = readbytesfromsocketFMU(sockfd, *buffer, BINARY_HEADER_LENGTH);
+	if ( retVal < 1 )
+		return -1;
+	retVal = disassembleBinaryHeaderFMU(*buffer, &version, flaRea,
+		nDblRea, nIntRea, nBooRea, curSimTim);
+	if ( retVal != 0 )
+		return retVal;
+	if ( *nDblRea > nDblCap || *nIntRea > nIntCap || *nBooRea > nBooCap ){
+		fprintf(stderr, "Error: Received %d doubles, %d integers and %d booleans,\n", *nDblRea, *nIntRea, *nBooRea);
+		fprintf(stderr, "       but can store at most %d, %d and %d.\n", nDblCap, nIntCap, nBooCap);
+		return -1;
+	}
+	nBytes = getbinarybufferlengthFMU(*nDblRea, *nIntRea, *nBooRea);
+	if ( nBytes < 0 )
+		return -1;
+	nBytes -= BINARY_HEADER_LENGTH;
+	if ( nBytes > 0 ){
+		if (reservebufferFMU(buffer, bufLen, nBytes) != 0)
+			return -1;
+		retVal = readbytesfromsocketFMU(sockfd, *buffer, nBytes);
+		if ( retVal < 1 )
+			return -1;
+		disassembleBinaryBufferFMU(*buffer, *nDblRea, *nIntRea, *nBooRea,
+			dblValRea, intValRea, booValRea);
+	}
+#ifdef NDEBUG
+	fprintf(f1, "Disassembled binary buffer.\n");
+#endif
+	return 0;
+}
+
 /////////////////////////////////////////////////////////////////
 /// Reads a character buffer from the socket.
 ///
 /// This method is called by \c readfromsocket.
 ///
 ///\param sockfd The socket file descripter.
-///\param buffer The buffer into which the values will be written.
-///\param bufLen The buffer length prior to the call.
+///\param buffer The buffer into which the values will be written. It will
+///              be reallocated if it is too short.
+///\param bufLen The buffer length prior and after the call.
+///\param version The version number of the server.
 ///\return The exit value of the \c read command.
 int readbufferfromsocketFMU(const int *sockfd, 
-	char *buffer, int *bufLen){
+	char **buffer, int *bufLen, const int version){
 		int retVal;
 		int reachedEnd = 0;
 		// The number 8192 needs to be the same as in Server.java
@@ -617,16 +1079,19 @@ int readbufferfromsocketFMU(const int *sockfd,
 		int chaSta = 0;
 		// Loop until we read the '\n' character
 		do {
+			// Make sure that a full read and the terminating character fit into the buffer
+			if (reservebufferFMU(buffer, bufLen, chaSta + maxChaRea + 1) != 0)
+				return -1;
 #ifdef _MSC_VER
 			// MSG_WAITALL is not in the winsock2.h file, at least not on my system...
 #define MSG_WAITALL 0x8 /* do not complete until packet is completely filled */
-			retVal = recv(*sockfd, buffer, *bufLen, 0);
+			retVal = recv(*sockfd, &(*buffer)[chaSta], maxChaRea, 0);
 #else
-			retVal = read(*sockfd, &buffer[chaSta], maxChaRea);
+			retVal = read(*sockfd, &(*buffer)[chaSta], maxChaRea);
 #endif
 
 #ifdef NDEBUG
-			fprintf(f1, "In readbufferfromsocketFMU: Read %d chars, maximum is %d.\n", retVal, REQUIRED_READ_LENGTH);
+			fprintf(f1, "In readbufferfromsocketFMU: Read %d chars, maximum is %d.\n", retVal, *bufLen);
 #endif
 			//FMU export - retVal stderr needed  to be deactivated to avoid the server to close too early
 			if ( retVal == 0 ){
@@ -639,10 +1104,12 @@ int readbufferfromsocketFMU(const int *sockfd,
 				return retVal;
 			}
 			
+			// Terminate the string for disassembleBufferFMU
+			(*buffer)[chaSta + retVal] = '\0';
 			// Check if we received '\n', in which case we finish the reading
-			if ( NULL == memchr(&buffer[chaSta], '\n', retVal) ){
+			if ( NULL == memchr(&(*buffer)[chaSta], '\n', retVal) ){
 				chaSta += retVal;
-				if (SERVER_VERSION == 1){
+				if (version == 1){
 					fprintf(stderr, "Error: This version of the socket interface cannot process such large data.\n");
 #ifdef NDEBUG
 					fprintf(f1, "Error: This version of the socket interface cannot process such large data.\n");
@@ -661,14 +1128,15 @@ int readbufferfromsocketFMU(const int *sockfd,
 ///
 /// Clients can call this method to exchange data through the socket.
 ///\param sockfd Socket file descripter
+///\param sockBuf The buffers of the socket connection.
 ///\param flaWri Communication flag to write to the socket stream.
 ///\param flaRea Communication flag read from the socket stream.
 ///\param nDblWri Number of double values to write.
 ///\param nIntWri Number of integer values to write.
 ///\param nBooWri Number of boolean values to write.
-///\param nDblRea Number of double values to read.
-///\param nIntRea Number of integer values to read.
-///\param nBooRea Number of boolean values to read.
+///\param nDblRea Number of double values read. On entry, the length of \c dblValRea.
+///\param nIntRea Number of integer values read. On entry, the length of \c intValRea.
+///\param nBooRea Number of boolean values read. On entry, the length of \c booValRea.
 ///\param simTimWri Current simulation time in seconds to write.
 ///\param dblValWri Double values to write.
 ///\param intValWri Integer values to write.
@@ -680,6 +1148,7 @@ int readbufferfromsocketFMU(const int *sockfd,
 ///\sa int establishclientsocket(uint16_t *portNo)
 ///\return The exit value of \c send or \c read, or a negative value if an error occured.
 int exchangewithsocketFMUex(const int *sockfd,
+	SocketBuffers *sockBuf,
 	const int *flaWri, int *flaRea,
 	const int *nDblWri, const int *nIntWri, const int *nBooWri,
 	int *nDblRea, int *nIntRea, int *nBooRea,
@@ -701,19 +1170,7 @@ int exchangewithsocketFMUex(const int *sockfd,
 		fprintf(f1, "Writing to socket at time = %e\n", *simTimWri);
 #endif
 
-		// In the first call, set the socket buffer length
-		// This is done here since we know how many data we need to send.
-		if ( REQUIRED_WRITE_LENGTH < 1 ){
-			REQUIRED_WRITE_LENGTH = getrequiredbufferlengthFMU(*nDblWri, *nIntWri, *nBooWri);
-			if ( REQUIRED_WRITE_LENGTH <= 0 )
-				return -1;
-			// Increase the buffer length for the socket
-			//   retVal = setrequiredbufferlength(*sockfd, REQUIRED_WRITE_LENGTH, SO_SNDBUF);
-			//   if ( retVal != 0 )
-			//     return retVal;
-		}
-
-		retVal = writetosocketFMU(sockfd, flaWri,
+		retVal = writetosocketFMU(sockfd, sockBuf, flaWri,
 			nDblWri, nIntWri, nBooWri,
 			simTimWri,
 			dblValWri, intValWri, booValWri);
@@ -722,7 +1179,7 @@ int exchangewithsocketFMUex(const int *sockfd,
 			fprintf(f1, "Reading from socket.\n");
 			fflush(f1);
 #endif
-			retVal = readfromsocketFMU(sockfd, flaRea,
+			retVal = readfromsocketFMU(sockfd, sockBuf, flaRea,
 				nDblRea, nIntRea, nBooRea,
 				simTimRea,
 				dblValRea, intValRea, booValRea);
@@ -739,10 +1196,11 @@ int exchangewithsocketFMUex(const int *sockfd,
 ///
 /// Clients can call this method to exchange data through the socket.
 ///\param sockfd Socket file descripter
+///\param sockBuf The buffers of the socket connection.
 ///\param flaWri Communication flag to write to the socket stream.
 ///\param flaRea Communication flag read from the socket stream.
 ///\param nDblWri Number of double values to write.
-///\param nDblRea Number of double values to read.
+///\param nDblRea Number of double values read. On entry, the length of \c dblValRea.
 ///\param simTimWri Current simulation time in seconds to write.
 ///\param dblValWri Double values to write.
 ///\param simTimRea Current simulation time in seconds read from socket.
@@ -750,6 +1208,7 @@ int exchangewithsocketFMUex(const int *sockfd,
 ///\sa int establishclientsocket(uint16_t *portNo)
 ///\return The exit value of \c send or \c read, or a negative value if an error occured.
 int exchangedoubleswithsocketFMUex(const int *sockfd,
+	SocketBuffers *sockBuf,
 	const int *flaWri, int *flaRea,
 	const int *nDblWri,
 	int *nDblRea,
@@ -762,7 +1221,7 @@ int exchangedoubleswithsocketFMUex(const int *sockfd,
 		int nBooRea = 0;
 		int intValRea[1]; // allocate array of non-zero size
 		int booValRea[1]; // allocate array of non-zero size
-		return exchangewithsocketFMUex(sockfd,
+		return exchangewithsocketFMUex(sockfd, sockBuf,
 			flaWri, flaRea,
 			nDblWri, &zer, &zer,
 			nDblRea, &nIntRea, &nBooRea,
@@ -772,6 +1231,533 @@ int exchangedoubleswithsocketFMUex(const int *sockfd,
 			dblValRea, intValRea, booValRea);
 }
 
+#ifdef __linux__
+/////////////////////////////////////////////////////////////////
+// Shared memory transport.
+//
+// The FMU and EnergyPlus map the same file. Each side writes to its
+// own single-producer/single-consumer ring and reads from the ring
+// of the other side. The values are copied into the mapped memory,
+// hence no system call is needed to exchange them. A futex is only
+// used to wake up a side that waits for a message.
+
+/// Magic number at the beginning of the shared memory file
+#define SHM_MAGIC 0x45504D53
+/// Number of messages in each ring
+#define SHM_RING_SLOTS 4
+/// Number of times a side polls before it waits on the futex
+#define SHM_SPIN_COUNT 4000
+/// Time in milliseconds after which a waiting side checks whether the other side is alive
+#define SHM_WAIT_MS 100
+/// Alignment of the rings and messages, which is the size of a cache line
+#define SHM_ALIGN 64
+
+/// Ring written by one side and read by the other side.
+/// Producer and consumer counters are on separate cache lines.
+typedef struct ShmRing {
+	unsigned int head;        // number of messages written by the producer
+	unsigned int headWaiting; // set if the consumer waits for head to change
+	char padHead[SHM_ALIGN - 2*sizeof(unsigned int)];
+	unsigned int tail;        // number of messages read by the consumer
+	unsigned int tailWaiting; // set if the producer waits for tail to change
+	char padTail[SHM_ALIGN - 2*sizeof(unsigned int)];
+} ShmRing;
+
+/// Message in a ring
+typedef struct ShmMessage {
+	int flag;
+	int nDbl;
+	double curSimTim;
+	double dblVal[1];
+} ShmMessage;
+
+/// Header of the shared memory file, followed by the messages of both rings
+struct ShmChannel {
+	int magic;
+	int version;
+	int nDblCap;              // maximum number of doubles in a message
+	int slotLength;           // size of a message in bytes
+	unsigned int connected;   // set by EnergyPlus once it mapped the file
+	int closed[2];            // set by a side once it closed the channel
+	int pid[2];               // process id of each side
+	char padHeader[SHM_ALIGN - 9*sizeof(int)];
+	ShmRing ring[2];          // ring[SHM_ROLE_FMU] is written by the FMU
+};
+
+/////////////////////////////////////////////////////////////////
+/// Returns the size of the shared memory file.
+///
+///\param nDblCap The maximum number of doubles in a message.
+///\param slotLength The size of a message in bytes.
+///\return The size of the file in bytes.
+static int getshmlengthFMU(const int nDblCap, int *slotLength){
+	*slotLength = (int) (offsetof(ShmMessage, dblVal) + sizeof(double) * (nDblCap > 0 ? nDblCap : 1));
+	*slotLength = ((*slotLength + SHM_ALIGN - 1) / SHM_ALIGN) * SHM_ALIGN;
+	return (int) sizeof(struct ShmChannel) + 2 * SHM_RING_SLOTS * (*slotLength);
+}
+
+/////////////////////////////////////////////////////////////////
+/// Returns a message of a ring.
+///
+///\param ch The shared memory channel.
+///\param role The role of the side that writes the ring.
+///\param idx The counter of the message.
+///\return A pointer to the message.
+static ShmMessage* getshmmessageFMU(struct ShmChannel *ch, const int role, const unsigned int idx){
+	return (ShmMessage*) ((char*) ch + sizeof(struct ShmChannel)
+		+ (role * SHM_RING_SLOTS + (idx % SHM_RING_SLOTS)) * ch->slotLength);
+}
+
+/////////////////////////////////////////////////////////////////
+/// Waits on a futex in shared memory as long as it has the value \c val.
+///
+///\param addr The futex.
+///\param val The value.
+///\param ms The maximum time to wait in milliseconds.
+static void futexwaitFMU(unsigned int *addr, const unsigned int val, const int ms){
+	struct timespec ts;
+	ts.tv_sec  = ms / 1000;
+	ts.tv_nsec = (ms % 1000) * 1000000L;
+	syscall(SYS_futex, addr, FUTEX_WAIT, val, &ts, NULL, 0);
+}
+
+/////////////////////////////////////////////////////////////////
+/// Wakes up all processes that wait on a futex in shared memory.
+///
+///\param addr The futex.
+static void futexwakeFMU(unsigned int *addr){
+	syscall(SYS_futex, addr, FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+}
+
+/////////////////////////////////////////////////////////////////
+/// Checks whether a process exited.
+///
+/// A child of the calling process that exited is a zombie until it is
+/// reaped, and \c kill does not fail for it. Hence, children are checked
+/// with \c waitid, which leaves them to be reaped by the caller.
+///
+///\param pid The process id.
+///\return 1 if the process exited, otherwise 0.
+static int shmprocessgoneFMU(const int pid){
+	siginfo_t info;
+	info.si_pid = 0;
+	if ( waitid(P_PID, (id_t) pid, &info, WEXITED | WNOHANG | WNOWAIT) == 0 )
+		return ( info.si_pid == pid );
+	return ( kill(pid, 0) != 0 && errno == ESRCH );
+}
+
+/////////////////////////////////////////////////////////////////
+/// Waits until the value at \c addr differs from \c val.
+///
+/// The function first polls, and then waits on the futex. While it
+/// waits, it checks whether the other side closed the channel or died.
+///
+///\param ch The shared memory channel.
+///\param peer The role of the other side.
+///\param addr The counter to wait for.
+///\param waiting The flag that tells the other side to wake us up.
+///\param val The current value of the counter.
+///\return 0 if the counter changed, or -1 if the other side is gone.
+static int shmwaitFMU(struct ShmChannel *ch, const int peer,
+	unsigned int *addr, unsigned int *waiting, const unsigned int val){
+	int i;
+	for(i = 0; i < SHM_SPIN_COUNT; i++){
+		if ( __atomic_load_n(addr, __ATOMIC_ACQUIRE) != val )
+			return 0;
+	}
+	for(;;){
+		__atomic_store_n(waiting, 1, __ATOMIC_SEQ_CST);
+		if ( __atomic_load_n(addr, __ATOMIC_SEQ_CST) == val )
+			futexwaitFMU(addr, val, SHM_WAIT_MS);
+		__atomic_store_n(waiting, 0, __ATOMIC_SEQ_CST);
+		if ( __atomic_load_n(addr, __ATOMIC_ACQUIRE) != val )
+			return 0;
+		if ( __atomic_load_n(&ch->closed[peer], __ATOMIC_ACQUIRE) )
+			return -1;
+		if ( ch->pid[peer] > 0 && shmprocessgoneFMU(ch->pid[peer]) ){
+			fprintf(stderr, "Error: Process %d of the shared memory channel is gone.\n", ch->pid[peer]);
+			return -1;
+		}
+	}
+}
+
+/////////////////////////////////////////////////////////////////
+/// Maps a shared memory file.
+///
+///\param fd The file descriptor.
+///\param shmLength The size of the file in bytes.
+///\return A pointer to the mapped file, or NULL if an error occurred.
+static struct ShmChannel* mapshmFMU(const int fd, const int shmLength){
+	void *addr = mmap(NULL, shmLength, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if ( addr == MAP_FAILED ){
+		perror("Failed to map shared memory file.");
+		return NULL;
+	}
+	return (struct ShmChannel*) addr;
+}
+
+/////////////////////////////////////////////////////////////////
+/// Creates the shared memory file and maps it as the FMU side.
+///
+///\param sockBuf The buffers of the connection, which will hold the mapping.
+///\param path The path of the shared memory file.
+///\param nDblCap The maximum number of doubles in a message.
+///\return 0 if no error occurred, or -1 if the transport is not available.
+int establishshmserverFMU(SocketBuffers *sockBuf, const char *path, const int nDblCap){
+	int fd;
+	int slotLength;
+	struct ShmChannel *ch;
+	const int shmLength = getshmlengthFMU(nDblCap, &slotLength);
+	fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0600);
+	if ( fd < 0 ){
+		perror("Failed to create shared memory file.");
+		return -1;
+	}
+	if ( ftruncate(fd, shmLength) != 0 ){
+		perror("Failed to set size of shared memory file.");
+		close(fd);
+		return -1;
+	}
+	ch = mapshmFMU(fd, shmLength);
+	close(fd);
+	if ( ch == NULL )
+		return -1;
+	memset(ch, 0, shmLength);
+	ch->version = BINARYVERSION;
+	ch->nDblCap = nDblCap;
+	ch->slotLength = slotLength;
+	ch->pid[SHM_ROLE_FMU] = getpid();
+	__atomic_store_n(&ch->magic, SHM_MAGIC, __ATOMIC_RELEASE);
+	sockBuf->shm = ch;
+	sockBuf->shmLength = shmLength;
+	sockBuf->shmRole = SHM_ROLE_FMU;
+	return 0;
+}
+
+/////////////////////////////////////////////////////////////////
+/// Waits until EnergyPlus mapped the shared memory file.
+///
+///\param sockBuf The buffers of the connection.
+///\param pid The process id of EnergyPlus, or 0 if it is not known.
+///\param timeout The maximum time to wait in milliseconds.
+///\return 0 if no error occurred, or -1 if EnergyPlus exited or did not
+///        connect within \c timeout.
+int acceptshmclientFMU(SocketBuffers *sockBuf, const int pid, const int timeout){
+	struct ShmChannel *ch = sockBuf->shm;
+	struct timespec now;
+	struct timespec start;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	while ( __atomic_load_n(&ch->connected, __ATOMIC_ACQUIRE) == 0 ){
+		if ( pid > 0 && shmprocessgoneFMU(pid) ){
+			fprintf(stderr, "Error: Process %d exited before it connected to the shared memory channel.\n", pid);
+			return -1;
+		}
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		if ( (now.tv_sec - start.tv_sec) * 1000 + (now.tv_nsec - start.tv_nsec) / 1000000 >= timeout ){
+			fprintf(stderr, "Error: EnergyPlus did not connect to the shared memory channel within %d ms.\n",
+				timeout);
+			return -1;
+		}
+		futexwaitFMU(&ch->connected, 0, SHM_WAIT_MS);
+	}
+	return 0;
+}
+
+/////////////////////////////////////////////////////////////////
+/// Maps the shared memory file as the EnergyPlus side.
+///
+///\param sockBuf The buffers of the connection, which will hold the mapping.
+///\param path The path of the shared memory file.
+///\return 0 if no error occurred.
+int connectshmclientFMU(SocketBuffers *sockBuf, const char *path){
+	int fd;
+	int slotLength;
+	struct stat st;
+	struct ShmChannel *ch;
+	fd = open(path, O_RDWR);
+	if ( fd < 0 ){
+		perror("Failed to open shared memory file.");
+		return -1;
+	}
+	if ( fstat(fd, &st) != 0 || st.st_size < (off_t) sizeof(struct ShmChannel) ){
+		fprintf(stderr, "Error: Shared memory file %s is too short.\n", path);
+		close(fd);
+		return -1;
+	}
+	ch = mapshmFMU(fd, (int) st.st_size);
+	close(fd);
+	if ( ch == NULL )
+		return -1;
+	if ( __atomic_load_n(&ch->magic, __ATOMIC_ACQUIRE) != SHM_MAGIC ){
+		fprintf(stderr, "Error: File %s is not a shared memory channel.\n", path);
+		munmap(ch, st.st_size);
+		return -1;
+	}
+	// the read side bounds messages by the capacity, so check it fits the file.
+	if ( ch->nDblCap < 0
+		|| ch->nDblCap > (st.st_size / (off_t) (2 * SHM_RING_SLOTS * sizeof(double)))
+		|| getshmlengthFMU(ch->nDblCap, &slotLength) > st.st_size
+		|| slotLength != ch->slotLength ){
+		fprintf(stderr, "Error: Shared memory file %s has an invalid header.\n", path);
+		munmap(ch, st.st_size);
+		return -1;
+	}
+	ch->pid[SHM_ROLE_EP] = getpid();
+	sockBuf->shm = ch;
+	sockBuf->shmLength = (int) st.st_size;
+	sockBuf->shmRole = SHM_ROLE_EP;
+	sockBuf->serverVersion = ch->version;
+	__atomic_store_n(&ch->connected, 1, __ATOMIC_RELEASE);
+	futexwakeFMU(&ch->connected);
+	return 0;
+}
+
+/////////////////////////////////////////////////////////////////
+/// Writes a message to the shared memory channel.
+///
+///\param sockBuf The buffers of the connection.
+///\param flag The communication flag.
+///\param nDbl The number of double values.
+///\param nInt The number of integer values, which must be zero.
+///\param nBoo The number of boolean values, which must be zero.
+///\param curSimTim The current simulation time in seconds.
+///\param dblVal The double values.
+///\return The number of bytes written, or a negative value if an error occurred.
+int writeshmFMU(SocketBuffers *sockBuf, const int flag,
+	const int nDbl, const int nInt, const int nBoo,
+	const double curSimTim, const double dblVal[]){
+	struct ShmChannel *ch = sockBuf->shm;
+	const int role = sockBuf->shmRole;
+	ShmRing *ring = &ch->ring[role];
+	ShmMessage *msg;
+	unsigned int head;
+	unsigned int tail;
+	const int n = ( flag == 0 ) ? nDbl : 0;
+	if ( nInt > 0 || nBoo > 0 || n > ch->nDblCap ){
+		fprintf(stderr, "Error: Shared memory channel can exchange at most %d doubles,"
+			" received %d doubles, %d integers and %d booleans.\n", ch->nDblCap, nDbl, nInt, nBoo);
+		return -1;
+	}
+	head = ring->head;
+	tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+	// wait if the ring is full
+	if ( head - tail == SHM_RING_SLOTS ){
+		if ( shmwaitFMU(ch, 1 - role, &ring->tail, &ring->tailWaiting, tail) != 0 )
+			return -1;
+	}
+	msg = getshmmessageFMU(ch, role, head);
+	msg->flag = flag;
+	msg->nDbl = n;
+	msg->curSimTim = curSimTim;
+	if ( n > 0 )
+		memcpy(msg->dblVal, dblVal, n * sizeof(double));
+	__atomic_store_n(&ring->head, head + 1, __ATOMIC_SEQ_CST);
+	if ( __atomic_load_n(&ring->headWaiting, __ATOMIC_SEQ_CST) )
+		futexwakeFMU(&ring->head);
+	return (int) offsetof(ShmMessage, dblVal) + n * (int) sizeof(double);
+}
+
+/////////////////////////////////////////////////////////////////
+/// Reads a message from the shared memory channel.
+///
+///\param sockBuf The buffers of the connection.
+///\param flag The communication flag.
+///\param nDbl The number of double values received. On entry, the length of \c dblVal.
+///\param nInt The number of integer values received.
+///\param nBoo The number of boolean values received.
+///\param curSimTim The current simulation time in seconds.
+///\param dblVal The double values received.
+///\return 0 if no error occurred.
+int readshmFMU(SocketBuffers *sockBuf, int *flag,
+	int *nDbl, int *nInt, int *nBoo,
+	double *curSimTim, double dblVal[]){
+	struct ShmChannel *ch = sockBuf->shm;
+	const int role = sockBuf->shmRole;
+	ShmRing *ring = &ch->ring[1 - role];
+	ShmMessage *msg;
+	unsigned int tail;
+	int n;
+	const int nDblCap = *nDbl;
+	tail = ring->tail;
+	// wait if the ring is empty
+	if ( __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE) == tail ){
+		if ( shmwaitFMU(ch, 1 - role, &ring->head, &ring->headWaiting, tail) != 0 )
+			return -1;
+	}
+	msg = getshmmessageFMU(ch, 1 - role, tail);
+	// the peer can write the message, so read the count once and check it
+	// against the size of the slot and of dblVal before copying.
+	n = *(volatile int *)&msg->nDbl;
+	if ( n < 0 || n > ch->nDblCap || n > nDblCap ){
+		fprintf(stderr, "Error: Received a message with %d doubles through the shared memory channel,"
+			" but can store at most %d.\n", n, ( ch->nDblCap < nDblCap ) ? ch->nDblCap : nDblCap);
+		return -1;
+	}
+	*flag = msg->flag;
+	*nDbl = n;
+	*nInt = 0;
+	*nBoo = 0;
+	*curSimTim = msg->curSimTim;
+	if ( n > 0 )
+		memcpy(dblVal, msg->dblVal, n * sizeof(double));
+	__atomic_store_n(&ring->tail, tail + 1, __ATOMIC_SEQ_CST);
+	if ( __atomic_load_n(&ring->tailWaiting, __ATOMIC_SEQ_CST) )
+		futexwakeFMU(&ring->tail);
+	return 0;
+}
+
+/////////////////////////////////////////////////////////////////
+/// Waits until a message can be read from the shared memory channel.
+///
+/// A channel whose other side closed it or is gone can be read without
+/// blocking as well, since \c readshmFMU then returns an error at once.
+///
+///\param sockBuf The buffers of the connection.
+///\param timeout The maximum time to wait in milliseconds.
+///\return 1 if a message can be read, or 0 if none arrived within \c timeout.
+int waitshmFMU(SocketBuffers *sockBuf, const int timeout){
+	struct ShmChannel *ch = sockBuf->shm;
+	const int role = sockBuf->shmRole;
+	ShmRing *ring = &ch->ring[1 - role];
+	const unsigned int tail = ring->tail;
+	struct timespec now;
+	struct timespec start;
+	int elapsed;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for(;;){
+		if ( __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE) != tail )
+			return 1;
+		if ( __atomic_load_n(&ch->closed[1 - role], __ATOMIC_ACQUIRE) )
+			return 1;
+		if ( ch->pid[1 - role] > 0 && shmprocessgoneFMU(ch->pid[1 - role]) )
+			return 1;
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		elapsed = (int) ((now.tv_sec - start.tv_sec) * 1000 + (now.tv_nsec - start.tv_nsec) / 1000000);
+		if ( elapsed >= timeout )
+			return 0;
+		__atomic_store_n(&ring->headWaiting, 1, __ATOMIC_SEQ_CST);
+		if ( __atomic_load_n(&ring->head, __ATOMIC_SEQ_CST) == tail )
+			futexwaitFMU(&ring->head, tail,
+				( timeout - elapsed < SHM_WAIT_MS ) ? timeout - elapsed : SHM_WAIT_MS);
+		__atomic_store_n(&ring->headWaiting, 0, __ATOMIC_SEQ_CST);
+	}
+}
+
+/////////////////////////////////////////////////////////////////
+/// Closes the shared memory channel and unmaps the file.
+///
+///\param sockBuf The buffers of the connection.
+void closeshmFMU(SocketBuffers *sockBuf){
+	struct ShmChannel *ch = sockBuf->shm;
+	if ( ch == NULL )
+		return;
+	__atomic_store_n(&ch->closed[sockBuf->shmRole], 1, __ATOMIC_SEQ_CST);
+	// wake up the other side if it waits for a message or a free slot
+	futexwakeFMU(&ch->ring[sockBuf->shmRole].head);
+	futexwakeFMU(&ch->ring[1 - sockBuf->shmRole].tail);
+	munmap(ch, sockBuf->shmLength);
+	sockBuf->shm = NULL;
+	sockBuf->shmLength = 0;
+}
+
+#else
+/////////////////////////////////////////////////////////////////
+// The shared memory transport uses futexes and is only available
+// on Linux. On other platforms, the FMU falls back to a socket.
+
+int establishshmserverFMU(SocketBuffers *sockBuf, const char *path, const int nDblCap){
+	return -1;
+}
+
+int acceptshmclientFMU(SocketBuffers *sockBuf, const int pid, const int timeout){
+	return -1;
+}
+
+int connectshmclientFMU(SocketBuffers *sockBuf, const char *path){
+	return -1;
+}
+
+int writeshmFMU(SocketBuffers *sockBuf, const int flag,
+	const int nDbl, const int nInt, const int nBoo,
+	const double curSimTim, const double dblVal[]){
+	return -1;
+}
+
+int readshmFMU(SocketBuffers *sockBuf, int *flag,
+	int *nDbl, int *nInt, int *nBoo,
+	double *curSimTim, double dblVal[]){
+	return -1;
+}
+
+int waitshmFMU(SocketBuffers *sockBuf, const int timeout){
+	return -1;
+}
+
+void closeshmFMU(SocketBuffers *sockBuf){
+}
+#endif
+
+/////////////////////////////////////////////////////////////////
+/// Gets the transport requested through the environment variable
+/// \c TRANSPORT_ENV.
+///
+///\return \c TRANSPORT_UNIX or \c TRANSPORT_SHM if this transport is requested
+///        and supported on this platform, otherwise \c TRANSPORT_TCP.
+int getsockettransportFMU(void){
+#ifdef _MSC_VER
+	return TRANSPORT_TCP;
+#else
+	const char *val = getenv(TRANSPORT_ENV);
+	if ( val != NULL && strcmp(val, "unix") == 0 )
+		return TRANSPORT_UNIX;
+#ifdef __linux__
+	if ( val != NULL && strcmp(val, "shm") == 0 )
+		return TRANSPORT_SHM;
+#endif
+	return TRANSPORT_TCP;
+#endif
+}
+
+/////////////////////////////////////////////////////////////////
+/// Creates a Unix domain socket server that listens at \c path.
+///
+/// A Unix domain socket avoids the TCP stack and the host name
+/// lookup if EnergyPlus runs on the same computer as the FMU.
+///
+///\param path The path of the socket file. An existing file
+///            at this path will be removed.
+///\return The socket file descriptor, or -1 if an error occurred
+///        or Unix domain sockets are not supported on this platform.
+int establishunixserversocketFMU(const char *path){
+#ifdef _MSC_VER
+	return -1;
+#else
+	int sockfd;
+	struct sockaddr_un server_addr;
+	if ( strlen(path) >= sizeof(server_addr.sun_path) ){
+		fprintf(stderr, "Error: Socket path %s is too long.\n", path);
+		return -1;
+	}
+	sockfd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if ( sockfd < 0 ){
+		perror("Failed to open Unix domain socket.");
+		return -1;
+	}
+	memset(&server_addr, 0, sizeof(server_addr));
+	server_addr.sun_family = AF_UNIX;
+	strcpy(server_addr.sun_path, path);
+	// remove a socket file that has been left by a previous run
+	unlink(path);
+	if ( bind(sockfd, (struct sockaddr *)&server_addr, sizeof(server_addr)) < 0
+		|| listen(sockfd, 1) < 0 ){
+		perror("Failed to bind Unix domain socket.");
+		close(sockfd);
+		return -1;
+	}
+	return sockfd;
+#endif
+}
+
 ///////////////////////////////////////////////////////////
 /// Closes the inter process communication socket.
 ///
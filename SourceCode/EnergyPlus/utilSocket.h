@@ -33,6 +33,7 @@
 // and on Mac OS X 10.6.1 Snow Leopard
 #include <arpa/inet.h>
 #include <sys/socket.h>
+#include <sys/un.h>
 //#include <netinet/in.h>
 #include <netdb.h> 
 #endif
@@ -97,6 +98,7 @@ int getDoubleCheckErrorFMU(const char *nptr, char **endptr,
 /// a long enough buffer for the read operation.
 ///
 ///\param buffer The buffer that contains the values to be parsed.
+///\param version The version number of the server.
 ///\param flag The communication flag.
 ///\param nDbl The number of double values received.
 ///\param nInt The number of integer values received.
@@ -104,6 +106,7 @@ int getDoubleCheckErrorFMU(const char *nptr, char **endptr,
 ///\return 0 if no error occurred.
 int disassembleHeaderBufferFMU(const char* buffer,
 			    char **endptr, const int base,
+			    int *version,
 			    int *fla, int *nDbl, int *nInt, int *nBoo);
 
 /////////////////////////////////////////////////////////////////
@@ -111,9 +114,9 @@ int disassembleHeaderBufferFMU(const char* buffer,
 ///
 ///\param buffer The buffer that contains the values to be parsed.
 ///\param flag The communication flag.
-///\param nDbl The number of double values received.
-///\param nInt The number of integer values received.
-///\param nBoo The number of boolean values received.
+///\param nDbl The number of double values received. On entry, the length of \c dblVal.
+///\param nInt The number of integer values received. On entry, the length of \c intVal.
+///\param nBoo The number of boolean values received. On entry, the length of \c booVal.
 ///\param dblVal The array that stores the double values.
 ///\param intVal The array that stores the integer values.
 ///\param booVal The array that stores the boolean values.
@@ -124,6 +127,116 @@ int disassembleBufferFMU(const char* buffer,
 		      double *curSimTim,
 		      double dblVal[], int intVal[], int booVal[]);
 
+////////////////////////////////////////////////////////////////
+/// Appends a character array of known length to another character
+/// array of known length.
+///
+///\param buffer The buffer to which the character array will be added.
+///\param nBufCha The number of characters in \c buffer. This parameter will
+///              be increased by \c nNewCha.
+///\param toAdd The character array that will be appended to \c buffer
+///\param nNewCha The number of characters in \c toAdd.
+///\param bufLen The length of the character array \c buffer. This parameter will
+///              be set to the new size of \c buffer if memory was reallocated.
+///\return 0 if no error occurred.
+int save_appendlengthFMU(char* *buffer, int *nBufCha,
+		      const char *toAdd, const int nNewCha, int *bufLen);
+
+////////////////////////////////////////////////////////////////
+/// Makes sure that a buffer has at least a given length.
+///
+///\param buffer The buffer.
+///\param bufLen The length of \c buffer. This parameter will
+///              be set to the new size of \c buffer if memory was reallocated.
+///\param minLen The required length.
+///\return 0 if no error occurred.
+int reservebufferFMU(char* *buffer, int *bufLen, const int minLen);
+
+////////////////////////////////////////////////////////////////
+/// Frees the buffers of a socket connection.
+///
+///\param sockBuf The buffers of the socket connection.
+void freesocketbuffersFMU(SocketBuffers *sockBuf);
+
+/////////////////////////////////////////////////////////////////
+/// Returns the number of bytes of a binary message.
+///
+///\param nDbl Number of double values to read or write.
+///\param nInt Number of integer values to read or write.
+///\param nBoo Number of boolean values to read or write.
+///\return The number of bytes of the message, or -1 if a number is negative
+///        or the message would be longer than \c INT_MAX bytes.
+int getbinarybufferlengthFMU(const int nDbl, const int nInt, const int nBoo);
+
+/////////////////////////////////////////////////////////////////
+/// Assembles a binary message that will be exchanged through the IPC.
+///
+///\param flag The communication flag.
+///\param nDbl The number of double values.
+///\param nInt The number of integer values.
+///\param nBoo The number of boolean values.
+///\param curSimTim The current simulation time in seconds.
+///\param dblVal The array that stores the double values.
+///\param intVal The array that stores the integer values.
+///\param booVal The array that stores the boolean values.
+///\param buffer The buffer into which the values will be written.
+///\param bufLen The buffer length.
+///\return The number of bytes of the message, or -1 if the buffer is too small.
+int assembleBinaryBufferFMU(int flag,
+			 int nDbl, int nInt, int nBoo,
+			 double curSimTim,
+			 double dblVal[], int intVal[], int booVal[],
+			 char *buffer, int bufLen);
+
+/////////////////////////////////////////////////////////////////
+/// Disassembles the header of a binary message.
+///
+///\param buffer The buffer that contains at least \c BINARY_HEADER_LENGTH bytes.
+///\param version The version number of the server.
+///\param fla The communication flag.
+///\param nDbl The number of double values received.
+///\param nInt The number of integer values received.
+///\param nBoo The number of boolean values received.
+///\param curSimTim The current simulation time in seconds.
+///\return 0 if no error occurred.
+int disassembleBinaryHeaderFMU(const char* buffer,
+			    int *version,
+			    int *fla,
+			    int *nDbl, int *nInt, int *nBoo,
+			    double *curSimTim);
+
+/////////////////////////////////////////////////////////////////
+/// Disassembles the values of a binary message.
+///
+///\param buffer The buffer that contains the values that follow the header.
+///\param nDbl The number of double values received.
+///\param nInt The number of integer values received.
+///\param nBoo The number of boolean values received.
+///\param dblVal The array that stores the double values.
+///\param intVal The array that stores the integer values.
+///\param booVal The array that stores the boolean values.
+void disassembleBinaryBufferFMU(const char* buffer,
+			     const int nDbl, const int nInt, const int nBoo,
+			     double dblVal[], int intVal[], int booVal[]);
+
+/////////////////////////////////////////////////////////////////
+/// Reads a given number of bytes from the socket.
+///
+///\param sockfd The socket file descripter.
+///\param buffer The buffer into which the bytes will be written.
+///\param nBytes The number of bytes to read.
+///\return The number of bytes read, or a value smaller than 1 if an error occurred.
+int readbytesfromsocketFMU(const int *sockfd, char *buffer, const int nBytes);
+
+/////////////////////////////////////////////////////////////////
+/// Writes a given number of bytes to the socket.
+///
+///\param sockfd The socket file descripter.
+///\param buffer The buffer that contains the bytes.
+///\param nBytes The number of bytes to write.
+///\return The number of bytes written, or a negative value if an error occurred.
+int writebytestosocketFMU(const int *sockfd, const char *buffer, const int nBytes);
+
 /////////////////////////////////////////////////////////////////////
 /// Gets the port number for the BSD socket communication.
 ///
@@ -147,6 +260,7 @@ int getsockethost(const char *const docname, char *const hostname);
 ///
 /// Clients can call this method to write data to the socket.
 ///\param sockfd Socket file descripter
+///\param sockBuf The buffers of the socket connection.
 ///\param flaWri Communication flag to write to the socket stream.
 ///\param nDblWri Number of double values to write.
 ///\param nIntWri Number of integer values to write.
@@ -158,6 +272,7 @@ int getsockethost(const char *const docname, char *const hostname);
 ///\sa int establishclientsocket(uint16_t *portNo)
 ///\return The exit value of \c send, or a negative value if an error occured.
 int writetosocketFMU(const int *sockfd, 
+		  SocketBuffers *sockBuf,
 		  const int *flaWri,
 		  const int *nDblWri, const int *nIntWri, const int *nBooWri,
 		  double *curSimTim,
@@ -166,11 +281,12 @@ int writetosocketFMU(const int *sockfd,
 /////////////////////////////////////////////////////////////////
 /// Returns the required socket buffer length by reading from
 /// the socket how many data it contains.
-/// This method also set the global variable \c SERVER_VERSION
+/// This method also sets the version number of the server.
 ///
 ///\param sockfd Socket file descripter
+///\param version The version number of the server.
 ///\return nCha The nunber of characters needed to store the buffer
-int getRequiredReadBufferLengthFMU(const int *sockfd);
+int getRequiredReadBufferLengthFMU(const int *sockfd, int *version);
 
 /////////////////////////////////////////////////////////////////
 /// Returns the required socket buffer length.
@@ -186,45 +302,88 @@ int getrequiredbufferlengthFMU(const int nDbl, const int nInt, const int nBoo);
 /// Clients can call this method to exchange data through the socket.
 ///
 ///\param sockfd Socket file descripter
+///\param sockBuf The buffers of the socket connection.
 ///\param flaRea Communication flag read from the socket stream.
-///\param nDblRea Number of double values to read.
-///\param nIntRea Number of integer values to read.
-///\param nBooRea Number of boolean values to read.
+///\param nDblRea Number of double values read. On entry, the length of \c dblValRea.
+///\param nIntRea Number of integer values read. On entry, the length of \c intValRea.
+///\param nBooRea Number of boolean values read. On entry, the length of \c booValRea.
 ///\param curSimTim Current simulation time in seconds read from socket.
 ///\param dblValRea Double values read from socket.
 ///\param intValRea Integer values read from socket.
 ///\param boolValRea Boolean values read from socket.
 ///\sa int establishclientsocket(uint16_t *portNo)
-int readfromsocketFMU(const int *sockfd, int *flaRea, 
+int readfromsocketFMU(const int *sockfd, SocketBuffers *sockBuf,
+		   int *flaRea, 
 		   int *nDblRea, int *nIntRea, int *nBooRea,
 		   double *curSimTim,
 		   double dblValRea[], int intValRea[], int booValRea[]);
 
+/////////////////////////////////////////////////////////////////
+/// Waits until a message can be read without blocking.
+///
+/// A connection that the other side closed can be read without
+/// blocking as well, since the read then returns an error at once.
+///
+///\param sockfd The socket file descriptor.
+///\param sockBuf The buffers of the connection.
+///\param timeout The maximum time to wait in milliseconds.
+///\return 1 if a message can be read, 0 if none arrived within \c timeout,
+///        or -1 if an error occurred.
+int waitforsocketFMU(const int *sockfd, SocketBuffers *sockBuf, const int timeout);
+
 /////////////////////////////////////////////////////////////////
 /// Reads a character buffer from the socket.
 ///
 /// This method is called by \c readfromsocket.
 ///
 ///\param sockfd The socket file descripter.
-///\param buffer The buffer into which the values will be written.
-///\param bufLen The buffer length prior to the call.
+///\param buffer The buffer into which the values will be written. It will
+///              be reallocated if it is too short.
+///\param bufLen The buffer length prior and after the call.
+///\param version The version number of the server.
 ///\return The exit value of the \c read command.
 int readbufferfromsocketFMU(const int *sockfd,
-			 char *buffer, int *bufLen);
+			 char **buffer, int *bufLen, const int version);
+
+/////////////////////////////////////////////////////////////////
+/// Reads a binary message from the socket.
+///
+/// This method is called by \c readfromsocketFMU if the server
+/// uses the binary format.
+///
+///\param sockfd Socket file descripter
+///\param buffer The buffer used to read the message. It will be
+///              reallocated if it is too short.
+///\param bufLen The buffer length prior and after the call.
+///\param flaRea Communication flag read from the socket stream.
+///\param nDblRea Number of double values read. On entry, the length of \c dblValRea.
+///\param nIntRea Number of integer values read. On entry, the length of \c intValRea.
+///\param nBooRea Number of boolean values read. On entry, the length of \c booValRea.
+///\param curSimTim Current simulation time in seconds read from socket.
+///\param dblValRea Double values read from socket.
+///\param intValRea Integer values read from socket.
+///\param boolValRea Boolean values read from socket.
+///\return 0 if no error occurred.
+int readbinaryfromsocketFMU(const int *sockfd, char **buffer, int *bufLen,
+			 int *flaRea,
+			 int *nDblRea, int *nIntRea, int *nBooRea,
+			 double *curSimTim,
+			 double dblValRea[], int intValRea[], int booValRea[]);
 
 /////////////////////////////////////////////////////////////////
 /// Exchanges data with the socket.
 ///
 /// Clients can call this method to exchange data through the socket.
 ///\param sockfd Socket file descripter
+///\param sockBuf The buffers of the socket connection.
 ///\param flaWri Communication flag to write to the socket stream.
 ///\param flaRea Communication flag read from the socket stream.
 ///\param nDblWri Number of double values to write.
 ///\param nIntWri Number of integer values to write.
 ///\param nBooWri Number of boolean values to write.
-///\param nDblRea Number of double values to read.
-///\param nIntRea Number of integer values to read.
-///\param nBooRea Number of boolean values to read.
+///\param nDblRea Number of double values read. On entry, the length of \c dblValRea.
+///\param nIntRea Number of integer values read. On entry, the length of \c intValRea.
+///\param nBooRea Number of boolean values read. On entry, the length of \c booValRea.
 ///\param simTimWri Current simulation time in seconds to write.
 ///\param dblValWri Double values to write.
 ///\param intValWri Integer values to write.
@@ -235,7 +394,7 @@ int readbufferfromsocketFMU(const int *sockfd,
 ///\param boolValRea Boolean values read from socket.
 ///\sa int establishclientsocket(uint16_t *portNo)
 ///\return The exit value of \c send or \c read, or a negative value if an error occured.
-int exchangewithsocketFMUex(const int *sockfd, 
+int exchangewithsocketFMUex(const int *sockfd, SocketBuffers *sockBuf,
 		       const int *flaWri, int *flaRea,
 		       const int *nDblWri, const int *nIntWri, const int *nBooWri,
 		       int *nDblRea, int *nIntRea, int *nBooRea,
@@ -249,17 +408,18 @@ int exchangewithsocketFMUex(const int *sockfd,
 ///
 /// Clients can call this method to exchange data through the socket.
 ///\param sockfd Socket file descripter
+///\param sockBuf The buffers of the socket connection.
 ///\param flaWri Communication flag to write to the socket stream.
 ///\param flaRea Communication flag read from the socket stream.
 ///\param nDblWri Number of double values to write.
-///\param nDblRea Number of double values to read.
+///\param nDblRea Number of double values read. On entry, the length of \c dblValRea.
 ///\param simTimWri Current simulation time in seconds to write.
 ///\param dblValWri Double values to write.
 ///\param simTimRea Current simulation time in seconds read from socket.
 ///\param dblValRea Double values read from socket.
 ///\sa int establishclientsocket(uint16_t *portNo)
 ///\return The exit value of \c send or \c read, or a negative value if an error occured.
-int exchangedoubleswithsocketFMUex(const int *sockfd, 
+int exchangedoubleswithsocketFMUex(const int *sockfd, SocketBuffers *sockBuf,
 			      const int *flaWri, int *flaRea,
 			      const int *nDblWri,
 			      int *nDblRea,
@@ -268,6 +428,104 @@ int exchangedoubleswithsocketFMUex(const int *sockfd,
 			      double *simTimRea,
 			      double dblValRea[]);
 
+/////////////////////////////////////////////////////////////////
+/// Gets the transport requested through the environment variable
+/// \c TRANSPORT_ENV.
+///
+///\return \c TRANSPORT_UNIX or \c TRANSPORT_SHM if this transport is requested
+///        and supported on this platform, otherwise \c TRANSPORT_TCP.
+int getsockettransportFMU(void);
+
+/////////////////////////////////////////////////////////////////
+/// Creates a Unix domain socket server that listens at \c path.
+///
+///\param path The path of the socket file. An existing file
+///            at this path will be removed.
+///\return The socket file descriptor, or -1 if an error occurred
+///        or Unix domain sockets are not supported on this platform.
+int establishunixserversocketFMU(const char *path);
+
+/////////////////////////////////////////////////////////////////
+/// Creates the shared memory file and maps it as the FMU side.
+///
+///\param sockBuf The buffers of the connection, which will hold the mapping.
+///\param path The path of the shared memory file.
+///\param nDblCap The maximum number of doubles in a message.
+///\return 0 if no error occurred, or -1 if the transport is not available.
+int establishshmserverFMU(SocketBuffers *sockBuf, const char *path, const int nDblCap);
+
+/////////////////////////////////////////////////////////////////
+/// Waits until EnergyPlus mapped the shared memory file.
+///
+///\param sockBuf The buffers of the connection.
+///\param pid The process id of EnergyPlus, or 0 if it is not known.
+///\param timeout The maximum time to wait in milliseconds.
+///\return 0 if no error occurred, or -1 if EnergyPlus exited or did not
+///        connect within \c timeout.
+int acceptshmclientFMU(SocketBuffers *sockBuf, const int pid, const int timeout);
+
+/////////////////////////////////////////////////////////////////
+/// Maps the shared memory file as the EnergyPlus side.
+///
+///\param sockBuf The buffers of the connection, which will hold the mapping.
+///\param path The path of the shared memory file.
+///\return 0 if no error occurred.
+int connectshmclientFMU(SocketBuffers *sockBuf, const char *path);
+
+/////////////////////////////////////////////////////////////////
+/// Writes a message to the shared memory channel.
+///
+/// This method is called by \c writetosocketFMU if the connection
+/// uses shared memory.
+///
+///\param sockBuf The buffers of the connection.
+///\param flag The communication flag.
+///\param nDbl The number of double values.
+///\param nInt The number of integer values, which must be zero.
+///\param nBoo The number of boolean values, which must be zero.
+///\param curSimTim The current simulation time in seconds.
+///\param dblVal The double values.
+///\return The number of bytes written, or a negative value if an error occurred.
+int writeshmFMU(SocketBuffers *sockBuf, const int flag,
+		const int nDbl, const int nInt, const int nBoo,
+		const double curSimTim, const double dblVal[]);
+
+/////////////////////////////////////////////////////////////////
+/// Reads a message from the shared memory channel.
+///
+/// This method is called by \c readfromsocketFMU if the connection
+/// uses shared memory.
+///
+///\param sockBuf The buffers of the connection.
+///\param flag The communication flag.
+///\param nDbl The number of double values received. On entry, the length of \c dblVal.
+///\param nInt The number of integer values received.
+///\param nBoo The number of boolean values received.
+///\param curSimTim The current simulation time in seconds.
+///\param dblVal The double values received.
+///\return 0 if no error occurred.
+int readshmFMU(SocketBuffers *sockBuf, int *flag,
+	       int *nDbl, int *nInt, int *nBoo,
+	       double *curSimTim, double dblVal[]);
+
+/////////////////////////////////////////////////////////////////
+/// Waits until a message can be read from the shared memory channel.
+///
+/// A channel whose other side closed it or is gone can be read without
+/// blocking as well, since \c readshmFMU then returns an error at once.
+///
+///\param sockBuf The buffers of the connection.
+///\param timeout The maximum time to wait in milliseconds.
+///\return 1 if a message can be read, 0 if none arrived within \c timeout,
+///        or -1 if the channel is not available on this platform.
+int waitshmFMU(SocketBuffers *sockBuf, const int timeout);
+
+/////////////////////////////////////////////////////////////////
+/// Closes the shared memory channel and unmaps the file.
+///
+///\param sockBuf The buffers of the connection.
+void closeshmFMU(SocketBuffers *sockBuf);
+
 ///////////////////////////////////////////////////////////
 /// Closes the inter process communication socket.
 ///
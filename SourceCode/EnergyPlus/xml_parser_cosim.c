@@ -46,9 +46,20 @@
  * -------------------------------------------------------------------------*/
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <assert.h>
 #include <string.h>
 #include <limits.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#ifdef _MSC_VER
+#include <windows.h>
+#include <process.h> // for _getpid
+#define getpid _getpid
+#else
+#include <pthread.h>
+#include <unistd.h>
+#endif
 #include "xml_parser_cosim.h"
 #include "util.h"
 #include "stack.h"
@@ -84,12 +95,49 @@ const char *enuNames[SIZEOF_ENU] = {
 };
 
 #define ANY_TYPE -1
-#define XMLBUFSIZE 1024
-char text[XMLBUFSIZE]; // XML file is parsed in chunks of length XMLBUFZIZE
-XML_Parser parser = NULL; // non-NULL during parsing
-Stack* stack = NULL; // the parser stack
-char* data = NULL; // buffer that holds element content, see handleData
-int skipData=0; // 1 to ignore element content, 0 when recordig content
+#define XMLBUFSIZE 16384 // XML file is parsed in chunks of length XMLBUFSIZE
+
+// Memory block of an AST. All nodes, attribute arrays and strings of an AST
+// are carved out of a list of blocks, so that freeElement() releases the
+// whole AST at once instead of walking it.
+struct AstBlock {
+    AstBlock* next; // block allocated before this one, or NULL
+    size_t size;    // bytes available after the header
+    size_t used;    // bytes handed out
+};
+
+// Memory handed out from a block is aligned for any of these types.
+typedef union {
+    void* p;
+    double d;
+    long l;
+} AstAlign;
+#define AST_ALIGN(n) (((n) + sizeof(AstAlign) - 1) / sizeof(AstAlign) * sizeof(AstAlign))
+#define AST_HEADER AST_ALIGN(sizeof(AstBlock))
+#define AST_MINBLOCK 4096
+
+// Hash indices of a ModelDescription. Each table is an open addressing
+// hash table with linear probing, whose size is a power of two.
+struct AstIndex {
+    unsigned int varMask;               // size of the variable tables - 1
+    ScalarVariable** varByName;         // variables by name
+    ScalarVariable** varByValueReference; // variables by base type and vr
+    unsigned int typeMask;              // size of the type table - 1
+    Type** typeByName;                  // declared types by name
+};
+
+// State of one call of parse(). It is passed to the callbacks of Expat
+// as user data, so that several threads can parse at the same time.
+typedef struct {
+    XML_Parser parser; // the Expat parser
+    Stack* stack;      // the parser stack
+    AstBlock* memory;  // blocks of the AST, newest first
+    char* data;        // buffer that holds element content, see handleData
+    size_t dataLen;    // length of the content in data
+    size_t dataSize;   // allocated size of data
+    int hasData;       // 1 once content of the current element was recorded
+    int skipData;      // 1 to ignore element content, 0 when recording content
+} ParseContext;
 
 // -------------------------------------------------------------------------
 // Low-level functions for inspecting the model description
@@ -169,7 +217,7 @@ char getBoolean(void* element, Att a, ValueStatus* vs){
     return 0;
 }
 
-static int checkEnumValue(const char* enu);
+static int checkEnumValue(ParseContext* ctx, const char* enu);
 
 // Retrieve the value of the given built-in enum attribute.
 // If the value is missing, this is marked in the ValueStatus
@@ -191,8 +239,8 @@ Enu getEnumValue(void* element, Att a, ValueStatus* vs) {
             default: return -1;  // hoho Returning {-1} rather than an {Enu}, and can't coerce {-1} into an {Enu} sensibly.
         }
     }
-    id = checkEnumValue(value);
-    if (id==-1) *vs = valueIllegal;
+    id = checkEnumValue(NULL, value);
+    *vs = (id==-1) ? valueIllegal : valueDefined;
     return( (Enu)id );  // hoho Note possible to try to coerce {-1} into {Enu}; undefined.
 }
 
@@ -229,41 +277,63 @@ const char* getName(void* element) {
     return name;
 }
 
+// The accessors of ScalarVariable below return the attributes
+// decoded by the parser, see decodeScalarVariable.
+
 // returns one of: input, output, internal, none
 // if value is missing, the default internal is returned
 Enu getCausality(void* scalarVariable) {
-    ValueStatus vs;
-    return getEnumValue(scalarVariable, att_causality, &vs);
+    assert(((Element*)scalarVariable)->type == elm_ScalarVariable);
+    return ((ScalarVariable*)scalarVariable)->causality;
 }
 
 // returns one of constant, parameter, discrete, continuous
 // if value is missing, the default continuous is returned
 Enu getVariability(void* scalarVariable) {
-    ValueStatus vs;
-    return getEnumValue(scalarVariable, att_variability, &vs);
+    assert(((Element*)scalarVariable)->type == elm_ScalarVariable);
+    return ((ScalarVariable*)scalarVariable)->variability;
 }
 
 // returns one of noAlias, alias, negatedAlias
 // if value is missing, the default noAlias is returned
 Enu getAlias(void* scalarVariable) {
-    ValueStatus vs;
-    return getEnumValue(scalarVariable, att_alias, &vs);
+    assert(((Element*)scalarVariable)->type == elm_ScalarVariable);
+    return ((ScalarVariable*)scalarVariable)->alias;
 }
 
 // the vr is unique only for one of the 4 base data types r,i,b,s and
 // may also be fmiUndefinedValueReference = 4294967295 = 0xFFFFFFFF
 // here, i means integer or enumeration
 fmiValueReference getValueReference(void* scalarVariable) {
-    ValueStatus vs;
-    fmiValueReference vr = getUInt(scalarVariable, att_valueReference, &vs);
     assert(((Element*)scalarVariable)->type == elm_ScalarVariable);
-    assert(vs==valueDefined); // this is a reqired attribute
-    return vr;
+    return ((ScalarVariable*)scalarVariable)->valueReference;
+}
+
+static AstIndex* getIndex(ModelDescription* md);
+static unsigned int hashName(const char* name);
+static unsigned int hashValueReference(fmiValueReference vr, Elm type);
+
+// Enumeration and Integer have the same base type while
+// Real, String, Boolean define own base types.
+static int sameBaseType(Elm t1, Elm t2){
+    return t1==t2 ||
+        (t1==elm_Enumeration && t2==elm_Integer) ||
+        (t2==elm_Enumeration && t1==elm_Integer);
 }
 
+// The lookups below use the hash indices of md, which are built on first
+// use. They search the lists only if the indices cannot be allocated.
+
 // the name is unique within a fmu
 ScalarVariable* getVariableByName(ModelDescription* md, const char* name) {
     int i;
+    AstIndex* ix = getIndex(md);
+    if (ix) {
+        unsigned int h;
+        for (h=hashName(name)&ix->varMask; ix->varByName[h]; h=(h+1)&ix->varMask)
+            if (!strcmp(getName(ix->varByName[h]), name)) return ix->varByName[h];
+        return NULL;
+    }
     if (md->modelVariables)
     for (i=0; md->modelVariables[i]; i++){
         ScalarVariable* sv = (ScalarVariable*)md->modelVariables[i];
@@ -272,21 +342,23 @@ ScalarVariable* getVariableByName(ModelDescription* md, const char* name) {
     return NULL;
 }
 
-// Enumeration and Integer have the same base type while
-// Real, String, Boolean define own base types.
-static int sameBaseType(Elm t1, Elm t2){
-    return t1==t2 ||
-        (t1==elm_Enumeration && t2==elm_Integer) ||
-        (t2==elm_Enumeration && t1==elm_Integer);
-}
-
 // returns NULL if variable not found or vr==fmiUndefinedValueReference
 ScalarVariable* getVariable(ModelDescription* md, fmiValueReference vr, Elm type){
     int i;
-    if (md->modelVariables && vr!=fmiUndefinedValueReference)
+    AstIndex* ix;
+    if (vr==fmiUndefinedValueReference) return NULL;
+    ix = getIndex(md);
+    if (ix) {
+        unsigned int h;
+        ScalarVariable* sv;
+        for (h=hashValueReference(vr, type)&ix->varMask; (sv=ix->varByValueReference[h]); h=(h+1)&ix->varMask)
+            if (sv->valueReference == vr && sameBaseType(type, sv->baseType)) return sv;
+        return NULL;
+    }
+    if (md->modelVariables)
     for (i=0; md->modelVariables[i]; i++){
         ScalarVariable* sv = (ScalarVariable*)md->modelVariables[i];
-        if (sameBaseType(type, sv->typeSpec->type) && getValueReference(sv) == vr)
+        if (sv->valueReference == vr && sameBaseType(type, sv->baseType))
             return sv;
     }
     return NULL;
@@ -294,7 +366,16 @@ ScalarVariable* getVariable(ModelDescription* md, fmiValueReference vr, Elm type
 
 Type* getDeclaredType(ModelDescription* md, const char* declaredType){
     int i;
-    if (declaredType && md->typeDefinitions)
+    AstIndex* ix;
+    if (!declaredType) return NULL;
+    ix = getIndex(md);
+    if (ix) {
+        unsigned int h;
+        for (h=hashName(declaredType)&ix->typeMask; ix->typeByName[h]; h=(h+1)&ix->typeMask)
+            if (!strcmp(declaredType, getName(ix->typeByName[h]))) return ix->typeByName[h];
+        return NULL;
+    }
+    if (md->typeDefinitions)
     for (i=0; md->typeDefinitions[i]; i++){
         Type* tp = (Type*)md->typeDefinitions[i];
         if (!strcmp(declaredType, getName(tp))) return tp;
@@ -365,73 +446,127 @@ double getNominal(ModelDescription* md, fmiValueReference vr){
 // -------------------------------------------------------------------------
 // Various checks that log an error and stop the parser
 
+// The checks stop the parser of ctx, if ctx is not NULL.
+
 // Returns 0 to indicate error
-static int checkPointer(const void* ptr){
+static int checkPointer(ParseContext* ctx, const void* ptr){
     if (! ptr) {
         printf("Out of memory\n");
-        if (parser) XML_StopParser(parser, XML_FALSE);
+        if (ctx) XML_StopParser(ctx->parser, XML_FALSE);
         return 0; // error
     }
     return 1; // success
 }
 
-static int checkName(const char* name, const char* kind, const char* array[], int n){
+static int checkName(ParseContext* ctx, const char* name, const char* kind, const char* array[], int n){
     int i;
     for (i=0; i<n; i++) {
         if (!strcmp(name, array[i])) return i;
     }
     printf("Illegal %s %s\n", kind, name);
-    XML_StopParser(parser, XML_FALSE);
+    if (ctx) XML_StopParser(ctx->parser, XML_FALSE);
     return -1;
 }
 
 // Returns -1 to indicate error
-static int checkElement(const char* elm){
-    return checkName(elm, "element", elmNames, SIZEOF_ELM);
+static int checkElement(ParseContext* ctx, const char* elm){
+    return checkName(ctx, elm, "element", elmNames, SIZEOF_ELM);
 }
 
 // Returns -1 to indicate error
-static int checkAttribute(const char* att){
-    return checkName(att, "attribute", attNames, SIZEOF_ATT);
+static int checkAttribute(ParseContext* ctx, const char* att){
+    return checkName(ctx, att, "attribute", attNames, SIZEOF_ATT);
 }
 
 // Returns -1 to indicate error
-static int checkEnumValue(const char* enu){
-    return checkName(enu, "enum value", enuNames, SIZEOF_ENU);
+static int checkEnumValue(ParseContext* ctx, const char* enu){
+    return checkName(ctx, enu, "enum value", enuNames, SIZEOF_ENU);
 }
 
-static void logFatalTypeError(const char* expected, Elm found) {
+static void logFatalTypeError(ParseContext* ctx, const char* expected, Elm found) {
     printf("Wrong element type, expected %s, found %s\n",
             expected, elmNames[found]);
-    XML_StopParser(parser, XML_FALSE);
+    XML_StopParser(ctx->parser, XML_FALSE);
 }
 
 // Returns 0 to indicate error
 // Verify that Element elm is of the given type
-static int checkElementType(void* element, Elm e) {
+static int checkElementType(ParseContext* ctx, void* element, Elm e) {
     Element* elm = (Element* )element;
     if (elm->type == e) return 1; // success
-    logFatalTypeError(elmNames[e], elm->type);
+    logFatalTypeError(ctx, elmNames[e], elm->type);
     return 0; // error
 }
 
 // Returns 0 to indicate error
 // Verify that the next stack element exists and is of the given type
 // If e==ANY_TYPE, the type check is ommited
-static int checkPeek(Elm e) {
-    if (stackIsEmpty(stack)){
+static int checkPeek(ParseContext* ctx, Elm e) {
+    if (stackIsEmpty(ctx->stack)){
         printf("Illegal document structure, expected %s\n", elmNames[e]);
-        XML_StopParser(parser, XML_FALSE);
+        XML_StopParser(ctx->parser, XML_FALSE);
         return 0; // error
     }
-    return e==ANY_TYPE ? 1 : checkElementType(stackPeek(stack), e);
+    return e==ANY_TYPE ? 1 : checkElementType(ctx, stackPeek(ctx->stack), e);
 }
 
 // Returns NULL to indicate error
 // Get the next stack element, it is of the given type.
 // If e==ANY_TYPE, the type check is ommited
-static void* checkPop(Elm e){
-    return checkPeek(e) ? stackPop(stack) : NULL;
+static void* checkPop(ParseContext* ctx, Elm e){
+    return checkPeek(ctx, e) ? stackPop(ctx->stack) : NULL;
+}
+
+// -------------------------------------------------------------------------
+// Memory of the AST
+
+// Returns NULL to indicate error
+// Allocate a block with size bytes available, in front of the list next.
+static AstBlock* newBlock(AstBlock* next, size_t size) {
+    AstBlock* b = (AstBlock*)malloc(AST_HEADER + size);
+    if (!b) return NULL;
+    b->next = next;
+    b->size = size;
+    b->used = 0;
+    return b;
+}
+
+// Release a list of blocks.
+static void freeBlocks(AstBlock* b) {
+    while (b) {
+        AstBlock* next = b->next;
+        free(b);
+        b = next;
+    }
+}
+
+// Returns NULL to indicate error
+// Get size bytes of memory for the AST. If the newest block is full,
+// start a new one of twice its size, so that few blocks are needed.
+static void* astAlloc(ParseContext* ctx, size_t size) {
+    AstBlock* b = ctx->memory;
+    void* p;
+    size = AST_ALIGN(size);
+    if (!b || b->size - b->used < size) {
+        size_t blockSize = b ? 2*b->size : AST_MINBLOCK;
+        if (blockSize < size) blockSize = size;
+        b = newBlock(ctx->memory, blockSize);
+        if (!b) return NULL;
+        ctx->memory = b;
+    }
+    p = (char*)b + AST_HEADER + b->used;
+    b->used += size;
+    return p;
+}
+
+// Returns NULL to indicate error
+// Copy the first len characters of s into the AST.
+static char* astStrndup(ParseContext* ctx, const char* s, size_t len) {
+    char* copy = (char*)astAlloc(ctx, len + 1);
+    if (!copy) return NULL;
+    memcpy(copy, s, len);
+    copy[len] = '\0';
+    return copy;
 }
 
 // -------------------------------------------------------------------------
@@ -463,25 +598,106 @@ static AstNodeType getAstNodeType(Elm e){
     }
 }
 
+// -------------------------------------------------------------------------
+// Hash indices of the AST
+
+// FNV-1a hash of a string
+static unsigned int hashName(const char* name) {
+    unsigned int h = 2166136261u;
+    for (; *name; name++) {
+        h ^= (unsigned char)*name;
+        h *= 16777619u;
+    }
+    return h;
+}
+
+// Hash of a value reference and its base type. Integer and Enumeration
+// hash alike, since they have the same base type.
+static unsigned int hashValueReference(fmiValueReference vr, Elm type) {
+    if (type == elm_Enumeration) type = elm_Integer;
+    return ((unsigned int)vr ^ ((unsigned int)type << 24)) * 2654435761u;
+}
+
+// Returns the smallest power of two that is at least twice n,
+// so that the tables are at most half full.
+static unsigned int tableSize(int n) {
+    unsigned int size = 8;
+    while (size < 2u*(unsigned int)n) size *= 2;
+    return size;
+}
+
+// Returns NULL to indicate error
+// Get the hash indices of md, and build them on first use. The indices
+// are kept in a memory block of the AST, so that freeElement releases
+// them with the AST.
+// Building the indices modifies md, hence the first lookup must not run
+// concurrently with other lookups on the same md.
+static AstIndex* getIndex(ModelDescription* md) {
+    AstIndex* ix;
+    AstBlock* b;
+    int i, nVar = 0, nType = 0;
+    unsigned int h, varSize, typeSize;
+    if (md->index) return md->index;
+    if (md->modelVariables) while (md->modelVariables[nVar]) nVar++;
+    if (md->typeDefinitions) while (md->typeDefinitions[nType]) nType++;
+    varSize = tableSize(nVar);
+    typeSize = tableSize(nType);
+    b = newBlock(md->memory, AST_ALIGN(sizeof(AstIndex))
+        + (2*varSize + typeSize)*sizeof(void*));
+    if (!b) return NULL;
+    md->memory = b;
+    b->used = b->size;
+    memset((char*)b + AST_HEADER, 0, b->size);
+    ix = (AstIndex*)((char*)b + AST_HEADER);
+    ix->varMask = varSize - 1;
+    ix->varByName = (ScalarVariable**)((char*)ix + AST_ALIGN(sizeof(AstIndex)));
+    ix->varByValueReference = ix->varByName + varSize;
+    ix->typeMask = typeSize - 1;
+    ix->typeByName = (Type**)(ix->varByValueReference + varSize);
+    // insert in the order of the lists, and keep the first of equal keys,
+    // so that the lookups return what a search of the lists returns
+    for (i=0; i<nVar; i++) {
+        ScalarVariable* sv = md->modelVariables[i];
+        ScalarVariable* other;
+        for (h=hashName(getName(sv))&ix->varMask; (other=ix->varByName[h]); h=(h+1)&ix->varMask)
+            if (!strcmp(getName(other), getName(sv))) break;
+        if (!other) ix->varByName[h] = sv;
+        if (sv->valueReference == fmiUndefinedValueReference) continue;
+        for (h=hashValueReference(sv->valueReference, sv->baseType)&ix->varMask;
+                (other=ix->varByValueReference[h]); h=(h+1)&ix->varMask)
+            if (other->valueReference == sv->valueReference && sameBaseType(other->baseType, sv->baseType)) break;
+        if (!other) ix->varByValueReference[h] = sv;
+    }
+    for (i=0; i<nType; i++) {
+        Type* tp = md->typeDefinitions[i];
+        Type* other;
+        for (h=hashName(getName(tp))&ix->typeMask; (other=ix->typeByName[h]); h=(h+1)&ix->typeMask)
+            if (!strcmp(getName(other), getName(tp))) break;
+        if (!other) ix->typeByName[h] = tp;
+    }
+    md->index = ix;
+    return ix;
+}
+
 // Returns 0 to indicate error
-// Copies the attr array and all values.
+// Copies the attr array and all values into the AST.
 // Replaces all attribute names by constant literal strings.
 // Converts the null-terminated array into an array of known size n.
-static int addAttributes(Element* el, const char** attr) {
+static int addAttributes(ParseContext* ctx, Element* el, const char** attr) {
     int n, a;
     const char** att = NULL;
     for (n=0; attr[n]; n+=2);
     if (n>0) {
-        att = (const char **)calloc(n, sizeof(char*));
-        if (!checkPointer(att)) return 0;
+        att = (const char **)astAlloc(ctx, n*sizeof(char*));
+        if (!checkPointer(ctx, att)) return 0;
     }
     for (n=0; attr[n]; n+=2) {
-        char* value = strdup(attr[n+1]);
-        if (!checkPointer(value)) return 0;
-        a = checkAttribute(attr[n]);
+        char* value = astStrndup(ctx, attr[n+1], strlen(attr[n+1]));
+        if (!checkPointer(ctx, value)) return 0;
+        a = checkAttribute(ctx, attr[n]);
         if (a == -1) return 0; // illegal attribute error
-        att[n ] = attNames[a]; // no heap memory
-        att[n+1] = value; // heap memory
+        att[n ] = attNames[a]; // no AST memory
+        att[n+1] = value; // AST memory
     }
     el->attributes = att; // NULL if n=0
     el->n = n;
@@ -489,29 +705,67 @@ static int addAttributes(Element* el, const char** attr) {
 }
 
 // Returns NULL to indicate error
-static Element* newElement(Elm type, int size, const char** attr) {
-    Element* e = (Element*)calloc(1, size);
-    if (!checkPointer(e)) return NULL;
+static Element* newElement(ParseContext* ctx, Elm type, int size, const char** attr) {
+    Element* e = (Element*)astAlloc(ctx, size);
+    if (!checkPointer(ctx, e)) return NULL;
+    memset(e, 0, size);
     e->type = type;
     e->attributes = NULL;
     e->n=0;
-    if (!addAttributes(e, attr)) return NULL;
+    if (!addAttributes(ctx, e, attr)) return NULL;
     return e;
 }
 
+// Returns 0 to indicate error
+// Decode the built-in enum attribute a of sv, and check that its value
+// is one of first to last.
+static int decodeEnum(ParseContext* ctx, ScalarVariable* sv, Att a, Enu first, Enu last, Enu* value) {
+    ValueStatus vs;
+    *value = getEnumValue(sv, a, &vs);
+    if (vs == valueIllegal || *value < first || *value > last) {
+        printf("Illegal %s of variable %s\n", attNames[a], getString(sv, att_name));
+        XML_StopParser(ctx->parser, XML_FALSE);
+        return 0; // error
+    }
+    return 1; // success
+}
+
+// Returns 0 to indicate error
+// Decode the attributes of sv that are read for every variable,
+// so that the accessors need not search and convert strings.
+static int decodeScalarVariable(ParseContext* ctx, ScalarVariable* sv) {
+    ValueStatus vs;
+    if (!getString(sv, att_name)) {
+        printf("Missing name of ScalarVariable\n");
+        XML_StopParser(ctx->parser, XML_FALSE);
+        return 0; // error
+    }
+    sv->valueReference = getUInt(sv, att_valueReference, &vs);
+    if (vs != valueDefined) {
+        printf("Missing or illegal valueReference of variable %s\n", getString(sv, att_name));
+        XML_StopParser(ctx->parser, XML_FALSE);
+        return 0; // error
+    }
+    sv->baseType = sv->typeSpec->type;
+    return decodeEnum(ctx, sv, att_causality, enu_input, enu_none, &sv->causality)
+        && decodeEnum(ctx, sv, att_variability, enu_constant, enu_continuous, &sv->variability)
+        && decodeEnum(ctx, sv, att_alias, enu_noAlias, enu_negatedAlias, &sv->alias);
+}
+
 // -------------------------------------------------------------------------
 // callback functions called by the XML parser
 
 // Create and push a new element node
 static void XMLCALL startElement(void *context, const char *elm, const char **attr) {
+    ParseContext* ctx = (ParseContext*)context;
     Elm el;
     int elInt;
     void* e;
     int size;
-    elInt = checkElement(elm);
+    elInt = checkElement(ctx, elm);
     if (elInt==-1) return; // error
     el = (Elm)elInt;
-    skipData = (el != elm_Name); // skip element content for all elements but Name
+    ctx->skipData = (el != elm_Name); // skip element content for all elements but Name
     switch(getAstNodeType(el)){
         case astElement: size = sizeof(Element); break;
         case astListElement: size = sizeof(ListElement); break;
@@ -521,25 +775,31 @@ static void XMLCALL startElement(void *context, const char *elm, const char **at
         case astModelDescription: size = sizeof(ModelDescription); break;
 default: assert(0);
     }
-    e = newElement(el, size, attr);
-    checkPointer(e);
-    stackPush(stack, e);
+    e = newElement(ctx, el, size, attr);
+    checkPointer(ctx, e);
+    stackPush(ctx->stack, e);
 }
 
 // Pop all elements of the given type from stack and
 // add it to the ListElement that follows.
 // The ListElement remains on the stack.
-static void popList(Elm e) {
-    int n = 0;
+static void popList(ParseContext* ctx, Elm e) {
+    int i, n = 0;
     Element** array;
-    Element* elm = (Element *)stackPop(stack);
+    Element* elm = (Element *)stackPop(ctx->stack);
     while (elm->type == e) {
-        elm = (Element *)stackPop(stack);
+        elm = (Element *)stackPop(ctx->stack);
         n++;
     }
-    stackPush(stack, elm); // push ListElement back to stack
-    array = (Element**)stackLastPopedAsArray0(stack, n); // NULL terminated list
+    stackPush(ctx->stack, elm); // push ListElement back to stack
     if (getAstNodeType(elm->type)!=astListElement) return; // failure
+    // copy the popped elements, which are still above the top of the stack,
+    // to a NULL terminated list
+    array = (Element**)astAlloc(ctx, (n + 1)*sizeof(Element*));
+    if (!checkPointer(ctx, array)) return;
+    for (i=0; i<n; i++)
+        array[i] = (Element*)ctx->stack->stack[i + ctx->stack->stackPos + 1];
+    array[n] = NULL;
     ((ListElement*)elm)->list = array;
     return; // success only if list!=NULL
 }
@@ -547,9 +807,10 @@ static void popList(Elm e) {
 // Pop the children from the stack and
 // check for correct type and sequence of children
 static void XMLCALL endElement(void *context, const char *elm) {
+    ParseContext* ctx = (ParseContext*)context;
     Elm el;
     int elInt;
-    elInt = checkElement(elm);
+    elInt = checkElement(ctx, elm);
     if( -1 == elInt ) return; // illegal element error
     el = (Elm)elInt;
     switch(el) {
@@ -563,49 +824,46 @@ static void XMLCALL endElement(void *context, const char *elm) {
                  ScalarVariable** mv = NULL; // NULL or list of ScalarVariable
                  CoSimulation *cs = NULL; // NULL or CoSimulation
                  ListElement* child;
+                 int i;
 
-                 child = (ListElement *)checkPop(ANY_TYPE);  // hoho {ANY_TYPE} is {int}; fcn checkPop() wants {Elm}.  Here and elsewhere.
+                 child = (ListElement *)checkPop(ctx, ANY_TYPE);  // hoho {ANY_TYPE} is {int}; fcn checkPop(ctx, ) wants {Elm}.  Here and elsewhere.
                  if (child->type == elm_CoSimulation_StandAlone || child->type == elm_CoSimulation_Tool) {
                      cs = (CoSimulation*)child;
-                     child = (ListElement *)checkPop(ANY_TYPE);
+                     child = (ListElement *)checkPop(ctx, ANY_TYPE);
                      if (!child) return;
                  }
                  if (child->type == elm_ModelVariables){
                      mv = (ScalarVariable**)child->list;
-                     free(child);
-                     child = (ListElement *)checkPop(ANY_TYPE);
+                     child = (ListElement *)checkPop(ctx, ANY_TYPE);
                      if (!child) return;
                  }
                  if (child->type == elm_VendorAnnotations){
                      va = (ListElement**)child->list;
-                     free(child);
-                     child = (ListElement *)checkPop(ANY_TYPE);
+                     child = (ListElement *)checkPop(ctx, ANY_TYPE);
                      if (!child) return;
                  }
                  if (child->type == elm_DefaultExperiment){
                      de = (Element*)child;
-                     child = (ListElement *)checkPop(ANY_TYPE);
+                     child = (ListElement *)checkPop(ctx, ANY_TYPE);
                      if (!child) return;
                  }
                  if (child->type == elm_TypeDefinitions){
                      td = (Type**)child->list;
-                     free(child);
-                     child = (ListElement *)checkPop(ANY_TYPE);
+                     child = (ListElement *)checkPop(ctx, ANY_TYPE);
                      if (!child) return;
                  }
                  if (child->type == elm_UnitDefinitions){
                      ud = (ListElement**)child->list;
-                     free(child);
-                     child = (ListElement *)checkPop(ANY_TYPE);
+                     child = (ListElement *)checkPop(ctx, ANY_TYPE);
                      if (!child) return;
                  }
                  // work around bug of SimulationX 3.4 and 3.5 which places Implementation at wrong location
                  if (!cs && (child->type == elm_CoSimulation_StandAlone || child->type == elm_CoSimulation_Tool)) {
                      cs = (CoSimulation*)child;
-                     child = (ListElement *)checkPop(ANY_TYPE);
+                     child = (ListElement *)checkPop(ctx, ANY_TYPE);
                      if (!child) return;
                  }
-                 if (!checkElementType(child, elm_fmiModelDescription)) return;
+                 if (!checkElementType(ctx, child, elm_fmiModelDescription)) return;
                  md = (ModelDescription*)child;
                  md->modelVariables = mv;
                  md->vendorAnnotations = va;
@@ -613,46 +871,51 @@ static void XMLCALL endElement(void *context, const char *elm) {
                  md->typeDefinitions = td;
                  md->unitDefinitions = ud;
                  md->cosimulation = cs;
-                 stackPush(stack, md);
+                 // count the inputs and outputs
+                 if (mv)
+                 for (i=0; mv[i]; i++){
+                     if (mv[i]->causality == enu_input) md->numInputs++;
+                     else if (mv[i]->causality == enu_output) md->numOutputs++;
+                 }
+                 stackPush(ctx->stack, md);
                  break;
             }
         case elm_Implementation:
             {
                  // replace Implementation element
-                 void* cs = checkPop(ANY_TYPE);
-                 void* im = checkPop(elm_Implementation);
-                 stackPush(stack, cs);
-                 free(im);
+                 void* cs = checkPop(ctx, ANY_TYPE);
+                 checkPop(ctx, elm_Implementation);
+                 stackPush(ctx->stack, cs);
                  el = ((Element*)cs)->type;
                  break;
             }
         case elm_CoSimulation_StandAlone:
             {
-                 Element* ca = (Element *)checkPop(elm_Capabilities);
-                 CoSimulation* cs = (CoSimulation *)checkPop(elm_CoSimulation_StandAlone);
+                 Element* ca = (Element *)checkPop(ctx, elm_Capabilities);
+                 CoSimulation* cs = (CoSimulation *)checkPop(ctx, elm_CoSimulation_StandAlone);
                  if (!ca || !cs) return;
                  cs->capabilities = ca;
-                 stackPush(stack, cs);
+                 stackPush(ctx->stack, cs);
                  break;
             }
         case elm_CoSimulation_Tool:
             {
-                 ListElement* mo = (ListElement *)checkPop(elm_Model);
-                 Element* ca = (Element *)checkPop(elm_Capabilities);
-                 CoSimulation* cs = (CoSimulation *)checkPop(elm_CoSimulation_Tool);
+                 ListElement* mo = (ListElement *)checkPop(ctx, elm_Model);
+                 Element* ca = (Element *)checkPop(ctx, elm_Capabilities);
+                 CoSimulation* cs = (CoSimulation *)checkPop(ctx, elm_CoSimulation_Tool);
                  if (!ca || !mo || !cs) return;
                  cs->capabilities = ca;
                  cs->model = mo;
-                 stackPush(stack, cs);
+                 stackPush(ctx->stack, cs);
                  break;
             }
         case elm_Type:
             {
                 Type* tp;
-                Element* ts = (Element *)checkPop(ANY_TYPE);
+                Element* ts = (Element *)checkPop(ctx, ANY_TYPE);
                 if (!ts) return;
-                if (!checkPeek(elm_Type)) return;
-                tp = (Type*)stackPeek(stack);
+                if (!checkPeek(ctx, elm_Type)) return;
+                tp = (Type*)stackPeek(ctx->stack);
                 switch (ts->type) {
                     case elm_RealType:
                     case elm_IntegerType:
@@ -661,7 +924,7 @@ static void XMLCALL endElement(void *context, const char *elm) {
                     case elm_EnumerationType:
                         break;
                     default:
-                         logFatalTypeError("RealType or similar", ts->type);
+                         logFatalTypeError(ctx, "RealType or similar", ts->type);
                          return;
                 }
                 tp->typeSpec = ts;
@@ -671,16 +934,15 @@ static void XMLCALL endElement(void *context, const char *elm) {
             {
                 ScalarVariable* sv;
                 Element** list = NULL;
-                Element* child = (Element *)checkPop(ANY_TYPE);
+                Element* child = (Element *)checkPop(ctx, ANY_TYPE);
                 if (!child) return;
                 if (child->type==elm_DirectDependency){
                     list = ((ListElement*)child)->list;
-                    free(child);
-                    child = (Element *)checkPop(ANY_TYPE);
+                    child = (Element *)checkPop(ctx, ANY_TYPE);
                     if (!child) return;
                 }
-                if (!checkPeek(elm_ScalarVariable)) return;
-                sv = (ScalarVariable*)stackPeek(stack);
+                if (!checkPeek(ctx, elm_ScalarVariable)) return;
+                sv = (ScalarVariable*)stackPeek(ctx->stack);
                 switch (child->type) {
                     case elm_Real:
                     case elm_Integer:
@@ -689,35 +951,42 @@ static void XMLCALL endElement(void *context, const char *elm) {
                     case elm_Enumeration:
                         break;
                     default:
-                         logFatalTypeError("Real or similar", child->type);
+                         logFatalTypeError(ctx, "Real or similar", child->type);
                          return;
                 }
                 sv->directDependencies = list;
                 sv->typeSpec = child;
+                if (!decodeScalarVariable(ctx, sv)) return;
                 break;
             }
-        case elm_ModelVariables: popList(elm_ScalarVariable); break;
-        case elm_VendorAnnotations: popList(elm_Tool);break;
-        case elm_Tool: popList(elm_Annotation); break;
-        case elm_TypeDefinitions: popList(elm_Type); break;
-        case elm_EnumerationType: popList(elm_Item); break;
-        case elm_UnitDefinitions: popList(elm_BaseUnit); break;
-        case elm_BaseUnit: popList(elm_DisplayUnitDefinition); break;
-        case elm_DirectDependency: popList(elm_Name); break;
-        case elm_Model: popList(elm_File); break;
+        case elm_ModelVariables: popList(ctx, elm_ScalarVariable); break;
+        case elm_VendorAnnotations: popList(ctx, elm_Tool);break;
+        case elm_Tool: popList(ctx, elm_Annotation); break;
+        case elm_TypeDefinitions: popList(ctx, elm_Type); break;
+        case elm_EnumerationType: popList(ctx, elm_Item); break;
+        case elm_UnitDefinitions: popList(ctx, elm_BaseUnit); break;
+        case elm_BaseUnit: popList(ctx, elm_DisplayUnitDefinition); break;
+        case elm_DirectDependency: popList(ctx, elm_Name); break;
+        case elm_Model: popList(ctx, elm_File); break;
         case elm_Name:
             {
                  // Exception: the name value is represented as element content.
                  // All other values of the XML file are represented using attributes.
-                 Element* name = (Element *)checkPop(elm_Name);
+                 Element* name = (Element *)checkPop(ctx, elm_Name);
                  if (!name) return;
                  name->n = 2;
-                 name->attributes = (const char **)malloc(2*sizeof(char*));
+                 name->attributes = (const char **)astAlloc(ctx, 2*sizeof(char*));
+                 if (!checkPointer(ctx, name->attributes)) return;
                  name->attributes[0] = attNames[att_input];
-                 name->attributes[1] = data;
-                 data = NULL;
-                 skipData = 1; // stop recording element content
-                 stackPush(stack, name);
+                 name->attributes[1] = NULL;
+                 if (ctx->hasData) {
+                     name->attributes[1] = astStrndup(ctx, ctx->data, ctx->dataLen);
+                     if (!checkPointer(ctx, name->attributes[1])) return;
+                 }
+                 ctx->hasData = 0;
+                 ctx->dataLen = 0;
+                 ctx->skipData = 1; // stop recording element content
+                 stackPush(ctx->stack, name);
                  break;
             }
         default: // must be a leaf Element
@@ -726,7 +995,7 @@ static void XMLCALL endElement(void *context, const char *elm) {
     }
     // All children of el removed from the stack.
     // The top element must be of type el now.
-    checkPeek(el);
+    checkPeek(ctx, el);
 }
 
 // Called to handle element data, e.g. "xy" in <Name>xy</Name>
@@ -735,26 +1004,27 @@ static void XMLCALL endElement(void *context, const char *elm) {
 // For some reason, if the element data is the empty string (Eg. <a></a>)
 // instead of an empty string with len == 0 we get "\n". The workaround is
 // to replace this with the empty string whenever we encounter "\n".
+// The content is collected in a buffer of the context, which is reused for
+// all elements, and copied into the AST when the element ends.
 static void XMLCALL handleData(void *context, const XML_Char *s, int len) {
-    int n;
-    if (skipData) return;
-    if (!data) {
+    ParseContext* ctx = (ParseContext*)context;
+    if (ctx->skipData) return;
+    if (!ctx->hasData) {
         // start a new data string
-        if (len == 1 && s[0] == '\n') {
-            data = strdup("");
-        } else {
-            data = (char *)malloc(len + 1);
-            strncpy(data, s, len);
-            data[len] = '\0';
-        }
+        ctx->hasData = 1;
+        ctx->dataLen = 0;
+        if (len == 1 && s[0] == '\n') return;
     }
-    else {
-        // continue existing string
-        n = strlen(data) + len;
-        data = (char *)realloc(data, n+1);
-        strncat(data, s, len);
-        data[n] = '\0';
+    // append to the data string
+    if (ctx->dataLen + len > ctx->dataSize) {
+        size_t size = 2*(ctx->dataLen + len);
+        char* data = (char *)realloc(ctx->data, size);
+        if (!checkPointer(ctx, data)) return;
+        ctx->data = data;
+        ctx->dataSize = size;
     }
+    memcpy(ctx->data + ctx->dataLen, s, len);
+    ctx->dataLen += len;
     return;
 }
 
@@ -817,59 +1087,13 @@ static void printList(int indent, void** list){
 // -------------------------------------------------------------------------
 // free memory of the AST
 
-static void freeList(void** list);
-
+// All nodes of an AST are in the memory blocks of its root node.
+// Hence freeing the root releases the whole AST at once, and
+// freeing any other node does nothing.
 void freeElement(void* element){
-    int i;
     Element* e = (Element*)element;
-    if (!e) return;
-    // free attributes
-    for (i=0; i<e->n; i+=2)
-        free((void*)e->attributes[i+1]);
-    if (e->attributes) free((void*)e->attributes);
-    // free child nodes
-    switch (getAstNodeType(e->type)) {
-        case astElement:
-// Add an empty case here to avoid warnings from -Wall
-// The element e gets freed elsewhere, if we free it
-// here, we get warnings
-//freeElement((void**)(Element*)e);
-            break;
-        case astListElement:
-            freeList((void**)((ListElement*)e)->list);
-            break;
-        case astScalarVariable:
-            freeList((void**)((ScalarVariable*)e)->directDependencies);
-        case astType:
-            freeElement(((Type*)e)->typeSpec);
-            break;
-        case astCoSimulation: {
-            CoSimulation* cs = (CoSimulation*)e;
-            freeElement(cs->capabilities);
-            freeElement(cs->model);
-            break;
-        }
-        case astModelDescription: {
-            ModelDescription* md = (ModelDescription*)e;
-            freeList((void**)md->unitDefinitions);
-            freeList((void**)md->typeDefinitions);
-            freeElement(md->defaultExperiment);
-            freeList((void**)md->vendorAnnotations);
-            freeList((void**)md->modelVariables);
-            freeElement(md->cosimulation);
-            break;
-       }
-    }
-    // free the struct
-    free(e);
-}
-
-static void freeList(void** list){
-    int i;
-    if (!list) return;
-    for (i=0; list[i]; i++)
-        freeElement(list[i]);
-    free(list);
+    if (!e || e->type != elm_fmiModelDescription) return;
+    freeBlocks(((ModelDescription*)e)->memory);
 }
 
 // -------------------------------------------------------------------------
@@ -898,124 +1122,634 @@ static ModelDescription* validate(ModelDescription* md) {
 // -------------------------------------------------------------------------
 // Entry function parse() of the XML parser
 
-static void cleanup(FILE *file) {
-    stackFree(stack);
-    stack = NULL;
-    XML_ParserFree(parser);
-    parser = NULL;
-    fclose(file);
+// Release the parser state of ctx. The AST is released too, unless
+// it was handed to the caller.
+static void cleanup(ParseContext* ctx, FILE *file) {
+    if (ctx->stack) stackFree(ctx->stack);
+    if (ctx->parser) XML_ParserFree(ctx->parser);
+    if (ctx->data) free(ctx->data);
+    freeBlocks(ctx->memory);
+    if (file) fclose(file);
 }
 
 // Returns NULL to indicate failure
 // Otherwise, return the root node md of the AST.
 // The receiver must call freeElement(md) to release AST memory.
+// parse() keeps its state in a ParseContext, hence it may be called
+// from several threads at the same time.
 ModelDescription* parse(const char* xmlPath) {
+    ParseContext ctx;
     ModelDescription* md = NULL;
     FILE *file;
+    long fileSize;
     int done = 0;
-    stack = stackNew(100, 10);
-    if (!checkPointer(stack)) return NULL; // failure
-    parser = XML_ParserCreate(NULL);
-    if (!checkPointer(parser)) return NULL; // failure
-    XML_SetElementHandler(parser, startElement, endElement);
-    XML_SetCharacterDataHandler(parser, handleData);
-   file = fopen(xmlPath, "rb");
-if (file == NULL) {
+    memset(&ctx, 0, sizeof(ctx));
+    file = fopen(xmlPath, "rb");
+    if (file == NULL) {
         printf("Cannot open file '%s'\n", xmlPath);
-      XML_ParserFree(parser);
         return NULL; // failure
     }
+    // size the first block of the AST for the whole file
+    fileSize = -1;
+    if (fseek(file, 0, SEEK_END) == 0) {
+        fileSize = ftell(file);
+        rewind(file);
+    }
+    ctx.memory = newBlock(NULL, fileSize > 0 ? (size_t)fileSize + fileSize/2 + AST_MINBLOCK : AST_MINBLOCK);
+    ctx.stack = stackNew(100, 10);
+    ctx.parser = XML_ParserCreate(NULL);
+    if (!checkPointer(NULL, ctx.memory) || !checkPointer(NULL, ctx.stack) || !checkPointer(NULL, ctx.parser)) {
+        cleanup(&ctx, file);
+        return NULL; // failure
+    }
+    XML_SetUserData(ctx.parser, &ctx);
+    XML_SetElementHandler(ctx.parser, startElement, endElement);
+    XML_SetCharacterDataHandler(ctx.parser, handleData);
     while (!done) {
-        int n = fread(text, sizeof(char), XMLBUFSIZE, file);
-if (n != XMLBUFSIZE) done = 1;
-        if (!XML_Parse(parser, text, n, done)){
+        // read into the buffer of Expat, to avoid copying the text
+        void* text = XML_GetBuffer(ctx.parser, XMLBUFSIZE);
+        int n;
+        if (!checkPointer(NULL, text)) {
+            cleanup(&ctx, file);
+            return NULL; // failure
+        }
+        n = (int)fread(text, sizeof(char), XMLBUFSIZE, file);
+        if (n != XMLBUFSIZE) done = 1;
+        if (!XML_ParseBuffer(ctx.parser, n, done)){
              printf("Parse error in file %s at line %d:\n%s\n",
                      xmlPath,
-                     (int)XML_GetCurrentLineNumber(parser),
-                     XML_ErrorString(XML_GetErrorCode(parser)));
-             while (! stackIsEmpty(stack)) md = (ModelDescription *)stackPop(stack);
-             if (md) freeElement(md);
-             cleanup(file);
+                     (int)XML_GetCurrentLineNumber(ctx.parser),
+                     XML_ErrorString(XML_GetErrorCode(ctx.parser)));
+             cleanup(&ctx, file);
              return NULL; // failure
         }
     }
-    md = (ModelDescription *)stackPop(stack);
-    assert(stackIsEmpty(stack));
-    cleanup(file);
+    if (stackIsEmpty(ctx.stack)) {
+        printf("Illegal document structure, expected %s\n", elmNames[elm_fmiModelDescription]);
+        cleanup(&ctx, file);
+        return NULL; // failure
+    }
+    md = (ModelDescription *)stackPop(ctx.stack);
+    assert(stackIsEmpty(ctx.stack));
     //printElement(1, md); // debug
-    return validate(md); // success if all refs are valid
+    if (md->type != elm_fmiModelDescription) {
+        printf("Illegal document structure, expected %s\n", elmNames[elm_fmiModelDescription]);
+        cleanup(&ctx, file);
+        return NULL; // failure
+    }
+    // hand the memory of the AST to its root, before validate builds
+    // the indices in it
+    md->memory = ctx.memory;
+    ctx.memory = NULL;
+    cleanup(&ctx, file);
+    if (!validate(md)) {
+        freeElement(md);
+        return NULL; // failure
+    }
+    return md; // success if all refs are valid
 }
 
 
-///////////////////////////////////////////////////////////////////////////////
-/// Check if string \c name is in the string array \c array[]. This function is
-///
-///\param name The string to be checked.
-///\param kind The type of string to be checked.
-///\param array The list of strings for comparison.
-///\param n The length of array.
-///\return The index of matched string in the \c array[].
-///        Otherwise, return -1 to indicate error.
-///////////////////////////////////////////////////////////////////////////////
-static int checkName2(const char* name, const char* kind, const char* array[], int n){
-    int i;
+// -------------------------------------------------------------------------
+// Cache of parsed model descriptions
+//
+// getModelDescription() keeps the validated and indexed ASTs in a process
+// wide cache, so that instances of an FMU share one read-only AST.
+// It also stores each AST as an image in a binary file. Loading an image
+// just reads the file and relocates the pointers of the AST, which is much
+// cheaper than parsing the XML file.
+
+#define MDFILE_MAGIC "EPFMU-MD"
+#define MDFILE_VERSION 1 // increase when the AST changes
+
+// Header of a binary model description file. The image of the AST follows
+// the header. The image holds the memory blocks of the AST one after the
+// other. Its pointers are stored as offset+1 into the image, or 0 for NULL,
+// and attribute names as index into attNames.
+typedef struct {
+    char magic[8];             // MDFILE_MAGIC
+    unsigned int version;      // MDFILE_VERSION
+    unsigned int layout;       // hash of the sizes of the AST, see getLayout
+    long long xmlTime;         // modification time of the XML file
+    long long xmlSize;         // size of the XML file
+    unsigned long long size;   // size of the image
+    unsigned long long root;   // offset+1 of the ModelDescription in the image
+    unsigned long long checksum; // FNV-1a hash of the image
+} MdFileHeader;
+
+// Relocates the pointers of an AST, see relocateNode.
+typedef struct {
+    int toImage;        // 1 to store the pointers of an AST in its image,
+                        // 0 to turn the pointers of a loaded image into addresses
+    AstBlock* memory;   // toImage: the blocks of the AST
+    char* image;        // the image
+    size_t size;        // size of the image
+    int error;          // 1 if the image is corrupt
+} Relocation;
+
+// Entry of the process cache
+typedef struct MdCacheEntry {
+    struct MdCacheEntry* next;
+    char* xmlPath;      // the XML file
+    long long xmlTime;  // modification time of the XML file when parsed
+    long long xmlSize;  // size of the XML file when parsed
+    ModelDescription* md;
+    int users;          // number of callers that did not yet release md
+    int current;        // 0 once the XML file changed; md is freed when unused
+} MdCacheEntry;
+
+static MdCacheEntry* mdCache = NULL;
+
+#ifdef _MSC_VER
+#define MD_PATH_SEP "\\"
+static SRWLOCK mdCacheLock = SRWLOCK_INIT;
+#define LOCK_MD_CACHE() AcquireSRWLockExclusive(&mdCacheLock)
+#define UNLOCK_MD_CACHE() ReleaseSRWLockExclusive(&mdCacheLock)
+#else
+#define MD_PATH_SEP "/"
+static pthread_mutex_t mdCacheLock = PTHREAD_MUTEX_INITIALIZER;
+#define LOCK_MD_CACHE() pthread_mutex_lock(&mdCacheLock)
+#define UNLOCK_MD_CACHE() pthread_mutex_unlock(&mdCacheLock)
+#endif
+
+// FNV-1a hash of n bytes, continuing hash h
+static unsigned long long hashBytes(unsigned long long h, const void* bytes, size_t n) {
+    const unsigned char* p = (const unsigned char*)bytes;
+    size_t i;
     for (i=0; i<n; i++) {
-        if (!strcmp(name, array[i])) return i;
+        h ^= p[i];
+        h *= 1099511628211ull;
     }
-    printf("Illegal %s %s\n", kind, name);
-    return -1;
+    return h;
 }
 
-///////////////////////////////////////////////////////////////////////////////
-/// Check enum value of input string \c enu.
-///
-///\param enu String to be checked.
-///\return The enum value of string if it is found in the enum.
-///        Otherwise, return -1 to indicate an error.
-///////////////////////////////////////////////////////////////////////////////
-static int checkEnumValue2(const char* enu){
-    return checkName2(enu, "enum value", enuNames, SIZEOF_ENU);
+// Hash of the sizes and the byte order of the AST. An image can only
+// be loaded by a program that was built with the same layout.
+static unsigned int getLayout(void) {
+    size_t sizes[12];
+    unsigned int one = 1;
+    sizes[0] = sizeof(void*);
+    sizes[1] = sizeof(AstAlign);
+    sizes[2] = sizeof(Element);
+    sizes[3] = sizeof(ListElement);
+    sizes[4] = sizeof(Type);
+    sizes[5] = sizeof(ScalarVariable);
+    sizes[6] = sizeof(CoSimulation);
+    sizes[7] = sizeof(ModelDescription);
+    sizes[8] = sizeof(AstIndex);
+    sizes[9] = SIZEOF_ELM;
+    sizes[10] = SIZEOF_ATT;
+    sizes[11] = *(unsigned char*)&one; // 1 on little endian machines
+    return (unsigned int)hashBytes(14695981039346656037ull, sizes, sizeof(sizes));
+}
+
+// Returns 0 if the n bytes at p are not within the image.
+static int inImage(Relocation* r, const void* p, size_t n) {
+    if ((const char*)p < r->image || (size_t)((const char*)p - r->image) > r->size
+        || n > r->size - (size_t)((const char*)p - r->image)) {
+        r->error = 1;
+        return 0;
+    }
+    return 1;
+}
+
+// Returns 0 if the n bytes of a node or array at p are not within the
+// image, or not aligned. When storing an AST, its nodes are not in the image.
+static int checkNode(Relocation* r, const void* p, size_t n) {
+    if (r->toImage) return 1;
+    if (!inImage(r, p, n)) return 0;
+    if ((size_t)((const char*)p - r->image) % sizeof(void*)) r->error = 1;
+    return !r->error;
+}
+
+// Offset in the image of the AST memory at p
+static size_t imageOffset(Relocation* r, const void* p) {
+    AstBlock* b;
+    size_t offset = r->size;
+    for (b=r->memory; b; b=b->next) {
+        const char* data = (const char*)b + AST_HEADER;
+        offset -= AST_ALIGN(b->used);
+        if ((const char*)p >= data && (const char*)p < data + b->used)
+            return offset + (size_t)((const char*)p - data);
+    }
+    r->error = 1; // p is not in the AST
+    return 0;
+}
+
+// Relocate the pointer at slot and return the address it refers to.
+// The image of an AST holds its blocks in the order of allocation,
+// hence the newest block is at the end of the image.
+static void* relocate(Relocation* r, void** slot) {
+    size_t v;
+    if (r->toImage) {
+        void* p = *slot;
+        v = p ? imageOffset(r, p) + 1 : 0;
+        memcpy(r->image + imageOffset(r, slot), &v, sizeof(v));
+        return p;
+    }
+    if (!inImage(r, slot, sizeof(v))) return NULL;
+    memcpy(&v, slot, sizeof(v));
+    if (v > r->size) {
+        r->error = 1;
+        v = 0;
+    }
+    *slot = v ? r->image + v - 1 : NULL;
+    return *slot;
+}
+
+// Relocate the pointer at slot to a string.
+static void relocateString(Relocation* r, const char** slot) {
+    const char* s = (const char*)relocate(r, (void**)slot);
+    if (!r->toImage && s && !memchr(s, '\0', r->size - (size_t)(s - r->image)))
+        r->error = 1;
+}
+
+// Relocate the pointer at slot to an attribute name.
+static void relocateAttName(Relocation* r, const char** slot) {
+    size_t a;
+    if (r->toImage) {
+        for (a=0; a<SIZEOF_ATT && attNames[a]!=*slot; a++);
+        if (a == SIZEOF_ATT) r->error = 1;
+        memcpy(r->image + imageOffset(r, slot), &a, sizeof(a));
+        return;
+    }
+    if (!inImage(r, slot, sizeof(a))) return;
+    memcpy(&a, slot, sizeof(a));
+    if (a >= SIZEOF_ATT) {
+        r->error = 1;
+        a = 0;
+    }
+    *slot = attNames[a];
+}
+
+static void relocateNode(Relocation* r, Element* e);
+
+// Relocate the pointer at slot to a node, and the node.
+static void relocateElement(Relocation* r, void** slot) {
+    Element* e = (Element*)relocate(r, slot);
+    if (e && !r->error) relocateNode(r, e);
+}
+
+// Relocate the pointer at slot to a null-terminated list of nodes,
+// and the nodes. If nodes is 0, relocate the list only.
+static void relocateList(Relocation* r, void** slot, int nodes) {
+    void** list = (void**)relocate(r, slot);
+    int i;
+    if (!list) return;
+    for (i=0; !r->error && checkNode(r, list + i, sizeof(void*)); i++) {
+        void* p = *(list + i);
+        if (nodes) relocateElement(r, list + i);
+        else relocate(r, list + i);
+        if (!p) break;
+    }
+}
+
+// Relocate the pointer at slot to a hash table of size mask+1.
+static void relocateTable(Relocation* r, void** slot, unsigned int mask) {
+    void** table = (void**)relocate(r, slot);
+    unsigned int i;
+    if (!table || (mask & (mask+1))) {
+        r->error = 1;
+        return;
+    }
+    if (!checkNode(r, table, ((size_t)mask+1)*sizeof(void*))) return;
+    for (i=0; i<=mask && !r->error; i++)
+        relocate(r, table + i);
+}
+
+// Relocate the pointer at slot to the indices of an AST, and the indices.
+// The entries of the tables refer to nodes that are relocated elsewhere.
+static void relocateIndex(Relocation* r, AstIndex** slot) {
+    AstIndex* ix = (AstIndex*)relocate(r, (void**)slot);
+    if (!ix || !checkNode(r, ix, sizeof(AstIndex))) return;
+    relocateTable(r, (void**)&ix->varByName, ix->varMask);
+    relocateTable(r, (void**)&ix->varByValueReference, ix->varMask);
+    relocateTable(r, (void**)&ix->typeByName, ix->typeMask);
+}
+
+// Relocate the pointers of node e and of its child nodes.
+// When storing the AST, the pointers are written to the image and the
+// AST is not modified. When loading, e is in the image and its pointers
+// are replaced by addresses after checking that they are in the image.
+static void relocateNode(Relocation* r, Element* e) {
+    int i;
+    size_t size;
+    if (!checkNode(r, e, sizeof(Element))) return;
+    if ((unsigned int)e->type >= SIZEOF_ELM || e->n < 0 || e->n % 2) {
+        r->error = 1;
+        return;
+    }
+    switch (getAstNodeType(e->type)) {
+        case astListElement: size = sizeof(ListElement); break;
+        case astType: size = sizeof(Type); break;
+        case astScalarVariable: size = sizeof(ScalarVariable); break;
+        case astCoSimulation: size = sizeof(CoSimulation); break;
+        case astModelDescription: size = sizeof(ModelDescription); break;
+        default: size = sizeof(Element); break;
+    }
+    if (!checkNode(r, e, size)) return;
+    relocate(r, (void**)&e->attributes);
+    if (e->n && !e->attributes) r->error = 1;
+    if (r->error || (e->n && !checkNode(r, e->attributes, e->n*sizeof(char*)))) return;
+    for (i=0; i<e->n && !r->error; i+=2) {
+        relocateAttName(r, &e->attributes[i]);
+        relocateString(r, &e->attributes[i+1]);
+    }
+    if (r->error) return;
+    switch (getAstNodeType(e->type)) {
+        case astElement:
+            break;
+        case astListElement:
+            relocateList(r, (void**)&((ListElement*)e)->list, 1);
+            break;
+        case astScalarVariable:
+            relocateElement(r, (void**)&((ScalarVariable*)e)->typeSpec);
+            relocateList(r, (void**)&((ScalarVariable*)e)->directDependencies, 1);
+            break;
+        case astType:
+            relocateElement(r, (void**)&((Type*)e)->typeSpec);
+            break;
+        case astCoSimulation: {
+            CoSimulation* cs = (CoSimulation*)e;
+            relocateElement(r, (void**)&cs->capabilities);
+            relocateElement(r, (void**)&cs->model);
+            break;
+        }
+        case astModelDescription: {
+            ModelDescription *md = (ModelDescription*)e;
+            void* memory = NULL;
+            relocateList(r, (void**)&md->unitDefinitions, 1);
+            relocateList(r, (void**)&md->typeDefinitions, 1);
+            relocateElement(r, (void**)&md->defaultExperiment);
+            relocateList(r, (void**)&md->vendorAnnotations, 1);
+            relocateList(r, (void**)&md->modelVariables, 1);
+            relocateElement(r, (void**)&md->cosimulation);
+            relocateIndex(r, &md->index);
+            // the blocks are not part of the image
+            if (r->toImage) memcpy(r->image + imageOffset(r, &md->memory), &memory, sizeof(memory));
+            else md->memory = NULL;
+            break;
+        }
+    }
+}
+
+// Returns 0 to indicate error
+// Store md in the binary file binPath. The file is written under a
+// temporary name and then renamed, so that other processes never
+// read a partial file.
+static int writeModelDescription(ModelDescription* md, const char* binPath, long long xmlTime, long long xmlSize) {
+    Relocation r;
+    MdFileHeader header;
+    AstBlock* b;
+    FILE* file;
+    char* tmpPath;
+    size_t offset;
+    int ok;
+    memset(&r, 0, sizeof(r));
+    r.toImage = 1;
+    r.memory = md->memory;
+    for (b=md->memory; b; b=b->next) r.size += AST_ALIGN(b->used);
+    r.image = (char*)calloc(r.size, 1);
+    if (!r.image) return 0;
+    offset = r.size;
+    for (b=md->memory; b; b=b->next) {
+        offset -= AST_ALIGN(b->used);
+        memcpy(r.image + offset, (char*)b + AST_HEADER, b->used);
+    }
+    relocateNode(&r, (Element*)md);
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, MDFILE_MAGIC, sizeof(header.magic));
+    header.version = MDFILE_VERSION;
+    header.layout = getLayout();
+    header.xmlTime = xmlTime;
+    header.xmlSize = xmlSize;
+    header.size = r.size;
+    header.root = imageOffset(&r, md) + 1;
+    header.checksum = hashBytes(14695981039346656037ull, r.image, r.size);
+    tmpPath = (char*)malloc(strlen(binPath) + 32);
+    if (r.error || !tmpPath) {
+        free(r.image);
+        free(tmpPath);
+        return 0;
+    }
+    sprintf(tmpPath, "%s.%d.tmp", binPath, (int)getpid());
+    file = fopen(tmpPath, "wb");
+    ok = file != NULL
+        && fwrite(&header, sizeof(header), 1, file) == 1
+        && fwrite(r.image, 1, r.size, file) == r.size;
+    if (file && fclose(file)) ok = 0;
+#ifdef _MSC_VER
+    // rename does not replace an existing file on Windows
+    if (ok) ok = MoveFileExA(tmpPath, binPath, MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+    if (ok) ok = rename(tmpPath, binPath) == 0;
+#endif
+    if (!ok) remove(tmpPath);
+    free(tmpPath);
+    free(r.image);
+    return ok;
+}
+
+// Returns NULL to indicate error
+// Load the AST of a modelDescription.xml with the given modification
+// time and size from the binary file binPath. Fails silently if the file
+// is missing, outdated, written by a different build, or corrupt.
+static ModelDescription* readModelDescription(const char* binPath, long long xmlTime, long long xmlSize) {
+    Relocation r;
+    MdFileHeader header;
+    AstBlock* b;
+    ModelDescription* md;
+    FILE* file = fopen(binPath, "rb");
+    if (!file) return NULL;
+    if (fread(&header, sizeof(header), 1, file) != 1
+        || memcmp(header.magic, MDFILE_MAGIC, sizeof(header.magic))
+        || header.version != MDFILE_VERSION || header.layout != getLayout()
+        || header.xmlTime != xmlTime || header.xmlSize != xmlSize
+        || header.size == 0 || header.size > (unsigned long long)(size_t)-1 - AST_HEADER
+        || header.root == 0 || header.root > header.size) {
+        fclose(file);
+        return NULL;
+    }
+    b = newBlock(NULL, (size_t)header.size);
+    if (!b || fread((char*)b + AST_HEADER, 1, (size_t)header.size, file) != (size_t)header.size) {
+        fclose(file);
+        freeBlocks(b);
+        return NULL;
+    }
+    fclose(file);
+    b->used = b->size;
+    memset(&r, 0, sizeof(r));
+    r.image = (char*)b + AST_HEADER;
+    r.size = b->size;
+    md = (ModelDescription*)(r.image + header.root - 1);
+    if (hashBytes(14695981039346656037ull, r.image, r.size) != header.checksum
+        || !checkNode(&r, md, sizeof(ModelDescription)) || md->type != elm_fmiModelDescription) {
+        freeBlocks(b);
+        return NULL;
+    }
+    relocateNode(&r, (Element*)md);
+    if (r.error) {
+        freeBlocks(b);
+        return NULL;
+    }
+    md->memory = b;
+    return md;
+}
+
+// Returns NULL to indicate error
+// Path of the binary file in directory cacheDir that caches xmlPath.
+// The name contains a hash of xmlPath, so that FMUs can share cacheDir.
+static char* getBinPath(const char* cacheDir, const char* xmlPath) {
+    size_t len = strlen(cacheDir);
+    char* binPath = (char*)malloc(len + 64);
+    if (!binPath) return NULL;
+    strcpy(binPath, cacheDir);
+    if (len > 0 && cacheDir[len-1] != '/' && cacheDir[len-1] != '\\')
+        strcat(binPath, MD_PATH_SEP);
+    sprintf(binPath + strlen(binPath), "modelDescription-%016llx.bin",
+        hashBytes(14695981039346656037ull, xmlPath, strlen(xmlPath)));
+    return binPath;
 }
 
+// Returns 1 if md has the given guid, or guid is NULL
+static int hasGUID(ModelDescription* md, const char* guid) {
+    const char* mdGUID = getString(md, att_guid);
+    return !guid || (mdGUID && !strcmp(mdGUID, guid));
+}
+
+// Find the current cache entry of md for xmlPath. Call with the lock held.
+static MdCacheEntry* findCacheEntry(const char* xmlPath, long long xmlTime, long long xmlSize, const char* guid) {
+    MdCacheEntry* en;
+    for (en=mdCache; en; en=en->next)
+        if (en->current && en->xmlTime == xmlTime && en->xmlSize == xmlSize
+            && !strcmp(en->xmlPath, xmlPath) && hasGUID(en->md, guid))
+            return en;
+    return NULL;
+}
+
+// Free an entry that is no longer in the cache.
+static void freeCacheEntry(MdCacheEntry* en) {
+    freeElement(en->md);
+    free(en->xmlPath);
+    free(en);
+}
+
+// Returns NULL to indicate failure
+// Otherwise, return the root node md of the AST of xmlPath.
+// md is shared with other callers and must not be modified. The receiver
+// must call releaseModelDescription(md) instead of freeElement(md).
+// md is taken from the process cache if xmlPath did not change since
+// it was parsed and has the given guid. Otherwise it is loaded from the
+// binary file in cacheDir, or parsed. If cacheDir is NULL, no binary file
+// is used. If guid is not NULL and differs from the GUID of xmlPath,
+// md is returned but not cached, so that the caller can report the error.
+ModelDescription* getModelDescription(const char* xmlPath, const char* guid, const char* cacheDir) {
+    struct stat st;
+    MdCacheEntry* en;
+    MdCacheEntry** prev;
+    ModelDescription* md = NULL;
+    char* binPath = NULL;
+    long long xmlTime, xmlSize;
+    if (stat(xmlPath, &st) != 0) return parse(xmlPath); // reports the error
+    xmlTime = (long long)st.st_mtime;
+    xmlSize = (long long)st.st_size;
+    LOCK_MD_CACHE();
+    en = findCacheEntry(xmlPath, xmlTime, xmlSize, guid);
+    if (en) en->users++;
+    UNLOCK_MD_CACHE();
+    if (en) return en->md;
+    // load or parse without the lock, so that other FMUs are not delayed
+    if (cacheDir) {
+        binPath = getBinPath(cacheDir, xmlPath);
+        if (binPath) md = readModelDescription(binPath, xmlTime, xmlSize);
+    }
+    if (!md) {
+        md = parse(xmlPath);
+        // build the indices before md is shared, see getIndex
+        if (!md || !getIndex(md) || !hasGUID(md, guid)) {
+            free(binPath);
+            return md;
+        }
+        if (binPath) writeModelDescription(md, binPath, xmlTime, xmlSize);
+    }
+    free(binPath);
+    if (!hasGUID(md, guid)) return md;
+    LOCK_MD_CACHE();
+    // another thread may have added xmlPath meanwhile
+    en = findCacheEntry(xmlPath, xmlTime, xmlSize, guid);
+    if (en) {
+        en->users++;
+        UNLOCK_MD_CACHE();
+        freeElement(md);
+        return en->md;
+    }
+    en = (MdCacheEntry*)calloc(1, sizeof(MdCacheEntry));
+    if (!en || !(en->xmlPath = (char*)malloc(strlen(xmlPath) + 1))) {
+        UNLOCK_MD_CACHE();
+        free(en);
+        return md; // not cached
+    }
+    // retire the entries of earlier versions of xmlPath
+    for (prev=&mdCache; *prev; ) {
+        MdCacheEntry* old = *prev;
+        if (old->current && !strcmp(old->xmlPath, xmlPath)
+            && (old->xmlTime != xmlTime || old->xmlSize != xmlSize)) {
+            old->current = 0;
+            if (old->users == 0) {
+                *prev = old->next;
+                freeCacheEntry(old);
+                continue;
+            }
+        }
+        prev = &old->next;
+    }
+    strcpy(en->xmlPath, xmlPath);
+    en->xmlTime = xmlTime;
+    en->xmlSize = xmlSize;
+    en->md = md;
+    en->users = 1;
+    en->current = 1;
+    en->next = mdCache;
+    mdCache = en;
+    UNLOCK_MD_CACHE();
+    return md;
+}
+
+// Release md returned by getModelDescription. md stays in the process
+// cache for later instances, unless its XML file changed meanwhile.
+void releaseModelDescription(ModelDescription* md) {
+    MdCacheEntry* en;
+    MdCacheEntry** prev;
+    if (!md) return;
+    LOCK_MD_CACHE();
+    for (prev=&mdCache; *prev && (*prev)->md != md; prev=&(*prev)->next);
+    en = *prev;
+    if (!en) {
+        UNLOCK_MD_CACHE();
+        freeElement(md); // not cached
+        return;
+    }
+    en->users--;
+    if (en->users == 0 && !en->current) *prev = en->next;
+    else en = NULL; // stays in the cache
+    UNLOCK_MD_CACHE();
+    if (en) freeCacheEntry(en);
+}
+
+
 ///////////////////////////////////////////////////////////////
 ///  This method is used to get the number of outputs in the FMU
 ///
 ///\param ModelDescription FMU model description file
 ////////////////////////////////////////////////////////////////
 fmiInteger getNumOutputVariablesInFMU(ModelDescription *md){
-	int i, j;
-	void **list;
-	int num_output = 0;
-
 	// get the model description of the FMU
 	if (!md) {
 		printf("Error: failed to get the modelDescription in fmigetValueReferenceByName!\n");
 		return -1;
 	}
-
-	for(i=0; i<md->n; i+=2)
-		if(!strcmp(md->attributes[i], "modelIdentifier"));  
-
-	list = (void **)md->modelVariables;
-	if (list)
-		for(j=0; list[j]; j++)
-		{
-			Element* e = (Element*)list[j];
-			Enu val = enu_none;
-
-			for(i=0; i<e->n; i+=2)
-			{
-				if(!strcmp(e->attributes[i], "causality"))
-					val = (Enu)checkEnumValue2(e->attributes[i+1]);  
-			}
-
-           // get number of input variables
-			if(val == enu_output)
-			{
-				num_output = num_output + 1;
-			}
-    }
-		return num_output;
+	// the parser counted the outputs
+	return md->numOutputs;
 }
 
 ////////////////////////////////////////////////////////////////
@@ -1024,36 +1758,10 @@ fmiInteger getNumOutputVariablesInFMU(ModelDescription *md){
 ///\param ModelDescription FMU model description file
 ////////////////////////////////////////////////////////////////
 fmiInteger getNumInputVariablesInFMU(ModelDescription *md){
-	int i, j;
-	void **list;
-	int num_input = 0;
-
 	if (!md) {
 		printf("Error: failed to get the modelDescription in fmigetValueReferenceByName!\n");
 		return -1;
 	}
-
-	for(i=0; i<md->n; i+=2)
-		if(!strcmp(md->attributes[i], "modelIdentifier"));  
-
-	list = (void **)md->modelVariables;
-	if (list)
-		for(j=0; list[j]; j++)
-		{
-			Element* e = (Element*)list[j];
-			Enu val = enu_none;
-
-			for(i=0; i<e->n; i+=2)
-			{
-				if(!strcmp(e->attributes[i], "causality"))
-					val = (Enu)checkEnumValue2(e->attributes[i+1]);  
-			}
-
-           // get number of input variables
-			if(val == enu_input)
-			{
-				num_input = num_input + 1;
-			}
-    }
-		return num_input;
+	// the parser counted the inputs
+	return md->numInputs;
 }
@@ -96,6 +96,12 @@ typedef struct {
     int n; // size of attributes, even number
     Element* typeSpec; // one of Real, Integer, etc
     Element** directDependencies; // null or null-terminated list of Name
+    // attributes decoded by the parser, see getValueReference etc.
+    fmiValueReference valueReference;
+    Enu causality; // one of input, output, internal, none
+    Enu variability; // one of constant, parameter, discrete, continuous
+    Enu alias; // one of noAlias, alias, negatedAlias
+    Elm baseType; // type of typeSpec
 } ScalarVariable;
 
 // AST node for element CoSimulation_StandAlone and CoSimulation_Tool
@@ -107,6 +113,12 @@ typedef struct {
     ListElement* model; // non-NULL to support tool coupling, NULL for standalone
 } CoSimulation;
 
+// Memory block of an AST, see freeElement
+typedef struct AstBlock AstBlock;
+
+// Hash indices of the variables and types of a ModelDescription
+typedef struct AstIndex AstIndex;
+
 // AST node for element ModelDescription
 typedef struct {
     Elm type; // element type
@@ -118,6 +130,10 @@ typedef struct {
     ListElement** vendorAnnotations; // NULL or null-terminated list of Tools
     ScalarVariable** modelVariables; // NULL or null-terminated list of ScalarVariable
     CoSimulation* cosimulation; // NULL if this ModelDescription is for model exchange only
+    int numInputs; // number of ScalarVariables with causality input
+    int numOutputs; // number of ScalarVariables with causality output
+    AstBlock* memory; // memory blocks holding all nodes of the AST
+    AstIndex* index; // NULL until the first lookup, see getVariableByName
 } ModelDescription;
 
 // types of AST nodes used to represent an element
@@ -147,6 +163,10 @@ char getBoolean (void* element, Att a, ValueStatus* vs);
 Enu getEnumValue (void* element, Att a, ValueStatus* vs);
 void freeElement (void* element);
 
+// Public methods: Shared model descriptions, see getModelDescription
+ModelDescription* getModelDescription(const char* xmlPath, const char* guid, const char* cacheDir);
+void releaseModelDescription(ModelDescription* md);
+
 // Convenience methods for AST access. To be used afer successful validation only.
 const char* getModelIdentifier(ModelDescription* md);
 int getNumberOfStates(ModelDescription* md);
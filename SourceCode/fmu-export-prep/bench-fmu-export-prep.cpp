@@ -0,0 +1,748 @@
+//--- Benchmark for the IDF/IDD reading pipeline of the FMU export preprocessor.
+//
+/// \brief  Benchmark for the IDF/IDD reading pipeline.
+///
+///   Times the stages that the preprocessor runs on every FMU export and
+/// every FMU instantiation:
+///   -- getMap:          read the IDD file into an {iddTable}.
+///   -- getMapRequired:  read the IDD file only up to the keywords that
+///                       {haveValidIDD()} checks.
+///   -- writeSnapshot:   read the IDD file, and save a snapshot of it, as
+///                       the preprocessor does on its first run.
+///   -- readSnapshot:    checksum the IDD file and load the snapshot, as
+///                       the preprocessor does on later runs.
+///   -- populateFromIDF: collect the ExternalInterface data of the IDF file.
+///   -- populateThreaded: as above, scanning parts of the IDF file on one
+///                       thread per processor.
+///   -- isLeapYear:      copy the weather file to {runweafile.epw}.
+///   -- writeInputFile:  copy the IDF file to {runinfile.idf}, and write the
+///                       time step to {tstep.txt}.
+///   -- getTimeStep:     write the time step to {tstep.txt}, in a pass of its
+///                       own, as the preprocessor did before.
+///
+///   Each stage runs in a forked child, so that the peak resident set size
+/// reported for a stage is that of the stage alone, plus the small baseline
+/// of this driver.  Throughput is given as MB/s of input and as objects/s,
+/// where an object is a ';'-terminated entry of an IDD or IDF file, or a
+/// line of a weather file.
+///
+///   Usage:
+///     bench-fmu-export-prep  [IDF size in MB ...]
+///     bench-fmu-export-prep  <IDD file>  <IDF file>  [weather file]
+///
+///   Given sizes, the driver writes a synthetic IDD file, a synthetic
+/// weather file, and one synthetic IDF file per size, to the directory
+/// {bench-fmu-export-prep} in the current working directory.  Without
+/// arguments, it uses sizes of 1, 10, and 100 MB.  Given files, it times
+/// the stages on those files, using a synthetic weather file if none is
+/// given.  The stages write their output files to the same directory.
+///
+///   Compile with the sources of the preprocessor, but not with their unit
+/// tests, which define {main()}.  For example
+///     g++ -O2 -o bench-fmu-export-prep bench-fmu-export-prep.cpp
+///       fmu-export-idf-data.cpp
+///       ../read-ep-file/ep-idd-map.cpp ../read-ep-file/fileReader.cpp
+///       ../read-ep-file/fileReaderData.cpp
+///       ../read-ep-file/fileReaderDictionary.cpp
+///       ../utility/digest-md5.cpp ../utility/string-help.cpp
+///       ../utility/utilReport.cpp  -lpthread
+
+
+//--- Includes.
+//
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+
+#include <string>
+using std::string;
+
+#include <vector>
+using std::vector;
+
+#include <fstream>
+#include <sstream>
+
+#include <iostream>
+using std::cout;
+using std::cerr;
+using std::endl;
+
+#include <errno.h>
+#include <limits.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+#include "fmu-export-idf-data.h"
+
+#include "../read-ep-file/ep-idd-map.h"
+#include "../read-ep-file/fileReaderData.h"
+#include "../read-ep-file/fileReaderDictionary.h"
+
+#include "../utility/digest-md5.h"
+#include "../utility/utilReport.h"
+
+
+//--- File-scope constants.
+//
+static const char* g_benchDir = "bench-fmu-export-prep";
+//
+// Start and stop time of the FMU, in seconds, passed to writeInputFile().
+static const string g_tStartFMU = "0";
+static const string g_tStopFMU = "86400";
+//
+// Number of classes in the synthetic IDD file.  The IDD file that ships
+// with EnergyPlus has roughly this many classes, and is of similar size.
+static const int g_iddClassCt = 800;
+//
+// Number of hours in the synthetic weather file.
+static const int g_epwHourCt = 8760;
+
+
+//--- Types.
+//
+// Result of one stage, as sent from the child to the parent.
+struct stageResult_s
+  {
+  int failLine;
+  double wallSec;
+  };
+
+
+//--- Return the monotonic clock time, in seconds.
+//
+static double wallTime(void)
+  {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return( ts.tv_sec + 1e-9*ts.tv_nsec );
+  }  // End fcn wallTime().
+
+
+//--- Return the size of a file, in bytes, or -1 on error.
+//
+static long long fileSize(const string& fileName)
+  {
+  struct stat st;
+  if( 0 != stat(fileName.c_str(), &st) )
+    {
+    return( -1 );
+    }
+  return( (long long)st.st_size );
+  }  // End fcn fileSize().
+
+
+//--- Count the objects in a file.
+//
+//   For an IDD or IDF file, count the ';' that are not in a comment, where
+// {commentChars} start a comment that runs to the end of the line.  For a
+// weather file, pass {commentChars} empty and {delim} '\n' to count lines.
+//
+static long long countObjects(const string& fileName, const char* commentChars, char delim)
+  {
+  FILE* fp = fopen(fileName.c_str(), "rb");
+  if( NULL == fp )
+    {
+    return( -1 );
+    }
+  long long objCt = 0;
+  bool inComment = false;
+  char buf[65536];
+  size_t len;
+  while( 0 < (len = fread(buf, 1, sizeof(buf), fp)) )
+    {
+    for( size_t idx=0; idx<len; ++idx )
+      {
+      const char ch = buf[idx];
+      if( inComment )
+        {
+        inComment = ('\n' != ch);
+        }
+      else if( '\0' != ch && NULL != strchr(commentChars, ch) )
+        {
+        inComment = true;
+        }
+      else if( delim == ch )
+        {
+        ++objCt;
+        }
+      }
+    }
+  fclose(fp);
+  return( objCt );
+  }  // End fcn countObjects().
+
+
+//--- Write IDD classes, given as (keyword, descriptor) pairs ending with a NULL keyword.
+//
+static void writeIddClasses(std::ostream& os, const char* const* keysDescs)
+  {
+  for( int idx=0; NULL!=keysDescs[idx]; idx+=2 )
+    {
+    const string desc = keysDescs[idx+1];
+    int aCt = 0, nCt = 0;
+    os << keysDescs[idx] << ",\n"
+      "       \\memo Required by the FMU export preprocessor.\n";
+    for( size_t fldIdx=0; fldIdx<desc.length(); ++fldIdx )
+      {
+      const char kind = desc[fldIdx];
+      os << "  " << kind << ('A'==kind ? ++aCt : ++nCt)
+        << (fldIdx+1<desc.length() ? " , " : " ; ")
+        << "\\field Field " << fldIdx+1 << "\n"
+        "       \\type " << ('A'==kind ? "alpha" : "real") << "\n";
+      }
+    os << "\n";
+    }
+  }  // End fcn writeIddClasses().
+
+
+//--- Write a synthetic IDD file.
+//
+//   Besides filler classes, write the classes that fmuExportIdfData::haveValidIDD()
+// checks, with the descriptors it expects.  Every field carries the kind of
+// '\' comments that make up most of a real IDD file.
+//
+//   As in {Energy+.idd}, the simulation parameters come first, and the
+// ExternalInterface classes come near the end, after most of the filler.
+//
+static bool writeSyntheticIdd(const string& fileName)
+  {
+  std::ofstream os(fileName.c_str(), std::ios::out | std::ios::trunc);
+  if( ! os.is_open() )
+    {
+    return( false );
+    }
+  //
+  static const char* const reqKeys[] = {
+    "Timestep", "N",
+    "RunPeriod", "ANNNNAAAAAANAN",
+    NULL, NULL,
+    "ExternalInterface", "A",
+    "ExternalInterface:FunctionalMockupUnitExport:To:Actuator", "AAAAAN",
+    "ExternalInterface:FunctionalMockupUnitExport:To:Schedule", "AAAN",
+    "ExternalInterface:FunctionalMockupUnitExport:From:Variable", "AAA",
+    "ExternalInterface:FunctionalMockupUnitExport:To:Variable", "AAN",
+    NULL, NULL
+    };
+  os << "!IDD_Version 8.4.0\n"
+    "! Synthetic data dictionary written by bench-fmu-export-prep.\n"
+    "\\group Simulation Parameters\n\n";
+  writeIddClasses(os, reqKeys);
+  //
+  // Filler classes.
+  const int lateClsIdx = g_iddClassCt - g_iddClassCt/10;
+  for( int clsIdx=0; clsIdx<g_iddClassCt; ++clsIdx )
+    {
+    if( lateClsIdx == clsIdx )
+      {
+      os << "\\group External Interface\n\n";
+      writeIddClasses(os, reqKeys + 6);
+      }
+    const int fldCt = 5 + clsIdx%60;
+    int aCt = 0, nCt = 0;
+    os << "Synthetic:Class" << clsIdx << ",\n"
+      "       \\memo Synthetic class " << clsIdx << ", with " << fldCt << " fields.\n"
+      "       \\min-fields 1\n";
+    for( int fldIdx=0; fldIdx<fldCt; ++fldIdx )
+      {
+      const char kind = (0==fldIdx || 0==fldIdx%4) ? 'A' : 'N';
+      os << "  " << kind << ('A'==kind ? ++aCt : ++nCt)
+        << (fldIdx+1<fldCt ? " , " : " ; ")
+        << "\\field Synthetic Field " << fldIdx+1 << "\n";
+      if( 'A' == kind )
+        {
+        os << "       \\type alpha\n"
+          "       \\note Free text, up to 100 characters.\n";
+        }
+      else
+        {
+        os << "       \\type real\n"
+          "       \\units W\n"
+          "       \\minimum 0.0\n"
+          "       \\default 1.0\n";
+        }
+      }
+    os << "\n";
+    }
+  //
+  os.close();
+  return( ! os.fail() );
+  }  // End fcn writeSyntheticIdd().
+
+
+//--- Write a synthetic IDF file of about {targetBytes} bytes.
+//
+//   The file has the objects the preprocessor looks for, surrounded by filler
+// objects of the kinds that dominate large IDF files: surfaces with vertices,
+// compact schedules, and output requests.  The {Timestep} object comes last,
+// so that getTimeStep() has to scan the whole file, as it would for an IDF
+// file that defines the time step after its geometry.
+//
+static bool writeSyntheticIdf(const string& fileName, long long targetBytes)
+  {
+  std::ofstream os(fileName.c_str(), std::ios::out | std::ios::trunc);
+  if( ! os.is_open() )
+    {
+    return( false );
+    }
+  //
+  os << "! Synthetic input file written by bench-fmu-export-prep.\n\n"
+    "  Version,8.4;\n\n"
+    "  RunPeriod,\n"
+    "    ,                        !- Name\n"
+    "    1,                       !- Begin Month\n"
+    "    1,                       !- Begin Day of Month\n"
+    "    12,                      !- End Month\n"
+    "    31,                      !- End Day of Month\n"
+    "    Tuesday,                 !- Day of Week for Start Day\n"
+    "    Yes,                     !- Use Weather File Holidays and Special Days\n"
+    "    Yes,                     !- Use Weather File Daylight Saving Period\n"
+    "    No,                      !- Apply Weekend Holiday Rule\n"
+    "    Yes,                     !- Use Weather File Rain Indicators\n"
+    "    Yes;                     !- Use Weather File Snow Indicators\n\n"
+    "  ExternalInterface,\n"
+    "    FunctionalMockupUnitExport;  !- Name of External Interface\n\n"
+    "  ExternalInterface:FunctionalMockupUnitExport:From:Variable,\n"
+    "    ZONE ONE,                !- Output:Variable Index Key Name\n"
+    "    Zone Mean Air Temperature,  !- Output:Variable Name\n"
+    "    TRooMea;                 !- FMU Variable Name\n\n"
+    "  ExternalInterface:FunctionalMockupUnitExport:To:Schedule,\n"
+    "    FMU_OthEqu_ZoneOne,      !- Schedule Name\n"
+    "    Fraction,                !- Schedule Type Limits Names\n"
+    "    Q,                       !- FMU Variable Name\n"
+    "    0;                       !- Initial Value\n\n";
+  //
+  // Filler objects.
+  long long objIdx = 0;
+  while( (long long)os.tellp() < targetBytes )
+    {
+    switch( objIdx%3 )
+      {
+      case 0:
+        os << "  BuildingSurface:Detailed,\n"
+          "    Surface " << objIdx << ",          !- Name\n"
+          "    Wall,                    !- Surface Type\n"
+          "    EXTWALL80,               !- Construction Name\n"
+          "    ZONE ONE,                !- Zone Name\n"
+          "    Outdoors,                !- Outside Boundary Condition\n"
+          "    ,                        !- Outside Boundary Condition Object\n"
+          "    SunExposed,              !- Sun Exposure\n"
+          "    WindExposed,             !- Wind Exposure\n"
+          "    0.50000000,              !- View Factor to Ground\n"
+          "    4,                       !- Number of Vertices\n"
+          "    0.000000,0.000000,4.572000,  !- X,Y,Z ==> Vertex 1 {m}\n"
+          "    0.000000,0.000000,0.000000,  !- X,Y,Z ==> Vertex 2 {m}\n"
+          "    15.24000,0.000000,0.000000,  !- X,Y,Z ==> Vertex 3 {m}\n"
+          "    15.24000,0.000000,4.572000;  !- X,Y,Z ==> Vertex 4 {m}\n\n";
+        break;
+      case 1:
+        os << "  Schedule:Compact,\n"
+          "    Schedule " << objIdx << ",         !- Name\n"
+          "    Fraction,                !- Schedule Type Limits Name\n"
+          "    Through: 12/31,          !- Field 1\n"
+          "    For: Weekdays SummerDesignDay,  !- Field 2\n"
+          "    Until: 08:00,0.0,        !- Field 3\n"
+          "    Until: 18:00,1.0,        !- Field 5\n"
+          "    Until: 24:00,0.0,        !- Field 7\n"
+          "    For: AllOtherDays,       !- Field 9\n"
+          "    Until: 24:00,0.0;        !- Field 10\n\n";
+        break;
+      default:
+        os << "  Output:Variable,\n"
+          "    Surface " << objIdx-2 << ",          !- Key Value\n"
+          "    Surface Inside Face Temperature,  !- Variable Name\n"
+          "    hourly;                  !- Reporting Frequency\n\n";
+        break;
+      }
+    ++objIdx;
+    }
+  //
+  os << "  Timestep,6;\n";
+  os.close();
+  return( ! os.fail() );
+  }  // End fcn writeSyntheticIdf().
+
+
+//--- Write a synthetic weather file.
+//
+//   Follow the layout of an EPW file: eight header lines, one of which holds
+// the leap year indicator, then one line per hour.
+//
+static bool writeSyntheticEpw(const string& fileName)
+  {
+  std::ofstream os(fileName.c_str(), std::ios::out | std::ios::trunc);
+  if( ! os.is_open() )
+    {
+    return( false );
+    }
+  //
+  os << "LOCATION,Synthetic,CA,USA,TMY3,724940,37.62,-122.40,-8.0,2.0\n"
+    "DESIGN CONDITIONS,0\n"
+    "TYPICAL/EXTREME PERIODS,0\n"
+    "GROUND TEMPERATURES,0\n"
+    "HOLIDAYS/DAYLIGHT SAVINGS,No,0,0,0\n"
+    "COMMENTS 1,Synthetic weather file written by bench-fmu-export-prep\n"
+    "COMMENTS 2,\n"
+    "DATA PERIODS,1,1,Data,Sunday, 1/ 1,12/31\n";
+  static const int daysPerMonth[] = {31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
+  int month = 1, day = 1, hour = 1;
+  for( int hrIdx=0; hrIdx<g_epwHourCt; ++hrIdx )
+    {
+    os << "1999," << month << "," << day << "," << hour << ",60,"
+      "?9?9?9?9E0?9?9?9?9?9?9?9?9?9?9?9?9?9?9?9*9*9?9?9?9,"
+      << 7.2+0.1*(hrIdx%50) << ",5.6,90,102200,0,0,288,0,0,0,0,0,0,0,"
+      "270,2.1,10,10,16.1,77777,9,999999999,0,0.0950,0,88,0.000,0.0,0.0\n";
+    if( 24 < ++hour )
+      {
+      hour = 1;
+      if( daysPerMonth[month-1] < ++day )
+        {
+        day = 1;
+        ++month;
+        }
+      }
+    }
+  //
+  os.close();
+  return( ! os.fail() );
+  }  // End fcn writeSyntheticEpw().
+
+
+//--- Check whether a stage reads the IDD file, rather than the IDF or weather file.
+//
+static bool stageReadsIdd(const string& stage)
+  {
+  return( 0 == stage.compare(0, 6, "getMap") || 0 == stage.compare("writeSnapshot")
+    || 0 == stage.compare("readSnapshot") );
+  }  // End fcn stageReadsIdd().
+
+
+//--- Run one stage of the pipeline.
+//
+//   Return the line number at which the stage failed, or 0 on success.
+// Runs in the child process.
+//
+static int runStage(const string& stage, const string& iddName, const string& idfName,
+  const string& epwName)
+  {
+  fmuExportIdfData fmuIdfData;
+  //
+  if( stageReadsIdd(stage) )
+    {
+    // Snapshot stages keep their snapshot next to the IDD file.
+    char md5Hex[33];
+    const string snapName = iddName + ".snap";
+    iddTable idd;
+    if( 0 == stage.compare("readSnapshot") )
+      {
+      digest_md5_fromFile(iddName.c_str(), md5Hex);
+      if( ! iddMap_readSnapshot(snapName.c_str(), md5Hex, idd) )
+        {
+        cerr << "Cannot read snapshot " << snapName << endl;
+        return( -1 );
+        }
+      }
+    else
+      {
+      fileReaderDictionary frIdd(iddName);
+      frIdd.attachErrorFcn(reportInputError);
+      frIdd.open();
+      if( 0 == stage.compare("getMapRequired") )
+        {
+        std::vector<string> requiredKeys;
+        fmuIdfData.getRequiredIddKeys(requiredKeys);
+        frIdd.getMap(idd, requiredKeys);  // Terminates on error.
+        }
+      else
+        {
+        frIdd.getMap(idd);  // Terminates on error.
+        }
+      if( 0 == stage.compare("writeSnapshot") )
+        {
+        digest_md5_fromFile(iddName.c_str(), md5Hex);
+        std::ofstream snapStream(snapName.c_str(), std::ios::out | std::ios::trunc | std::ios::binary);
+        if( ! iddMap_writeSnapshot(snapStream, idd, md5Hex) )
+          {
+          cerr << "Cannot write snapshot " << snapName << endl;
+          return( -1 );
+          }
+        }
+      }
+    string errStr;
+    if( ! fmuIdfData.haveValidIDD(idd, errStr) )
+      {
+      cerr << "Incompatible IDD file " << iddName << endl << errStr << endl;
+      return( -1 );
+      }
+    return( 0 );
+    }
+  //
+  // Here, stage reads either the IDF file or the weather file.
+  const bool readsEpw = (0 == stage.compare("isLeapYear"));
+  fileReaderData frIdf(readsEpw ? epwName : idfName, IDF_DELIMITERS_ENTRY, IDF_DELIMITERS_SECTION);
+  frIdf.attachErrorFcn(reportInputError);
+  frIdf.open();
+  if( 0 == stage.compare(0, 8, "populate") )
+    {
+    const int failLine = ( 0 == stage.compare("populateThreaded") )
+      ? fmuIdfData.populateFromIDF(frIdf, 0) : fmuIdfData.populateFromIDF(frIdf);
+    if( 0 == failLine && ! fmuIdfData.check() )
+      {
+      return( -1 );
+      }
+    return( failLine );
+    }
+  if( readsEpw )
+    {
+    int leapYear;
+    return( fmuIdfData.isLeapYear(frIdf, leapYear) );
+    }
+  if( 0 == stage.compare("writeInputFile") )
+    {
+    int timeStep;
+    return( fmuIdfData.writeInputFile(frIdf, 0, timeStep, g_tStartFMU, g_tStopFMU) );
+    }
+  if( 0 == stage.compare("getTimeStep") )
+    {
+    return( fmuIdfData.getTimeStep(frIdf) );
+    }
+  //
+  cerr << "Unknown stage " << stage << endl;
+  return( -1 );
+  }  // End fcn runStage().
+
+
+//--- Time one stage of the pipeline, and report its throughput.
+//
+//   Return true if the stage succeeded.
+//
+static bool benchStage(const string& stage, const string& iddName, const string& idfName,
+  const string& epwName)
+  {
+  //
+  // Find input size.
+  string inName;
+  long long objCt;
+  if( stageReadsIdd(stage) )
+    {
+    inName = iddName;
+    objCt = countObjects(inName, "!\\", ';');
+    }
+  else if( 0 == stage.compare("isLeapYear") )
+    {
+    inName = epwName;
+    objCt = countObjects(inName, "", '\n');
+    }
+  else
+    {
+    inName = idfName;
+    objCt = countObjects(inName, "!", ';');
+    }
+  const long long inBytes = fileSize(inName);
+  if( inBytes < 0 || objCt < 0 )
+    {
+    cerr << "Cannot read " << inName << ": " << strerror(errno) << endl;
+    return( false );
+    }
+  //
+  // Run the stage in a child, so that its peak resident set size is its own.
+  int fds[2];
+  if( 0 != pipe(fds) )
+    {
+    cerr << "Cannot create pipe: " << strerror(errno) << endl;
+    return( false );
+    }
+  cout.flush();
+  const pid_t pid = fork();
+  if( pid < 0 )
+    {
+    cerr << "Cannot fork: " << strerror(errno) << endl;
+    return( false );
+    }
+  if( 0 == pid )
+    {
+    close(fds[0]);
+    // Hide what the stages print, so that it does not mix with the table.
+    if( NULL == freopen("/dev/null", "w", stdout) )
+      {
+      _exit(EXIT_FAILURE);
+      }
+    stageResult_s res;
+    const double tStart = wallTime();
+    res.failLine = runStage(stage, iddName, idfName, epwName);
+    res.wallSec = wallTime() - tStart;
+    const bool wrote = (sizeof(res) == write(fds[1], &res, sizeof(res)));
+    close(fds[1]);
+    _exit(wrote ? EXIT_SUCCESS : EXIT_FAILURE);
+    }
+  close(fds[1]);
+  stageResult_s res;
+  const bool gotRes = (sizeof(res) == read(fds[0], &res, sizeof(res)));
+  close(fds[0]);
+  int status;
+  struct rusage ru;
+  if( pid != wait4(pid, &status, 0, &ru) || ! WIFEXITED(status)
+    || EXIT_SUCCESS != WEXITSTATUS(status) || ! gotRes )
+    {
+    cerr << "Stage " << stage << " did not finish on " << inName << endl;
+    return( false );
+    }
+  if( 0 != res.failLine )
+    {
+    cerr << "Stage " << stage << " failed on " << inName << ", at line #" << res.failLine << endl;
+    return( false );
+    }
+  //
+  // Report.
+  const double inMB = inBytes / (1024.0*1024.0);
+  #ifdef __APPLE__
+    const double rssMB = ru.ru_maxrss / (1024.0*1024.0);
+  #else
+    const double rssMB = ru.ru_maxrss / 1024.0;
+  #endif
+  char line[256];
+  snprintf(line, sizeof(line), "%-16s %9.2f %10lld %9.3f %9.2f %12.0f %9.1f",
+    stage.c_str(), inMB, objCt, res.wallSec,
+    inMB/res.wallSec, objCt/res.wallSec, rssMB);
+  cout << line << endl;
+  return( true );
+  }  // End fcn benchStage().
+
+
+//--- Time all stages of the pipeline on one set of files.
+//
+static bool benchPipeline(const string& iddName, const string& idfName, const string& epwName)
+  {
+  static const char* const stages[] = {
+    "getMap", "getMapRequired", "writeSnapshot", "readSnapshot",
+    "populateFromIDF", "populateThreaded", "isLeapYear", "writeInputFile", "getTimeStep", NULL
+    };
+  //
+  cout << endl << "IDD file: " << iddName << endl
+    << "IDF file: " << idfName << endl
+    << "Weather file: " << epwName << endl << endl
+    << "stage                   MB    objects    time s      MB/s    objects/s  peak RSS MB" << endl;
+  bool allOK = true;
+  for( int idx=0; NULL!=stages[idx]; ++idx )
+    {
+    allOK = benchStage(stages[idx], iddName, idfName, epwName) && allOK;
+    }
+  return( allOK );
+  }  // End fcn benchPipeline().
+
+
+//--- Return the absolute path of an existing file.
+//
+static string absolutePath(const char* fileName)
+  {
+  char buf[PATH_MAX];
+  if( NULL == realpath(fileName, buf) )
+    {
+    cerr << "Cannot find " << fileName << ": " << strerror(errno) << endl;
+    exit(EXIT_FAILURE);
+    }
+  return( string(buf) );
+  }  // End fcn absolutePath().
+
+
+//--- Main driver.
+//
+int main(int argc, const char* argv[])
+  {
+  //
+  // Check arguments.
+  //   Sizes are numbers; anything else is a file name.
+  vector<double> sizesMB;
+  bool haveFiles = false;
+  for( int idx=1; idx<argc; ++idx )
+    {
+    char* end;
+    const double sizeMB = strtod(argv[idx], &end);
+    if( end == argv[idx] || '\0' != *end )
+      {
+      haveFiles = true;
+      }
+    else if( 0 < sizeMB )
+      {
+      sizesMB.push_back(sizeMB);
+      }
+    }
+  if( (haveFiles && (0 != sizesMB.size() || argc < 3 || 4 < argc)) )
+    {
+    cout << "Usage: " << argv[0] << "  [IDF size in MB ...]" << endl
+      << "       " << argv[0] << "  <IDD file>  <IDF file>  [weather file]" << endl;
+    return( EXIT_FAILURE );
+    }
+  if( ! haveFiles && 0 == sizesMB.size() )
+    {
+    sizesMB.push_back(1);
+    sizesMB.push_back(10);
+    sizesMB.push_back(100);
+    }
+  string iddName, idfName, epwName;
+  if( haveFiles )
+    {
+    iddName = absolutePath(argv[1]);
+    idfName = absolutePath(argv[2]);
+    if( 4 == argc )
+      {
+      epwName = absolutePath(argv[3]);
+      }
+    }
+  //
+  // Work in own directory, since the stages write their output files to
+  // the current working directory.
+  if( 0 != mkdir(g_benchDir, 0755) && EEXIST != errno )
+    {
+    cerr << "Cannot create directory " << g_benchDir << ": " << strerror(errno) << endl;
+    return( EXIT_FAILURE );
+    }
+  if( 0 != chdir(g_benchDir) )
+    {
+    cerr << "Cannot change to directory " << g_benchDir << ": " << strerror(errno) << endl;
+    return( EXIT_FAILURE );
+    }
+  //
+  // Write synthetic inputs.
+  if( 0 == epwName.length() )
+    {
+    epwName = "synthetic.epw";
+    if( ! writeSyntheticEpw(epwName) )
+      {
+      cerr << "Cannot write " << epwName << endl;
+      return( EXIT_FAILURE );
+      }
+    }
+  if( haveFiles )
+    {
+    return( benchPipeline(iddName, idfName, epwName) ? EXIT_SUCCESS : EXIT_FAILURE );
+    }
+  iddName = "synthetic.idd";
+  if( ! writeSyntheticIdd(iddName) )
+    {
+    cerr << "Cannot write " << iddName << endl;
+    return( EXIT_FAILURE );
+    }
+  //
+  // Run pipeline for each size.
+  bool allOK = true;
+  for( size_t idx=0; idx<sizesMB.size(); ++idx )
+    {
+    std::ostringstream os;
+    os << "synthetic-" << sizesMB[idx] << "MB.idf";
+    idfName = os.str();
+    if( ! writeSyntheticIdf(idfName, (long long)(sizesMB[idx]*1024.0*1024.0)) )
+      {
+      cerr << "Cannot write " << idfName << endl;
+      return( EXIT_FAILURE );
+      }
+    allOK = benchPipeline(iddName, idfName, epwName) && allOK;
+    remove(idfName.c_str());
+    }
+  //
+  return( allOK ? EXIT_SUCCESS : EXIT_FAILURE );
+  }  // End fcn main().
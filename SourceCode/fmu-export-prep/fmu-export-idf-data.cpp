@@ -10,10 +10,14 @@
 //
 #include <assert.h>
 
+#include <cctype>
 #include <sstream>
 #include <iostream>
 #include <fstream>
+#include <cstring>
+#include <set>
 #include <string>
+#include <vector>
 using namespace std;
 using std::string;
 using std::cerr;
@@ -24,6 +28,11 @@ using std::endl;
 
 #include "../utility/string-help.h"
 
+#ifndef _WIN32
+#include <pthread.h>
+#include <unistd.h>
+#endif
+
 //--- Microsoft doesn't implement the modern standard.
 //
 #ifdef _MSC_VER
@@ -31,6 +40,15 @@ using std::endl;
 #endif
 
 
+//--- Preprocessor definitions.
+//
+// Smallest part of an IDF file worth scanning on a thread of its own.
+#define IDF_PART_MIN_BYTES (4*1024*1024)
+//
+// Parts per thread, so that threads that finish early can take on more.
+#define IDF_PARTS_PER_THREAD 4
+
+
 //--- File-scope constants.
 //
 // Expected keywords and dictionary descriptors.
@@ -62,6 +80,46 @@ const string g_desc_extInt_fmuExport_fromVar = "AAA";
 //
 const string g_key_extInt_fmuExport_toVar = "EXTERNALINTERFACE:FUNCTIONALMOCKUPUNITEXPORT:TO:VARIABLE";
 const string g_desc_extInt_fmuExport_toVar = "AAN";
+//
+// Keywords that populateFromIDF() handles, as found by findIdfKey().
+enum idfKey_e {
+  IDF_KEY_NONE,
+  IDF_KEY_EXTINT,
+  IDF_KEY_EXTINT_FMUEXPORT_TOACTUATOR,
+  IDF_KEY_EXTINT_FMUEXPORT_TOSCHED,
+  IDF_KEY_EXTINT_FMUEXPORT_FROMVAR,
+  IDF_KEY_EXTINT_FMUEXPORT_TOVAR
+  };
+
+
+//--- File-scope types.
+//
+#ifndef _WIN32
+// Part of an IDF file, for populateFromIDF() on several threads.
+struct idfPart_s {
+  const char* beg;
+  const char* end;
+  int newlineCt;
+  bool goodRead;
+  };
+//
+// Parts of an IDF file, and the next one for a thread to take.
+struct idfPartPool_s {
+  const fileReaderData* frIdf;
+  std::vector<idfPart_s>* parts;
+  std::vector<fmuExportIdfData>* partData;
+  size_t nextPartIdx;
+  pthread_mutex_t mutex;
+  };
+#endif
+
+
+//--- File-scope fcn prototypes.
+//
+static idfKey_e findIdfKey(const char* str, size_t len);
+#ifndef _WIN32
+static void* scanIdfParts(void* poolVoid);
+#endif
 
 
 //--- Functions.
@@ -96,7 +154,18 @@ fmuExportIdfData::fmuExportIdfData(void)
     assert( _fromVar_epKeyName.empty() );
     assert( _fromVar_epVarName.empty() );
     assert( _fromVar_fmuVarName.empty() );
-	assert(_runPer_numerics.empty())
+	assert(_runPer_numerics.empty());
+    //
+    // findIdfKey() must recognize every keyword handled by populateFromIDF().
+    assert( IDF_KEY_EXTINT == findIdfKey(g_key_extInt.data(), g_key_extInt.length()) );
+    assert( IDF_KEY_EXTINT_FMUEXPORT_TOACTUATOR == findIdfKey(g_key_extInt_fmuExport_toActuator.data(),
+      g_key_extInt_fmuExport_toActuator.length()) );
+    assert( IDF_KEY_EXTINT_FMUEXPORT_TOSCHED == findIdfKey(g_key_extInt_fmuExport_toSched.data(),
+      g_key_extInt_fmuExport_toSched.length()) );
+    assert( IDF_KEY_EXTINT_FMUEXPORT_FROMVAR == findIdfKey(g_key_extInt_fmuExport_fromVar.data(),
+      g_key_extInt_fmuExport_fromVar.length()) );
+    assert( IDF_KEY_EXTINT_FMUEXPORT_TOVAR == findIdfKey(g_key_extInt_fmuExport_toVar.data(),
+      g_key_extInt_fmuExport_toVar.length()) );
   #endif
   }  // End constructor fmuExportIdfData::fmuExportIdfData().
 
@@ -109,9 +178,17 @@ void fmuExportIdfData::attachErrorFcn(void (*errFcn)(std::ostringstream& errorMe
   }  // End method fmuExportIdfData::attachErrorFcn().
 
 
+//--- Set the folder for the files written.
+//
+void fmuExportIdfData::setOutputDir(const string& dirName)
+  {
+  _outDirName = dirName;
+  }  // End method fmuExportIdfData::setOutputDir().
+
+
 //--- Validate IDD file.
 //
-bool fmuExportIdfData::haveValidIDD(const iddMap& idd, string& errStr) const
+bool fmuExportIdfData::haveValidIDD(const iddTable& idd, string& errStr) const
   {
   //
   #ifdef _DEBUG
@@ -129,6 +206,32 @@ bool fmuExportIdfData::haveValidIDD(const iddMap& idd, string& errStr) const
     );
   }  // End method fmuExportIdfData::haveValidIDD().
 
+
+//--- Validate IDD file, given as an {iddMap}.
+//
+bool fmuExportIdfData::haveValidIDD(const iddMap& idd, string& errStr) const
+  {
+  //
+  iddTable iddTab;
+  iddTab.assign(idd);
+  return( haveValidIDD(iddTab, errStr) );
+  }  // End method fmuExportIdfData::haveValidIDD().
+
+
+//--- List the keywords checked by haveValidIDD().
+//
+void fmuExportIdfData::getRequiredIddKeys(std::vector<string>& keys) const
+  {
+  //
+  keys.clear();
+  keys.push_back(g_key_runPer);
+  keys.push_back(g_key_extInt);
+  keys.push_back(g_key_extInt_fmuExport_toActuator);
+  keys.push_back(g_key_extInt_fmuExport_toSched);
+  keys.push_back(g_key_extInt_fmuExport_fromVar);
+  keys.push_back(g_key_extInt_fmuExport_toVar);
+  }  // End method fmuExportIdfData::getRequiredIddKeys().
+
 ///////////////////////////////////////////////////////////////////////////////
 /// This function calculates the modulo of two doubles. 
 ///
@@ -612,13 +715,85 @@ static int getCurrentDayOfWeek(double t_start_idf, double t_start_fmu,
 		return 0;
 }
 
+//--- Identify an IDF keyword handled by populateFromIDF().
+//
+//   Case-insensitive, and works on the keyword in place.
+//
+//   Every handled keyword starts with "EXTERNALINTERFACE", and their lengths
+// and one distinguishing byte pick out a single candidate.  So nearly every
+// other IDF object gets rejected on its length or its first four bytes, and
+// at most one full comparison is ever needed.
+//
+//   Keep in step with the {g_key_*} strings.  Debug builds check this in the
+// constructor.
+//
+static idfKey_e findIdfKey(const char* str, size_t len)
+  {
+  //
+  // Reject by length.
+  if( 17 != len && 56 != len && 58 != len )
+    {
+    return( IDF_KEY_NONE );
+    }
+  //
+  // Reject by first bytes.
+  //   Setting bit 0x20 lower-cases a letter, and maps no other byte onto
+  // a lower-case letter.
+  unsigned int head, expectHead;
+  memcpy(&head, str, 4);
+  memcpy(&expectHead, "exte", 4);
+  if( expectHead != (head | 0x20202020u) )
+    {
+    return( IDF_KEY_NONE );
+    }
+  //
+  // Pick candidate.
+  const string* candKey;
+  idfKey_e candId;
+  if( 17 == len )
+    {
+    candKey = &g_key_extInt;
+    candId = IDF_KEY_EXTINT;
+    }
+  else if( 58 == len )
+    {
+    candKey = &g_key_extInt_fmuExport_fromVar;
+    candId = IDF_KEY_EXTINT_FMUEXPORT_FROMVAR;
+    }
+  else
+    {
+    // Here, "...:TO:ACTUATOR", "...:TO:SCHEDULE", or "...:TO:VARIABLE".
+    switch( str[len-5] | 0x20 )
+      {
+      case 'u':
+        candKey = &g_key_extInt_fmuExport_toActuator;
+        candId = IDF_KEY_EXTINT_FMUEXPORT_TOACTUATOR;
+        break;
+      case 'e':
+        candKey = &g_key_extInt_fmuExport_toSched;
+        candId = IDF_KEY_EXTINT_FMUEXPORT_TOSCHED;
+        break;
+      case 'i':
+        candKey = &g_key_extInt_fmuExport_toVar;
+        candId = IDF_KEY_EXTINT_FMUEXPORT_TOVAR;
+        break;
+      default:
+        return( IDF_KEY_NONE );
+      }
+    }
+  //
+  // Confirm candidate.
+  return( equalsCapitalized(*candKey, str, len) ? candId : IDF_KEY_NONE );
+  }  // End fcn findIdfKey().
+
+
 //--- Read IDF file, collecting data needed to export an EnergyPlus simulation as an FMU.
 //
 int fmuExportIdfData::populateFromIDF(fileReaderData& frIdf)
   {
   //
   int lineNo;
-  string idfKey, iddDesc;
+  fileReaderSpan idfKey;
   //
   #ifdef _DEBUG
     assert( ! frIdf.isEOF() );
@@ -632,43 +807,44 @@ int fmuExportIdfData::populateFromIDF(fileReaderData& frIdf)
   while( _goodRead )
     {
     // Here, assume looking for next keyword.
-    frIdf.skipComment(IDF_COMMENT_CHARS, lineNo);
-    frIdf.getToken(IDF_DELIMITERS_ALL, IDF_COMMENT_CHARS, idfKey);
+    frIdf.skipComment(IDF_CHAR_CLASS_ALL, lineNo);
+    frIdf.getToken(IDF_CHAR_CLASS_ALL, idfKey);
     // Consume the delimiter that caused getToken() to return.
     const char delimChar = frIdf.getChar();
     if( frIdf.isEOF() )
       {
       // Here, hit EOF.
       //   OK to hit EOF, provided don't actually have a keyword.
-      if( 0 != idfKey.length() )
+      if( 0 != idfKey.len )
         {
         _goodRead = false;
         std::ostringstream os;
-        os << "Error: IDF file ends after keyword '" << idfKey << "' on line " << lineNo;
+        os << "Error: IDF file ends after keyword '" << idfKey.str() << "' on line " << lineNo;
         reportError(os);
         }
       break;
       }
     // Here, have a keyword (although may be zero length).
-    capitalize(idfKey);
+    //   Identify it, without copying it out of the file.
     // Handle or skip IDF entry for this keyword.
-    if( 0 == g_key_extInt.compare(idfKey) )
+    const idfKey_e keyId = findIdfKey(idfKey.beg, idfKey.len);
+    if( IDF_KEY_EXTINT == keyId )
       {
       handleKey_extInt(frIdf);
       }
-    else if( 0 == g_key_extInt_fmuExport_toActuator.compare(idfKey) )
+    else if( IDF_KEY_EXTINT_FMUEXPORT_TOACTUATOR == keyId )
       {
       handleKey_extInt_fmuExport_toActuator(frIdf);
       }
-    else if( 0 == g_key_extInt_fmuExport_toSched.compare(idfKey) )
+    else if( IDF_KEY_EXTINT_FMUEXPORT_TOSCHED == keyId )
       {
       handleKey_extInt_fmuExport_toSched(frIdf);
       }
-    else if( 0 == g_key_extInt_fmuExport_fromVar.compare(idfKey) )
+    else if( IDF_KEY_EXTINT_FMUEXPORT_FROMVAR == keyId )
       {
       handleKey_extInt_fmuExport_fromVar(frIdf);
       }
-    else if( 0 == g_key_extInt_fmuExport_toVar.compare(idfKey) )
+    else if( IDF_KEY_EXTINT_FMUEXPORT_TOVAR == keyId )
       {
       handleKey_extInt_fmuExport_toVar(frIdf);
       }
@@ -698,6 +874,266 @@ int fmuExportIdfData::populateFromIDF(fileReaderData& frIdf)
   return( lineNo );
   }  // End method fmuExportIdfData::populateFromIDF().
 
+
+//--- Read IDF file, scanning parts of a large file on several threads.
+//
+//   Split the file just after section delimiters that are not in comments.
+// The one-pass read ends a section at each of these, so a reader of any part
+// starts where the one-pass read would look for the next keyword, and reads
+// that part the same way.  Only the line numbers differ, by the count of
+// lines before the part.
+//
+//   Parts do not see each other's entries, so check the names for duplicates
+// after all the parts are done.
+//
+int fmuExportIdfData::populateFromIDF(fileReaderData& frIdf, int threadCt)
+  {
+  #ifdef _WIN32
+    // Here, no thread pool.
+    return( populateFromIDF(frIdf) );
+  #else
+    //
+    if( threadCt <= 0 )
+      {
+      const long cpuCt = sysconf(_SC_NPROCESSORS_ONLN);
+      threadCt = ( 0 < cpuCt ) ? (int)cpuCt : 1;
+      }
+    //
+    // Split the file into parts.
+    //   Read small files in one pass.
+    const char* idfBeg;
+    const char* idfEnd;
+    frIdf.getContents(idfBeg, idfEnd);
+    int partCt = threadCt * IDF_PARTS_PER_THREAD;
+    const size_t maxPartCt = (size_t)(idfEnd - idfBeg) / IDF_PART_MIN_BYTES;
+    if( maxPartCt < (size_t)partCt )
+      {
+      partCt = (int)maxPartCt;
+      }
+    std::vector<const char*> partBounds;
+    if( 1 < threadCt && 1 < partCt )
+      {
+      frIdf.splitAtSections(partCt, partBounds);
+      }
+    if( partBounds.size() < 3 )
+      {
+      return( populateFromIDF(frIdf) );
+      }
+    partCt = (int)partBounds.size() - 1;
+    std::vector<idfPart_s> parts(partCt);
+    for( int partIdx=0; partIdx<partCt; ++partIdx )
+      {
+      parts[partIdx].beg = partBounds[partIdx];
+      parts[partIdx].end = partBounds[partIdx+1];
+      parts[partIdx].newlineCt = 0;
+      parts[partIdx].goodRead = false;
+      }
+    std::vector<fmuExportIdfData> partData(partCt);
+    //
+    // Scan the parts on a pool of threads, including this one.
+    //   If cannot start a thread, make do with the ones already started.
+    idfPartPool_s pool;
+    pool.frIdf = &frIdf;
+    pool.parts = &parts;
+    pool.partData = &partData;
+    pool.nextPartIdx = 0;
+    pthread_mutex_init(&pool.mutex, NULL);
+    if( partCt < threadCt )
+      {
+      threadCt = partCt;
+      }
+    std::vector<pthread_t> threads(threadCt-1);
+    int startedCt = 0;
+    while( startedCt < threadCt-1
+      &&
+      0 == pthread_create(&threads[startedCt], NULL, scanIdfParts, &pool) )
+      {
+      ++startedCt;
+      }
+    scanIdfParts(&pool);
+    for( int threadIdx=0; threadIdx<startedCt; ++threadIdx )
+      {
+      pthread_join(threads[threadIdx], NULL);
+      }
+    pthread_mutex_destroy(&pool.mutex);
+    //
+    // Check the parts.
+    //   On any problem, read the file again in one pass, so that the errors
+    // get reported with the usual messages and line numbers.
+    bool goodParts = true;
+    for( int partIdx=0; partIdx<partCt && goodParts; ++partIdx )
+      {
+      goodParts = ( parts[partIdx].goodRead && partData[partIdx]._goodRead );
+      }
+    if( ! goodParts || haveDuplicateNames(partData) )
+      {
+      return( populateFromIDF(frIdf) );
+      }
+    //
+    // Collect the data of the parts, in order.
+    int lineNoOffset = 0;
+    for( int partIdx=0; partIdx<partCt; ++partIdx )
+      {
+      appendIdfData(partData[partIdx], lineNoOffset);
+      lineNoOffset += parts[partIdx].newlineCt;
+      }
+    //
+    frIdf.close();
+    _goodRead = true;
+    return( 0 );
+  #endif
+  }  // End method fmuExportIdfData::populateFromIDF().
+
+
+#ifndef _WIN32
+//--- Ignore errors found while scanning part of an IDF file.
+//
+//   The caller reads the file again to report them.
+//
+static void ignoreReadError(std::ostringstream&, const std::string&, int)
+  {
+  }  // End fcn ignoreReadError().
+
+static void ignoreIdfError(std::ostringstream&)
+  {
+  }  // End fcn ignoreIdfError().
+
+
+//--- Scan parts of an IDF file, until none are left.
+//
+//   Run on each thread of the pool.  Each part gets its own reader and data.
+//
+static void* scanIdfParts(void* poolVoid)
+  {
+  idfPartPool_s& pool = *(idfPartPool_s*)poolVoid;
+  //
+  while( 1 )
+    {
+    pthread_mutex_lock(&pool.mutex);
+    const size_t partIdx = pool.nextPartIdx++;
+    pthread_mutex_unlock(&pool.mutex);
+    if( pool.parts->size() <= partIdx )
+      {
+      break;
+      }
+    idfPart_s& part = (*pool.parts)[partIdx];
+    fmuExportIdfData& partData = (*pool.partData)[partIdx];
+    //
+    // Count the lines, for the line numbers of the following parts.
+    int newlineCt = 0;
+    for( const char* cur=part.beg;
+      NULL != (cur = (const char*)memchr(cur, '\n', part.end - cur)); ++cur )
+      {
+      ++newlineCt;
+      }
+    part.newlineCt = newlineCt;
+    //
+    // Scan.
+    fileReaderData frPart("", IDF_DELIMITERS_ENTRY, IDF_DELIMITERS_SECTION);
+    frPart.attachErrorFcn(ignoreReadError);
+    frPart.setExitOnError(false);
+    frPart.openPart(*pool.frIdf, part.beg, part.end);
+    partData.attachErrorFcn(ignoreIdfError);
+    part.goodRead = ( 0 == partData.populateFromIDF(frPart) );
+    part.goodRead = ( part.goodRead && 0 == frPart.getErrorCount() );
+    }
+  //
+  return( NULL );
+  }  // End fcn scanIdfParts().
+#endif
+
+
+//--- Add names to a set.
+//
+//   Return {true} if any of them was already there.
+//
+static bool insertNames(std::set<string>& names, const std::vector<string>& newNames)
+  {
+  for( size_t idx=0; idx<newNames.size(); ++idx )
+    {
+    if( ! names.insert(newNames[idx]).second )
+      {
+      return( true );
+      }
+    }
+  return( false );
+  }  // End fcn insertNames().
+
+
+//--- Check for names repeated across parts of an IDF file.
+//
+//   Check the same names as the handlers of the keywords, including those
+// already held.
+//
+bool fmuExportIdfData::haveDuplicateNames(const std::vector<fmuExportIdfData>& parts) const
+  {
+  std::set<string> toActuatorNames, toSchedNames, fromVarNames, toVarNames;
+  //
+  if( insertNames(toActuatorNames, _toActuator_epName) ||
+    insertNames(toSchedNames, _toSched_epSchedName) ||
+    insertNames(fromVarNames, _fromVar_fmuVarName) ||
+    insertNames(toVarNames, _toVar_epName) )
+    {
+    return( true );
+    }
+  for( size_t partIdx=0; partIdx<parts.size(); ++partIdx )
+    {
+    const fmuExportIdfData& part = parts[partIdx];
+    if( insertNames(toActuatorNames, part._toActuator_epName) ||
+      insertNames(toSchedNames, part._toSched_epSchedName) ||
+      insertNames(fromVarNames, part._fromVar_fmuVarName) ||
+      insertNames(toVarNames, part._toVar_epName) )
+      {
+      return( true );
+      }
+    }
+  //
+  return( false );
+  }  // End method fmuExportIdfData::haveDuplicateNames().
+
+
+//--- Append line numbers, adding an offset.
+//
+static void appendLineNos(std::vector<int>& lineNos, const std::vector<int>& partLineNos, int lineNoOffset)
+  {
+  for( size_t idx=0; idx<partLineNos.size(); ++idx )
+    {
+    lineNos.push_back(partLineNos[idx] + lineNoOffset);
+    }
+  }  // End fcn appendLineNos().
+
+
+//--- Append the data read from part of an IDF file.
+//
+//   Line numbers of the part count from its start, so add the count of lines
+// before it.
+//
+void fmuExportIdfData::appendIdfData(const fmuExportIdfData& part, int lineNoOffset)
+  {
+  //
+  appendLineNos(_toActuator_idfLineNo, part._toActuator_idfLineNo, lineNoOffset);
+  _toActuator_epName.insert(_toActuator_epName.end(), part._toActuator_epName.begin(), part._toActuator_epName.end());
+  _toActuator_fmuVarName.insert(_toActuator_fmuVarName.end(), part._toActuator_fmuVarName.begin(), part._toActuator_fmuVarName.end());
+  _toActuator_initValue.insert(_toActuator_initValue.end(), part._toActuator_initValue.begin(), part._toActuator_initValue.end());
+  //
+  appendLineNos(_toSched_idfLineNo, part._toSched_idfLineNo, lineNoOffset);
+  _toSched_epSchedName.insert(_toSched_epSchedName.end(), part._toSched_epSchedName.begin(), part._toSched_epSchedName.end());
+  _toSched_fmuVarName.insert(_toSched_fmuVarName.end(), part._toSched_fmuVarName.begin(), part._toSched_fmuVarName.end());
+  _toSched_initValue.insert(_toSched_initValue.end(), part._toSched_initValue.begin(), part._toSched_initValue.end());
+  //
+  appendLineNos(_toVar_idfLineNo, part._toVar_idfLineNo, lineNoOffset);
+  _toVar_epName.insert(_toVar_epName.end(), part._toVar_epName.begin(), part._toVar_epName.end());
+  _toVar_fmuVarName.insert(_toVar_fmuVarName.end(), part._toVar_fmuVarName.begin(), part._toVar_fmuVarName.end());
+  _toVar_initValue.insert(_toVar_initValue.end(), part._toVar_initValue.begin(), part._toVar_initValue.end());
+  //
+  appendLineNos(_fromVar_idfLineNo, part._fromVar_idfLineNo, lineNoOffset);
+  _fromVar_epKeyName.insert(_fromVar_epKeyName.end(), part._fromVar_epKeyName.begin(), part._fromVar_epKeyName.end());
+  _fromVar_epVarName.insert(_fromVar_epVarName.end(), part._fromVar_epVarName.begin(), part._fromVar_epVarName.end());
+  _fromVar_fmuVarName.insert(_fromVar_fmuVarName.end(), part._fromVar_fmuVarName.begin(), part._fromVar_fmuVarName.end());
+  //
+  _gotKeyExtInt = ( _gotKeyExtInt || part._gotKeyExtInt );
+  }  // End method fmuExportIdfData::appendIdfData().
+
 //--- Read IDF file, collecting data needed to run an EnergyPlus simulation as an FMU.
 //
 int fmuExportIdfData::writeInputFile(fileReaderData& frIdf, int leapYear, int &tStepVal, string tStartFMU, string tStopFMU)
@@ -705,9 +1141,12 @@ int fmuExportIdfData::writeInputFile(fileReaderData& frIdf, int leapYear, int &t
 	//
 	int lineNo;
 	int nRunPer;
+	int nTStep;
+	bool atObjectStart, inTStep;
 	string inputKey, iddDesc, inputKeyExt;
 	string line;
 	ofstream runInfile;
+	ofstream tStepfile;
 	//
 #ifdef _DEBUG
 	assert(!frIdf.isEOF());
@@ -716,23 +1155,44 @@ int fmuExportIdfData::writeInputFile(fileReaderData& frIdf, int leapYear, int &t
 	// Initialize.
 	lineNo = 0;
 	nRunPer = 0;
-	//nTStep = 0;
+	nTStep = 0;
+	tStepVal = 0;
+	// Track whether the next token starts an object, and whether it is the
+	// field of a Timestep object.
+	atObjectStart = true;
+	inTStep = false;
 	_goodRead = true;
 	//
 	// Run through the IDF file.
 #define HS_MAX 10
 
-	runInfile.open("runinfile.idf");
+	runInfile.open((_outDirName + "runinfile.idf").c_str());
 	char valueStr[HS_MAX];
 	while (_goodRead)
 	{
-		frIdf.skipComment(IDF_COMMENT_CHARS, lineNo);
+		frIdf.skipComment(IDF_CHAR_CLASS_ALL, lineNo);
 		//frIdf.getToken(IDF_DELIMITERS_ALL, IDF_COMMENT_CHARS, inputKey, inputKeyExt);
-		frIdf.getToken(IDF_DELIMITERS_ALL, IDF_COMMENT_CHARS, inputKey, inputKeyExt);
+		frIdf.getToken(IDF_CHAR_CLASS_ALL, inputKey, inputKeyExt);
 		// Consume the delimiter that caused getToken() to return.
 		char delimChar = frIdf.getChar();		
 		capitalize(inputKey);
 
+		// collect the time step on the way, from the first Timestep object,
+		// so that the IDF file need not be read again by getTimeStep().
+		if (inTStep){
+			inTStep = false;
+			if (';' == delimChar && 0 == nTStep++){
+				tStepVal = atoi(inputKey.c_str());
+				tStepfile.open((_outDirName + "tstep.txt").c_str());
+				tStepfile << inputKey;
+				tStepfile.close();
+			}
+		}
+		else if (atObjectStart && ',' == delimChar && 0 == g_key_timeStep.compare(inputKey)){
+			inTStep = true;
+		}
+		atObjectStart = (';' == delimChar);
+
 		// handle all Output: explicitely to make sure that we do not 
 		// get a runperiod which we shouldn't be getting.
 		// key RunPeriod is only used in Output: thus we can handle them 
@@ -744,11 +1204,12 @@ int fmuExportIdfData::writeInputFile(fileReaderData& frIdf, int leapYear, int &t
 			while (';' != delimChar)
 			{
 				// Here, hit EOF.
-				frIdf.skipComment(IDF_COMMENT_CHARS, lineNo);
-				frIdf.getToken(IDF_DELIMITERS_ALL, IDF_COMMENT_CHARS, inputKey, inputKeyExt);
+				frIdf.skipComment(IDF_CHAR_CLASS_ALL, lineNo);
+				frIdf.getToken(IDF_CHAR_CLASS_ALL, inputKey, inputKeyExt);
 				runInfile << inputKeyExt << '\n';
 				delimChar = frIdf.getChar();
 			}
+			atObjectStart = true;
 		}
 
 		// handle RunPeriod
@@ -756,6 +1217,17 @@ int fmuExportIdfData::writeInputFile(fileReaderData& frIdf, int leapYear, int &t
 				nRunPer++;
 				if (nRunPer < 2){
 					handleKey_runPer(frIdf);
+					// handleKey_runPer() consumed the end of the object.
+					atObjectStart = true;
+					// Need the begin month, begin day, and day of week below.
+					if (_runPer_numerics.size() < 2 || _runPer_strings.size() < 2){
+						_goodRead = false;
+						lineNo = frIdf.getLineNumber();
+						std::ostringstream os;
+						os << "Error: Incomplete RunPeriod object, ending on line " << lineNo;
+						reportError(os);
+						break;
+					}
 					std::string runPeriod("RUNPERIOD, \n");
 					if (_runPer_strings.size() > 1){
 						runPeriod.append(_runPer_strings[0]);
@@ -853,6 +1325,15 @@ int fmuExportIdfData::writeInputFile(fileReaderData& frIdf, int leapYear, int &t
 		// Here, ready to look for next keyword.
 	}
 
+	// Report if we couldn't find a time step in the file.
+	if (_goodRead && nTStep == 0){
+		_goodRead = false;
+		lineNo = frIdf.getLineNumber();
+		std::ostringstream os;
+		os << "Error: There is no TimeStep object in the IDF input file";
+		reportError(os);
+	}
+
 	// Here, ran through whole IDF file.
 	frIdf.close();
 	runInfile.close();
@@ -872,10 +1353,9 @@ int fmuExportIdfData::isLeapYear(fileReaderData& frIdf, int &leapYear)
 	//
 	int lineNo;
 	int nLeapYear;
-	string inputKey, iddDesc;
-	string line, inputKeyExt;
+	string inputKey;
 	ofstream runWeafile;
-	runWeafile.open("runweafile.epw");
+	runWeafile.open((_outDirName + "runweafile.epw").c_str());
 	//
 #ifdef _DEBUG
 	assert(!frIdf.isEOF());
@@ -887,40 +1367,52 @@ int fmuExportIdfData::isLeapYear(fileReaderData& frIdf, int &leapYear)
 	nLeapYear = 0;
 	_goodRead = true;
 	//
-	// Run through the IDF file.
-	while (_goodRead)
+	// Run through the header lines of the weather file.
+	//   The header ends at the first line that starts with a digit, which is
+	// the year of the first data line.  Look for the leap year indicator in
+	// the field after keyword {g_key_leapYear}.
+	const char* wthBeg;
+	const char* wthEnd;
+	frIdf.getContents(wthBeg, wthEnd);
+	const char* lineBeg = wthBeg;
+	while (lineBeg != wthEnd && !isdigit((unsigned char)*lineBeg))
 	{
-		frIdf.getToken(",", IDF_COMMENT_CHARS, inputKey, inputKeyExt);
-		// Consume the delimiter that caused getToken() to return.
-		const char delimChar = frIdf.getChar();
-		capitalize(inputKey);
-		if (inputKey.find(g_key_leapYear) != string::npos){
-			nLeapYear++;
-			runWeafile << inputKeyExt;
-			frIdf.getToken(",", IDF_COMMENT_CHARS, inputKey, inputKeyExt);
-			capitalize(inputKey);
-			if (0== inputKey.compare("YES")){
-				leapYear = 1;
-			}
-		}
-		// Write weather file
-		runWeafile << inputKeyExt;
-		if (frIdf.isEOF())
+		const char* lineEnd = (const char*)memchr(lineBeg, '\n', wthEnd - lineBeg);
+		if (NULL == lineEnd)
+			lineEnd = wthEnd;
+		const char* fieldsEnd = lineEnd;
+		if (fieldsEnd != lineBeg && '\r' == fieldsEnd[-1])
+			--fieldsEnd;
+		const char* keyEnd = (const char*)memchr(lineBeg, ',', fieldsEnd - lineBeg);
+		if (NULL != keyEnd)
 		{
-			// Here, hit EOF.
-			//   OK to hit EOF, provided don't actually have a keyword.
-			if (nLeapYear == 0){
-				cout << "Finish reading weather file without finding leap year indicator." << endl;
-			}
-			else{
-				cout << "Successfully finish reading weather file." << endl;
+			inputKey.assign(lineBeg, keyEnd);
+			capitalize(inputKey);
+			if (inputKey.find(g_key_leapYear) != string::npos){
+				nLeapYear++;
+				const char* valBeg = keyEnd + 1;
+				const char* valEnd = (const char*)memchr(valBeg, ',', fieldsEnd - valBeg);
+				if (NULL == valEnd)
+					valEnd = fieldsEnd;
+				if (equalsCapitalized("YES", valBeg, trimEndLength(valBeg, valEnd - valBeg))){
+					leapYear = 1;
+				}
 			}
-			break;
 		}
-		// Here, ready to look for next keyword.
+		lineBeg = (lineEnd == wthEnd) ? wthEnd : lineEnd + 1;
+	}
+	if (nLeapYear == 0){
+		cout << "Finish reading weather file without finding leap year indicator." << endl;
+	}
+	else{
+		cout << "Successfully finish reading weather file." << endl;
 	}
+	//
+	// Write weather file.
+	//   Copy it as is, in one block.
+	runWeafile.write(wthBeg, wthEnd - wthBeg);
 
-	// Here, ran through whole IDF file.
+	// Here, ran through whole weather file.
 	frIdf.close();
 	runWeafile.close();
 	//
@@ -942,7 +1434,7 @@ int fmuExportIdfData::getTimeStep(fileReaderData& frIdf)
 	string inputKey, iddDesc;
 	string line, inputKeyExt;
 	ofstream tStepfile;
-	tStepfile.open("tstep.txt");
+	tStepfile.open((_outDirName + "tstep.txt").c_str());
 	//
 #ifdef _DEBUG
 	assert(!frIdf.isEOF());
@@ -956,15 +1448,15 @@ int fmuExportIdfData::getTimeStep(fileReaderData& frIdf)
 	// Run through the IDF file.
 	while (_goodRead)
 	{
-		frIdf.skipComment(IDF_COMMENT_CHARS, lineNo);
-		frIdf.getToken(",", IDF_COMMENT_CHARS, inputKey, inputKeyExt);
+		frIdf.skipComment(IDF_CHAR_CLASS_ALL, lineNo);
+		frIdf.getToken(IDF_CHAR_CLASS_ENTRY, inputKey, inputKeyExt);
 		// Consume the delimiter that caused getToken() to return.
 		const char delimChar = frIdf.getChar();
 		capitalize(inputKey);
 		if (inputKey.find(g_key_timeStep) != string::npos){
 			nTStep++;
-			frIdf.skipComment(IDF_COMMENT_CHARS, lineNo);
-			frIdf.getToken(";", IDF_COMMENT_CHARS, inputKey, inputKeyExt);
+			frIdf.skipComment(IDF_CHAR_CLASS_ALL, lineNo);
+			frIdf.getToken(IDF_CHAR_CLASS_SECTION, inputKey, inputKeyExt);
 			capitalize(inputKey);
 			if ((inputKey.find(",") != string::npos)){
 				//this is not the correct timestep
@@ -1064,7 +1556,7 @@ void fmuExportIdfData::reportError(std::ostringstream& errorMessage) const
 void fmuExportIdfData::handleKey_extInt(fileReaderData& frIdf)
   {
   bool entryOK;
-  vString strVals;
+  vSpan strVals;
   vDouble dblVals;
   std::ostringstream os;
   //
@@ -1092,7 +1584,7 @@ void fmuExportIdfData::handleKey_extInt(fileReaderData& frIdf)
   if( entryOK )
     {
     const char *const expectInterfaceName = "FUNCTIONALMOCKUPUNITEXPORT";
-    string &gotInterfaceName = strVals[0];
+    string gotInterfaceName = strVals[0].str();
     capitalize(gotInterfaceName);
     if( 0 != gotInterfaceName.compare(expectInterfaceName) )
       {
@@ -1132,7 +1624,7 @@ void fmuExportIdfData::handleKey_extInt(fileReaderData& frIdf)
 void fmuExportIdfData::handleKey_extInt_fmuExport_toActuator(fileReaderData& frIdf)
   {
   bool entryOK;
-  vString strVals;
+  vSpan strVals;
   vDouble dblVals;
   std::ostringstream os;
   //
@@ -1160,7 +1652,7 @@ void fmuExportIdfData::handleKey_extInt_fmuExport_toActuator(fileReaderData& frI
   // Name (actuator name in IDF file).
   if( entryOK )
     {
-    _toActuator_epName.push_back(strVals[0]);
+    _toActuator_epName.push_back(strVals[0].str());
     // In principle, could check that the IDF file contains the corresponding
     // entry.  However, this would complicate the code here considerably.
     }
@@ -1177,7 +1669,7 @@ void fmuExportIdfData::handleKey_extInt_fmuExport_toActuator(fileReaderData& frI
   // FMU variable name (name in FMU master).
   if( entryOK )
     {
-    _toActuator_fmuVarName.push_back(strVals[4]);
+    _toActuator_fmuVarName.push_back(strVals[4].str());
     }
   //
   // Initial value.
@@ -1238,7 +1730,7 @@ void fmuExportIdfData::handleKey_extInt_fmuExport_toActuator(fileReaderData& frI
 void fmuExportIdfData::handleKey_extInt_fmuExport_toSched(fileReaderData& frIdf)
   {
   bool entryOK;
-  vString strVals;
+  vSpan strVals;
   vDouble dblVals;
   std::ostringstream os;
   //
@@ -1266,7 +1758,7 @@ void fmuExportIdfData::handleKey_extInt_fmuExport_toSched(fileReaderData& frIdf)
   // Schedule Name (schedule name in IDF file).
   if( entryOK )
     {
-    _toSched_epSchedName.push_back(strVals[0]);
+    _toSched_epSchedName.push_back(strVals[0].str());
     // In principle, could check that the IDF file contains the corresponding
     // entry.  However, this would complicate the code here considerably.
     }
@@ -1277,7 +1769,7 @@ void fmuExportIdfData::handleKey_extInt_fmuExport_toSched(fileReaderData& frIdf)
   // FMU variable name (name in FMU master).
   if( entryOK )
     {
-    _toSched_fmuVarName.push_back(strVals[2]);
+    _toSched_fmuVarName.push_back(strVals[2].str());
     }
   //
   // Initial value.
@@ -1337,7 +1829,7 @@ void fmuExportIdfData::handleKey_extInt_fmuExport_toSched(fileReaderData& frIdf)
 void fmuExportIdfData::handleKey_extInt_fmuExport_fromVar(fileReaderData& frIdf)
   {
   bool entryOK;
-  vString strVals;
+  vSpan strVals;
   vDouble dblVals;
   std::ostringstream os;
   //
@@ -1365,7 +1857,7 @@ void fmuExportIdfData::handleKey_extInt_fmuExport_fromVar(fileReaderData& frIdf)
   // Output:Variable Index Key Name (key name in IDF file).
   if( entryOK )
     {
-    _fromVar_epKeyName.push_back(strVals[0]);
+    _fromVar_epKeyName.push_back(strVals[0].str());
     // In principle, could check that the IDF file contains the corresponding
     // entry.  However, this would complicate the code here considerably.
     }
@@ -1373,7 +1865,7 @@ void fmuExportIdfData::handleKey_extInt_fmuExport_fromVar(fileReaderData& frIdf)
   // Output:Variable Name (variable name in IDF file).
   if( entryOK )
     {
-    _fromVar_epVarName.push_back(strVals[1]);
+    _fromVar_epVarName.push_back(strVals[1].str());
     // In principle, could check that the IDF file contains the corresponding
     // entry.  However, this would complicate the code here considerably.
     }
@@ -1381,7 +1873,7 @@ void fmuExportIdfData::handleKey_extInt_fmuExport_fromVar(fileReaderData& frIdf)
   // FMU variable name (Name in FMU master).
   if( entryOK )
     {
-    _fromVar_fmuVarName.push_back(strVals[2]);
+    _fromVar_fmuVarName.push_back(strVals[2].str());
     }
   //
   // Check for duplicate names.
@@ -1435,7 +1927,7 @@ void fmuExportIdfData::handleKey_extInt_fmuExport_fromVar(fileReaderData& frIdf)
 void fmuExportIdfData::handleKey_extInt_fmuExport_toVar(fileReaderData& frIdf)
   {
   bool entryOK;
-  vString strVals;
+  vSpan strVals;
   vDouble dblVals;
   std::ostringstream os;
   //
@@ -1463,7 +1955,7 @@ void fmuExportIdfData::handleKey_extInt_fmuExport_toVar(fileReaderData& frIdf)
   // Name (variable name in IDF file).
   if( entryOK )
     {
-    _toVar_epName.push_back(strVals[0]);
+    _toVar_epName.push_back(strVals[0].str());
     // In principle, could check that the IDF file contains the corresponding
     // entry.  However, this would complicate the code here considerably.
     }
@@ -1471,7 +1963,7 @@ void fmuExportIdfData::handleKey_extInt_fmuExport_toVar(fileReaderData& frIdf)
   // FMU variable name (name in FMU master).
   if( entryOK )
     {
-    _toVar_fmuVarName.push_back(strVals[1]);
+    _toVar_fmuVarName.push_back(strVals[1].str());
     }
   //
   // Initial value.
@@ -1592,7 +2084,7 @@ void fmuExportIdfData::handleKey_extInt_fmuExport_toVar(fileReaderData& frIdf)
 void fmuExportIdfData::handleKey_runPer(fileReaderData& frIdf)
 {
 	bool entryOK;
-	vString strVals;
+	vSpan strVals;
 	vDouble dblVals;
 	std::ostringstream os;
 	//
@@ -1621,7 +2113,7 @@ void fmuExportIdfData::handleKey_runPer(fileReaderData& frIdf)
 	if (strVals.size() > 1){
 		if (entryOK)
 		{
-			_runPer_strings.push_back(strVals[0]);
+			_runPer_strings.push_back(strVals[0].str());
 			// In principle, could check that the IDF file contains the corresponding
 			// entry.  However, this would complicate the code here considerably.
 		}
@@ -1663,7 +2155,7 @@ void fmuExportIdfData::handleKey_runPer(fileReaderData& frIdf)
 		// Day of Week for Start Day.
 		if (entryOK)
 		{
-			_runPer_strings.push_back(strVals[1]);
+			_runPer_strings.push_back(strVals[1].str());
 			// In principle, could check that the IDF file contains the corresponding
 			// entry.  However, this would complicate the code here considerably.
 		}
@@ -1671,7 +2163,7 @@ void fmuExportIdfData::handleKey_runPer(fileReaderData& frIdf)
 		// Use Weather File Holidays and Special Days.
 		if (entryOK)
 		{
-			_runPer_strings.push_back(strVals[2]);
+			_runPer_strings.push_back(strVals[2].str());
 			// In principle, could check that the IDF file contains the corresponding
 			// entry.  However, this would complicate the code here considerably.
 		}
@@ -1680,28 +2172,28 @@ void fmuExportIdfData::handleKey_runPer(fileReaderData& frIdf)
 		// Use Weather File Daylight Saving Period.
 		if (entryOK)
 		{
-			_runPer_strings.push_back(strVals[3]);
+			_runPer_strings.push_back(strVals[3].str());
 		}
 
 		//
 		// Apply Weekend Holiday Rule.
 		if (entryOK)
 		{
-			_runPer_strings.push_back(strVals[4]);
+			_runPer_strings.push_back(strVals[4].str());
 		}
 
 		//
 		// Use Weather File Rain Indicators.
 		if (entryOK)
 		{
-			_runPer_strings.push_back(strVals[5]);
+			_runPer_strings.push_back(strVals[5].str());
 		}
 
 		//
 		// Use Weather File Snow Indicators.
 		if (entryOK)
 		{
-			_runPer_strings.push_back(strVals[6]);
+			_runPer_strings.push_back(strVals[6].str());
 		}
 	}
 
@@ -1720,7 +2212,7 @@ void fmuExportIdfData::handleKey_runPer(fileReaderData& frIdf)
 		// Increment Day of Week on repeat.
 		if (entryOK)
 		{
-			_runPer_strings.push_back(strVals[7]);
+			_runPer_strings.push_back(strVals[7].str());
 		}
 	}
 
@@ -34,6 +34,12 @@ public:
   /// \param errFcn Pointer to function to be called in case of an error.
   void attachErrorFcn(void (*errFcn)(std::ostringstream& errorMessage));
 
+  /// Set the folder for the files written by writeInputFile(), isLeapYear(),
+  /// and getTimeStep().
+  /// \param dirName The folder, ending with a path separator; empty for the
+  /// current working directory.
+  void setOutputDir(const string& dirName);
+
 
   //--- Validate IDD file.
   //
@@ -42,20 +48,43 @@ public:
   //
   /// \param idd Map containing input data keywords and descriptors (Input Data Dictionary).
   /// \return 1 if \c idd is compatible with expected entries for method \c populateFromIDF().
+  bool haveValidIDD(const iddTable& idd, string& errStr) const;
   bool haveValidIDD(const iddMap& idd, string& errStr) const;
 
+  /// List the Input Data Dictionary keywords checked by haveValidIDD().
+  //
+  //   Lets a caller read just these entries from the IDD file.
+  //
+  /// \retval keys The capitalized keywords.
+  void getRequiredIddKeys(std::vector<string>& keys) const;
+
   /// Read IDF file, collecting data needed to export an EnergyPlus simulation as an FMU.
   //
   /// \param frIdf IDF-file reader, configured to read from EnergyPlus Input Data File of interest.
   /// \return 0 on success; or IDF line number where encountered a problem.
   int populateFromIDF(fileReaderData& frIdf);
 
+  /// Read IDF file, as above, scanning parts of a large file on several threads.
+  //
+  ///   Gives the same data, in the same order, with the same line numbers, as
+  /// reading the file in one pass.  If any part has a problem, reads the file
+  /// again in one pass, so that errors get reported as usual.
+  //
+  /// \param frIdf IDF-file reader, configured to read from EnergyPlus Input Data File of interest.
+  /// \param threadCt Count of threads to use; 0 for one per processor.
+  /// \return 0 on success; or IDF line number where encountered a problem.
+  int populateFromIDF(fileReaderData& frIdf, int threadCt);
 
-  /// Read Weather file, collecting data needed to export an EnergyPlus simulation as an FMU.
+
+  /// Read IDF file, writing the IDF file {runinfile.idf} and the time step file
+  /// {tstep.txt} needed to run an EnergyPlus simulation as an FMU.
+  //
+  ///   Reads the IDF file once.  The time step comes from the first Timestep
+  /// object, so there is no need to call getTimeStep() afterwards.
   //
   /// \param frIdf IDF-file reader, configured to read from EnergyPlus Input Data File of interest.
   /// \param leapYear 1 if leap year 0 else.
-  /// \param timeStep The eimstep extracted from the IDF file.
+  /// \param tStep The number of time steps per hour extracted from the IDF file.
   /// \return 0 on success; or IDF line number where encountered a problem.
   int writeInputFile(fileReaderData& frIdf, int leapYear, int &tStep, string tStartFMU, string tStopFMU);
 
@@ -109,11 +138,14 @@ private:
   //
   bool _goodRead;
   void (*_externalErrorFcn)(std::ostringstream& errorMessage);
+  string _outDirName;
   bool _gotKeyExtInt;
 
   //-- Private methods.
   //
   void reportError(std::ostringstream& errorMessage) const;
+  bool haveDuplicateNames(const std::vector<fmuExportIdfData>& parts) const;
+  void appendIdfData(const fmuExportIdfData& part, int lineNoOffset);
   void handleKey_extInt(fileReaderData& frIdf);
   void handleKey_extInt_fmuExport_toActuator(fileReaderData& frIdf);
   void handleKey_extInt_fmuExport_toSched(fileReaderData& frIdf);
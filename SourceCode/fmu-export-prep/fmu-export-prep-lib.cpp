@@ -0,0 +1,268 @@
+//--- Write the run files needed to simulate an EnergyPlus IDF file as an FMU.
+
+
+//--- Copyright notice.
+//
+//   Please see the header file.
+
+
+//--- Includes.
+//
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <vector>
+
+#if defined(_WIN32)
+  #include <process.h>
+  #define getpid _getpid
+#else
+  #include <unistd.h>
+#endif
+
+#include <iostream>
+using std::cout;
+using std::endl;
+
+#include "fmu-export-prep-lib.h"
+
+#include "../read-ep-file/fileReaderData.h"
+#include "../read-ep-file/fileReaderDictionary.h"
+
+#include "../utility/digest-md5.h"
+#include "../utility/file-help.h"
+#include "../utility/utilReport.h"
+
+
+//--- File-scope constants.
+//
+// Environment variable naming the directory for IDD snapshots.
+static const char *const IDD_SNAPSHOT_DIR_ENV = "FMU_EXPORT_PREP_CACHE_DIR";
+//
+// Version of the run files.
+//   Increment whenever a change to the preprocessor, or to the readers it uses,
+// changes the contents of the run files.  Callers key cached run files on it,
+// so a stale value would reuse run files written by the old logic.
+static const char *const RUN_FILES_VERSION = "fmu-export-prep run files 1";
+
+
+//--- Functions.
+//
+static bool haveReadableFile(const char *const fileName);
+static void reportRunFileError(void *errContext, std::ostringstream& errorMessage,
+  const string& fileName, int lineNo);
+
+
+//--- Get the data dictionary entries needed to check the IDD file.
+//
+//   Use a snapshot saved by an earlier run against an IDD file with the same
+// MD5 checksum, if have one.  Otherwise parse the IDD file, and save a snapshot
+// for next time.  If cannot save a snapshot, stop parsing as soon as have read
+// the keywords checked by {haveValidIDD()}.
+//
+//   Snapshots go in the directory named by environment variable
+// {IDD_SNAPSHOT_DIR_ENV}, or else alongside the IDD file.  Setting the variable
+// to an empty string turns snapshots off.
+//
+//   Have the reader return on error, rather than exit, and do not save a
+// snapshot of a malformed IDD file.  Log errors in folder {outDirName}, or in
+// the current working directory if NULL.
+//
+int fmuExportPrep_getIddMap(const char *iddFileName, const fmuExportIdfData& fmuIdfData, iddTable& idd,
+  const char *outDirName)
+  {
+  //
+  // Find snapshot file name.
+  string snapFileName;
+  const char *const snapDirName = getenv(IDD_SNAPSHOT_DIR_ENV);
+  if( NULL == snapDirName )
+    {
+    snapFileName.assign(iddFileName, findFileBaseNameIdx(iddFileName));
+    }
+  else if( 0 != snapDirName[0] )
+    {
+    snapFileName = snapDirName;
+    const char lastCh = snapFileName[snapFileName.length()-1];
+    if( '/' != lastCh && '\\' != lastCh )
+      snapFileName.push_back('/');
+    }
+  const bool useSnap = ( NULL == snapDirName || 0 != snapDirName[0] );
+  //
+  // Try snapshot.
+  char md5Hex[33];
+  if( useSnap )
+    {
+    digest_md5_fromFile(iddFileName, md5Hex);
+    snapFileName.append("idd-").append(md5Hex).append(".snap");
+    if( iddMap_readSnapshot(snapFileName.c_str(), md5Hex, idd) )
+      return( 0 );
+    }
+  //
+  // Set up data dictionary.
+  string logDirName = ( NULL == outDirName ) ? "" : outDirName;
+  fileReaderDictionary frIdd(iddFileName);
+  frIdd.attachErrorFcn(reportRunFileError, &logDirName);
+  frIdd.setExitOnError(false);
+  frIdd.open();
+  //
+  // Parse.
+  //   Write the snapshot to a temporary file, then rename it, so that another
+  // run never sees a partial snapshot under the final name.  Name the temporary
+  // file for this process and call, since FMU instances may run this
+  // concurrently.
+  std::ofstream snapStream;
+  string errStr;
+  std::ostringstream tmpNameStream;
+  tmpNameStream << snapFileName << ".tmp." << getpid() << "." << (const void*)&idd;
+  const string tmpFileName = tmpNameStream.str();
+  if( useSnap &&
+    openOutputFile(snapStream, tmpFileName.c_str(), std::ios::out | std::ios::trunc | std::ios::binary, errStr) )
+    {
+    frIdd.getMap(idd);
+    const bool wroteSnap = ( 0 == frIdd.getErrorCount() &&
+      iddMap_writeSnapshot(snapStream, idd, md5Hex) );
+    snapStream.close();
+    if( ! wroteSnap ||
+      0 != rename(tmpFileName.c_str(), snapFileName.c_str()) )
+      {
+      remove(tmpFileName.c_str());
+      }
+    }
+  else
+    {
+    std::vector<string> requiredKeys;
+    fmuIdfData.getRequiredIddKeys(requiredKeys);
+    frIdd.getMap(idd, requiredKeys);
+    }
+  //
+  if( 0 < frIdd.getErrorCount() )
+    {
+    cout << "Error detected while reading IDD file " << iddFileName << endl;
+    return( 1 );
+    }
+  return( 0 );
+  }  // End fcn fmuExportPrep_getIddMap().
+
+
+//--- Write the run files.
+//
+//   The file readers would otherwise exit on a missing file or an illegal
+// character.  Therefore check the files can be read before opening them, and
+// have the readers return on error.
+//
+//   Log input errors in the output folder, rather than in the working directory
+// of the process, which belongs to the caller.
+//
+//   Catch all exceptions, since they cannot pass through a C caller.
+//
+int fmuExportPrep_writeRunFiles(const char *outDirName, const char *iddFileName,
+  const char *idfFileName, const char *wthFileName, const char *tStartFMU, const char *tStopFMU,
+  int *timeStepP)
+  {
+  try
+    {
+    //
+    // Check inputs.
+    if( ! haveReadableFile(iddFileName) || ! haveReadableFile(idfFileName) ||
+      (NULL != wthFileName && ! haveReadableFile(wthFileName)) )
+      {
+      return( 1 );
+      }
+    //
+    // Set up data dictionary.
+    fmuExportIdfData fmuIdfData;
+    if( NULL != outDirName )
+      fmuIdfData.setOutputDir(outDirName);
+    iddTable idd;
+    if( 0 != fmuExportPrep_getIddMap(iddFileName, fmuIdfData, idd, outDirName) )
+      {
+      return( 1 );
+      }
+    //
+    // Check data dictionary.
+    string errStr;
+    if( ! fmuIdfData.haveValidIDD(idd, errStr) )
+      {
+      cout << "Incompatible IDD file " << iddFileName <<
+        endl << errStr << endl;
+      return( 1 );
+      }
+    //
+    // Read weather file for leap year, and copy it to {runweafile.epw}.
+    string logDirName = ( NULL == outDirName ) ? "" : outDirName;
+    int failLine;
+    int leapYear = 0;
+    if( NULL != wthFileName )
+      {
+      fileReaderData frWth(wthFileName, IDF_DELIMITERS_ENTRY, IDF_DELIMITERS_SECTION);
+      frWth.attachErrorFcn(reportRunFileError, &logDirName);
+      frWth.setExitOnError(false);
+      frWth.open();
+      failLine = fmuIdfData.isLeapYear(frWth, leapYear);
+      if( 0 < failLine || 0 < frWth.getErrorCount() )
+        {
+        cout << "Error detected while reading Weather file " << wthFileName << ", at line #" << failLine << endl;
+        return( 1 );
+        }
+      }
+    //
+    // Read IDF file for data of interest.
+    //   Writes both {runinfile.idf} and {tstep.txt}, in a single pass.
+    fileReaderData frIdf(idfFileName, IDF_DELIMITERS_ENTRY, IDF_DELIMITERS_SECTION);
+    frIdf.attachErrorFcn(reportRunFileError, &logDirName);
+    frIdf.setExitOnError(false);
+    frIdf.open();
+    int timeStep = 0;
+    failLine = fmuIdfData.writeInputFile(frIdf, leapYear, timeStep, tStartFMU, tStopFMU);
+    if( 0 < failLine || 0 < frIdf.getErrorCount() )
+      {
+      cout << "Error detected while reading IDF file " << idfFileName << ", at line #" << failLine << endl;
+      return( 1 );
+      }
+    *timeStepP = timeStep;
+    }
+  catch( ... )
+    {
+    cout << "Error detected while writing the run files for IDF file " << idfFileName << endl;
+    return( 1 );
+    }
+  //
+  return( 0 );
+  }  // End fcn fmuExportPrep_writeRunFiles().
+
+
+//--- Get the version of the run files.
+//
+const char* fmuExportPrep_getRunFilesVersion(void)
+  {
+  return( RUN_FILES_VERSION );
+  }  // End fcn fmuExportPrep_getRunFilesVersion().
+
+
+//--- Check a file can be read.
+//
+//   Report the error if not.
+//
+static bool haveReadableFile(const char *const fileName)
+  {
+  FILE *const fileP = fopen(fileName, "r");
+  if( NULL == fileP )
+    {
+    cout << "Cannot open file " << fileName << endl;
+    return( false );
+    }
+  fclose(fileP);
+  return( true );
+  }  // End fcn haveReadableFile().
+
+
+//--- Report an input error.
+//
+//   Log it in the folder named by {errContext}, a {string}.
+//
+static void reportRunFileError(void *errContext, std::ostringstream& errorMessage,
+  const string& fileName, int lineNo)
+  {
+  reportInputError(errorMessage, fileName, lineNo, *static_cast<const string*>(errContext));
+  }  // End fcn reportRunFileError().
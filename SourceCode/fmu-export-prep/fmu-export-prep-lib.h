@@ -0,0 +1,154 @@
+//--- Write the run files needed to simulate an EnergyPlus IDF file as an FMU.
+//
+/// \author David Lorenzetti,
+///         Lawrence Berkeley National Laboratory,
+///         dmlorenzetti@lbl.gov
+///
+/// \brief  C-callable entry point to the preprocessor, so that the FMU shared
+///         library can link it, rather than run the preprocessor executable.
+
+
+#if !defined(__FMU_EXPORT_PREP_LIB__)
+#define __FMU_EXPORT_PREP_LIB__
+
+
+//--- Includes.
+//
+#if defined(__cplusplus)
+  #include "fmu-export-idf-data.h"
+  #include "../read-ep-file/ep-idd-map.h"
+#endif
+
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+
+//--- Write the run files.
+//
+//   Write {runinfile.idf}, {tstep.txt}, and, if given a weather file,
+// {runweafile.epw}.
+//   Arguments:
+// ** {outDirName}, the folder for the run files, ending with a path separator;
+// or NULL for the current working directory.
+// ** {iddFileName}, {idfFileName}, the data dictionary and the input file.
+// ** {wthFileName}, the weather file, or NULL to write no weather file.
+// ** {tStartFMU}, {tStopFMU}, the start and stop time of the FMU, in seconds.
+// ** {timeStepP}, set to the count of time steps per hour found in the IDF file.
+//   Return 0 on success.  Otherwise, report the error and return nonzero.
+// Unlike the preprocessor executable, do not exit on bad input.
+//
+int fmuExportPrep_writeRunFiles(const char *outDirName, const char *iddFileName,
+  const char *idfFileName, const char *wthFileName, const char *tStartFMU, const char *tStopFMU,
+  int *timeStepP);
+
+
+//--- Get the version of the run files.
+//
+//   Changes whenever the preprocessor changes the contents of the run files,
+// so that callers can key cached run files on it.
+//
+const char* fmuExportPrep_getRunFilesVersion(void);
+
+
+#if defined(__cplusplus)
+}  // extern "C"
+
+
+//--- Get the data dictionary entries needed to check the IDD file.
+//
+//   Use a snapshot of the IDD file if have one.  Otherwise parse the IDD file.
+//   Log errors in folder {outDirName}, ending with a path separator; or, if NULL,
+// in the current working directory.
+//   Return 0 on success.  Otherwise, report the error and return nonzero.
+//
+int fmuExportPrep_getIddMap(const char *iddFileName, const fmuExportIdfData& fmuIdfData, iddTable& idd,
+  const char *outDirName);
+#endif
+
+
+#endif // __FMU_EXPORT_PREP_LIB__
+
+
+/*
+***********************************************************************************
+Copyright Notice
+----------------
+
+Functional Mock-up Unit Export of EnergyPlus (C)2013, The Regents of
+the University of California, through Lawrence Berkeley National
+Laboratory (subject to receipt of any required approvals from
+the U.S. Department of Energy). All rights reserved.
+
+If you have questions about your rights to use or distribute this software,
+please contact Berkeley Lab's Technology Transfer Department at
+TTD@lbl.gov.referring to "Functional Mock-up Unit Export
+of EnergyPlus (LBNL Ref 2013-088)".
+
+NOTICE: This software was produced by The Regents of the
+University of California under Contract No. DE-AC02-05CH11231
+with the Department of Energy.
+For 5 years from November 1, 2012, the Government is granted for itself
+and others acting on its behalf a nonexclusive, paid-up, irrevocable
+worldwide license in this data to reproduce, prepare derivative works,
+and perform publicly and display publicly, by or on behalf of the Government.
+There is provision for the possible extension of the term of this license.
+Subsequent to that period or any extension granted, the Government is granted
+for itself and others acting on its behalf a nonexclusive, paid-up, irrevocable
+worldwide license in this data to reproduce, prepare derivative works,
+distribute copies to the public, perform publicly and display publicly,
+and to permit others to do so. The specific term of the license can be identified
+by inquiry made to Lawrence Berkeley National Laboratory or DOE. Neither
+the United States nor the United States Department of Energy, nor any of their employees,
+makes any warranty, express or implied, or assumes any legal liability or responsibility
+for the accuracy, completeness, or usefulness of any data, apparatus, product,
+or process disclosed, or represents that its use would not infringe privately owned rights.
+
+
+Copyright (c) 2013, The Regents of the University of California, Department
+of Energy contract-operators of the Lawrence Berkeley National Laboratory.
+All rights reserved.
+
+1. Redistribution and use in source and binary forms, with or without modification,
+are permitted provided that the following conditions are met:
+
+(1) Redistributions of source code must retain the copyright notice, this list
+of conditions and the following disclaimer.
+
+(2) Redistributions in binary form must reproduce the copyright notice, this list
+of conditions and the following disclaimer in the documentation and/or other
+materials provided with the distribution.
+
+(3) Neither the name of the University of California, Lawrence Berkeley
+National Laboratory, U.S. Dept. of Energy nor the names of its contributors
+may be used to endorse or promote products derived from this software without
+specific prior written permission.
+
+2. THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+POSSIBILITY OF SUCH DAMAGE.
+
+3. You are under no obligation whatsoever to provide any bug fixes, patches,
+or upgrades to the features, functionality or performance of the source code
+("Enhancements") to anyone; however, if you choose to make your Enhancements
+available either publicly, or directly to Lawrence Berkeley National Laboratory,
+without imposing a separate written license agreement for such Enhancements,
+then you hereby grant the following license: a non-exclusive, royalty-free
+perpetual license to install, use, modify, prepare derivative works, incorporate
+into other computer software, distribute, and sublicense such enhancements or
+derivative works thereof, in binary and source code form.
+
+NOTE: This license corresponds to the "revised BSD" or "3-clause BSD"
+License and includes the following modification: Paragraph 3. has been added.
+
+
+***********************************************************************************
+*/
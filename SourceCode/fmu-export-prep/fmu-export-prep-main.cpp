@@ -6,9 +6,11 @@
 // #include <assert.h>
 //
 // #include <sstream>
+#include <cstdio>
 #include <cstdlib>
 #include <fstream>
 #include <cstring>
+#include <vector>
 
 #include <iostream>
 using std::cout;
@@ -16,12 +18,12 @@ using std::endl;
 
 #include "app-cmdln-input.h"
 #include "fmu-export-idf-data.h"
+#include "fmu-export-prep-lib.h"
 #include "fmu-export-write-model-desc.h"
 #include "fmu-export-write-vars-cfg.h"
 
 #include "../read-ep-file/ep-idd-map.h"
 #include "../read-ep-file/fileReaderData.h"
-#include "../read-ep-file/fileReaderDictionary.h"
 
 #include "../utility/file-help.h"
 #include "../utility/time-help.h"
@@ -29,6 +31,9 @@ using std::endl;
 
 
 //--- File-scope constants.
+//
+// Environment variable giving the count of threads for reading the IDF file.
+static const char *const IDF_THREAD_CT_ENV = "FMU_EXPORT_PREP_THREADS";
 
 
 //--- Functions.
@@ -36,7 +41,7 @@ using std::endl;
 static void getIdfData(cmdlnInput_s& cmdlnInput, fmuExportIdfData& fmuIdfData);
 
 //
-static void getInputData(cmdlnInput_s& cmdlnInput, fmuExportIdfData& fmuIdfData);
+static void getInputData(cmdlnInput_s& cmdlnInput);
 
 
 //--- Main driver.
@@ -83,7 +88,7 @@ int main(int argc, const char* argv[])
 	}
 	else{
 		cout << "Reading input and weather file for preprocessor program." << endl;
-		getInputData(cmdlnInput, fmuIdfData);
+		getInputData(cmdlnInput);
 	}
 	//
 	// Finalize.
@@ -138,15 +143,18 @@ int main(int argc, const char* argv[])
 
 //--- Read required data from IDF file.
 //
+//   Scan large IDF files on the count of threads given by environment variable
+// {IDF_THREAD_CT_ENV}, or else on one thread per processor.
+//
 static void getIdfData(cmdlnInput_s& cmdlnInput, fmuExportIdfData& fmuIdfData)
   {
   //
   // Set up data dictionary.
-  fileReaderDictionary frIdd(cmdlnInput.iddFileName);
-  frIdd.attachErrorFcn(reportInputError);
-  frIdd.open();
-  iddMap idd;
-  frIdd.getMap(idd);  // Terminates on error.
+  iddTable idd;
+  if( 0 != fmuExportPrep_getIddMap(cmdlnInput.iddFileName, fmuIdfData, idd, NULL) )
+    {
+    exit( EXIT_FAILURE );
+    }
   //
   // Check data dictionary.
   string errStr;
@@ -163,7 +171,9 @@ static void getIdfData(cmdlnInput_s& cmdlnInput, fmuExportIdfData& fmuIdfData)
   frIdf.open();
   //
   // Read IDF file for data of interest.
-  const int failLine = fmuIdfData.populateFromIDF(frIdf);
+  const char *const threadCtStr = getenv(IDF_THREAD_CT_ENV);
+  const int threadCt = ( NULL == threadCtStr ) ? 0 : atoi(threadCtStr);
+  const int failLine = fmuIdfData.populateFromIDF(frIdf, threadCt);
   if( 0 < failLine )
     {
     cout << "Error detected while reading IDF file " << cmdlnInput.idfFileName << ", at line #" << failLine << endl;
@@ -182,68 +192,16 @@ static void getIdfData(cmdlnInput_s& cmdlnInput, fmuExportIdfData& fmuIdfData)
   }  // End fcn getIdfData().
 
 
-//--- Read required data from IDF file.
+//--- Write the run files.
 //
-static void getInputData(cmdlnInput_s& cmdlnInput, fmuExportIdfData& fmuIdfData)
+static void getInputData(cmdlnInput_s& cmdlnInput)
 {
-	//
-	// Set up data dictionary.
-	fileReaderDictionary frIdd(cmdlnInput.iddFileName);
-	frIdd.attachErrorFcn(reportInputError);
-	frIdd.open();
-	iddMap idd;
 	int timeStep;
-	int leapYear;
-	frIdd.getMap(idd);  // Terminates on error.
-	//
-	// Check data dictionary.
-	string errStr;
-	if (!fmuIdfData.haveValidIDD(idd, errStr))
-	{
-		cout << "Incompatible IDD file " << cmdlnInput.iddFileName <<
-			endl << errStr << endl;
-		exit(EXIT_FAILURE);
-	}
-	//
-	// Initialize weather data file.
-	fileReaderData frIdf1(cmdlnInput.wthFileName, IDF_DELIMITERS_ENTRY, IDF_DELIMITERS_SECTION);
-	frIdf1.attachErrorFcn(reportInputError);
-	frIdf1.open();
-	// Read IDF file for data of interest.
-	int failLine = fmuIdfData.isLeapYear(frIdf1, leapYear);
-	if (0 < failLine)
+	if (0 != fmuExportPrep_writeRunFiles(NULL, cmdlnInput.iddFileName, cmdlnInput.idfFileName,
+		cmdlnInput.wthFileName, cmdlnInput.tStartFMU, cmdlnInput.tStopFMU, &timeStep))
 	{
-		cout << "Error detected while reading Weather file " << cmdlnInput.wthFileName << ", at line #" << failLine << endl;
 		exit(EXIT_FAILURE);
 	}
-
-	// Initialize input data file.
-	fileReaderData frIdf2(cmdlnInput.idfFileName, IDF_DELIMITERS_ENTRY, IDF_DELIMITERS_SECTION);
-	frIdf2.attachErrorFcn(reportInputError);
-	frIdf2.open();
-	//
-	// Read IDF file for data of interest.
-	failLine = fmuIdfData.writeInputFile(frIdf2, leapYear, timeStep, cmdlnInput.tStartFMU, cmdlnInput.tStopFMU);
-	if (0 < failLine)
-	{
-		cout << "Error detected while reading IDF file " << cmdlnInput.idfFileName << ", at line #" << failLine << endl;
-		exit(EXIT_FAILURE);
-	}
-
-	// Initialize input data file.
-	fileReaderData frIdf3(cmdlnInput.idfFileName, IDF_DELIMITERS_ENTRY, IDF_DELIMITERS_SECTION);
-	frIdf3.attachErrorFcn(reportInputError);
-	frIdf3.open();
-	//
-	// Read IDF file for data of interest.
-	failLine = fmuIdfData.getTimeStep(frIdf3);
-	if (0 < failLine)
-	{
-		cout << "Error detected while reading IDF file " << cmdlnInput.idfFileName << ", at line #" << failLine << endl;
-		exit(EXIT_FAILURE);
-	}
-	//
-	// Here, successfully extracted data of interest from the IDF file.
 }  // End fcn getInputData().
 
 
@@ -31,11 +31,14 @@ using std::endl;
 //   Collect data needed to prepare an EnergyPlus IDF file to be exported as an
 // FMU.  Echo the data to stdout.
 //
+//   Given a count of threads, scan the IDF file on that many threads.  The
+// output should match that of a run without it.
+//
 int main(int argc, const char* argv[]) {
   //
   // Check arguments.
-  if( 3 != argc ){
-    cout << "Error: missing filename\nUsage: " << argv[0] << "  <name of IDD file to guide parsing>  <name of IDF file to parse>\n";
+  if( 3 != argc && 4 != argc ){
+    cout << "Error: missing filename\nUsage: " << argv[0] << "  <name of IDD file to guide parsing>  <name of IDF file to parse>  [count of threads]\n";
     return(1);
   }
   //
@@ -64,7 +67,8 @@ int main(int argc, const char* argv[]) {
   frIdf.open();
   //
   // Read IDF file for data of interest.
-  const int failLine = fmuIdfData.populateFromIDF(frIdf);
+  const int failLine = ( 4 == argc )
+    ? fmuIdfData.populateFromIDF(frIdf, atoi(argv[3])) : fmuIdfData.populateFromIDF(frIdf);
   //
   // Check read.
   if( 0 < failLine )
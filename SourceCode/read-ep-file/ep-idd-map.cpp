@@ -8,6 +8,18 @@
 
 //--- Includes.
 //
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <vector>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
 #include "ep-idd-map.h"
 
 
@@ -18,9 +30,39 @@
 
 
 //--- Global variables.
+//
+// Snapshot layout:
+// ** 8-byte magic string.
+// ** 4-byte format version.
+// ** 32-byte MD5 checksum of the IDD file, in hex.
+// ** 4-byte count of entries.
+// ** 4-byte count of bytes in the entries that follow.
+// ** Per entry: 4-byte keyword length, 4-byte descriptor length, keyword, descriptor.
+//
+//   Bump {SNAPSHOT_VERSION} whenever the layout, or the way the IDD file gets
+// parsed into an {iddMap}, changes.
+static const char SNAPSHOT_MAGIC[8] = {'E', 'P', 'I', 'D', 'D', 'M', 'A', 'P'};
+static const unsigned int SNAPSHOT_VERSION = 1;
+static const size_t SNAPSHOT_HEADER_BYTES = 8 + 4 + 32 + 4 + 4;
 
 
 //--- File-scope fcn prototypes.
+static void appendMissingKeyError(const string& expectKey, string& errStr);
+static void appendWrongDescError(const string& expectKey, const string& expectDesc,
+  const string& iddDesc, string& errStr);
+static void putUint32(std::ostream& outStream, unsigned int val);
+static unsigned int getUint32(const unsigned char *const buf);
+static void writeSnapshotHeader(std::ostream& snapStream, const char *const md5Hex,
+  size_t entryCt, size_t entryBytes);
+static void writeSnapshotEntry(std::ostream& snapStream, const string& key, const string& desc);
+static void addSnapshotEntry(iddMap& idd, const char *const key, size_t keyLen,
+  const char *const desc, size_t descLen);
+static void addSnapshotEntry(iddTable& idd, const char *const key, size_t keyLen,
+  const char *const desc, size_t descLen);
+template <class IDD>
+static bool readSnapshot(const char *const snapFileName, const char *const md5Hex, IDD& idd);
+template <class IDD>
+static bool parseSnapshot(const char *const buf, size_t bufLen, const char *const md5Hex, IDD& idd);
 
 
 //--- Functions.
@@ -43,6 +85,23 @@ bool iddMap_getDescriptor(const iddMap& idd, const string& key, string& desc){
 }  // End fcn iddMap_getDescriptor().
 
 
+//--- Get descriptor for a given keyword, from an {iddTable}.
+//
+bool iddMap_getDescriptor(const iddTable& idd, const string& key, string& desc){
+  //
+  size_t entryIdx;
+  //
+  if( idd.find(key, entryIdx) ){
+    idd.getDescriptor(entryIdx, desc);
+    return true;
+  }
+  //
+  // Here, invalid keyword.
+  desc = "";
+  return false;
+}  // End fcn iddMap_getDescriptor().
+
+
 //--- Count the "A" (string) and "N" (double) markers in a data dictionary descriptor.
 //
 int iddMap_countDescriptorTypes(const string& desc, int& strCt, int& dblCt){
@@ -115,21 +174,508 @@ int iddMap_compareEntry(const iddMap& idd, const string& expectKey, const string
   //
   if( ! iddMap_getDescriptor(idd, expectKey, iddDesc) )
     {
-    if( 0 != errStr.size() )
-      errStr.push_back('\n');
-    errStr.append("Input data dictionary does not contain key '").append(expectKey).push_back('\'');
+    appendMissingKeyError(expectKey, errStr);
     return( 1 );
     }
   //
   if( 0 != iddDesc.compare(expectDesc) )
     {
-    if( 0 != errStr.size() )
-      errStr.push_back('\n');
-    errStr.append("For key '").append(expectKey);
-    errStr.append("', input data dictionary has descriptor '").append(iddDesc);
-    errStr.append("', but expecting '").append(expectDesc).push_back('\'');
+    appendWrongDescError(expectKey, expectDesc, iddDesc, errStr);
+    return( 2 );
+    }
+  //
+  return( 0 );
+  }  // End fcn iddMap_compareEntry.
+
+
+//--- Check an {iddTable} has an expected keyword and descriptor.
+//
+//   Compare the descriptor in its packed form, decoding it only to report
+// a mismatch.
+//
+int iddMap_compareEntry(const iddTable& idd, const string& expectKey, const string& expectDesc,
+  string &errStr)
+  {
+  //
+  size_t entryIdx;
+  //
+  if( ! idd.find(expectKey, entryIdx) )
+    {
+    appendMissingKeyError(expectKey, errStr);
+    return( 1 );
+    }
+  //
+  if( ! idd.descriptorEquals(entryIdx, expectDesc) )
+    {
+    string iddDesc;
+    idd.getDescriptor(entryIdx, iddDesc);
+    appendWrongDescError(expectKey, expectDesc, iddDesc, errStr);
     return( 2 );
     }
   //
   return( 0 );
   }  // End fcn iddMap_compareEntry.
+
+
+//--- Report a keyword missing from an Input Data Dictionary.
+//
+static void appendMissingKeyError(const string& expectKey, string& errStr)
+  {
+  if( 0 != errStr.size() )
+    errStr.push_back('\n');
+  errStr.append("Input data dictionary does not contain key '").append(expectKey).push_back('\'');
+  }  // End fcn appendMissingKeyError().
+
+
+//--- Report an unexpected descriptor in an Input Data Dictionary.
+//
+static void appendWrongDescError(const string& expectKey, const string& expectDesc,
+  const string& iddDesc, string& errStr)
+  {
+  if( 0 != errStr.size() )
+    errStr.push_back('\n');
+  errStr.append("For key '").append(expectKey);
+  errStr.append("', input data dictionary has descriptor '").append(iddDesc);
+  errStr.append("', but expecting '").append(expectDesc).push_back('\'');
+  }  // End fcn appendWrongDescError().
+
+
+//--- Constructor.
+//
+iddTable::iddTable(void)
+  {
+  clear();
+  }  // End constructor iddTable::iddTable().
+
+
+//--- Remove all entries.
+//
+void iddTable::clear(void)
+  {
+  _entries.clear();
+  _keyPool.clear();
+  _descBits.clear();
+  _descBitCt = 0;
+  _descText.clear();
+  _slots.assign(16, 0);
+  }  // End method iddTable::clear().
+
+
+//--- Copy all entries of an {iddMap}.
+//
+void iddTable::assign(const iddMap& idd)
+  {
+  clear();
+  iddMap::const_iterator it;
+  for( it=idd.begin(); it!=idd.end(); ++it ){
+    setDescriptor(it->first, it->second);
+  }
+  }  // End method iddTable::assign().
+
+
+//--- Add an entry, or replace the descriptor of an existing entry.
+//
+void iddTable::setDescriptor(const char *const key, size_t keyLen, const char *const desc, size_t descLen)
+  {
+  //
+  const unsigned int keyHash = hashKey(key, keyLen);
+  size_t slotIdx = findSlot(key, keyLen, keyHash);
+  //
+  if( 0 != _slots[slotIdx] )
+    {
+    // Here, replacing.
+    //   Old descriptor stays in its pool, unused.
+    storeDescriptor(_entries[_slots[slotIdx]-1], desc, descLen);
+    return;
+    }
+  //
+  // Intern keyword.
+  entry_s entry;
+  entry.keyOff = _keyPool.length();
+  entry.keyLen = keyLen;
+  entry.keyHash = keyHash;
+  _keyPool.append(key, keyLen);
+  storeDescriptor(entry, desc, descLen);
+  _entries.push_back(entry);
+  //
+  // Keep at most half the slots full.
+  if( 2*_entries.size() > _slots.size() )
+    growSlots();
+  else
+    _slots[slotIdx] = _entries.size();
+  }  // End method iddTable::setDescriptor().
+
+
+//--- Find a keyword.
+//
+bool iddTable::find(const char *const key, size_t keyLen, size_t& entryIdx) const
+  {
+  //
+  const size_t slotIdx = findSlot(key, keyLen, hashKey(key, keyLen));
+  if( 0 == _slots[slotIdx] )
+    return false;
+  //
+  entryIdx = _slots[slotIdx] - 1;
+  return true;
+  }  // End method iddTable::find().
+
+
+//--- Get the keyword of an entry.
+//
+string iddTable::getKey(size_t entryIdx) const
+  {
+  const entry_s& entry = _entries[entryIdx];
+  return( _keyPool.substr(entry.keyOff, entry.keyLen) );
+  }  // End method iddTable::getKey().
+
+
+//--- Get the descriptor of an entry.
+//
+void iddTable::getDescriptor(size_t entryIdx, string& desc) const
+  {
+  //
+  const entry_s& entry = _entries[entryIdx];
+  //
+  if( ! entry.descPacked )
+    {
+    desc.assign(_descText, entry.descOff, entry.descLen);
+    return;
+    }
+  //
+  desc.resize(entry.descLen);
+  for( size_t idx=0; idx<entry.descLen; ++idx )
+    {
+    const size_t bitIdx = entry.descOff + idx;
+    desc[idx] = ( (_descBits[bitIdx/32] >> (bitIdx%32)) & 1 ) ? 'N' : 'A';
+    }
+  }  // End method iddTable::getDescriptor().
+
+
+//--- Get the marker counts of an entry.
+//
+void iddTable::getDescriptorTypeCounts(size_t entryIdx, int& strCt, int& dblCt) const
+  {
+  const entry_s& entry = _entries[entryIdx];
+  strCt = entry.strCt;
+  dblCt = entry.dblCt;
+  }  // End method iddTable::getDescriptorTypeCounts().
+
+
+//--- Check the descriptor of an entry.
+//
+bool iddTable::descriptorEquals(size_t entryIdx, const string& desc) const
+  {
+  //
+  const entry_s& entry = _entries[entryIdx];
+  //
+  if( desc.length() != entry.descLen )
+    return false;
+  //
+  if( ! entry.descPacked )
+    return( 0 == _descText.compare(entry.descOff, entry.descLen, desc) );
+  //
+  for( size_t idx=0; idx<entry.descLen; ++idx )
+    {
+    const size_t bitIdx = entry.descOff + idx;
+    const char mark = ( (_descBits[bitIdx/32] >> (bitIdx%32)) & 1 ) ? 'N' : 'A';
+    if( mark != desc[idx] )
+      return false;
+    }
+  return true;
+  }  // End method iddTable::descriptorEquals().
+
+
+//--- Hash a keyword.
+//
+//   Use 32-bit FNV-1a.  Keywords are short and already capitalized, so there
+// is no need for anything stronger.
+//
+unsigned int iddTable::hashKey(const char *const key, size_t keyLen)
+  {
+  unsigned int keyHash = 2166136261u;
+  for( size_t idx=0; idx<keyLen; ++idx )
+    {
+    keyHash ^= (unsigned char)key[idx];
+    keyHash *= 16777619u;
+    }
+  return( keyHash );
+  }  // End method iddTable::hashKey().
+
+
+//--- Find the slot for a keyword.
+//
+//   Probe linearly from the hashed slot.  Return the slot holding the keyword,
+// or else the empty slot where it would go.
+//
+size_t iddTable::findSlot(const char *const key, size_t keyLen, unsigned int keyHash) const
+  {
+  const size_t slotMask = _slots.size() - 1;
+  size_t slotIdx = keyHash & slotMask;
+  while( 0 != _slots[slotIdx] )
+    {
+    const entry_s& entry = _entries[_slots[slotIdx]-1];
+    if( entry.keyHash == keyHash && entry.keyLen == keyLen &&
+      0 == memcmp(_keyPool.data()+entry.keyOff, key, keyLen) )
+      break;
+    slotIdx = (slotIdx + 1) & slotMask;
+    }
+  return( slotIdx );
+  }  // End method iddTable::findSlot().
+
+
+//--- Double the number of hash slots, and re-insert all entries.
+//
+void iddTable::growSlots(void)
+  {
+  _slots.assign(2*_slots.size(), 0);
+  const size_t slotMask = _slots.size() - 1;
+  for( size_t entryIdx=0; entryIdx<_entries.size(); ++entryIdx )
+    {
+    size_t slotIdx = _entries[entryIdx].keyHash & slotMask;
+    while( 0 != _slots[slotIdx] )
+      slotIdx = (slotIdx + 1) & slotMask;
+    _slots[slotIdx] = entryIdx + 1;
+    }
+  }  // End method iddTable::growSlots().
+
+
+//--- Store the descriptor of an entry.
+//
+void iddTable::storeDescriptor(entry_s& entry, const char *const desc, size_t descLen)
+  {
+  //
+  const string descStr(desc, descLen);
+  const int badIdx = iddMap_countDescriptorTypes(descStr, entry.strCt, entry.dblCt);
+  entry.descLen = descLen;
+  //
+  // Note {iddMap_countDescriptorTypes()} cannot flag a bad marker at index 0.
+  entry.descPacked = ( 0 == badIdx && entry.strCt + entry.dblCt == (int)descLen );
+  if( ! entry.descPacked )
+    {
+    entry.descOff = _descText.length();
+    _descText.append(desc, descLen);
+    return;
+    }
+  //
+  entry.descOff = _descBitCt;
+  _descBitCt += descLen;
+  _descBits.resize((_descBitCt+31)/32, 0);
+  for( size_t idx=0; idx<descLen; ++idx )
+    {
+    if( 'N' == desc[idx] )
+      {
+      const size_t bitIdx = entry.descOff + idx;
+      _descBits[bitIdx/32] |= 1u << (bitIdx%32);
+      }
+    }
+  }  // End method iddTable::storeDescriptor().
+
+
+//--- Write a binary snapshot of an Input Data Dictionary.
+//
+bool iddMap_writeSnapshot(std::ostream& snapStream, const iddMap& idd, const char *const md5Hex){
+  //
+  if( 32 != strlen(md5Hex) )
+    return false;
+  //
+  // Size the entries.
+  size_t entryBytes = 0;
+  iddMap::const_iterator it;
+  for( it=idd.begin(); it!=idd.end(); ++it ){
+    entryBytes += 8 + it->first.length() + it->second.length();
+  }
+  //
+  writeSnapshotHeader(snapStream, md5Hex, idd.size(), entryBytes);
+  for( it=idd.begin(); it!=idd.end(); ++it ){
+    writeSnapshotEntry(snapStream, it->first, it->second);
+  }
+  //
+  snapStream.flush();
+  return( snapStream.good() );
+}  // End fcn iddMap_writeSnapshot().
+
+
+//--- Write a binary snapshot of an {iddTable}.
+//
+bool iddMap_writeSnapshot(std::ostream& snapStream, const iddTable& idd, const char *const md5Hex){
+  //
+  if( 32 != strlen(md5Hex) )
+    return false;
+  //
+  // Size the entries.
+  size_t entryBytes = 0;
+  string desc;
+  for( size_t entryIdx=0; entryIdx<idd.size(); ++entryIdx ){
+    idd.getDescriptor(entryIdx, desc);
+    entryBytes += 8 + idd.getKey(entryIdx).length() + desc.length();
+  }
+  //
+  writeSnapshotHeader(snapStream, md5Hex, idd.size(), entryBytes);
+  for( size_t entryIdx=0; entryIdx<idd.size(); ++entryIdx ){
+    idd.getDescriptor(entryIdx, desc);
+    writeSnapshotEntry(snapStream, idd.getKey(entryIdx), desc);
+  }
+  //
+  snapStream.flush();
+  return( snapStream.good() );
+}  // End fcn iddMap_writeSnapshot().
+
+
+//--- Read a binary snapshot of an Input Data Dictionary.
+//
+bool iddMap_readSnapshot(const char *const snapFileName, const char *const md5Hex, iddMap& idd){
+  //
+  return( readSnapshot(snapFileName, md5Hex, idd) );
+}  // End fcn iddMap_readSnapshot().
+
+
+//--- Read a binary snapshot into an {iddTable}.
+//
+bool iddMap_readSnapshot(const char *const snapFileName, const char *const md5Hex, iddTable& idd){
+  //
+  return( readSnapshot(snapFileName, md5Hex, idd) );
+}  // End fcn iddMap_readSnapshot().
+
+
+//--- Write an unsigned integer as four little-endian bytes.
+//
+static void putUint32(std::ostream& outStream, unsigned int val){
+  //
+  char buf[4];
+  buf[0] = (char)(val & 0xFF);
+  buf[1] = (char)((val >> 8) & 0xFF);
+  buf[2] = (char)((val >> 16) & 0xFF);
+  buf[3] = (char)((val >> 24) & 0xFF);
+  outStream.write(buf, 4);
+}  // End fcn putUint32().
+
+
+//--- Read an unsigned integer from four little-endian bytes.
+//
+static unsigned int getUint32(const unsigned char *const buf){
+  //
+  return( (unsigned int)buf[0] | ((unsigned int)buf[1] << 8) |
+    ((unsigned int)buf[2] << 16) | ((unsigned int)buf[3] << 24) );
+}  // End fcn getUint32().
+
+
+//--- Write the header of a snapshot.
+//
+static void writeSnapshotHeader(std::ostream& snapStream, const char *const md5Hex,
+  size_t entryCt, size_t entryBytes){
+  //
+  snapStream.write(SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC));
+  putUint32(snapStream, SNAPSHOT_VERSION);
+  snapStream.write(md5Hex, 32);
+  putUint32(snapStream, (unsigned int)entryCt);
+  putUint32(snapStream, (unsigned int)entryBytes);
+}  // End fcn writeSnapshotHeader().
+
+
+//--- Write one entry of a snapshot.
+//
+static void writeSnapshotEntry(std::ostream& snapStream, const string& key, const string& desc){
+  //
+  putUint32(snapStream, (unsigned int)key.length());
+  putUint32(snapStream, (unsigned int)desc.length());
+  snapStream.write(key.data(), key.length());
+  snapStream.write(desc.data(), desc.length());
+}  // End fcn writeSnapshotEntry().
+
+
+//--- Add one snapshot entry to an {iddMap}.
+//
+//   Entries were written in key order, so hint each insert at the end.
+//
+static void addSnapshotEntry(iddMap& idd, const char *const key, size_t keyLen,
+  const char *const desc, size_t descLen){
+  //
+  idd.insert(idd.end(), iddMap::value_type(string(key, keyLen), string(desc, descLen)));
+}  // End fcn addSnapshotEntry().
+
+
+//--- Add one snapshot entry to an {iddTable}.
+//
+static void addSnapshotEntry(iddTable& idd, const char *const key, size_t keyLen,
+  const char *const desc, size_t descLen){
+  //
+  idd.setDescriptor(key, keyLen, desc, descLen);
+}  // End fcn addSnapshotEntry().
+
+
+//--- Read a snapshot file.
+//
+//   Memory-map the file where possible.
+//
+template <class IDD>
+static bool readSnapshot(const char *const snapFileName, const char *const md5Hex, IDD& idd){
+  //
+  bool gotSnap = false;
+  idd.clear();
+  //
+  #ifndef _WIN32
+    const int fd = ::open(snapFileName, O_RDONLY);
+    if( fd < 0 )
+      return false;
+    struct stat st;
+    if( 0 == fstat(fd, &st) && S_ISREG(st.st_mode) && 0 < st.st_size ){
+      void* addr = mmap(0, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+      if( MAP_FAILED != addr ){
+        gotSnap = parseSnapshot((const char*)addr, (size_t)st.st_size, md5Hex, idd);
+        munmap(addr, (size_t)st.st_size);
+      }
+    }
+    ::close(fd);
+  #else
+    std::ifstream snapStream(snapFileName, std::ios::in | std::ios::binary);
+    if( ! snapStream.is_open() )
+      return false;
+    std::vector<char> buf((std::istreambuf_iterator<char>(snapStream)),
+      std::istreambuf_iterator<char>());
+    if( ! buf.empty() )
+      gotSnap = parseSnapshot(&buf[0], buf.size(), md5Hex, idd);
+  #endif
+  //
+  if( ! gotSnap )
+    idd.clear();
+  return( gotSnap );
+}  // End fcn readSnapshot().
+
+
+//--- Unpack a snapshot held in memory.
+//
+//   Check every length against the buffer, so that a truncated or damaged
+// snapshot just gets rejected.
+//
+template <class IDD>
+static bool parseSnapshot(const char *const buf, size_t bufLen, const char *const md5Hex, IDD& idd){
+  //
+  const unsigned char *const ubuf = (const unsigned char*)buf;
+  //
+  // Check header.
+  if( bufLen < SNAPSHOT_HEADER_BYTES ||
+    0 != memcmp(buf, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC)) ||
+    SNAPSHOT_VERSION != getUint32(ubuf+8) ||
+    32 != strlen(md5Hex) || 0 != memcmp(buf+12, md5Hex, 32) )
+    return false;
+  const unsigned int entryCt = getUint32(ubuf+44);
+  const size_t entryBytes = getUint32(ubuf+48);
+  if( entryBytes != bufLen - SNAPSHOT_HEADER_BYTES )
+    return false;
+  //
+  // Unpack entries.
+  size_t pos = SNAPSHOT_HEADER_BYTES;
+  for( unsigned int idx=0; idx<entryCt; ++idx ){
+    if( bufLen - pos < 8 )
+      return false;
+    const size_t keyLen = getUint32(ubuf+pos);
+    const size_t descLen = getUint32(ubuf+pos+4);
+    pos += 8;
+    if( bufLen - pos < keyLen || bufLen - pos - keyLen < descLen )
+      return false;
+    addSnapshotEntry(idd, buf+pos, keyLen, buf+pos+keyLen, descLen);
+    pos += keyLen + descLen;
+  }
+  //
+  return( pos == bufLen );
+}  // End fcn parseSnapshot().
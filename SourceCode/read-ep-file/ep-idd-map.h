@@ -61,6 +61,8 @@
 #include <string>
 using std::string;
 #include <map>
+#include <ostream>
+#include <vector>
 
 
 //--- Types.
@@ -84,6 +86,98 @@ using std::string;
 typedef std::map<std::string, std::string> iddMap;
 
 
+//--- Store an IDD mapping, for fast lookup.
+//
+//   An \c iddTable holds the same keyword-descriptor pairs as an \c iddMap,
+// but finds keywords with an open-addressing hash table instead of a tree
+// of string compares.
+//
+//   Keywords are interned: their characters are stored once, end to end, in a
+// single pool.  Descriptors are stored as bitstrings, one bit per marker
+// (set for "N", clear for "A"), along with the marker counts found by
+// \c iddMap_countDescriptorTypes().  A descriptor that contains any other
+// marker is kept as plain text instead, so that it reads back unchanged.
+//
+//   Entries are numbered in the order they were first added.  Adding an
+// existing keyword replaces its descriptor but keeps its number.
+//
+class iddTable {
+
+public:
+
+  /// Constructor.
+  iddTable(void);
+
+  /// Remove all entries.
+  void clear(void);
+
+  /// Copy all entries of an \c iddMap.
+  void assign(const iddMap& idd);
+
+  /// \return Number of entries.
+  size_t size(void) const { return( _entries.size() ); }
+
+  /// \return \c true if have no entries.
+  bool empty(void) const { return( _entries.empty() ); }
+
+  /// Add an entry, or replace the descriptor of an existing entry.
+  void setDescriptor(const char *const key, size_t keyLen, const char *const desc, size_t descLen);
+  void setDescriptor(const string& key, const string& desc)
+    { setDescriptor(key.data(), key.length(), desc.data(), desc.length()); }
+
+  /// Find a keyword.
+  ///
+  /// \retval entryIdx Number of the entry for \c key.
+  /// \return \c true if \c key is valid, \c false otherwise.
+  bool find(const char *const key, size_t keyLen, size_t& entryIdx) const;
+  bool find(const string& key, size_t& entryIdx) const
+    { return( find(key.data(), key.length(), entryIdx) ); }
+
+  /// Get the keyword of an entry.
+  string getKey(size_t entryIdx) const;
+
+  /// Get the descriptor of an entry.
+  void getDescriptor(size_t entryIdx, string& desc) const;
+
+  /// Get the marker counts of an entry, as from \c iddMap_countDescriptorTypes().
+  void getDescriptorTypeCounts(size_t entryIdx, int& strCt, int& dblCt) const;
+
+  /// \return \c true if the descriptor of an entry equals \c desc.
+  bool descriptorEquals(size_t entryIdx, const string& desc) const;
+
+private:
+
+  // One keyword-descriptor pair.
+  //   For a packed descriptor, {descOff} is the index of its first bit in
+  // {_descBits}.  Otherwise, it is the index of its first character in {_descText}.
+  struct entry_s {
+    size_t keyOff;
+    size_t keyLen;
+    unsigned int keyHash;
+    size_t descOff;
+    size_t descLen;
+    int strCt;
+    int dblCt;
+    bool descPacked;
+  };
+
+  std::vector<entry_s> _entries;
+  string _keyPool;
+  std::vector<unsigned int> _descBits;
+  size_t _descBitCt;
+  string _descText;
+
+  // Hash slots, each holding zero (empty) or one more than an entry number.
+  //   The number of slots is a power of two, at least twice the number of entries.
+  std::vector<size_t> _slots;
+
+  static unsigned int hashKey(const char *const key, size_t keyLen);
+  size_t findSlot(const char *const key, size_t keyLen, unsigned int keyHash) const;
+  void growSlots(void);
+  void storeDescriptor(entry_s& entry, const char *const desc, size_t descLen);
+};
+
+
 //--- Functions.
 
 
@@ -94,6 +188,7 @@ typedef std::map<std::string, std::string> iddMap;
 /// \retval desc String containing the descriptor (blank if invalid key).
 /// \return \c true if \c key is valid, \c false otherwise.
 bool iddMap_getDescriptor(const iddMap& idd, const string& key, string& desc);
+bool iddMap_getDescriptor(const iddTable& idd, const string& key, string& desc);
 
 
 /// Count the "A" (string) and "N" (double) markers in a data dictionary descriptor.
@@ -130,6 +225,38 @@ void iddMap_markDescriptorIdx(const string& desc, int markIdx, string& markedDes
 //
 int iddMap_compareEntry(const iddMap& idd, const string& expectKey, const string& expectDesc,
   string &errStr);
+int iddMap_compareEntry(const iddTable& idd, const string& expectKey, const string& expectDesc,
+  string &errStr);
+
+
+//--- Write a binary snapshot of an Input Data Dictionary.
+//
+//   Parsing a full IDD file takes far longer than reading back the few
+// thousand keyword-descriptor pairs it contains.  A snapshot stores those
+// pairs, along with the MD5 checksum of the IDD file they came from, so that
+// a later run can skip the parse as long as the IDD file has not changed.
+//
+//   The snapshot format is versioned.  All integers are written little-endian,
+// so a snapshot can be shared between machines.
+//
+// \param md5Hex  MD5 checksum of the IDD file, as 32 hex digits.
+// \return \c true on success.
+//
+bool iddMap_writeSnapshot(std::ostream& snapStream, const iddMap& idd, const char *const md5Hex);
+bool iddMap_writeSnapshot(std::ostream& snapStream, const iddTable& idd, const char *const md5Hex);
+
+
+//--- Read a binary snapshot of an Input Data Dictionary.
+//
+//   Memory-map the snapshot file where possible.
+//
+// \param md5Hex  Expected MD5 checksum of the IDD file, as 32 hex digits.
+// \retval idd  Keywords and descriptors from the snapshot.
+// \return \c true if the snapshot exists, is well-formed, and was taken from
+//   an IDD file with checksum \c md5Hex.  On \c false, \c idd is left empty.
+//
+bool iddMap_readSnapshot(const char *const snapFileName, const char *const md5Hex, iddMap& idd);
+bool iddMap_readSnapshot(const char *const snapFileName, const char *const md5Hex, iddTable& idd);
 
 
 #endif //__EP_IDD_MAP_H__
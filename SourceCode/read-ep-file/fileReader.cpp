@@ -8,7 +8,9 @@
 
 //--- Includes.
 
+#include <cctype>
 #include <cstdlib>
+#include <cstring>
 
 #include <iostream>
 using std::string;
@@ -16,48 +18,288 @@ using std::cerr;
 using std::cout;
 using std::endl;
 
+#include <fstream>
 #include <sstream>
 
+#if defined(__SSE2__) && defined(__GNUC__)
+#define FILEREADER_USE_SSE2
+#include <emmintrin.h>
+#endif
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
 #include "fileReader.h"
 
 
+//--- Preprocessor definitions.
+//
+// Size of the consumed part of a mapped file at which to release it.
+#define FILEREADER_RELEASE_BYTES (8*1024*1024)
+
+
+//--- Build the table of character classes.
+//
+fileReaderCharClass::fileReaderCharClass(const string& delimiters,
+  const string& commentChars, const string& illegalChars)
+  {
+  memset(classTable, 0, sizeof(classTable));
+  for( int classIdx=0; classIdx<CLASS_CT; ++classIdx )
+    {
+    classCharCt[classIdx] = 0;
+    }
+  //
+  // Note the bit of class {classIdx} is (1 << classIdx).
+  addChars(delimiters, 0);
+  addChars(commentChars, 1);
+  addChars(illegalChars, 2);
+  addChars(" \t\n\v\f\r", 3);
+  addChars("\n", 4);
+  }  // End constructor fileReaderCharClass::fileReaderCharClass().
+
+
+//--- Add characters to a class.
+//
+void fileReaderCharClass::addChars(const string& chars, int classIdx)
+  {
+  for( size_t idx=0; idx<chars.length(); ++idx )
+    {
+    const char ch = chars[idx];
+    classTable[(unsigned char)ch] |= (unsigned char)(1 << classIdx);
+    if( classCharCt[classIdx] < CLASS_MAX_CHARS )
+      {
+      classChars[classIdx][classCharCt[classIdx]] = ch;
+      }
+    ++classCharCt[classIdx];
+    }
+  }  // End method fileReaderCharClass::addChars().
+
+
+//--- Find the first character in one of the classes.
+//
+//   Where SSE2 is available, and the classes have few characters, compare 16
+// characters at a time with each character of the classes.  Finish, or do all
+// the work otherwise, with the table.
+//
+const char* fileReaderCharClass::find(const char* beg, const char* end, int classMask) const
+  {
+  #ifdef FILEREADER_USE_SSE2
+    char chars[CLASS_MAX_CHARS];
+    int charCt = 0;
+    for( int classIdx=0; classIdx<CLASS_CT && charCt<=CLASS_MAX_CHARS; ++classIdx )
+      {
+      if( 0 != (classMask & (1 << classIdx)) )
+        {
+        const int classCharCtHere = classCharCt[classIdx];
+        if( CLASS_MAX_CHARS < charCt + classCharCtHere )
+          {
+          charCt = CLASS_MAX_CHARS + 1;
+          break;
+          }
+        memcpy(chars + charCt, classChars[classIdx], classCharCtHere);
+        charCt += classCharCtHere;
+        }
+      }
+    if( 0 == charCt )
+      {
+      return( end );
+      }
+    if( charCt <= CLASS_MAX_CHARS )
+      {
+      __m128i patterns[CLASS_MAX_CHARS];
+      for( int idx=0; idx<charCt; ++idx )
+        {
+        patterns[idx] = _mm_set1_epi8(chars[idx]);
+        }
+      while( 16 <= end - beg )
+        {
+        const __m128i block = _mm_loadu_si128((const __m128i*)beg);
+        __m128i hits = _mm_cmpeq_epi8(block, patterns[0]);
+        for( int idx=1; idx<charCt; ++idx )
+          {
+          hits = _mm_or_si128(hits, _mm_cmpeq_epi8(block, patterns[idx]));
+          }
+        const int hitBits = _mm_movemask_epi8(hits);
+        if( 0 != hitBits )
+          {
+          return( beg + __builtin_ctz(hitBits) );
+          }
+        beg += 16;
+        }
+      }
+  #endif
+  //
+  while( beg != end && 0 == (classTable[(unsigned char)*beg] & classMask) )
+    {
+    ++beg;
+    }
+  return( beg );
+  }  // End method fileReaderCharClass::find().
+
+
 ///////////////////////////////////////////////////////
 fileReader::fileReader(const string& fname){
   fileName = fname;
   lineNumber = 0;
   externalErrorFcn = 0;
+  externalErrorCtxFcn = 0;
+  externalErrorContext = 0;
+  bufBeg = bufCur = bufEnd = 0;
+  atEOF = false;
+  exitOnError = true;
+  errorCt = 0;
+  mapAddr = 0;
+  mapLen = 0;
+  mapKeep = 0;
 }
 
-///////////////////////////////////////////////////////
+
+//--- Open the file.
+//
+//   Map the file into memory if possible.  Otherwise, for example on Windows,
+// or for a file that is not a regular file, read it into {bufData} in one
+// block.  Reading through a text-mode stream keeps the line-end translation
+// of the platform.
+//
 void fileReader::open(){
-  fileStream.open(fileName.c_str(), std::ios::in);
-  if( ! fileStream.is_open() ){
-     std::ostringstream os;
-     os << "Cannot open file";
-     reportError(os);
-     exit(1);
+  close();
+  #ifndef _WIN32
+    const int fd = ::open(fileName.c_str(), O_RDONLY);
+    if( 0 <= fd ){
+      struct stat st;
+      if( 0 == fstat(fd, &st) && S_ISREG(st.st_mode) ){
+        if( 0 == st.st_size ){
+          // Here, empty file, which cannot be mapped.
+          bufBeg = bufCur = bufEnd = bufData.data();
+        }
+        else{
+          void* addr = mmap(0, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+          if( MAP_FAILED != addr ){
+            #ifdef MADV_SEQUENTIAL
+              madvise(addr, (size_t)st.st_size, MADV_SEQUENTIAL);
+            #endif
+            mapAddr = addr;
+            mapLen = (size_t)st.st_size;
+            bufBeg = bufCur = mapKeep = (const char*)addr;
+            bufEnd = bufBeg + mapLen;
+          }
+        }
+      }
+      ::close(fd);
+    }
+  #endif
+  if( ! bufBeg ){
+    std::ifstream fileStream(fileName.c_str(), std::ios::in);
+    if( ! fileStream.is_open() ){
+       std::ostringstream os;
+       os << "Cannot open file";
+       errorCt = 0;
+       reportError(os);
+       if( exitOnError )
+         exit(1);
+       // Here, caller handles the error.  Read nothing.
+       bufBeg = bufCur = bufEnd = bufData.data();
+       atEOF = true;
+       return;
+    }
+    std::ostringstream contents;
+    contents << fileStream.rdbuf();
+    bufData = contents.str();
+    bufBeg = bufCur = bufData.data();
+    bufEnd = bufBeg + bufData.length();
   }
+  atEOF = false;
+  errorCt = 0;
   lineNumber = 1;
 }
 
 
+//--- Open part of the contents of another reader.
+//
+//   If the other reader mapped the file, let this one release the pages it
+// has passed, starting at the page that holds {beg}.  Readers of neighboring
+// parts may share that page.  Releasing it early only costs reading it from
+// the file again.
+//
+void fileReader::openPart(const fileReader& whole, const char* beg, const char* end)
+  {
+  close();
+  #ifndef _WIN32
+    if( whole.mapAddr )
+      {
+      const size_t pageSize = (size_t)sysconf(_SC_PAGESIZE);
+      const char* mapStart = (const char*)whole.mapAddr;
+      mapKeep = mapStart + ((size_t)(beg - mapStart) / pageSize) * pageSize;
+      }
+  #endif
+  bufBeg = bufCur = beg;
+  bufEnd = end;
+  atEOF = false;
+  errorCt = 0;
+  lineNumber = 1;
+  }  // End method fileReader::openPart().
+
+
 //--- Close the file.
 //
 void fileReader::close()
   {
-  if( fileStream.is_open() )
-    {
-    fileStream.close();
-    }
+  #ifndef _WIN32
+    if( mapAddr )
+      {
+      munmap(mapAddr, mapLen);
+      }
+  #endif
+  mapAddr = 0;
+  mapLen = 0;
+  mapKeep = 0;
+  bufData.clear();
+  bufBeg = bufCur = bufEnd = 0;
   lineNumber = 0;
   }  // End method fileReader::close().
 
 
+//--- Release consumed part of a mapped file.
+//
+//   The reader never moves backward, so the pages before the cursor are not
+// needed again.  Dropping them keeps the resident set small for large files.
+// Should they be touched after all, they are read from the file again.
+//
+void fileReader::releaseConsumed()
+  {
+  #ifndef _WIN32
+    if( mapKeep && bufCur - mapKeep >= FILEREADER_RELEASE_BYTES )
+      {
+      const size_t pageSize = (size_t)sysconf(_SC_PAGESIZE);
+      const size_t relLen = ((size_t)(bufCur - mapKeep) / pageSize) * pageSize;
+      madvise((void*)mapKeep, relLen, MADV_DONTNEED);
+      mapKeep += relLen;
+      }
+  #endif
+  }  // End method fileReader::releaseConsumed().
+
+
 //--- Attach an error-reporting function.
 //
 void fileReader::attachErrorFcn(void (*errFcn)(
   std::ostringstream& errorMessage, const std::string& fileName, int lineNo)){
   externalErrorFcn = errFcn;
+  externalErrorCtxFcn = 0;
+}  // End method fileReader::attachErrorFcn().
+
+
+//--- Attach an error-reporting function that takes a context.
+//
+void fileReader::attachErrorFcn(void (*errFcn)(void* errContext,
+  std::ostringstream& errorMessage, const std::string& fileName, int lineNo),
+  void* errContext){
+  externalErrorFcn = 0;
+  externalErrorCtxFcn = errFcn;
+  externalErrorContext = errContext;
 }  // End method fileReader::attachErrorFcn().
 
 
@@ -65,17 +307,18 @@ void fileReader::attachErrorFcn(void (*errFcn)(
 //
 char fileReader::getChar(void)
   {
-  const int charAsInt = fileStream.get();
-  if( (int)'\n' == charAsInt )
+  if( bufCur == bufEnd )
     {
-    ++lineNumber;
+    atEOF = true;
+    return( '\0' );
     }
-  else if( EOF == charAsInt )
+  const char ch = *bufCur++;
+  if( '\n' == ch )
     {
-    return( '\0' );
+    ++lineNumber;
     }
   //
-  return( (char)charAsInt );
+  return( ch );
   }  // End method fileReader::getChar().
 
 
@@ -84,25 +327,29 @@ char fileReader::getChar(void)
 // hoho dml  Note could return EOF status.
 //
 void fileReader::skipComment(const string& commentSign, int& lineNo){
-  char ch;
+  skipComment(fileReaderCharClass("", commentSign, ""), lineNo);
+}  // End method fileReader::skipComment().
+
+
+void fileReader::skipComment(const fileReaderCharClass& charClass, int& lineNo){
   //
-  if( ! fileStream.eof() ){
+  if( ! atEOF ){
     while( 1 ){
       // Here, assume next content on current line may be a comment.
       // Get first non-space character.
       skipSpace(lineNo);
-      if( fileStream.eof() )
+      if( atEOF )
         break;
-      fileStream.get(ch);
-      // Check {ch}.
-      if( fileStream.eof() )
+      // Check next character, without consuming it.
+      if( bufCur == bufEnd ){
+        atEOF = true;
         break;
-      if( commentSign.find(ch) == std::string::npos ){
+      }
+      if( 0 == (charClass.classOf(*bufCur) & fileReaderCharClass::COMMENT) ){
         // Not a comment line.
-        fileStream.putback(ch);
         break;
       }
-      // Here, {ch} starts a comment.
+      // Here, next character starts a comment.
       //   Skip rest of line, then go back to check whether next line also
       // is a comment.
       skipLine(lineNo);
@@ -128,91 +375,177 @@ void fileReader::skipComment(const string& commentSign, int& lineNo){
 //
 void fileReader::getToken(const string& delimiters, const string& illegalChars,
   string& token){
+  getToken(fileReaderCharClass(delimiters, "", illegalChars), token);
+}  // End method fileReader::getToken().
+
+
+void fileReader::getToken(const fileReaderCharClass& charClass, string& token){
+  fileReaderSpan tokenSpan;
+  getToken(charClass, tokenSpan);
+  token.assign(tokenSpan.beg, tokenSpan.len);
+}  // End method fileReader::getToken().
+
+
+void fileReader::getToken(const fileReaderCharClass& charClass, fileReaderSpan& token){
   //
-  token = "";
-  char ch;
+  token.beg = bufCur;
+  token.len = 0;
   //
-  if( ! fileStream.eof() ){
+  if( ! atEOF ){
+    const char* tokEnd = bufCur;
     while( 1 ){
-      // Get next character (which may or may not be part of the token).
-      fileStream.get(ch);
+      // Find next character that may end the token, or that starts a new line.
       // Reasons to end the token:
       // ** Hit EOF.
       // ** Hit a delimiter.
       // ** Hit a comment (which is an error).
       //   Note hitting EOL does not end a token.
-      if( fileStream.eof() )
+      tokEnd = charClass.find(tokEnd, bufEnd,
+        fileReaderCharClass::DELIMITER | fileReaderCharClass::ILLEGAL | fileReaderCharClass::NEWLINE);
+      if( tokEnd == bufEnd ){
+        atEOF = true;
         break;
-      if( '\n' == ch )
+      }
+      const char ch = *tokEnd;
+      const int chClass = charClass.classOf(ch);
+      if( 0 != (chClass & fileReaderCharClass::NEWLINE) )
         ++lineNumber;
-      if( delimiters.find(ch) != std::string::npos ){
+      if( 0 != (chClass & fileReaderCharClass::DELIMITER) ){
         // Here, found delimiter.
-        //   Put delimiter back before finish.
-        fileStream.putback(ch);
+        //   Leave delimiter unread before finish.
         break;
       }
-      if( illegalChars.find(ch) != std::string::npos ){
+      if( 0 != (chClass & fileReaderCharClass::ILLEGAL) ){
         // Error, illegal character.
+        bufCur = tokEnd + 1;
         std::ostringstream os;
         os << "Encountered illegal character '" << ch << "' while reading a token.";
         reportError(os);
-        exit(1);
+        if( exitOnError )
+          exit(1);
+        // Here, caller handles the error.  Read nothing more.
+        bufCur = bufEnd;
+        atEOF = true;
+        return;
       }
       // Here, still reading token.
-      token += ch;
+      ++tokEnd;
     }
+    token.len = tokEnd - bufCur;
+    bufCur = tokEnd;
+    releaseConsumed();
   }
   //
   return;
 }  // End method fileReader::getToken().
 
+
 void fileReader::getToken(const string& delimiters, const string& illegalChars,
+	string& token, string& tokenExt){
+	getToken(fileReaderCharClass(delimiters, "", illegalChars), token, tokenExt);
+}  // End method fileReader::getToken().
+
+
+void fileReader::getToken(const fileReaderCharClass& charClass,
 	string& token, string& tokenExt){
 	//
-	token = "";
-	tokenExt = "";
-	char ch;
+	token.clear();
+	tokenExt.clear();
 	//
-	if (!fileStream.eof()){
+	if (!atEOF){
+		const char* tokEnd = bufCur;
 		while (1){
-			// Get next character (which may or may not be part of the token).
-			fileStream.get(ch);
+			// Find next character that may end the token, or that starts a new line.
 			// Reasons to end the token:
 			// ** Hit EOF.
 			// ** Hit a delimiter.
 			// ** Hit a comment (which is an error).
 			//   Note hitting EOL does not end a token.
-			if (fileStream.eof())
+			tokEnd = charClass.find(tokEnd, bufEnd,
+				fileReaderCharClass::DELIMITER | fileReaderCharClass::NEWLINE);
+			if (tokEnd == bufEnd){
+				atEOF = true;
 				break;
-			if ('\n' == ch)
+			}
+			const int chClass = charClass.classOf(*tokEnd);
+			if (0 != (chClass & fileReaderCharClass::NEWLINE))
 				++lineNumber;
-			if (delimiters.find(ch) != std::string::npos){
+			if (0 != (chClass & fileReaderCharClass::DELIMITER)){
 				// Here, found delimiter.
-				//   Put delimiter back before finish.
-				tokenExt += ch;
-				fileStream.putback(ch);
+				//   Leave delimiter unread before finish, but include it
+				// in {tokenExt}.
+				tokenExt.assign(bufCur, tokEnd + 1);
 				break;
 			}
-			//if (illegalChars.find(ch) != std::string::npos){
+			//if (0 != (chClass & fileReaderCharClass::ILLEGAL)){
 			//	// Error, illegal character.
 			//	std::ostringstream os;
-			//	os << "Encountered illegal character '" << ch << "' while reading a token.";
+			//	os << "Encountered illegal character '" << *tokEnd << "' while reading a token.";
 			//	reportError(os);
 			//	exit(1);
 			//}
 			// Here, still reading token.
-			token += ch;
-			tokenExt += ch;
+			++tokEnd;
 		}
+		token.assign(bufCur, tokEnd);
+		if (tokEnd == bufEnd)
+			tokenExt = token;
+		bufCur = tokEnd;
+		releaseConsumed();
 	}
 	//
 	return;
 }  // End method fileReader::getToken().
 
 
-///////////////////////////////////////////////////////
+//--- Move to the next character in one of the classes.
+//
+//   Do not consume that character, and do not set EOF if there is none, so
+// that the caller can read it with getChar().
+//
+bool fileReader::skipToClass(const fileReaderCharClass& charClass, int classMask){
+  //
+  if( ! atEOF ){
+    while( 1 ){
+      bufCur = charClass.find(bufCur, bufEnd, classMask | fileReaderCharClass::NEWLINE);
+      if( bufCur == bufEnd )
+        break;
+      if( 0 != (charClass.classOf(*bufCur) & classMask) ){
+        releaseConsumed();
+        return true;
+      }
+      // Here, skip a new line that is not in {classMask}.
+      ++lineNumber;
+      ++bufCur;
+    }
+    releaseConsumed();
+  }
+  //
+  return false;
+}  // End method fileReader::skipToClass().
+
+
+//--- Get the rest of the current line.
+//
+//   As {std::getline()}, consume the '\n' but do not store it, and leave
+// {line} unchanged if already at EOF.
+//
 void fileReader::getLine(string& line, int& lineNo){
-  getline(fileStream, line);
+  if( bufCur == bufEnd ){
+    atEOF = true;
+  }
+  else{
+    const char* lineEnd = (const char*)memchr(bufCur, '\n', bufEnd - bufCur);
+    if( lineEnd ){
+      line.assign(bufCur, lineEnd);
+      bufCur = lineEnd + 1;
+    }
+    else{
+      line.assign(bufCur, bufEnd);
+      bufCur = bufEnd;
+      atEOF = true;
+    }
+  }
   lineNo = lineNumber++;
   return;
 }
@@ -222,18 +555,21 @@ void fileReader::getLine(string& line, int& lineNo){
 //
 void fileReader::skipSpace(int& lineNo) {
   //
-  if( ! fileStream.eof() ){
+  if( ! atEOF ){
     while( 1 ){
-      // Get next character.
-      const char ch = getChar();
-      if( fileStream.eof() )
+      if( bufCur == bufEnd ){
+        atEOF = true;
         break;
-      if( ! isspace(ch) ){
-        // Return non-space to fileStream before finish.
-        fileStream.putback(ch);
+      }
+      const char ch = *bufCur;
+      if( ! isspace((unsigned char)ch) ){
+        // Leave non-space unread before finish.
         break;
-      // Here, still consuming spaces.
       }
+      // Here, still consuming spaces.
+      if( '\n' == ch )
+        ++lineNumber;
+      ++bufCur;
     }
   }
   //
@@ -244,18 +580,29 @@ void fileReader::skipSpace(int& lineNo) {
 
 ///////////////////////////////////////////////////////
 void fileReader::skipLine(int& lineNo){
-  string dummy;
-  getline(fileStream, dummy);
+  if( bufCur == bufEnd ){
+    atEOF = true;
+  }
+  else{
+    const char* lineEnd = (const char*)memchr(bufCur, '\n', bufEnd - bufCur);
+    if( lineEnd ){
+      bufCur = lineEnd + 1;
+    }
+    else{
+      bufCur = bufEnd;
+      atEOF = true;
+    }
+    releaseConsumed();
+  }
   lineNo = ++lineNumber;
   return;
 }
 
+
 ///////////////////////////////////////////////////////
 void fileReader::skipLine(const int noOfLines, int& lineNo){
-  string dummy;
   for (int i = 0; i < noOfLines; i++){
-    getline(fileStream, dummy);
-    lineNo = ++lineNumber;
+    skipLine(lineNo);
   }
   return;
 }
@@ -264,15 +611,15 @@ void fileReader::skipLine(const int noOfLines, int& lineNo){
 ///////////////////////////////////////////////////////
 bool fileReader::moveForward(int skipCharCt){
   while( skipCharCt > 0 ){
-    const int charAsInt = fileStream.get();
     --skipCharCt;
-    if( (int)'\n' == charAsInt ){
-      ++lineNumber;
-    }
-    else if( EOF == charAsInt ){
+    if( bufCur == bufEnd ){
       // Hit EOF before ate \c skipCharCt characters.
+      atEOF = true;
       return false;
     }
+    if( '\n' == *bufCur++ ){
+      ++lineNumber;
+    }
   }
   // Here, ate {skipCharCt} characters, without hitting EOF.
   return true;
@@ -282,11 +629,16 @@ bool fileReader::moveForward(int skipCharCt){
 //--- Report an error.
 //
 void fileReader::reportError(std::ostringstream& errorMessage){
+  //
+  ++errorCt;
   //
   // Call user-supplied error fcn if available.
   if( externalErrorFcn ){
     (*externalErrorFcn)(errorMessage, fileName, lineNumber);
   }
+  else if( externalErrorCtxFcn ){
+    (*externalErrorCtxFcn)(externalErrorContext, errorMessage, fileName, lineNumber);
+  }
   else{
     // Here, no user-supplied error fcn.
     //   Note flush both {cout} and {cerr}, to avoid overlapped writes.
@@ -8,6 +8,10 @@
 /// \brief  Virtual file reader for input parameter and weather
 ///         data.
 ///
+/// The whole file is held in memory while it is open, either
+/// memory-mapped or, where mapping is not available, read in one
+/// block.  All reads advance a cursor into this buffer.
+///
 ///////////////////////////////////////////////////////
 #if !defined(__FILEREADER_H__)
 #define __FILEREADER_H__
@@ -16,6 +20,71 @@
 #include <string>
 
 
+///////////////////////////////////////////////////////
+/// Classes of characters that the \c fileReader scans for.
+///
+/// A caller builds one table for each set of delimiters, comment
+/// characters, and illegal characters it uses, and passes it to the
+/// \c fileReader methods, instead of passing the sets as strings.
+class fileReaderCharClass {
+
+public:
+  /// Bits of the class of a character.  A character can be in more
+  /// than one class.
+  enum {
+    DELIMITER = 1,  ///< Ends a token.
+    COMMENT   = 2,  ///< Starts a comment that runs to the end of the line.
+    ILLEGAL   = 4,  ///< Must not appear in a token.
+    SPACE     = 8,  ///< White space, as for \c isspace() in the "C" locale.
+    NEWLINE   = 16  ///< Ends a line.
+  };
+
+  /// Constructor.
+  /// \param delimiters Characters that mark end of token.
+  /// \param commentChars Characters that begin a comment.
+  /// \param illegalChars Characters that should never appear in a token.
+  fileReaderCharClass(const std::string& delimiters, const std::string& commentChars,
+    const std::string& illegalChars);
+
+  /// Gets the class of a character.
+  /// \param ch Character.
+  /// \return Bits of the classes that contain \c ch.
+  inline int classOf(char ch) const { return classTable[(unsigned char)ch]; }
+
+  /// Finds the first character in a range that is in one of the classes.
+  /// \param beg Start of the range.
+  /// \param end End of the range.
+  /// \param classMask Bits of the classes to look for.
+  /// \return Pointer to the character, or \c end if there is none.
+  const char* find(const char* beg, const char* end, int classMask) const;
+
+private:
+  enum { CLASS_CT = 5, CLASS_MAX_CHARS = 8 };
+
+  /// Table of the class bits for each character.
+  unsigned char classTable[256];
+  /// Characters of each class, for the vectorized search.  A count
+  /// above \c CLASS_MAX_CHARS means the class has too many characters
+  /// to search for them one by one.
+  char classChars[CLASS_CT][CLASS_MAX_CHARS];
+  int classCharCt[CLASS_CT];
+
+  void addChars(const std::string& chars, int classIdx);
+};
+
+
+///////////////////////////////////////////////////////
+/// Characters of the file, as read by the \c fileReader without
+/// copying them.  Valid until the file is closed.
+struct fileReaderSpan {
+  const char* beg;  ///< First character.
+  size_t len;       ///< Count of characters.
+
+  /// Returns a copy of the characters.
+  std::string str() const { return std::string(beg, len); }
+};
+
+
 ///////////////////////////////////////////////////////
 /// File reader for input parameter and weather  data.
 class fileReader {
@@ -32,6 +101,13 @@ public:
   void attachErrorFcn(void (*errFcn)(
     std::ostringstream& errorMessage, const std::string& fileName, int lineNo));
 
+  /// Attach an error-reporting function that takes a context.
+  /// \param errFcn Pointer to function to be called in case of a \c fileReader error.
+  /// \param errContext Pointer passed as the first argument of \c errFcn.
+  void attachErrorFcn(void (*errFcn)(void* errContext,
+    std::ostringstream& errorMessage, const std::string& fileName, int lineNo),
+    void* errContext);
+
   /// Gets the current line.
   /// \retval str String where the current line will be stored.
   /// \retval lineNo Integer where the current line number will be stored.
@@ -65,6 +141,13 @@ public:
   /// \retval lineNo Line number.
   void skipComment(const std::string& commentSign, int& lineNo);
 
+  /// Skips all comments (and spaces) starting from the
+  ///  current buffer position.
+  /// \param charClass Classes of characters, of which
+  ///       \c fileReaderCharClass::COMMENT begin a line comment.
+  /// \retval lineNo Line number.
+  void skipComment(const fileReaderCharClass& charClass, int& lineNo);
+
   /// Moves pointer of \c ifstream forward.
   /// \param skipCharCt Number of characters to move forward.
   /// \return \c false if moving the pointer is not possible due to end of file,
@@ -92,6 +175,35 @@ public:
   //   delimiter with no actual token, returns without indication something out-of-ordinary happened.
   void getToken(const std::string& delimiters, const std::string& illegalChars, std::string& token, std::string& tokenExt);
 
+  /// Gets the current token.
+  /// \param charClass Classes of characters, of which
+  ///       \c fileReaderCharClass::DELIMITER mark end of token, and
+  ///       \c fileReaderCharClass::ILLEGAL should never appear.
+  /// \retval token String where the current token is stored.
+  void getToken(const fileReaderCharClass& charClass, std::string& token);
+
+  /// Gets the current token, without copying it.
+  /// \param charClass Classes of characters, of which
+  ///       \c fileReaderCharClass::DELIMITER mark end of token, and
+  ///       \c fileReaderCharClass::ILLEGAL should never appear.
+  /// \retval token Span where the current token is stored.
+  void getToken(const fileReaderCharClass& charClass, fileReaderSpan& token);
+
+  /// Gets the current token.
+  /// \param charClass Classes of characters, of which
+  ///       \c fileReaderCharClass::DELIMITER mark end of token.
+  /// \retval token String where the current token is stored.
+  /// \retval tokenExt String where the current token with delimiter is stored.
+  void getToken(const fileReaderCharClass& charClass, std::string& token, std::string& tokenExt);
+
+  /// Moves the stream pointer to the next character in one of the classes,
+  /// without consuming that character.
+  /// \param charClass Classes of characters.
+  /// \param classMask Bits of the classes to stop at.
+  /// \return \c false if there is no such character before end of file,
+  ///         \c true otherwise.
+  bool skipToClass(const fileReaderCharClass& charClass, int classMask);
+
   /// Gets the current line number.
   /// \retval The current line number.
   inline int getLineNumber(){ return lineNumber; }
@@ -99,25 +211,80 @@ public:
   /// Opens the file, writes an error message if file cannot be opened.
   void open();
 
+  /// Opens part of the contents of another open \c fileReader, without
+  /// copying it.  Line numbers count from 1 at the start of the part.
+  ///
+  /// The other reader must stay open until this one is closed.  Readers of different parts of the same file may
+  /// run on different threads.
+  /// \param whole Open reader of the whole file.
+  /// \param beg Start of the part, from \c getContents() of \c whole.
+  /// \param end End of the part.
+  void openPart(const fileReader& whole, const char* beg, const char* end);
+
+  /// Gets the contents of the open file.
+  /// \retval beg Start of the contents.
+  /// \retval end End of the contents.
+  void getContents(const char*& beg, const char*& end) const { beg = bufBeg; end = bufEnd; }
+
+  /// Sets whether a read error ends the program, as it does by default.
+  ///
+  /// If not, the reader reports the error, then acts as at end-of-file.
+  /// \param doExit \c false to return to the caller after an error.
+  void setExitOnError(bool doExit){ exitOnError = doExit; }
+
+  /// Gets whether a read error ends the program.
+  bool getExitOnError() const { return exitOnError; }
+
+  /// Gets the count of errors reported since the file was opened.
+  int getErrorCount() const { return errorCt; }
+
   /// Closes the file.
   void close();
 
   /// Check for end-of-file.
-  bool isEOF(){ return fileStream.eof(); }
+  ///
+  /// As for a \c std::istream, this becomes true only after a read
+  /// tried to go past the last character.
+  bool isEOF(){ return atEOF; }
 
 protected:
 
   //--- Protected member data.
   std::string fileName;
-  std::ifstream fileStream;
   int lineNumber;
   void (*externalErrorFcn)(std::ostringstream& errorMessage, const std::string& fileName, int lineNo);
+  void (*externalErrorCtxFcn)(void* errContext,
+    std::ostringstream& errorMessage, const std::string& fileName, int lineNo);
+  void* externalErrorContext;
 
   //--- Protected methods.
   void reportError(std::ostringstream& errorMessage);
 
 private:
   fileReader();
+  fileReader(const fileReader&);
+  fileReader& operator=(const fileReader&);
+
+  /// Releases the mapped pages that the cursor has passed, once they add up
+  /// to a few MB, so that the resident set does not grow with the file size.
+  void releaseConsumed();
+
+  //--- Private member data.
+  // Contents of the file, and the cursor into them.
+  const char* bufBeg;
+  const char* bufCur;
+  const char* bufEnd;
+  bool atEOF;
+  bool exitOnError;
+  int errorCt;
+  // Start and length of the mapping, if the file is memory-mapped, and start
+  // of the pages not yet released.  Only {mapKeep} is set for a part of a
+  // file mapped by another reader.
+  void* mapAddr;
+  size_t mapLen;
+  const char* mapKeep;
+  // Contents of the file, if the file is not memory-mapped.
+  std::string bufData;
 };
 
 
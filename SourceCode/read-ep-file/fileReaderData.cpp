@@ -35,6 +35,10 @@ const std::string IDF_DELIMITERS_ENTRY   = ",";   // {entryDel}
 const std::string IDF_DELIMITERS_SECTION = ";";   // {sectionDel}
 const std::string IDF_DELIMITERS_ALL     = ",;";  // {delimiter}
 const std::string IDF_COMMENT_CHARS = "!";
+//
+const fileReaderCharClass IDF_CHAR_CLASS_ENTRY(IDF_DELIMITERS_ENTRY, IDF_COMMENT_CHARS, IDF_COMMENT_CHARS);
+const fileReaderCharClass IDF_CHAR_CLASS_SECTION(IDF_DELIMITERS_SECTION, IDF_COMMENT_CHARS, IDF_COMMENT_CHARS);
+const fileReaderCharClass IDF_CHAR_CLASS_ALL(IDF_DELIMITERS_ALL, IDF_COMMENT_CHARS, IDF_COMMENT_CHARS);
 
 
 //--- File-scope fcn prototypes.
@@ -47,7 +51,9 @@ const std::string IDF_COMMENT_CHARS = "!";
 //
 fileReaderData::fileReaderData(const std::string& fname,
   const string& entryDel, const std::string& sectionDel) :
-  fileReader(fname) {
+  fileReader(fname),
+  delimiterClass(entryDel + sectionDel, IDF_COMMENT_CHARS, IDF_COMMENT_CHARS),
+  sectionDelimiterClass(sectionDel, IDF_COMMENT_CHARS, IDF_COMMENT_CHARS) {
   //
   entryDelimiter = entryDel;
   sectionDelimiter = sectionDel;
@@ -63,6 +69,19 @@ fileReaderData::fileReaderData(const std::string& fname,
 // hoho dml  Consider returning number of entries read (negative value on failure).
 //
 bool fileReaderData::getValues(const string& desc, vString& strVals, vDouble& dblVals){
+  //
+  const bool gotValues = getValues(desc, spanVals, dblVals);
+  strVals.clear();
+  for( size_t idx=0; idx<spanVals.size(); ++idx ){
+    strVals.push_back(spanVals[idx].str());
+  }
+  return gotValues;
+}  // End method fileReaderData::getValues().
+
+
+//--- Read string and double values from the IDF file, without copying.
+//
+bool fileReaderData::getValues(const string& desc, vSpan& strVals, vDouble& dblVals){
   //
   int descIdx = -1;
   //
@@ -74,13 +93,13 @@ bool fileReaderData::getValues(const string& desc, vString& strVals, vDouble& db
     // Here, assume ready to read an entry of type desc[descIdx] from the IDF file.
     int lineNo;
     // Get next entry.
-    skipComment(IDF_COMMENT_CHARS, lineNo);
-    string entry;
-    getToken(delimiter, IDF_COMMENT_CHARS, entry);
+    skipComment(delimiterClass, lineNo);
+    fileReaderSpan entry;
+    getToken(delimiterClass, entry);
     // Consume delimiter that marked end of {entry} in IDF file.
     const char delimChar = getChar();
     // Parse the entry.
-    trimEnd(entry);
+    entry.len = trimEndLength(entry.beg, entry.len);
     if( desc[descIdx] == 'A' ){
       // Here, {entry} should be a string.
       strVals.push_back(entry);
@@ -88,17 +107,17 @@ bool fileReaderData::getValues(const string& desc, vString& strVals, vDouble& db
     else if( desc[descIdx] == 'N' ){
       // Here, {entry} should be number.
       double temp;
-      if( !strToDbl(entry, temp) ) {
+      if( !strToDbl(entry.beg, entry.len, temp) ) {
         // Failed to read number.
         string markedDesc;
         std::ostringstream os;
         iddMap_markDescriptorIdx(desc, descIdx, markedDesc);
         if( errno != ERANGE )
-          os << "Expected a number, received '" << entry;
+          os << "Expected a number, received '" << entry.str();
         else if( temp == 0 )
-          os << "Underflow, received '" << entry;
+          os << "Underflow, received '" << entry.str();
         else
-          os << "Overflow, received '" << entry;
+          os << "Overflow, received '" << entry.str();
         os << "', while reading entry #" << descIdx+1 <<
           " according to dictionary descriptor '" << markedDesc << "' (at <>).";
         reportError(os);
@@ -129,7 +148,7 @@ bool fileReaderData::getValues(const string& desc, vString& strVals, vDouble& db
     // ** Got end-of-section delimiter, even though {desc} declares there are
     // more entries.  This is not an error, since some input sections have a
     // variable count of values.
-    if( containsChar(sectionDelimiter, delimChar) ){
+    if( 0 != (sectionDelimiterClass.classOf(delimChar) & fileReaderCharClass::DELIMITER) ){
       // hoho dml  If hard-code {sectionDelimiter}, since know it's a single
       // character, could make test simpler above.
       // Here, IDF file has a section delimiter.  Note it's OK if {desc} says
@@ -160,19 +179,56 @@ bool fileReaderData::skipSection(void)
   //   Assume not currently in a comment.
   if( ! isEOF() )
     {
-    while( 1 )
+    // Move to the section delimiter, then consume it.  If there is none,
+    // getChar() hits end-of-file.
+    skipToClass(sectionDelimiterClass, fileReaderCharClass::DELIMITER);
+    getChar();
+    }
+  //
+  return( isEOF() );
+  }  // End method fileReaderData::skipSection().
+
+
+//--- Split the contents into parts at section delimiters.
+//
+//   Split near even shares of the contents.  From each nominal split, move to
+// the start of the next line, which cannot be in a comment.  Then take the
+// first section delimiter that comes before a comment character on its line.
+//
+void fileReaderData::splitAtSections(int partCt, std::vector<const char*>& partBounds) const
+  {
+  const char* beg;
+  const char* end;
+  getContents(beg, end);
+  const size_t partLen = (size_t)(end - beg) / (0 < partCt ? partCt : 1);
+  //
+  partBounds.clear();
+  partBounds.push_back(beg);
+  for( int partIdx=1; partIdx<partCt; ++partIdx )
+    {
+    const char* cur = beg + partIdx*partLen;
+    if( cur < partBounds.back() )
+      cur = partBounds.back();
+    cur = sectionDelimiterClass.find(cur, end, fileReaderCharClass::NEWLINE);
+    while( cur != end )
       {
-      // Get next character.
-      const char ch = getChar();
-      if( containsChar(sectionDelimiter,ch) || isEOF() )
+      // Here, {cur} at a newline.
+      cur = sectionDelimiterClass.find(cur+1, end,
+        fileReaderCharClass::DELIMITER | fileReaderCharClass::COMMENT | fileReaderCharClass::NEWLINE);
+      if( cur == end )
+        break;
+      const int chClass = sectionDelimiterClass.classOf(*cur);
+      if( 0 != (chClass & fileReaderCharClass::DELIMITER) )
         {
-        // Here, reached end-of-section or end-of-file.
-        // hoho dml  If hard-code {sectionDelimiter}, since know it's a single
-        // character, could make test simpler above.
+        ++cur;
         break;
         }
+      if( 0 != (chClass & fileReaderCharClass::COMMENT) )
+        cur = sectionDelimiterClass.find(cur, end, fileReaderCharClass::NEWLINE);
       }
+    if( cur == end )
+      break;
+    partBounds.push_back(cur);
     }
-  //
-  return( isEOF() );
-  }  // End method fileReaderData::skipSection().
+  partBounds.push_back(end);
+  }  // End method fileReaderData::splitAtSections().
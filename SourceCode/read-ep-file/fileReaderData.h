@@ -21,6 +21,7 @@
 // hoho dml  To be useful, these typedefs probably should shift to a different header file.
 typedef std::vector<std::string> vString;
 typedef std::vector<double> vDouble;
+typedef std::vector<fileReaderSpan> vSpan;
 
 
 //--- Convenience constants.
@@ -31,6 +32,13 @@ extern const std::string IDF_DELIMITERS_ENTRY;   // {entryDel}
 extern const std::string IDF_DELIMITERS_SECTION;   // {sectionDel}
 extern const std::string IDF_DELIMITERS_ALL;
 extern const std::string IDF_COMMENT_CHARS;
+//
+/// Classes of the characters above, for scanning.  Each treats
+/// {IDF_COMMENT_CHARS} as comment and illegal characters.
+//
+extern const fileReaderCharClass IDF_CHAR_CLASS_ENTRY;
+extern const fileReaderCharClass IDF_CHAR_CLASS_SECTION;
+extern const fileReaderCharClass IDF_CHAR_CLASS_ALL;
 
 
 ///////////////////////////////////////////////////////
@@ -51,16 +59,42 @@ public:
   /// \return \c true if input reading was successful, \c false otherwise
   bool getValues(const std::string& desc, vString& strVals, vDouble& dblVals);
 
+  /// Get the string and double input values from the IDF file, without
+  /// copying the strings.
+  ///   As the method above, but \c strVals holds spans of the file, which
+  /// stay valid until the file is closed.  Reusing \c strVals and
+  /// \c dblVals from one call to the next avoids any allocation.
+  /// \param desc order in which the double and string values are to
+  ///           be read from the input file stream (e.g., "AANA")
+  /// \param strVals vector that contains the string values after execution
+  /// \param dblVals vector that contains the double values after execution
+  /// \return \c true if input reading was successful, \c false otherwise
+  bool getValues(const std::string& desc, vSpan& strVals, vDouble& dblVals);
+
   /// Skip a section in the IDF file.
   /// \return \c true if hit end-of-file, \c false otherwise
   bool skipSection(void);
 
+  /// Split the contents of the open file into parts, each but the last
+  /// ending just after a section delimiter that is not in a comment.
+  ///   A reader opened on one part, with \c openPart(), starts where a
+  /// reader of the whole file would look for the next keyword.
+  /// \param partCt Count of parts wanted.  Gives fewer if the file does
+  ///           not have enough sections.
+  /// \retval partBounds Start of each part, then the end of the contents.
+  void splitAtSections(int partCt, std::vector<const char*>& partBounds) const;
+
 protected:
 
   /// Input data dictionary.
   std::string entryDelimiter;
   std::string sectionDelimiter;
   std::string delimiter;
+  /// Classes of the characters in {delimiter} and {sectionDelimiter}.
+  fileReaderCharClass delimiterClass;
+  fileReaderCharClass sectionDelimiterClass;
+  /// Scratch space for getValues().
+  vSpan spanVals;
 
 private:
   fileReaderData();
@@ -11,6 +11,7 @@
 using std::string;
 
 #include <sstream>
+#include <set>
 
 #include "fileReaderDictionary.h"
 
@@ -32,6 +33,10 @@ static const std::string IDD_DELIMITERS = ",;";
 static const std::string IDD_COMMENT_CHARS_TOKEN = "!";
 static const std::string IDD_COMMENT_CHARS_COMMENT = "!\\";
 
+// Classes of the characters above, for scanning.
+static const fileReaderCharClass IDD_CHAR_CLASS(IDD_DELIMITERS,
+  IDD_COMMENT_CHARS_COMMENT, IDD_COMMENT_CHARS_TOKEN);
+
 
 //--- File-scope fcn prototypes.
 
@@ -46,15 +51,15 @@ bool fileReaderDictionary::getKeywordAndDescriptor(string& keyword, string& desc
   //
   do{
     int lineNo;
-    skipComment(IDD_COMMENT_CHARS_COMMENT, lineNo);
+    skipComment(IDD_CHAR_CLASS, lineNo);
     if( onKeyword ){
-      getToken(IDD_DELIMITERS, IDD_COMMENT_CHARS_TOKEN, keyword);
+      getToken(IDD_CHAR_CLASS, keyword);
       capitalize(keyword);
       onKeyword = 0;
     }
     else{
       string s;
-      getToken(IDD_DELIMITERS, IDD_COMMENT_CHARS_TOKEN, s);
+      getToken(IDD_CHAR_CLASS, s);
       if( ! containsChar("AN;", s[0]) ){
         std::ostringstream os;
         os << "For IDD keyword " << keyword
@@ -66,11 +71,11 @@ bool fileReaderDictionary::getKeywordAndDescriptor(string& keyword, string& desc
       if (s[0] != ';')
         desc += s[0];
     }
-    skipComment(IDD_COMMENT_CHARS_COMMENT, lineNo);
+    skipComment(IDD_CHAR_CLASS, lineNo);
     if (isEOF())
       return true;
     ch = getChar();
-    if( ! containsChar(IDD_DELIMITERS, ch) ){
+    if( 0 == (IDD_CHAR_CLASS.classOf(ch) & fileReaderCharClass::DELIMITER) ){
       std::ostringstream os;
       os << "Expecting a delimiter '" << IDD_DELIMITERS << "', got '" << ch << "'.";
       fileReader::reportError(os);
@@ -85,19 +90,70 @@ bool fileReaderDictionary::getKeywordAndDescriptor(string& keyword, string& desc
 ///////////////////////////////////////////////////////
 void fileReaderDictionary::getMap(iddMap& idd){
   //
-  while (! isEOF() ){
-    string kw = "";
-    string desc = "";
-    if( ! getKeywordAndDescriptor(kw, desc) ){
-      std::ostringstream os;
-      os << "fileReaderDictionary::getMap(): Exit with error.";
-      fileReader::reportError(os);
-      exit(1);
-    }
+  const std::vector<string> noKeys;
+  getMap(idd, noKeys);
+}
+
+
+///////////////////////////////////////////////////////
+void fileReaderDictionary::getMap(iddMap& idd, const std::vector<string>& requiredKeys){
+  //
+  // Keywords still to be found.
+  //   If none were requested, read the whole file.
+  std::set<string> pendingKeys(requiredKeys.begin(), requiredKeys.end());
+  const bool stopEarly = ! pendingKeys.empty();
+  //
+  string kw, desc;
+  while( getNextEntry(kw, desc) ){
     // Store new keyword and descriptor.
     // hoho dml  Note no check whether overwriting an existing entry.
     idd[kw] = desc;
-    int lineNo;
-    skipComment(IDD_COMMENT_CHARS_COMMENT, lineNo);
+    if( stopEarly && 0 != pendingKeys.erase(kw) && pendingKeys.empty() )
+      break;
+  }// end while
+}
+
+
+///////////////////////////////////////////////////////
+void fileReaderDictionary::getMap(iddTable& idd){
+  //
+  const std::vector<string> noKeys;
+  getMap(idd, noKeys);
+}
+
+
+///////////////////////////////////////////////////////
+void fileReaderDictionary::getMap(iddTable& idd, const std::vector<string>& requiredKeys){
+  //
+  std::set<string> pendingKeys(requiredKeys.begin(), requiredKeys.end());
+  const bool stopEarly = ! pendingKeys.empty();
+  //
+  string kw, desc;
+  while( getNextEntry(kw, desc) ){
+    idd.setDescriptor(kw, desc);
+    if( stopEarly && 0 != pendingKeys.erase(kw) && pendingKeys.empty() )
+      break;
   }// end while
 }
+
+
+///////////////////////////////////////////////////////
+bool fileReaderDictionary::getNextEntry(string& keyword, string& desc){
+  //
+  if( isEOF() )
+    return false;
+  //
+  keyword.clear();
+  desc.clear();
+  if( ! getKeywordAndDescriptor(keyword, desc) ){
+    std::ostringstream os;
+    os << "fileReaderDictionary::getMap(): Exit with error.";
+    fileReader::reportError(os);
+    if( getExitOnError() )
+      exit(1);
+    return false;
+  }
+  int lineNo;
+  skipComment(IDD_CHAR_CLASS, lineNo);
+  return true;
+}
@@ -12,6 +12,8 @@
 #define __FILEREADERDICTIONARY_H__
 
 
+#include <vector>
+
 #include "fileReader.h"
 
 #include "ep-idd-map.h"
@@ -39,12 +41,59 @@ class fileReaderDictionary : public fileReader {
   ///  After execution, all keywords and their descriptors are stored
   ///  in the argument \c idd.
   ///
-  ///  \note In case of input error, the program terminates.
+  ///  \note In case of input error, the program terminates, unless exit on
+  ///  error is turned off.
   ///
   /// \pre This method requires the input file stream to be open.
   /// \retval idd Map that contains the keywords and their descriptors.
   void getMap(iddMap& idd);
 
+  /// Gets keywords and their data descriptors from the input file stream,
+  ///  stopping as soon as all of \c requiredKeys have been read.
+  ///
+  ///  Use this when only a few entries of the dictionary are of interest.
+  ///  Entries read before the last required keyword are kept in \c idd as
+  ///  well.  If some required keywords are missing, reads the whole file.
+  ///
+  ///  \note In case of input error, the program terminates, unless exit on
+  ///  error is turned off.
+  ///
+  /// \pre This method requires the input file stream to be open.
+  /// \param requiredKeys Capitalized keywords to look for.
+  /// \retval idd Map that contains the keywords and their descriptors.
+  void getMap(iddMap& idd, const std::vector<std::string>& requiredKeys);
+
+  /// Gets all keywords and their corresponding data descriptors from
+  ///  the input file stream, into an \c iddTable.
+  ///
+  ///  \note In case of input error, the program terminates, unless exit on
+  ///  error is turned off.
+  ///
+  /// \pre This method requires the input file stream to be open.
+  /// \retval idd Table that contains the keywords and their descriptors.
+  void getMap(iddTable& idd);
+
+  /// Gets keywords and their data descriptors into an \c iddTable,
+  ///  stopping as soon as all of \c requiredKeys have been read.
+  ///
+  ///  \note In case of input error, the program terminates, unless exit on
+  ///  error is turned off.
+  ///
+  /// \pre This method requires the input file stream to be open.
+  /// \param requiredKeys Capitalized keywords to look for.
+  /// \retval idd Table that contains the keywords and their descriptors.
+  void getMap(iddTable& idd, const std::vector<std::string>& requiredKeys);
+
+  private:
+
+  /// Gets the next keyword and descriptor, and skips the comments after them.
+  ///
+  ///  \note In case of input error, the program terminates.  If exit on error
+  ///  is turned off, returns \c false instead, with the error counted.
+  ///
+  /// \return \c false if already at the end of the file.
+  bool getNextEntry(std::string& keyword, std::string& desc);
+
 };
 
 
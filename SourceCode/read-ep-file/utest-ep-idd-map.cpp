@@ -9,6 +9,11 @@
 //--- Includes.
 #include <assert.h>
 
+#include <cstdio>
+#include <fstream>
+
+#include <sstream>
+
 #include <string>
 using std::string;
 
@@ -100,6 +105,111 @@ int main(int argc, const char* argv[]) {
   assert( 0 == errStr.compare("Input data dictionary does not contain key 'keyMissing'"
     "\nFor key 'key1', input data dictionary has descriptor 'AA', but expecting 'ANANAN'") );
   //
+  //-- Test class iddTable.
+  iddTable iddTab;
+  iddTab.assign(idd);
+  assert( 3 == iddTab.size() );
+  //
+  assert( iddMap_getDescriptor(iddTab, key1, descGot) );
+  assert( desc1 == descGot );
+  assert( iddMap_getDescriptor(iddTab, key2, descGot) );
+  assert( desc2 == descGot );
+  assert( iddMap_getDescriptor(iddTab, keyBad, descGot) );
+  assert( descBad == descGot );
+  assert( ! iddMap_getDescriptor(iddTab, keyMissing, descGot) );
+  assert( 0 == descGot.compare("") );
+  //
+  size_t entryIdx;
+  assert( iddTab.find(key2, entryIdx) );
+  assert( key2 == iddTab.getKey(entryIdx) );
+  iddTab.getDescriptorTypeCounts(entryIdx, strCt, dblCt);
+  assert( 3 == strCt );
+  assert( 3 == dblCt );
+  assert( iddTab.descriptorEquals(entryIdx, desc2) );
+  assert( ! iddTab.descriptorEquals(entryIdx, "ANANAA") );
+  assert( ! iddTab.descriptorEquals(entryIdx, "ANANA") );
+  //
+  assert( iddTab.find(keyBad, entryIdx) );
+  iddTab.getDescriptorTypeCounts(entryIdx, strCt, dblCt);
+  assert( 4 == strCt );
+  assert( 2 == dblCt );
+  assert( iddTab.descriptorEquals(entryIdx, descBad) );
+  //
+  // Should give same messages as for an {iddMap}.
+  string errStrTab;
+  assert( 0 == iddMap_compareEntry(iddTab, key1, desc1, errStrTab) );
+  assert( 1 == iddMap_compareEntry(iddTab, keyMissing, desc1, errStrTab) );
+  assert( 2 == iddMap_compareEntry(iddTab, key1, desc2, errStrTab) );
+  assert( errStr == errStrTab );
+  //
+  // Should replace descriptor of an existing keyword, keeping its number.
+  assert( iddTab.find(key1, entryIdx) );
+  iddTab.setDescriptor(key1, desc2);
+  size_t entryIdxAgain;
+  assert( iddTab.find(key1, entryIdxAgain) );
+  assert( entryIdx == entryIdxAgain );
+  assert( 3 == iddTab.size() );
+  assert( iddMap_getDescriptor(iddTab, key1, descGot) );
+  assert( desc2 == descGot );
+  //
+  // Should keep finding keywords as the table grows.
+  for( int idx=0; idx<1000; ++idx ){
+    std::ostringstream key;
+    key << "KEY:" << idx;
+    iddTab.setDescriptor(key.str(), string(idx%70, 'A') + "N");
+  }
+  assert( 1003 == iddTab.size() );
+  for( int idx=0; idx<1000; ++idx ){
+    std::ostringstream key;
+    key << "KEY:" << idx;
+    assert( iddMap_getDescriptor(iddTab, key.str(), descGot) );
+    assert( string(idx%70, 'A') + "N" == descGot );
+  }
+  assert( iddMap_getDescriptor(iddTab, key2, descGot) );
+  assert( desc2 == descGot );
+  //
+  //-- Test fcns iddMap_writeSnapshot() and iddMap_readSnapshot().
+  const char *const snapFileName = "utest-ep-idd-map.snap";
+  const char *const md5Hex = "0123456789abcdef0123456789abcdef";
+  const char *const md5HexOther = "fedcba9876543210fedcba9876543210";
+  {
+    std::ofstream snapStream(snapFileName, std::ios::out | std::ios::trunc | std::ios::binary);
+    assert( iddMap_writeSnapshot(snapStream, idd, md5Hex) );
+  }
+  iddMap iddSnap;
+  assert( iddMap_readSnapshot(snapFileName, md5Hex, iddSnap) );
+  assert( idd == iddSnap );
+  //
+  // Should reject a snapshot of a different IDD file.
+  assert( ! iddMap_readSnapshot(snapFileName, md5HexOther, iddSnap) );
+  assert( iddSnap.empty() );
+  //
+  // Should reject a snapshot whose length does not match its header.
+  {
+    std::ofstream snapStream(snapFileName, std::ios::out | std::ios::app | std::ios::binary);
+    snapStream.put('x');
+  }
+  assert( ! iddMap_readSnapshot(snapFileName, md5Hex, iddSnap) );
+  assert( iddSnap.empty() );
+  //
+  // Should move between an {iddMap} and an {iddTable}.
+  {
+    std::ofstream snapStream(snapFileName, std::ios::out | std::ios::trunc | std::ios::binary);
+    assert( iddMap_writeSnapshot(snapStream, iddTab, md5Hex) );
+  }
+  assert( iddMap_readSnapshot(snapFileName, md5Hex, iddSnap) );
+  assert( iddTab.size() == iddSnap.size() );
+  assert( desc2 == iddSnap[key1] );
+  iddTable iddTabSnap;
+  assert( iddMap_readSnapshot(snapFileName, md5Hex, iddTabSnap) );
+  assert( iddTab.size() == iddTabSnap.size() );
+  assert( iddMap_getDescriptor(iddTabSnap, keyBad, descGot) );
+  assert( descBad == descGot );
+  //
+  // Should reject a missing snapshot.
+  remove(snapFileName);
+  assert( ! iddMap_readSnapshot(snapFileName, md5Hex, iddSnap) );
+  //
   return( 0 );
 }  // End fcn main().
 
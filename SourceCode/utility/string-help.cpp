@@ -9,6 +9,7 @@
 //--- Includes.
 //
 #include <algorithm>
+#include <cctype>
 
 #include "string-help.h"
 
@@ -44,9 +45,61 @@ void trimEnd(std::string& str){
 }  // End fcn trimEnd().
 
 
+//--- Find length of a character range without trailing spaces.
+//
+size_t trimEndLength(const char* str, size_t len){
+  while( len > 1 && str[len-1] == ' ' )
+    --len;
+  return( len );
+}  // End fcn trimEndLength().
+
+
+//--- Read a double value out of a character range.
+//
+//   Copy the range, so that strtod() cannot read past it.  Short ranges, which
+// are all that hold a number in practice, go to the stack.
+//
+bool strToDbl(const char* str, size_t len, double& dbl){
+  char buf[64];
+  std::string longStr;
+  const char* pBeg;
+  if( len < sizeof(buf) ){
+    memcpy(buf, str, len);
+    buf[len] = '\0';
+    pBeg = buf;
+  }
+  else{
+    longStr.assign(str, len);
+    pBeg = longStr.c_str();
+  }
+  char* pEnd;
+  dbl = strtod(pBeg, &pEnd);
+  return ( (size_t)(pEnd-pBeg)==strlen(pBeg) && (errno!=ERANGE) );
+}  // End fcn strToDbl().
+
+
 //--- Capitalize a string.
 //
 void capitalize(std::string& str)
   {
   transform(str.begin(), str.end(), str.begin(), toupper);
   }  // End fcn capitalize().
+
+
+//--- Compare a character range, capitalized, to a string.
+//
+bool equalsCapitalized(const std::string& upper, const char* str, size_t len)
+  {
+  if( len != upper.length() )
+    {
+    return( false );
+    }
+  for( size_t idx=0; idx<len; ++idx )
+    {
+    if( toupper((unsigned char)str[idx]) != (unsigned char)upper[idx] )
+      {
+      return( false );
+      }
+    }
+  return( true );
+  }  // End fcn equalsCapitalized().
@@ -35,6 +35,17 @@ extern bool containsChar(const std::string& expected, const char received);
 extern void trimEnd(std::string& str);
 
 
+/// Find the length of a character range without its trailing spaces.
+///
+///   As for trimEnd(), keep the first character, even if it is a space.
+///
+/// \param str First character of the range.
+/// \param len Count of characters in the range.
+/// \return Count of characters that trimEnd() would keep.
+///
+extern size_t trimEndLength(const char* str, size_t len);
+
+
 /// Read a double value out of a string.
 ///
 inline bool strToDbl(const std::string& str, double& dbl){
@@ -45,11 +56,27 @@ inline bool strToDbl(const std::string& str, double& dbl){
 }
 
 
+/// Read a double value out of a character range, which need not be
+/// null-terminated.
+///
+extern bool strToDbl(const char* str, size_t len, double& dbl);
+
+
 /// Capitalize a string.
 ///
 extern void capitalize(std::string& str);
 
 
+/// Check whether a character range, capitalized, equals a string.
+///
+/// \param upper Capitalized string.
+/// \param str First character of the range.
+/// \param len Count of characters in the range.
+/// \return \c true if capitalize() would turn the range into \c upper.
+///
+extern bool equalsCapitalized(const std::string& upper, const char* str, size_t len);
+
+
 #endif // __STRING_HELP_H__
 
 
@@ -86,6 +86,24 @@ int main(int argc, const char* argv[]) {
   s = "1.2 y";
   assert( ! strToDbl(s,dbl) );
   //
+  //-- Test fcn strToDbl() on character ranges.
+  s = "-4.6e2,";
+  assert( strToDbl(s.c_str(), 6, dbl) );
+  assert( fabs(dbl+460) < 1e-18 );
+  //
+  assert( ! strToDbl(s.c_str(), 7, dbl) );
+  //
+  s = string(100, '0') + "1.5";
+  assert( strToDbl(s.c_str(), s.length(), dbl) );
+  assert( fabs(dbl-1.5) < 1e-18 );
+  //
+  //-- Test fcn trimEndLength().
+  assert( 4 == trimEndLength("1234  ", 6) );
+  assert( 9 == trimEndLength("123 567 9   ", 12) );
+  assert( 4 == trimEndLength("123\t ", 5) );
+  assert( 1 == trimEndLength("   ", 3) );
+  assert( 0 == trimEndLength("", 0) );
+  //
   //-- Test fcn capitalize().
   s = "a";
   capitalize(s);
@@ -99,6 +117,12 @@ int main(int argc, const char* argv[]) {
   capitalize(s);
   assert( 0 == s.compare("ABC") );
   //
+  //-- Test fcn equalsCapitalized().
+  assert( equalsCapitalized("ABC", "aBc,", 3) );
+  assert( ! equalsCapitalized("ABC", "aBc,", 4) );
+  assert( ! equalsCapitalized("ABC", "aBd", 3) );
+  assert( equalsCapitalized("", "", 0) );
+  //
   s = "a2b1 c ";
   capitalize(s);
   assert( 0 == s.compare("A2B1 C ") );
@@ -93,6 +93,16 @@ void reportInputError(std::ostringstream& errorMessage,
   flushLogStream(os);
 }
 
+void reportInputError(std::ostringstream& errorMessage, 
+    const string& fileName, 
+    const int lineNo,
+    const string& logDirName){
+  std::ostringstream os;
+  os << "=== Input Error ===" << endl
+     << "File " << fileName << ", line " << lineNo << ": " << errorMessage.str() << endl << endl;
+  flushLogStream(os, logDirName);
+}
+
 void reportInputError(const string& functionName, std::ostringstream& errorMessage){
   std::ostringstream os;
   os << "=== Input error ===" << endl 
@@ -110,9 +120,14 @@ void reportInputError(std::ostringstream& errorMessage){
 
 
 void flushLogStream(std::ostringstream& errorMessage){
-  std::ofstream ofs(LOGFILENAME.c_str(), std::ios::app);
+  flushLogStream(errorMessage, "");
+}
+
+void flushLogStream(std::ostringstream& errorMessage, const string& logDirName){
+  const string logFileName = logDirName + LOGFILENAME;
+  std::ofstream ofs(logFileName.c_str(), std::ios::app);
   if (!ofs.is_open())
-    cerr << "Cannot open log file '" << LOGFILENAME << "'." << endl;
+    cerr << "Cannot open log file '" << logFileName << "'." << endl;
   else{
     ofs << errorMessage.str();
     ofs.close();
@@ -63,6 +63,17 @@ extern void reportInputError(std::ostringstream& errorMessage,
            const std::string& fileName, 
            const int lineNo);
 
+/// Reports an input error to the log file in a given folder.
+/// This method does NOT exit the program.
+/// \param errorMessage Error message to be appended to file name and line number.
+/// \param fileName File name where input error occured.
+/// \param lineNo Line number where input error occured.
+/// \param logDirName Folder of the log file, ending with a path separator.
+extern void reportInputError(std::ostringstream& errorMessage, 
+           const std::string& fileName, 
+           const int lineNo,
+           const std::string& logDirName);
+
 /// Reports an input error. This method does NOT exit the program.
 /// \param FunctionName name of function where error has been detected.
 /// \param ErrorMessage error message.
@@ -77,6 +88,11 @@ extern void reportInputError(std::ostringstream& errorMessage);
 /// \param errorMessage Error message.
 extern void flushLogStream(std::ostringstream& errorMessage);
 
+/// Flushs the error message to \c cerr and to the log file in a given folder.
+/// \param errorMessage Error message.
+/// \param logDirName Folder of the log file, ending with a path separator.
+extern void flushLogStream(std::ostringstream& errorMessage, const std::string& logDirName);
+
 /// Writes the header of the log file.
 extern void writeLogHeader();
 /// Print optional string \c optStr followed by